@@ -0,0 +1,181 @@
+#include <benchmark/benchmark.h>
+#include "../src/Bvh.h"
+#include "../src/Mesh.h"
+#include "../src/ThreadPool.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace crt;
+
+namespace {
+    /**
+     * Bounds of small random triangles on a wavy height field, roughly what a dense scan looks like.
+     */
+    std::vector<BoundingBox<float>> makeScanBounds(size_t count) {
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> position(0.0f, 1000.0f);
+        std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+        std::vector<BoundingBox<float>> bounds(count);
+        for (auto& box: bounds) {
+            const auto x = position(random);
+            const auto z = position(random);
+            const Vector3f base{x, 50.0f * std::sin(x * 0.02f) * std::cos(z * 0.03f), z};
+            box.expand(base);
+            box.expand(base + Vector3f{offset(random), offset(random), offset(random)});
+            box.expand(base + Vector3f{offset(random), offset(random), offset(random)});
+        }
+        return bounds;
+    }
+
+    /**
+     * BVH build over range(1) primitives with the BvhBuildMethod in range(0), on a pool of every core.
+     */
+    void BM_BvhBuild(benchmark::State& state) {
+        const auto bounds = makeScanBounds(static_cast<size_t>(state.range(1)));
+        ThreadPool threadPool;
+        BvhBuildOptions options;
+        options.leafBlockSize = 8;
+        options.method = static_cast<BvhBuildMethod>(state.range(0));
+        options.threadPool = &threadPool;
+        Bvh bvh;
+        for (auto _: state) {
+            bvh.build(bounds, options);
+            benchmark::DoNotOptimize(bvh.getNodes().data());
+        }
+        state.counters["sah"] = bvh.getStatistics().sahCost;
+        state.counters["depth"] = static_cast<double>(bvh.getStatistics().maxDepth);
+        state.SetItemsProcessed(state.iterations() * state.range(1));
+    }
+
+    BENCHMARK(BM_BvhBuild)
+            ->ArgNames({"method", "primitives"})
+            ->Args({static_cast<int>(BvhBuildMethod::Sah), 1 << 20})
+            ->Args({static_cast<int>(BvhBuildMethod::Lbvh), 1 << 20})
+            ->Args({static_cast<int>(BvhBuildMethod::Ploc), 1 << 20})
+            ->Args({static_cast<int>(BvhBuildMethod::Lbvh), 10'000'000})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+
+    /**
+     * Height field of (range(1) + 1)^2 vertices over 1000 x 1000 units, two triangles per grid cell.
+     */
+    Mesh makeTerrainMesh(int resolution, const BvhBuildOptions& bvhOptions, MeshStorage storage) {
+        std::vector<Vector3f> points;
+        for (int z = 0; z <= resolution; ++z) {
+            for (int x = 0; x <= resolution; ++x) {
+                const auto px = 1000.0f * static_cast<float>(x) / static_cast<float>(resolution);
+                const auto pz = 1000.0f * static_cast<float>(z) / static_cast<float>(resolution);
+                points.push_back({px, 50.0f * std::sin(px * 0.02f) * std::cos(pz * 0.03f), pz});
+            }
+        }
+        std::vector<Vector3i> indices;
+        for (int z = 0; z < resolution; ++z) {
+            for (int x = 0; x < resolution; ++x) {
+                const int i = z * (resolution + 1) + x;
+                indices.emplace_back(i, i + resolution + 1, i + 1);
+                indices.emplace_back(i + 1, i + resolution + 1, i + resolution + 2);
+            }
+        }
+        return {std::move(points), std::move(indices), bvhOptions, storage};
+    }
+
+    /**
+     * Closest hits of incoherent rays against a terrain mesh traversed through a tree of width range(0), stored
+     * compact when range(2) is 1. The nodes counter is the size of the traversed nodes in bytes per triangle,
+     * bytes the whole mesh.
+     */
+    void BM_MeshHit(benchmark::State& state) {
+        BvhBuildOptions options;
+        options.width = static_cast<uint32_t>(state.range(0));
+        const auto storage = state.range(2) != 0 ? MeshStorage::Compact : MeshStorage::Full;
+        const auto mesh = makeTerrainMesh(static_cast<int>(state.range(1)), options, storage);
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> position(0.0f, 1000.0f);
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        std::vector<Ray> rays;
+        for (int i = 0; i < 1 << 16; ++i) {
+            const Vector3f origin{position(random), 200.0f, position(random)};
+            rays.push_back({origin, Vector3f{direction(random), -1.0f, direction(random)}.normalize()});
+        }
+
+        size_t i = 0;
+        for (auto _: state) {
+            HitRecord hitRecord{};
+            benchmark::DoNotOptimize(mesh.hit(rays[i], 0.0f, std::numeric_limits<float>::max(), hitRecord));
+            i = i + 1 == rays.size() ? 0 : i + 1;
+        }
+        const auto nodeBytes = mesh.getBvh().getNodes().size() * sizeof(BvhNode) +
+                               mesh.getLeafBlocks().size() * sizeof(uint32_t) +
+                               mesh.getWideBvh4().getNodes().size() * sizeof(WideBvhNode<4>) +
+                               mesh.getWideBvh8().getNodes().size() * sizeof(WideBvhNode<8>);
+        const auto triangleCount = static_cast<double>(mesh.getTriangleCount());
+        state.counters["nodes"] = static_cast<double>(nodeBytes) / triangleCount;
+        state.counters["bytes"] = static_cast<double>(mesh.getByteSize()) / triangleCount;
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_MeshHit)
+            ->ArgNames({"width", "resolution", "compact"})
+            ->Args({2, 64, 0})
+            ->Args({4, 64, 0})
+            ->Args({8, 64, 0})
+            ->Args({2, 1024, 0})
+            ->Args({4, 1024, 0})
+            ->Args({8, 1024, 0})
+            ->Args({2, 1024, 1})
+            ->Args({8, 1024, 1});
+
+    /**
+     * Per frame preparation of a terrain mesh of width range(0) whose heights ripple from frame to frame: a refit
+     * through Mesh::updatePoints, or a full rebuild when range(1) is 1. sah is the cost of the final tree relative
+     * to a fresh build.
+     */
+    void BM_MeshUpdate(benchmark::State& state) {
+        constexpr int kResolution = 512;
+        constexpr int kFrameCount = 8;
+        ThreadPool threadPool;
+        BvhBuildOptions options;
+        options.width = static_cast<uint32_t>(state.range(0));
+        options.method = BvhBuildMethod::Lbvh;
+        options.threadPool = &threadPool;
+        auto mesh = makeTerrainMesh(kResolution, options, MeshStorage::Full);
+        const auto indices = std::vector<Vector3i>(mesh.getTriangleVertexIndices().begin(),
+                                                   mesh.getTriangleVertexIndices().end());
+        std::vector<std::vector<Vector3f>> frames;
+        for (int frame = 0; frame < kFrameCount; ++frame) {
+            auto& points = frames.emplace_back(mesh.getPoints().begin(), mesh.getPoints().end());
+            for (auto& point: points) {
+                const auto phase = 0.3f * static_cast<float>(frame);
+                point[1] = 50.0f * std::sin(point[0] * 0.02f + phase) * std::cos(point[2] * 0.03f - phase);
+            }
+        }
+
+        size_t frame = 0;
+        for (auto _: state) {
+            if (state.range(1) != 0) {
+                mesh = Mesh(frames[frame], indices, options);
+            } else {
+                mesh.updatePoints(frames[frame], {}, &threadPool);
+            }
+            benchmark::DoNotOptimize(mesh.getBoundingBox());
+            frame = (frame + 1) % frames.size();
+        }
+        const Mesh rebuilt(frames[(frame + frames.size() - 1) % frames.size()], indices, options);
+        const auto getSahCost = [](const Mesh& mesh) {
+            return mesh.getBvhWidth() == 8 ? mesh.getWideBvh8().getSahCost() : mesh.getBvh().getStatistics().sahCost;
+        };
+        state.counters["sah"] = getSahCost(mesh) / getSahCost(rebuilt);
+        state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(mesh.getTriangleCount()));
+    }
+
+    BENCHMARK(BM_MeshUpdate)
+            ->ArgNames({"width", "rebuild"})
+            ->Args({2, 0})
+            ->Args({2, 1})
+            ->Args({8, 0})
+            ->Args({8, 1})
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+}
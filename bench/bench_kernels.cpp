@@ -0,0 +1,133 @@
+#include <benchmark/benchmark.h>
+#include "../src/BoundingBox.h"
+#include "../src/MathUtils.h"
+#include "../src/Matrix.h"
+#include "../src/MatrixUtils.h"
+#include "../src/Sphere.h"
+#include "../src/Texture2D.h"
+
+#include <random>
+#include <vector>
+
+using namespace crt;
+
+namespace {
+    // Inputs cycle through a fixed set, large enough to defeat branch prediction, small enough for L1.
+    constexpr size_t kInputCount = 1024;
+
+    std::vector<Ray> makeRays(uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+        std::uniform_real_distribution<float> target(-2.0f, 2.0f);
+        std::vector<Ray> rays;
+        for (size_t i = 0; i < kInputCount; ++i) {
+            const Vector3f origin{position(random), position(random), 20.0f};
+            rays.push_back({origin, (Vector3f{target(random), target(random), 0.0f} - origin).normalize()});
+        }
+        return rays;
+    }
+
+    void BM_RayIntersectsTriangle(benchmark::State& state) {
+        const auto rays = makeRays(1);
+        const Vector3f v0{-1.5f, -1.5f, 0.0f}, v1{1.5f, -1.5f, 0.5f}, v2{0.0f, 1.5f, -0.5f};
+        size_t i = 0;
+        for (auto _: state) {
+            float t, u, v;
+            benchmark::DoNotOptimize(MathUtils::rayIntersectsTriangle(rays[i], v0, v1, v2, t, u, v));
+            benchmark::DoNotOptimize(t);
+            i = (i + 1) % kInputCount;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_RayIntersectsTriangle);
+
+    void BM_SphereIntersect(benchmark::State& state) {
+        const auto rays = makeRays(2);
+        const Sphere sphere(Vector3f{0.0f, 0.0f, 0.0f}, 1.5f);
+        size_t i = 0;
+        for (auto _: state) {
+            float t;
+            benchmark::DoNotOptimize(sphere.intersect(rays[i], t));
+            benchmark::DoNotOptimize(t);
+            i = (i + 1) % kInputCount;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_SphereIntersect);
+
+    void BM_BoundingBoxHit(benchmark::State& state) {
+        const auto rays = makeRays(3);
+        const BoundingBox<float> box(Vector3f{-1.5f, -1.5f, -1.5f}, Vector3f{1.5f, 1.5f, 1.5f});
+        size_t i = 0;
+        for (auto _: state) {
+            benchmark::DoNotOptimize(box.hit(rays[i], 0.0f, std::numeric_limits<float>::max()));
+            i = (i + 1) % kInputCount;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_BoundingBoxHit);
+
+    /**
+     * Bilinear lookups at random coordinates; range(0) is the footprint in texels, 0 samples the full level.
+     */
+    void BM_TextureGetColor(benchmark::State& state) {
+        const int width = 1024;
+        const int height = 512;
+        std::mt19937 random(4);
+        std::vector<uint8_t> rgb8(static_cast<size_t>(width) * height * 3);
+        for (auto& value: rgb8) {
+            value = static_cast<uint8_t>(random());
+        }
+        const Texture2D texture(width, height, rgb8);
+        std::uniform_real_distribution<float> coordinate(0.0f, 1.0f);
+        std::vector<Vector2f> uvs;
+        for (size_t i = 0; i < kInputCount; ++i) {
+            uvs.push_back({coordinate(random), coordinate(random)});
+        }
+        const auto texels = static_cast<float>(state.range(0));
+        const Vector2f footprint{texels / width, texels / height};
+        size_t i = 0;
+        for (auto _: state) {
+            if (texels > 0.0f) {
+                benchmark::DoNotOptimize(texture.getColor(uvs[i], footprint));
+            } else {
+                benchmark::DoNotOptimize(texture.getColor(uvs[i]));
+            }
+            i = (i + 1) % kInputCount;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_TextureGetColor)->Arg(0)->Arg(4);
+
+    Matrix4f makeTransform(float angle) {
+        return MatrixUtils::translate(1.0f, 2.0f, 3.0f) * MatrixUtils::rotateByY<float>(angle) *
+               MatrixUtils::scale(2.0f, 3.0f, 4.0f);
+    }
+
+    void BM_Matrix4fMultiply(benchmark::State& state) {
+        const auto a = makeTransform(30.0f);
+        const auto b = makeTransform(45.0f);
+        for (auto _: state) {
+            benchmark::DoNotOptimize(a * b);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_Matrix4fMultiply);
+
+    void BM_Matrix4fInverse(benchmark::State& state) {
+        const auto transform = makeTransform(30.0f);
+        Matrix4f inverse;
+        for (auto _: state) {
+            transform.inverseTo(inverse);
+            benchmark::DoNotOptimize(inverse);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_Matrix4fInverse);
+}
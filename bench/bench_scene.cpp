@@ -0,0 +1,122 @@
+#include <benchmark/benchmark.h>
+#include "../src/DemoScene.h"
+#include "../src/MatrixUtils.h"
+#include "../src/Renderer.h"
+#include "../src/Scene.h"
+#include "../src/WavefrontTracer.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace crt;
+
+namespace {
+    constexpr int kFrameWidth = 640;
+    constexpr int kFrameHeight = 480;
+
+    /**
+     * The default scene of main, seen from the same camera. Loaded once and shared by all benchmarks.
+     */
+    struct DragonScene {
+        Scene scene;
+        std::vector<LightSource> lightSources = DemoScene::getLightSources();
+        std::vector<Ray> cameraRays;
+        std::string error;
+        bool loaded = false;
+
+        DragonScene() {
+            if (!DemoScene::build(scene, CRT_RESOURCE_DIR, {}, MeshStorage::Full, true, error)) {
+                return;
+            }
+
+            const auto cameraOrigin = DemoScene::getCameraOrigin();
+            const auto camera2world = MatrixUtils::makeCameraToWorldTransform(
+                    cameraOrigin, DemoScene::getCameraTarget(), DemoScene::getCameraUp());
+            float left, right, bottom, top;
+            MatrixUtils::getViewPlaneBounds(static_cast<float>(DemoScene::kFieldOfViewDegrees * M_PI / 180.0),
+                                            static_cast<float>(kFrameWidth) / kFrameHeight, DemoScene::kCameraNear,
+                                            DemoScene::kCameraFar, left, right, bottom, top);
+            for (int y = 0; y < kFrameHeight; ++y) {
+                for (int x = 0; x < kFrameWidth; ++x) {
+                    const Vector4f pointInCamera{left + (right - left) * (static_cast<float>(x) + 0.5f) / kFrameWidth,
+                                                 top - (top - bottom) * (static_cast<float>(y) + 0.5f) / kFrameHeight,
+                                                 DemoScene::kCameraNear, 1.0f};
+                    const auto pointInWorld = camera2world * pointInCamera;
+                    const Vector3f direction{pointInWorld.getX() - cameraOrigin.getX(),
+                                             pointInWorld.getY() - cameraOrigin.getY(),
+                                             pointInWorld.getZ() - cameraOrigin.getZ()};
+                    cameraRays.push_back({cameraOrigin, direction.normalize()});
+                }
+            }
+            // Build the hierarchy outside of the timed loops.
+            benchmark::DoNotOptimize(scene.getBvh());
+            loaded = true;
+        }
+    };
+
+    const DragonScene* getDragonScene(benchmark::State& state) {
+        static const DragonScene dragonScene;
+        if (!dragonScene.loaded) {
+            state.SkipWithError(dragonScene.error.c_str());
+            return nullptr;
+        }
+        return &dragonScene;
+    }
+
+    /**
+     * Closest hits of the camera rays in image order, one ray per iteration.
+     */
+    void BM_SceneHit(benchmark::State& state) {
+        const auto* dragonScene = getDragonScene(state);
+        if (!dragonScene) {
+            return;
+        }
+        const auto& rays = dragonScene->cameraRays;
+        size_t i = 0;
+        for (auto _: state) {
+            HitRecord hitRecord{};
+            benchmark::DoNotOptimize(dragonScene->scene.hit(rays[i], hitRecord));
+            benchmark::DoNotOptimize(hitRecord);
+            i = i + 1 == rays.size() ? 0 : i + 1;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    BENCHMARK(BM_SceneHit);
+
+    /**
+     * Whole 640x480 frames with shadows and reflections on every core. The rays counter is the throughput in
+     * rays per second of wall time, comparable to the Mrays/s main reports.
+     */
+    void BM_FullFrame(benchmark::State& state) {
+        const auto* dragonScene = getDragonScene(state);
+        if (!dragonScene) {
+            return;
+        }
+        Renderer renderer;
+        std::vector<WavefrontTracer> tracers;
+        for (unsigned i = 0; i < renderer.getThreadCount(); ++i) {
+            tracers.emplace_back(dragonScene->scene, dragonScene->lightSources);
+        }
+        std::vector<uint8_t> image(static_cast<size_t>(kFrameWidth) * kFrameHeight * 3);
+        std::atomic<uint64_t> rayCount{0};
+        const auto packetSize = renderer.getTileSize() * renderer.getTileSize();
+        for (auto _: state) {
+            renderer.render({kFrameWidth, kFrameHeight}, packetSize,
+                            [&](const PixelCoordinate* pixels, int pixelCount, PixelContext& context,
+                                Vector3f* outColors) {
+                std::vector<Ray> rays;
+                rays.reserve(pixelCount);
+                for (int i = 0; i < pixelCount; ++i) {
+                    rays.push_back(dragonScene->cameraRays[pixels[i].y * kFrameWidth + pixels[i].x]);
+                }
+                rayCount += tracers[context.workerIndex].trace(rays.data(), pixelCount, outColors);
+            }, image.data());
+        }
+        state.counters["rays"] = benchmark::Counter(static_cast<double>(rayCount), benchmark::Counter::kIsRate);
+        state.SetItemsProcessed(state.iterations() * kFrameWidth * kFrameHeight);
+    }
+
+    BENCHMARK(BM_FullFrame)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -8,152 +8,392 @@
 #include "src/Texture2D.h"
 #include "src/Matrix.h"
 #include "src/MatrixUtils.h"
-
-#include "third_party/svpng/svpng.inc"
+#include "src/Renderer.h"
+#include "src/HdrOutput.h"
+#include "src/PngOutput.h"
+#include "src/Sampler.h"
+#include "src/Shading.h"
+#include "src/Statistics.h"
+#include "src/WavefrontTracer.h"
+#include "src/FrameBuffer.h"
+#include "src/FramePipeline.h"
+#include "src/SequenceTrack.h"
+#include "src/ThreadPool.h"
+#include "src/TileCoordinator.h"
+#include "src/TileWorker.h"
+
+#include "src/DemoScene.h"
 #include "src/Mesh.h"
+#include "src/SceneBundle.h"
 
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <memory>
 #include <vector>
 #include <iostream>
+#include <string>
 #include <thread>
 
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #define MAX_REFLECTIONS 5
 #define REFLECTION_RAY_EPSILON 0.006
 
 using namespace crt;
 
-
-struct LightSource {
-    Vector3f position;
-    Vector3f color;
+// What the heatmap debug mode paints instead of shading, per pixel.
+enum class HeatmapMode {
+    Off,
+    // Bounding box tests, i.e. BVH traversal steps.
+    Boxes,
+    // Triangle and primitive intersection tests.
+    Tests,
 };
 
+
 static Vector3f rayColor(const Scene& scene,
                          const std::vector<LightSource>& lightSources,
                          const Ray& ray,
-                         const float tMin,
-                         const float tMax,
-                         const int depth = 0) {
-    HitRecord hitRecord{};
-    HitRecord shadowHitRecord{};
-    Vector3f color{};
-    if (scene.hit(ray, tMin, tMax, hitRecord)) {
-        const auto& hitPoint = hitRecord.p;
-        const auto& normal = hitRecord.normal;
-
-        Material& material = hitRecord.material;
-        color = material.getAmbient();
-
-        for (const auto& lightSource: lightSources) {
-            const auto l = (lightSource.position - hitPoint).normalize();
-            const Ray& shadowRay = Ray(hitPoint, l);
-            if (!scene.hit(shadowRay,
-                           REFLECTION_RAY_EPSILON,
-                           std::numeric_limits<float>::max(), shadowHitRecord)) {
-                const auto diffuseColor = lightSource.color * normal.dot(l);
-
-                const auto v = (ray.getOrigin() - hitPoint).normalize();
-                const auto h = (l + v).normalize();
-                auto specularColor =
-                        lightSource.color * std::pow(normal.dot(h),
-                                                     material.getShininess());
-
-                if (depth < MAX_REFLECTIONS && material.getSpecular() > 0.0f) {
-                    const auto r = ray.getDirection() - normal * 2 * normal.dot(ray.getDirection());
-                    const auto reflectedRay = Ray(hitPoint, r);
-                    const auto reflectedColor = rayColor(scene, lightSources,
-                                                         reflectedRay,
-                                                         REFLECTION_RAY_EPSILON,
-                                                         std::numeric_limits<float>::max(),
-                                                         depth + 1);
-                    specularColor += lightSource.color * reflectedColor;
-                }
+                         float tMin,
+                         float tMax,
+                         uint32_t& rayCount,
+                         int depth = 0);
 
-                color += (material.getDiffuse() * diffuseColor + material.getSpecular() * specularColor);
+static Vector3f shadeHit(const Scene& scene,
+                         const std::vector<LightSource>& lightSources,
+                         const Ray& ray,
+                         HitRecord& hitRecord,
+                         uint32_t& rayCount,
+                         const int depth) {
+    const auto& hitPoint = hitRecord.p;
+    const auto& normal = hitRecord.normal;
+
+    const Material& material = *hitRecord.material;
+    Vector3f color = material.getAmbient();
+
+    for (const auto& lightSource: lightSources) {
+        float lightDistance;
+        const auto l = Shading::getLightDirection(lightSource, hitPoint, lightDistance);
+        const Ray& shadowRay = Ray(hitPoint, l);
+        ++rayCount;
+        if (!scene.occluded(shadowRay, REFLECTION_RAY_EPSILON, lightDistance)) {
+            if (depth < MAX_REFLECTIONS && Shading::isReflective(material)) {
+                const auto reflectedColor = rayColor(scene, lightSources,
+                                                     Shading::reflect(ray, hitPoint, normal),
+                                                     REFLECTION_RAY_EPSILON,
+                                                     std::numeric_limits<float>::max(),
+                                                     rayCount,
+                                                     depth + 1);
+                color += Shading::shadeLight(lightSource, material, ray, hitPoint, normal, l, &reflectedColor);
+            } else {
+                color += Shading::shadeLight(lightSource, material, ray, hitPoint, normal, l, nullptr);
             }
         }
+    }
 
-        color *= color.dot(hitRecord.color);
+    return Shading::finish(color, hitRecord.color);
+}
 
-        color = color.min(Vector3f{1.0f, 1.0f, 1.0f});
+static Vector3f rayColor(const Scene& scene,
+                         const std::vector<LightSource>& lightSources,
+                         const Ray& ray,
+                         const float tMin,
+                         const float tMax,
+                         uint32_t& rayCount,
+                         const int depth) {
+    HitRecord hitRecord{};
+    ++rayCount;
+    if (depth > 0) {
+        CRT_COUNT(reflectionRays, 1);
+        CRT_COUNT_MAX(maxReflectionDepth, static_cast<uint32_t>(depth));
+    }
+    if (scene.hit(ray, tMin, tMax, hitRecord)) {
+        return shadeHit(scene, lightSources, ray, hitRecord, rayCount, depth);
     }
-    return color;
+    return {};
 }
 
-auto loadMoonTexture() {
-    const auto width = 1024;
-    const auto height = 512;
-    std::vector<unsigned char> data;
-    auto *fp = fopen("../resource/moon-1024-512-rgb24.raw", "r");
-    assert(fp);
-    fseek(fp, 0, SEEK_END);
-    auto size = ftell(fp);
-    assert(size == width * height * 3);
-    rewind(fp);
-    data.resize(size);
-    fread(data.data(), 1, size, fp);
-    fclose(fp);
-
-    std::vector<Vector3f> pixels;
-    pixels.resize(width * height);
-    for (int i = 0; i < width * height; ++i) {
-        pixels[i] = Vector3f{
-                static_cast<float>(data[i * 3 + 0]) / 255.0f,
-                static_cast<float>(data[i * 3 + 1]) / 255.0f,
-                static_cast<float>(data[i * 3 + 2]) / 255.0f
-        };
-    }
+// Output path of a sequence frame: the text around the frame number and the number's zero padded width.
+struct FramePathPattern {
+    std::string prefix;
+    std::string suffix;
+    int width = 4;
+};
 
-    return std::make_shared<Texture2D>(width, height, pixels);
+// Reads the output path of a sequence: a pattern with one %d or %0Nd, such as out/frame_%04d.png, where %% stands
+// for a literal percent sign. Without a conversion the frame number goes in front of the extension.
+static bool parseFramePathPattern(const std::string& outputPath, FramePathPattern& outPattern, std::string& outError) {
+    std::string text;
+    bool hasConversion = false;
+    for (size_t i = 0; i < outputPath.size(); ++i) {
+        if (outputPath[i] != '%') {
+            text += outputPath[i];
+            continue;
+        }
+        if (i + 1 < outputPath.size() && outputPath[i + 1] == '%') {
+            text += '%';
+            ++i;
+            continue;
+        }
+        auto end = i + 1;
+        while (end < outputPath.size() && std::isdigit(static_cast<unsigned char>(outputPath[end]))) {
+            ++end;
+        }
+        const auto digits = outputPath.substr(i + 1, end - i - 1);
+        if (hasConversion || end == outputPath.size() || outputPath[end] != 'd' ||
+            (!digits.empty() && (digits[0] != '0' || digits.size() > 3))) {
+            outError = outputPath + ": a sequence output takes one %d or %0Nd for the frame number and %% for a "
+                                    "percent sign";
+            return false;
+        }
+        hasConversion = true;
+        outPattern.prefix = text;
+        outPattern.width = digits.empty() ? 0 : std::atoi(digits.c_str());
+        text.clear();
+        i = end;
+    }
+    if (hasConversion) {
+        outPattern.suffix = text;
+        return true;
+    }
+    const auto slash = text.find_last_of('/');
+    const auto dot = text.find_last_of('.');
+    const auto insertAt = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : text.size();
+    outPattern.prefix = text.substr(0, insertAt) + "_";
+    outPattern.suffix = text.substr(insertAt);
+    outPattern.width = 4;
+    return true;
 }
 
-std::unique_ptr<Mesh> loadDragonMesh() {
-    auto *fp = fopen("../resource/dragon_vrip_res4.ply", "r");
-    assert(fp);
-
-    int vertexCount = 0;
-    int faceCount = 0;
-    fscanf(fp, "ply\n");
-    fscanf(fp, "format ascii 1.0\n");
-    fscanf(fp, "comment generated by ply_writer\n");
-    fscanf(fp, "element vertex %d\n", &vertexCount);
-    fscanf(fp, "property float x\n");
-    fscanf(fp, "property float y\n");
-    fscanf(fp, "property float z\n");
-    fscanf(fp, "element face %d\n", &faceCount);
-    fscanf(fp, "property list uchar int vertex_indices\n");
-    fscanf(fp, "end_header\n");
-
-    // Transformation matrix
-    Matrix4f transform = Matrix4f::makeIdentity();
-    transform = MatrixUtils::scale(1000.0f, 1000.0f, 1000.0f) * transform;
-    transform = MatrixUtils::rotateByY<float>(135.0) * transform;
-    transform = MatrixUtils::translate(-200.0f, -50.0f, 0.0f) * transform;
-
-    std::vector<Vector3f> vertices;
-    vertices.resize(vertexCount);
-    for (int i = 0; i < vertexCount; ++i) {
-        float x, y, z;
-//        fscanf(fp, "%f %f %f\n", &vertices[i][0], &vertices[i][1], &vertices[i][2]);
-        fscanf(fp, "%f %f %f\n", &x, &y, &z);
-        vertices[i] = (transform * Vector4f{x, y, z, 1.0f}).getXYZ();
+static std::string getFramePath(const FramePathPattern& pattern, uint32_t frame) {
+    auto number = std::to_string(frame);
+    if (static_cast<int>(number.size()) < pattern.width) {
+        number.insert(0, pattern.width - number.size(), '0');
     }
+    return pattern.prefix + number + pattern.suffix;
+}
 
-    std::vector<Vector3i> indices;
-    indices.resize(faceCount * 3);
-    for (int i = 0; i < faceCount; ++i) {
-        int n = 0;
-        fscanf(fp, "%d", &n);
-        assert(n == 3);
-        fscanf(fp, " %d %d %d\n", &indices[i][0], &indices[i][1], &indices[i][2]);
+// Renders the frame on worker processes: localWorkerCount of them are started here with workerArguments, more
+// can join from other machines with --worker=ADDRESS.
+static int runCoordinator(const std::string& address, unsigned localWorkerCount,
+                          const std::vector<std::string>& workerArguments, const SizeI& imageSize,
+                          ImageOutput& output, bool quiet) {
+    TileCoordinator coordinator;
+    if (!coordinator.listen(address)) {
+        std::cerr << coordinator.getError() << std::endl;
+        return 1;
+    }
+    std::vector<pid_t> workers;
+    for (unsigned i = 0; i < localWorkerCount; ++i) {
+        const auto pid = fork();
+        if (pid == 0) {
+            std::vector<char*> arguments;
+            for (const auto& argument: workerArguments) {
+                arguments.push_back(const_cast<char*>(argument.c_str()));
+            }
+            arguments.push_back(nullptr);
+            // argv[0] has no path when the binary was found through PATH.
+            execv("/proc/self/exe", arguments.data());
+            _exit(127);
+        }
+        if (pid > 0) {
+            workers.push_back(pid);
+        }
     }
-//    assert(ftell(fp) == 0);
-    fclose(fp);
 
-    return std::make_unique<Mesh>(vertices, indices);
+    // Reaps the local workers while rendering. Once all of them have exited and nobody else is connected, no
+    // worker is coming, so the render fails right away instead of after the worker timeout.
+    size_t exitedWorkerCount = 0;
+    int lastExitStatus = 0;
+    const auto watchWorkers = [&](std::string& outError) {
+        for (auto& pid: workers) {
+            int status = 0;
+            if (pid > 0 && waitpid(pid, &status, WNOHANG) == pid) {
+                pid = 0;
+                ++exitedWorkerCount;
+                lastExitStatus = status;
+            }
+        }
+        if (workers.empty() || exitedWorkerCount < workers.size() || coordinator.getWorkerCount() > 0) {
+            return true;
+        }
+        outError = "all " + std::to_string(workers.size()) + " local workers exited";
+        if (WIFEXITED(lastExitStatus)) {
+            outError += ", the last with status " + std::to_string(WEXITSTATUS(lastExitStatus));
+        } else if (WIFSIGNALED(lastExitStatus)) {
+            outError += ", the last on signal " + std::to_string(WTERMSIG(lastExitStatus));
+        }
+        return false;
+    };
+
+    TileCoordinatorStatistics statistics;
+    const bool rendered = coordinator.render(imageSize, output, &statistics, watchWorkers);
+    coordinator.finish();
+    for (const auto pid: workers) {
+        if (pid <= 0) {
+            continue;
+        }
+        // Workers still starting up would otherwise keep retrying to connect.
+        if (!rendered) {
+            kill(pid, SIGTERM);
+        }
+        waitpid(pid, nullptr, 0);
+    }
+    if (!rendered) {
+        std::cerr << coordinator.getError() << std::endl;
+        return 1;
+    }
+    if (!quiet) {
+        std::cout << statistics.tileCount << " tiles on " << statistics.workerCount << " workers in "
+                  << statistics.seconds * 1000.0 << " ms, " << statistics.failedWorkerCount << " workers failed, "
+                  << statistics.reassignedTileCount << " tiles reassigned, " << statistics.duplicatedTileCount
+                  << " duplicated" << std::endl;
+    }
+    return 0;
 }
 
-int main() {
-    auto moonTexture = loadMoonTexture();
+int main(int argc, char *argv[]) {
+    bool quiet = false;
+    int packetSize = RayPacket::kMaxSize;
+    std::string scenePath;
+    std::string compiledScenePath;
+    std::string outputPath = "../out/test.png";
+    int pngLevel = PngOutput::kDefaultCompressionLevel;
+    bool progressive = false;
+    bool wavefront = false;
+    HeatmapMode heatmap = HeatmapMode::Off;
+    float heatmapScale = 0.0f;
+    BvhBuildOptions bvhOptions;
+    auto meshStorage = MeshStorage::Full;
+    ProgressiveOptions progressiveOptions;
+    SamplerType samplerType = SamplerType::Sobol;
+    uint32_t frameCount = 0;
+    std::string trackPath;
+    unsigned threadCount = 0;
+    std::string coordinatorAddress;
+    std::string workerAddress;
+    unsigned localWorkerCount = 0;
+    // Arguments every local worker of a coordinator gets, the ones that decide what a pixel looks like.
+    std::vector<std::string> workerArguments{argv[0], "--quiet"};
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const std::string packetSizeOption = "--packet-size=";
+        const std::string sceneOption = "--scene=";
+        const std::string compileSceneOption = "--compile-scene=";
+        const std::string outputOption = "--output=";
+        const std::string pngLevelOption = "--png-level=";
+        const std::string maxSamplesOption = "--max-samples=";
+        const std::string errorOption = "--error=";
+        const std::string samplerOption = "--sampler=";
+        const std::string heatmapScaleOption = "--heatmap-scale=";
+        const std::string framesOption = "--frames=";
+        const std::string trackOption = "--track=";
+        const std::string threadsOption = "--threads=";
+        const std::string coordinatorOption = "--coordinator=";
+        const std::string workerOption = "--worker=";
+        const std::string workersOption = "--workers=";
+        if (argument.rfind(coordinatorOption, 0) != 0 && argument.rfind(workersOption, 0) != 0 &&
+            argument.rfind(outputOption, 0) != 0 && argument.rfind(threadsOption, 0) != 0 && argument != "-q" &&
+            argument != "--quiet") {
+            workerArguments.push_back(argument);
+        }
+        if (argument == "-q" || argument == "--quiet") {
+            quiet = true;
+        } else if (argument.rfind(sceneOption, 0) == 0) {
+            scenePath = argument.substr(sceneOption.size());
+        } else if (argument.rfind(compileSceneOption, 0) == 0) {
+            compiledScenePath = argument.substr(compileSceneOption.size());
+        } else if (argument.rfind(outputOption, 0) == 0) {
+            outputPath = argument.substr(outputOption.size());
+        } else if (argument.rfind(pngLevelOption, 0) == 0 && argument.size() == pngLevelOption.size() + 1 &&
+                   std::isdigit(static_cast<unsigned char>(argument.back()))) {
+            pngLevel = argument.back() - '0';
+        } else if (argument == "--wavefront") {
+            wavefront = true;
+        } else if (argument == "--bvh=sah") {
+            bvhOptions.method = BvhBuildMethod::Sah;
+        } else if (argument == "--bvh=lbvh") {
+            bvhOptions.method = BvhBuildMethod::Lbvh;
+        } else if (argument == "--bvh=ploc") {
+            bvhOptions.method = BvhBuildMethod::Ploc;
+        } else if (argument == "--bvh-width=2" || argument == "--bvh-width=4" || argument == "--bvh-width=8") {
+            bvhOptions.width = static_cast<uint32_t>(argument.back() - '0');
+        } else if (argument == "--compact-mesh") {
+            meshStorage = MeshStorage::Compact;
+        } else if (argument == "--heatmap=boxes") {
+            heatmap = HeatmapMode::Boxes;
+        } else if (argument == "--heatmap=tests") {
+            heatmap = HeatmapMode::Tests;
+        } else if (argument.rfind(heatmapScaleOption, 0) == 0 &&
+                   std::atof(argument.c_str() + heatmapScaleOption.size()) > 0.0) {
+            heatmapScale = static_cast<float>(std::atof(argument.c_str() + heatmapScaleOption.size()));
+        } else if (argument.rfind(framesOption, 0) == 0 && std::atoi(argument.c_str() + framesOption.size()) > 0) {
+            frameCount = static_cast<uint32_t>(std::atoi(argument.c_str() + framesOption.size()));
+        } else if (argument.rfind(trackOption, 0) == 0) {
+            trackPath = argument.substr(trackOption.size());
+        } else if (argument.rfind(threadsOption, 0) == 0 && std::atoi(argument.c_str() + threadsOption.size()) > 0) {
+            threadCount = static_cast<unsigned>(std::atoi(argument.c_str() + threadsOption.size()));
+        } else if (argument.rfind(coordinatorOption, 0) == 0 && argument.size() > coordinatorOption.size()) {
+            coordinatorAddress = argument.substr(coordinatorOption.size());
+        } else if (argument.rfind(workerOption, 0) == 0 && argument.size() > workerOption.size()) {
+            workerAddress = argument.substr(workerOption.size());
+        } else if (argument.rfind(workersOption, 0) == 0 && std::atoi(argument.c_str() + workersOption.size()) >= 0) {
+            localWorkerCount = static_cast<unsigned>(std::atoi(argument.c_str() + workersOption.size()));
+        } else if (argument == "--progressive") {
+            progressive = true;
+        } else if (argument.rfind(maxSamplesOption, 0) == 0 &&
+                   std::atoi(argument.c_str() + maxSamplesOption.size()) >=
+                   static_cast<int>(progressiveOptions.minSamples)) {
+            progressiveOptions.maxSamples = std::atoi(argument.c_str() + maxSamplesOption.size());
+        } else if (argument.rfind(samplerOption, 0) == 0) {
+            const auto samplerName = argument.substr(samplerOption.size());
+            SamplerType type;
+            if (!Sampler::parseType(samplerName, type)) {
+                std::cerr << "Unknown sampler " << samplerName << ", use random, stratified, sobol or bluenoise"
+                          << std::endl;
+                return 1;
+            }
+            samplerType = type;
+        } else if (argument.rfind(errorOption, 0) == 0 && std::atof(argument.c_str() + errorOption.size()) > 0.0) {
+            progressiveOptions.errorThreshold = static_cast<float>(std::atof(argument.c_str() + errorOption.size()));
+        } else if (argument.rfind(packetSizeOption, 0) == 0 &&
+                   (argument.substr(packetSizeOption.size()) == "1" ||
+                    argument.substr(packetSizeOption.size()) == "4" ||
+                    argument.substr(packetSizeOption.size()) == "8" ||
+                    argument.substr(packetSizeOption.size()) == "16")) {
+            packetSize = std::stoi(argument.substr(packetSizeOption.size()));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-q|--quiet] [--packet-size=1|4|8|16|--wavefront]"
+                      << " [--compile-scene=BUNDLE] [--scene=BUNDLE] [--output=IMAGE.png|.pfm|.raw]"
+                      << " [--png-level=0-9] [--bvh=sah|lbvh|ploc] [--bvh-width=2|4|8] [--compact-mesh]"
+                      << " [--progressive [--max-samples=N] [--error=E]"
+                      << " [--sampler=random|stratified|sobol|bluenoise]]"
+                      << " [--heatmap=boxes|tests [--heatmap-scale=N]] [--frames=N] [--track=FILE]"
+                      << " [--threads=N] [--coordinator=unix:PATH|HOST:PORT [--workers=N]]"
+                      << " [--worker=unix:PATH|HOST:PORT]" << std::endl;
+            return 1;
+        }
+    }
+    if (!coordinatorAddress.empty() && (frameCount > 0 || !trackPath.empty() || !workerAddress.empty())) {
+        std::cerr << "--coordinator renders a single still and cannot be a worker itself" << std::endl;
+        return 1;
+    }
+    if (!coordinatorAddress.empty() && !compiledScenePath.empty()) {
+        std::cerr << "--coordinator does not load the scene, run --compile-scene without it" << std::endl;
+        return 1;
+    }
+    if (!workerAddress.empty() && (frameCount > 0 || !trackPath.empty())) {
+        std::cerr << "--worker renders tiles of a still, not sequences" << std::endl;
+        return 1;
+    }
+    if (heatmap != HeatmapMode::Off && !Statistics::kEnabled) {
+        std::cerr << "--heatmap needs a build with CRT_ENABLE_STATISTICS=ON" << std::endl;
+        return 1;
+    }
 
     const float scale = 4.0f;
     const Vector2f viewportSize = {640 * scale, 480 * scale};
@@ -161,12 +401,13 @@ int main() {
 
     const SizeF cameraFrameSize = {static_cast<float>(outputPixelSize.getWidth()) * 1.0f,
                                    static_cast<float>(outputPixelSize.getHeight()) * 1.0f};
-    const float cameraNear = -0.1f;
-    const float cameraFar = -100.0f;
-    const auto fov = static_cast<float>(60.0f * M_PI / 180.0f);
+    const float cameraNear = DemoScene::kCameraNear;
+    const float cameraFar = DemoScene::kCameraFar;
+    const auto fov = static_cast<float>(DemoScene::kFieldOfViewDegrees * M_PI / 180.0f);
 
-    const Vector3f cameraOrigin{150.0f, 220.0f, 500.0f};
-    const Vector3f cameraTarget{0.0f, 100.0f, 50.0f};
+    // Sequence frames move the camera, see the render stage below.
+    Vector3f cameraOrigin = DemoScene::getCameraOrigin();
+    const Vector3f cameraTarget = DemoScene::getCameraTarget();
 
     const auto viewPortTransform = MatrixUtils::makeViewportTransform(viewportSize.getX(), viewportSize.getY());
 
@@ -176,139 +417,369 @@ int main() {
 
     const auto world2cameraTransform = MatrixUtils::makeWorldToCameraTransform(cameraOrigin,
                                                                                cameraTarget,
-                                                                               Vector3f{0.0f, 1.0f, 0.0f});
-    const auto camera2worldTransform = MatrixUtils::makeCameraToWorldTransform(cameraOrigin,
+                                                                               DemoScene::getCameraUp());
+    auto camera2worldTransform = MatrixUtils::makeCameraToWorldTransform(cameraOrigin,
                                                                                cameraTarget,
-                                                                               Vector3f{0.0f, 1.0f, 0.0f});
+                                                                               DemoScene::getCameraUp());
 
-    std::vector<LightSource> lightSources = {
-            {{150.0f * 4.0f,  500.0f * 1.5f, 1200.0f}, {1.0f, 1.0f, 1.0f}},
-            {{-150.0f * 1.0f, 400.0f,        400.0f},  {0.3f, 0.3f, 0.3f}},
-//            {{0.0f, 120.0f,        -80.0f},  {0.3f, 0.3f, 0.3f}},
-    };
+    const std::vector<LightSource> lightSources = DemoScene::getLightSources();
 
-    Scene scene;
+    const auto makeOutput = [&](const std::string& path) -> std::unique_ptr<ImageOutput> {
+        const auto hasExtension = [&](const std::string& extension) {
+            return path.size() >= extension.size() &&
+                   path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+        };
+        if (hasExtension(".pfm")) {
+            return std::make_unique<HdrOutput>(path, HdrFormat::Pfm);
+        } else if (hasExtension(".raw")) {
+            return std::make_unique<HdrOutput>(path, HdrFormat::Raw);
+        }
+        return std::make_unique<PngOutput>(path, pngLevel);
+    };
 
-    {
-        const auto material = Material({0.01f, 0.01f, 0.01f},
-                                       {0.8f, 0.2f, 0.2f},
-                                       {.3f, .3f, .3f},
-                                       200.0f);
-        auto sphere = std::make_shared<Sphere>(Vector3f{0.0f, 50.0f, 0.0f}, 50.0f);
-        sphere->setMaterial(material);
-        scene.addSurface(sphere);
+    // The coordinator only assembles tiles, the scene lives in the workers.
+    if (!coordinatorAddress.empty()) {
+        const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        workerArguments.push_back("--worker=" + coordinatorAddress);
+        workerArguments.push_back("--threads=" + std::to_string(
+                threadCount > 0 ? threadCount : std::max(1u, hardwareThreads / std::max(1u, localWorkerCount))));
+        const auto output = makeOutput(outputPath);
+        return runCoordinator(coordinatorAddress, localWorkerCount, workerArguments, outputPixelSize, *output,
+                              quiet);
     }
 
-//    {
-//        const auto material = Material({0.1f, 0.1f, 0.1f},
-//                                       {0.3f, 0.3f, 0.3f},
-//                                       {0.0f, 0.0f, 0.0f},
-//                                       0.0f);
-//        auto sphere = std::make_shared<Sphere>(Vector3f{80.0f, 30.0f, 50.0f}, 30.0f);
-//        sphere->setTexture(moonTexture);
-//        scene.addSurface(sphere);
-//    }
-
-    {
-        const auto material = Material({0.01f, 0.01f, 0.01f},
-                                       {0.1f, 0.5f, 0.1f},
-                                       {0.0f, 0.0f, 0.0f},
-                                       0.0f);
-        scene.addSurface(std::make_shared<Sphere>(Vector3f{130.0f, 50.0f, -50.0f}, 50.0f, material));
+    // A sequence renders from one slot while the next frame is updated in the other, a still only uses the first.
+    Scene scenes[FramePipeline::kSlotCount];
+    Scene& scene = scenes[0];
+    const auto sceneStart = std::chrono::steady_clock::now();
+    if (!scenePath.empty()) {
+        std::string error;
+        if (!SceneBundle::read(scenePath, scene, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    } else {
+        std::string error;
+        if (!DemoScene::build(scene, "../resource", bvhOptions, meshStorage, quiet, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    if (!compiledScenePath.empty()) {
+        std::string error;
+        if (!SceneBundle::write(scene, compiledScenePath, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (!quiet) {
+            std::cout << "Scene compiled to " << compiledScenePath << std::endl;
+        }
+        return 0;
+    }
+    if (!quiet) {
+        std::cout << "Scene ready in " << std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - sceneStart).count() << " ms" << std::endl;
     }
 
+    // Sequence mode moves every mesh of the scene by the track and keeps both scene slots resident between frames,
+    // so a frame only refits the hierarchies. Slot 1 shares the static surfaces and copies the meshes, whose
+    // arrays are shared until the first update writes them.
+    const bool sequence = frameCount > 0 || !trackPath.empty();
+    SequenceTrack track;
+    std::vector<std::shared_ptr<Mesh>> slotMeshes[FramePipeline::kSlotCount];
+    std::vector<std::vector<Vector3f>> restPoints;
+    Vector3f pivot;
+    FramePathPattern framePathPattern;
+    if (sequence) {
+        std::string error;
+        if (!parseFramePathPattern(outputPath, framePathPattern, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (!trackPath.empty()) {
+            if (!SequenceTrack::load(trackPath, track, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+        } else {
+            track = SequenceTrack::makeTurntable(frameCount, cameraOrigin, cameraTarget);
+        }
+        if (frameCount == 0) {
+            frameCount = track.getFrameCount();
+        }
 
-    {
-        const Material& triangleMaterial = Material({0.01f, 0.01f, 0.01f},
-                                                    {0.0f, 0.0f, 0.0f},
-                                                    {0.6f, 0.6f, 0.6f},
-                                                    50.0f);
+        BoundingBox<float> meshBounds;
+        for (const auto& surface: scene.getSurface()) {
+            auto mesh = std::dynamic_pointer_cast<Mesh>(surface);
+            if (!mesh) {
+                scenes[1].addSurface(surface);
+                continue;
+            }
+            std::vector<Vector3f> points;
+            if (mesh->isCompact()) {
+                points.reserve(mesh->getPointCount());
+                for (uint32_t i = 0; i < mesh->getPointCount(); ++i) {
+                    points.push_back(mesh->getCompactGeometry().getPoint(i));
+                }
+            } else {
+                points.assign(mesh->getPoints().begin(), mesh->getPoints().end());
+            }
+            restPoints.push_back(std::move(points));
+            BoundingBox<float> bounds;
+            mesh->boundingBox(bounds);
+            meshBounds.expand(bounds);
+
+            auto copy = std::make_shared<Mesh>(*mesh);
+            scenes[1].addSurface(copy);
+            slotMeshes[0].push_back(std::move(mesh));
+            slotMeshes[1].push_back(std::move(copy));
+        }
+        pivot = meshBounds.getCenter();
+    }
 
-        std::vector<Vector3f> vertices = {
-                {-200.0f, 0.0f,   -200.0f},
-                {100.0f,  0.0f,   -280.0f},
-                {-200.0f, 300.0f, -200.0f},
-                {100.0f,  300.0f, -280.0f},
+    RenderProgress progress;
+    progress.setQuiet(quiet);
+
+    // Angle one pixel covers at the image center, the cone every camera ray stands for.
+    const auto pixelSpreadAngle = (top - bottom) / static_cast<float>(outputPixelSize.getHeight()) / -cameraNear;
+    // Where in pixel (i, j) a sample lands. Single sample renders keep shooting through the pixel center.
+    const auto sampler = Sampler::create(samplerType, progressiveOptions.maxSamples);
+    // Workers render a tile of the frame as an image of its own, pixel (i, j) of it is pixel (regionX + i,
+    // regionY + j) of the frame.
+    int regionX = 0;
+    int regionY = 0;
+    const auto getSampleOffset = [&](int i, int j, uint32_t sampleIndex) {
+        return progressive ? sampler->get2D(regionX + i, regionY + j, sampleIndex) : Vector2f{0.5f, 0.5f};
+    };
+    const auto makeCameraRay = [&](int i, int j, const Vector2f& sampleOffset) {
+        const auto dx = left + (right - left) * (static_cast<float>(regionX + i) + sampleOffset.getX()) /
+                               static_cast<float>(outputPixelSize.getWidth());
+        const auto dy = top - (top - bottom) * (static_cast<float>(regionY + j) + sampleOffset.getY()) /
+                              static_cast<float>(outputPixelSize.getHeight());
+        const Vector4f pointInCamera = {
+                dx,
+                dy,
+                cameraNear,
+                1.0f
         };
-        scene.addSurface(std::make_shared<Triangle>(vertices[0], vertices[1], vertices[2], triangleMaterial));
-        scene.addSurface(std::make_shared<Triangle>(vertices[1], vertices[3], vertices[2], triangleMaterial));
-    }
 
+        const Vector4f pointInWorld4Homo = camera2worldTransform * pointInCamera;
+        const Vector3f pointInWorld = {pointInWorld4Homo.getX(), pointInWorld4Homo.getY(),
+                                       pointInWorld4Homo.getZ()};
 
-    {
-        const auto material = Material({0.3f, 0.3f, 0.3f},
-                                       {0.3f, 0.3f, 0.3f},
-                                       {0.0f, 0.0f, 0.0f},
-                                       0.0f);
-        auto moonSphere = std::make_shared<Sphere>(Vector3f{350.0f, 200.0f, -500.0f}, 200.0f,
-                                                   material);
-        moonSphere->setTexture(moonTexture);
-        scene.addSurface(moonSphere);
-    }
+        const auto rayDirection = (pointInWorld - cameraOrigin).normalize();
+        const auto rayOrigin = cameraOrigin;
+        return Ray{rayOrigin, rayDirection, pixelSpreadAngle};
+    };
+
+    // The scene slot the frame being rendered reads from.
+    unsigned activeSlot = 0;
+    const Scene* activeScene = &scene;
+    const Renderer::PixelFunction pixelFunction = [&](int i, int j, PixelContext& context) {
+        return rayColor(*activeScene, lightSources, makeCameraRay(i, j, getSampleOffset(i, j, context.sampleIndex)),
+                        0.0f, std::numeric_limits<float>::max(), context.rayCount);
+    };
+    // Primary rays of a pixel block are traced as one packet, secondary rays stay scalar.
+    const Renderer::PacketFunction packetFunction = [&](const PixelCoordinate* pixels, int pixelCount,
+                                                        PixelContext& context, Vector3f* outColors) {
+        RayPacket packet(packetSize);
+        for (int lane = 0; lane < pixelCount; ++lane) {
+            const auto& pixel = pixels[lane];
+            packet.setRay(lane, makeCameraRay(pixel.x, pixel.y, getSampleOffset(pixel.x, pixel.y, context.sampleIndex)),
+                          0.0f, std::numeric_limits<float>::max());
+        }
+        PacketHit packetHit;
+        activeScene->hitPacket(packet, packetHit);
+        for (int lane = 0; lane < pixelCount; ++lane) {
+            ++context.rayCount;
+            outColors[lane] = {};
+            if (const auto* surface = packetHit.surface[lane]) {
+                const auto ray = packet.getRay(lane);
+                HitRecord hitRecord{};
+                surface->resolveHit(ray, packet.tMax[lane], packetHit.primitive[lane],
+                                    packetHit.u[lane], packetHit.v[lane], hitRecord);
+                outColors[lane] = shadeHit(*activeScene, lightSources, ray, hitRecord, context.rayCount, 0);
+            }
+        }
+    };
 
-    {
-        const Material& material = Material({},
-                                            {0.2f, 0.2f, 0.2f},
-                                            {0.03f, 0.03f, 0.03f},
-                                            0.0f);
-        scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f},
-                                                 Vector3f{0.0f, 0.0f, 0.0f}, material));
+    Renderer renderer(threadCount);
+    // Wavefront mode traces a whole tile as one batch, with one tracer and its queues per render thread and scene
+    // slot.
+    std::vector<WavefrontTracer> wavefrontTracers[FramePipeline::kSlotCount];
+    const Renderer::PacketFunction wavefrontFunction = [&](const PixelCoordinate* pixels, int pixelCount,
+                                                           PixelContext& context, Vector3f* outColors) {
+        std::vector<Ray> cameraRays;
+        cameraRays.reserve(pixelCount);
+        for (int i = 0; i < pixelCount; ++i) {
+            const auto& pixel = pixels[i];
+            cameraRays.push_back(makeCameraRay(pixel.x, pixel.y,
+                                               getSampleOffset(pixel.x, pixel.y, context.sampleIndex)));
+        }
+        context.rayCount += wavefrontTracers[activeSlot][context.workerIndex].trace(cameraRays.data(), pixelCount,
+                                                                                    outColors);
+    };
+    if (wavefront) {
+        const WavefrontOptions wavefrontOptions{MAX_REFLECTIONS, static_cast<float>(REFLECTION_RAY_EPSILON)};
+        for (unsigned slot = 0; slot < (sequence ? FramePipeline::kSlotCount : 1); ++slot) {
+            for (unsigned i = 0; i < renderer.getThreadCount(); ++i) {
+                wavefrontTracers[slot].emplace_back(scenes[slot], lightSources, wavefrontOptions);
+            }
+        }
+        packetSize = renderer.getTileSize() * renderer.getTileSize();
     }
+    const auto& tileFunction = wavefront ? wavefrontFunction : packetFunction;
 
-    {
-        std::shared_ptr<Mesh> dragon = loadDragonMesh();
-        const auto material = Material({0.01f, 0.01f, 0.01f},
-                                       {0.8f, 0.2f, 0.2f},
-                                       {.3f, .3f, .3f},
-                                       200.0f);
-        dragon->setMaterial(material);
-        scene.addSurface(dragon);
+    // Heatmap mode shades pixel by pixel, so the counters of the rendering thread before and after a pixel tell
+    // what that pixel cost. Costs at or above the scale show as red.
+    if (heatmapScale <= 0.0f) {
+        heatmapScale = heatmap == HeatmapMode::Boxes ? 400.0f : 100.0f;
     }
+    const Renderer::PixelFunction heatmapFunction = [&](int i, int j, PixelContext& context) {
+        const auto before = Statistics::getThreadCounters();
+        pixelFunction(i, j, context);
+        const auto& after = Statistics::getThreadCounters();
+        const auto cost = heatmap == HeatmapMode::Boxes
+                          ? after.boxTests - before.boxTests
+                          : after.getIntersectionTests() - before.getIntersectionTests();
+        return Statistics::getHeatColor(static_cast<float>(cost) / heatmapScale);
+    };
+    if (heatmap != HeatmapMode::Off) {
+        packetSize = 1;
+    }
+    const auto& shadePixel = heatmap != HeatmapMode::Off ? heatmapFunction : pixelFunction;
+
+    const auto renderFrame = [&](const SizeI& imageSize, ImageOutput& output) {
+        if (progressive) {
+            ProgressiveStatistics statistics;
+            const auto rendered = packetSize == 1
+                                  ? renderer.renderProgressive(imageSize, shadePixel, progressiveOptions,
+                                                               output, &progress, &statistics)
+                                  : renderer.renderProgressive(imageSize, packetSize, tileFunction,
+                                                               progressiveOptions, output, &progress, &statistics);
+            if (rendered && !quiet) {
+                const auto pixelCount = static_cast<double>(imageSize.getWidth()) * imageSize.getHeight();
+                std::cout << statistics.passCount << " passes, "
+                          << static_cast<double>(statistics.sampleCount) / pixelCount
+                          << " samples per pixel on average (" << progressiveOptions.maxSamples << " at most)"
+                          << std::endl;
+            }
+            return rendered;
+        } else if (packetSize == 1) {
+            return renderer.render(imageSize, shadePixel, output, &progress);
+        }
+        return renderer.render(imageSize, packetSize, tileFunction, output, &progress);
+    };
 
-    auto outputRGBBuffer = std::make_unique<uint8_t[]>(
-            outputPixelSize.getWidth() * outputPixelSize.getHeight() * 3);
-
-    #pragma omp parallel for
-    for (int j = 0; j < outputPixelSize.getHeight(); ++j) {
-        #pragma omp parallel for
-        for (int i = 0; i < outputPixelSize.getWidth(); ++i) {
-            const auto dx = left + (right - left) * (static_cast<float>(i) + 0.5f) /
-                                   static_cast<float>(outputPixelSize.getWidth());
-            const auto dy = top - (top - bottom) * (static_cast<float>(j) + 0.5f) /
-                                  static_cast<float>(outputPixelSize.getHeight());
-            const Vector4f pointInCamera = {
-                    dx,
-                    dy,
-                    cameraNear,
-                    1.0f
-            };
-
-            const Vector4f pointInWorld4Homo = camera2worldTransform * pointInCamera;
-            const Vector3f pointInWorld = {pointInWorld4Homo.getX(), pointInWorld4Homo.getY(),
-                                           pointInWorld4Homo.getZ()};
-
-            const auto rayDirection = (pointInWorld - cameraOrigin).normalize();
-            const auto rayOrigin = cameraOrigin;
-            const auto ray = Ray{rayOrigin, rayDirection};
-
-            const auto color = rayColor(scene, lightSources, ray, 0.0f, std::numeric_limits<float>::max());
-
-            const int index = (j * outputPixelSize.getWidth() + i) * 3;
-            outputRGBBuffer[index + 0] = static_cast<uint8_t>(std::min(1.0f, color.getX()) * 255);
-            outputRGBBuffer[index + 1] = static_cast<uint8_t>(std::min(1.0f, color.getY()) * 255);
-            outputRGBBuffer[index + 2] = static_cast<uint8_t>(std::min(1.0f, color.getZ()) * 255);
-
-            int currentCount = j * outputPixelSize.getWidth() + i;
-            int totalCount = outputPixelSize.getWidth() * outputPixelSize.getHeight();
-            std::cout << "Calculating pixel count " << currentCount
-                      << "/" << totalCount << " progress:" << (currentCount * 100.0f / totalCount) << "%" << std::endl;
+    if (!workerAddress.empty()) {
+        TileWorker worker;
+        if (!worker.connect(workerAddress)) {
+            std::cerr << worker.getError() << std::endl;
+            return 1;
         }
-    }
+        const TileWorker::RenderFunction renderTile = [&](const SizeI& imageSize, const RenderTile& tile,
+                                                          FrameBuffer& outImage, std::string& outError) {
+            if (imageSize != outputPixelSize) {
+                outError = "the coordinator renders a different image size";
+                return false;
+            }
+            regionX = tile.x;
+            regionY = tile.y;
+            if (!renderFrame({tile.width, tile.height}, outImage)) {
+                outError = outImage.getError();
+                return false;
+            }
+            return true;
+        };
+        TileWorkerStatistics statistics;
+        if (!worker.run(renderTile, &statistics)) {
+            std::cerr << worker.getError() << std::endl;
+            return 1;
+        }
+        if (!quiet) {
+            std::cout << statistics.tileCount << " tiles rendered in " << statistics.renderSeconds * 1000.0 << " ms"
+                      << std::endl;
+        }
+    } else if (!sequence) {
+        const auto output = makeOutput(outputPath);
+        if (!renderFrame(outputPixelSize, *output)) {
+            std::cerr << output->getError() << std::endl;
+            return 1;
+        }
+    } else {
+        // Frames report one line each instead of render progress.
+        progress.setQuiet(true);
+        ThreadPool updatePool;
+        // Pose each slot's meshes are in, a frame with the same pose leaves them alone.
+        SequenceFrame slotPoses[FramePipeline::kSlotCount];
+
+        const FramePipeline::UpdateFunction update = [&](uint32_t frame, unsigned slot, std::string& outError) {
+            const auto pose = track.getFrame(frame);
+            if (pose.yaw != slotPoses[slot].yaw || pose.move != slotPoses[slot].move) {
+                const auto transform = pose.getTransform(pivot);
+                for (size_t i = 0; i < slotMeshes[slot].size(); ++i) {
+                    std::vector<Vector3f> points(restPoints[i].size());
+                    for (size_t j = 0; j < points.size(); ++j) {
+                        const auto& point = restPoints[i][j];
+                        points[j] = (transform * Vector4f{point.getX(), point.getY(), point.getZ(), 1.0f})
+                                .getXYZ();
+                    }
+                    if (!slotMeshes[slot][i]->updatePoints(points, {}, &updatePool)) {
+                        outError = "frame " + std::to_string(frame) + ": mesh update failed";
+                        return false;
+                    }
+                    scenes[slot].updateSurface(slotMeshes[slot][i]);
+                }
+                slotPoses[slot] = pose;
+            }
+            // Refits the top level here instead of in the first query of the render.
+            static_cast<void>(scenes[slot].getFrozenScene());
+            return true;
+        };
+        const FramePipeline::RenderFunction render = [&](uint32_t frame, unsigned slot, FrameBuffer& outImage,
+                                                         std::string& outError) {
+            const auto pose = track.getFrame(frame);
+            cameraOrigin = pose.eye;
+            camera2worldTransform = MatrixUtils::makeCameraToWorldTransform(pose.eye, pose.target,
+                                                                            DemoScene::getCameraUp());
+            activeSlot = slot;
+            activeScene = &scenes[slot];
+            if (!renderFrame(outputPixelSize, outImage)) {
+                outError = "frame " + std::to_string(frame) + ": " + outImage.getError();
+                return false;
+            }
+            return true;
+        };
+        const FramePipeline::WriteFunction write = [&](uint32_t frame, const FrameBuffer& image,
+                                                       std::string& outError) {
+            const auto path = getFramePath(framePathPattern, frame);
+            const auto output = makeOutput(path);
+            if (!image.writeTo(*output)) {
+                outError = path + ": " + output->getError();
+                return false;
+            }
+            if (!quiet) {
+                std::cout << "Frame " << frame << " written to " << path << std::endl;
+            }
+            return true;
+        };
 
-    FILE *fp = fopen("../out/test.png", "wb");
-    assert(fp);
-    svpng(fp, outputPixelSize.getWidth(), outputPixelSize.getHeight(), outputRGBBuffer.get(), 0);
-    fclose(fp);
+        FramePipelineStatistics statistics;
+        std::string error;
+        if (!FramePipeline::run(frameCount, update, render, write, error, &statistics)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        if (!quiet) {
+            std::cout << statistics.frameCount << " frames in " << statistics.seconds << " s ("
+                      << statistics.frameCount / statistics.seconds << " fps), update "
+                      << statistics.updateSeconds << " s, render " << statistics.renderSeconds << " s, write "
+                      << statistics.writeSeconds << " s" << std::endl;
+        }
+    }
+    if (Statistics::kEnabled && !quiet) {
+        Statistics::print(Statistics::collect(), std::cout);
+    }
 
     return 0;
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Ray.h"
+#include "Statistics.h"
 
 namespace crt {
 
@@ -15,12 +16,36 @@ namespace crt {
 
         [[nodiscard]] bool hit(const Ray& ray, float tMin, float tMax) const;
 
+        /**
+         * Slab test against a precomputed reciprocal ray direction, used by BVH traversal.
+         */
+        [[nodiscard]] bool hit(const Vector3f& origin, const Vector3f& invDirection, float tMin, float tMax) const;
+
         [[nodiscard]] Vector3f getMin() const { return _min; }
 
         [[nodiscard]] Vector3f getMax() const { return _max; }
 
+        [[nodiscard]] Vector3f getCenter() const { return (_min + _max) * 0.5f; }
+
+        [[nodiscard]] Vector3f getExtent() const { return _max - _min; }
+
+        [[nodiscard]] bool isEmpty() const {
+            return _min.getX() > _max.getX() || _min.getY() > _max.getY() || _min.getZ() > _max.getZ();
+        }
+
+        [[nodiscard]] float getSurfaceArea() const {
+            if (isEmpty()) {
+                return 0.0f;
+            }
+            const auto extent = getExtent();
+            return 2.0f * (extent.getX() * extent.getY() + extent.getY() * extent.getZ() +
+                           extent.getZ() * extent.getX());
+        }
+
         void expand(const Vector3<Scalar>& point);
 
+        void expand(const BoundingBox& other);
+
     private:
         Vector3f _min;
         Vector3f _max;
@@ -38,6 +63,7 @@ namespace crt {
 
     template<typename Scalar>
     bool BoundingBox<Scalar>::hit(const Ray& ray, float tMin, float tMax) const {
+        CRT_COUNT(boxTests, 1);
         for (int a = 0; a < 3; a++) {
             const auto invD = 1.0f / ray.getDirection()[a];
             auto t0 = (_min[a] - ray.getOrigin()[a]) * invD;
@@ -54,6 +80,27 @@ namespace crt {
         return true;
     }
 
+    template<typename Scalar>
+    bool BoundingBox<Scalar>::hit(const Vector3f& origin, const Vector3f& invDirection, float tMin, float tMax) const {
+        // Widen the exit distance slightly so that flat boxes (axis aligned triangles) are not culled by rounding.
+        constexpr float kRobustness = 1.0f + 3.0f * std::numeric_limits<float>::epsilon();
+        CRT_COUNT(boxTests, 1);
+        for (int a = 0; a < 3; a++) {
+            auto t0 = (_min[a] - origin[a]) * invDirection[a];
+            auto t1 = (_max[a] - origin[a]) * invDirection[a];
+            if (invDirection[a] < 0.0f) {
+                std::swap(t0, t1);
+            }
+            t1 *= kRobustness;
+            tMin = t0 > tMin ? t0 : tMin;
+            tMax = t1 < tMax ? t1 : tMax;
+            if (tMax < tMin) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     template<typename Scalar>
     void BoundingBox<Scalar>::expand(const Vector3<Scalar>& point) {
         _min = Vector3<Scalar>{
@@ -67,4 +114,13 @@ namespace crt {
                 std::max(_max.getZ(), point.getZ())
         };
     }
+
+    template<typename Scalar>
+    void BoundingBox<Scalar>::expand(const BoundingBox& other) {
+        if (other.isEmpty()) {
+            return;
+        }
+        expand(other._min);
+        expand(other._max);
+    }
 }
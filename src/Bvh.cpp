@@ -0,0 +1,309 @@
+#include "Bvh.h"
+
+#include "LinearBvhBuilder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <optional>
+
+namespace crt {
+    namespace {
+        constexpr int kBinCount = 16;
+        constexpr float kTraversalCost = 1.0f;
+        constexpr float kIntersectionCost = 1.0f;
+        // Past this depth nodes are split at the object median, which bounds the remaining depth by log2(count).
+        constexpr size_t kMaxSahDepth = Bvh::kMaxDepth / 2;
+        // Smaller trees are refit on the calling thread.
+        constexpr size_t kParallelRefitThreshold = 64 * 1024;
+        // About this many subtrees are handed to the workers, enough to balance uneven subtrees.
+        constexpr size_t kRefitSubtreeCount = 64;
+
+        struct Bin {
+            BoundingBox<float> bounds;
+            uint32_t count = 0;
+        };
+
+        int getBinIndex(float centroid, float min, float scale) {
+            const auto index = static_cast<int>((centroid - min) * scale);
+            return std::clamp(index, 0, kBinCount - 1);
+        }
+    }
+
+    void Bvh::build(const std::vector<BoundingBox<float>>& primitiveBounds, const BvhBuildOptions& options) {
+        assert(options.leafBlockSize >= 1 && options.leafBlockSize <= kMaxLeafSize);
+        _options = options;
+        _nodes = {};
+        _statistics = {};
+        std::vector<uint32_t> primitiveIndices(primitiveBounds.size());
+        std::iota(primitiveIndices.begin(), primitiveIndices.end(), 0u);
+        if (primitiveBounds.empty()) {
+            _primitiveIndices = SharedArray<uint32_t>(std::move(primitiveIndices));
+            return;
+        }
+
+        std::vector<BvhNode> nodes;
+        if (options.method == BvhBuildMethod::Sah) {
+            std::vector<Vector3f> centroids;
+            centroids.reserve(primitiveBounds.size());
+            for (const auto& bounds: primitiveBounds) {
+                centroids.push_back(bounds.getCenter());
+            }
+
+            nodes.reserve(primitiveBounds.size() * 2 - 1);
+            nodes.emplace_back();
+            buildNode(0, 0, static_cast<uint32_t>(primitiveBounds.size()), 1, primitiveBounds, centroids,
+                      nodes, primitiveIndices);
+            nodes.shrink_to_fit();
+        } else {
+            LinearBvhBuilder::build(primitiveBounds, options, nodes, primitiveIndices);
+        }
+        _options.threadPool = nullptr;
+        _nodes = SharedArray<BvhNode>(std::move(nodes));
+        _primitiveIndices = SharedArray<uint32_t>(std::move(primitiveIndices));
+        updateStatistics();
+        _statistics.builtSahCost = _statistics.sahCost;
+    }
+
+    void Bvh::refit(const std::vector<BoundingBox<float>>& primitiveBounds,
+                    const std::vector<uint8_t>& dirtyPrimitives, ThreadPool* threadPool) {
+        if (_nodes.empty()) {
+            return;
+        }
+        assert(dirtyPrimitives.empty() || dirtyPrimitives.size() == primitiveBounds.size());
+        auto* nodes = _nodes.getMutableData();
+
+        // Split the tree into subtrees that are refit independently, the nodes above them are fixed up afterwards.
+        // Walking the levels breadth first lists every parent before its children.
+        std::vector<uint32_t> topNodes;
+        std::vector<uint32_t> subtrees{0};
+        if (_nodes.size() >= kParallelRefitThreshold) {
+            while (subtrees.size() < kRefitSubtreeCount) {
+                std::vector<uint32_t> nextSubtrees;
+                for (const auto index: subtrees) {
+                    if (nodes[index].isLeaf()) {
+                        nextSubtrees.push_back(index);
+                    } else {
+                        topNodes.push_back(index);
+                        nextSubtrees.push_back(nodes[index].offset);
+                        nextSubtrees.push_back(nodes[index].offset + 1);
+                    }
+                }
+                if (nextSubtrees.size() == subtrees.size()) {
+                    break;
+                }
+                subtrees.swap(nextSubtrees);
+            }
+        }
+
+        std::vector<uint8_t> changed(_nodes.size(), 0);
+        const auto refitSubtree = [&](uint32_t subtree, unsigned) {
+            changed[subtrees[subtree]] = refitNode(subtrees[subtree], primitiveBounds, dirtyPrimitives, nodes);
+        };
+        if (subtrees.size() > 1) {
+            std::optional<ThreadPool> localThreadPool;
+            if (!threadPool) {
+                localThreadPool.emplace();
+                threadPool = &*localThreadPool;
+            }
+            threadPool->parallelFor(static_cast<uint32_t>(subtrees.size()), refitSubtree);
+        } else {
+            refitSubtree(0, 0);
+        }
+        for (auto it = topNodes.rbegin(); it != topNodes.rend(); ++it) {
+            auto& node = nodes[*it];
+            if (changed[node.offset] || changed[node.offset + 1]) {
+                node.bounds = nodes[node.offset].bounds;
+                node.bounds.expand(nodes[node.offset + 1].bounds);
+                changed[*it] = 1;
+            }
+        }
+
+        // Adopted hierarchies (e.g. from a scene bundle) do not know their build cost, take the one before the
+        // first refit.
+        const auto builtSahCost = _statistics.builtSahCost > 0.0f ? _statistics.builtSahCost : _statistics.sahCost;
+        _statistics = {};
+        updateStatistics();
+        _statistics.builtSahCost = builtSahCost;
+    }
+
+    bool Bvh::refitNode(uint32_t nodeIndex, const std::vector<BoundingBox<float>>& primitiveBounds,
+                        const std::vector<uint8_t>& dirtyPrimitives, BvhNode* nodes) const {
+        auto& node = nodes[nodeIndex];
+        if (!node.isLeaf()) {
+            const auto leftChanged = refitNode(node.offset, primitiveBounds, dirtyPrimitives, nodes);
+            const auto rightChanged = refitNode(node.offset + 1, primitiveBounds, dirtyPrimitives, nodes);
+            if (!leftChanged && !rightChanged) {
+                return false;
+            }
+            node.bounds = nodes[node.offset].bounds;
+            node.bounds.expand(nodes[node.offset + 1].bounds);
+            return true;
+        }
+
+        const auto getPrimitive = [&](uint32_t position) {
+            return _primitiveIndices.empty() ? position : _primitiveIndices[position];
+        };
+        if (!dirtyPrimitives.empty()) {
+            bool dirty = false;
+            for (uint32_t i = 0; i < node.primitiveCount && !dirty; ++i) {
+                dirty = dirtyPrimitives[getPrimitive(node.offset + i)] != 0;
+            }
+            if (!dirty) {
+                return false;
+            }
+        }
+        BoundingBox<float> bounds;
+        for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+            bounds.expand(primitiveBounds[getPrimitive(node.offset + i)]);
+        }
+        node.bounds = bounds;
+        return true;
+    }
+
+    void Bvh::updateStatistics() {
+        // Children are always stored after their parent, so one forward pass sees every parent before its children.
+        std::vector<uint8_t> depths(_nodes.size(), 1);
+        const auto rootArea = _nodes.front().bounds.getSurfaceArea();
+        _statistics.nodeCount = _nodes.size();
+        for (size_t i = 0; i < _nodes.size(); ++i) {
+            const auto& node = _nodes[i];
+            const auto relativeArea = rootArea > 0.0f ? node.bounds.getSurfaceArea() / rootArea : 1.0f;
+            _statistics.maxDepth = std::max<size_t>(_statistics.maxDepth, depths[i]);
+            if (node.isLeaf()) {
+                ++_statistics.leafCount;
+                _statistics.maxLeafPrimitiveCount = std::max<size_t>(_statistics.maxLeafPrimitiveCount,
+                                                                     node.primitiveCount);
+                _statistics.sahCost += relativeArea * getIntersectionCost(node.primitiveCount);
+            } else {
+                depths[node.offset] = depths[node.offset + 1] = static_cast<uint8_t>(depths[i] + 1);
+                _statistics.sahCost += relativeArea * kTraversalCost;
+            }
+        }
+    }
+
+    float Bvh::getIntersectionCost(uint32_t primitiveCount) const {
+        const auto blockCount = (primitiveCount + _options.leafBlockSize - 1) / _options.leafBlockSize;
+        return kIntersectionCost * static_cast<float>(blockCount);
+    }
+
+    void Bvh::buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, size_t depth,
+                        const std::vector<BoundingBox<float>>& primitiveBounds,
+                        const std::vector<Vector3f>& centroids,
+                        std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitiveIndices) {
+        BoundingBox<float> bounds;
+        BoundingBox<float> centroidBounds;
+        for (auto i = begin; i < end; ++i) {
+            bounds.expand(primitiveBounds[primitiveIndices[i]]);
+            centroidBounds.expand(centroids[primitiveIndices[i]]);
+        }
+        nodes[nodeIndex].bounds = bounds;
+
+        const auto count = end - begin;
+        const auto makeLeaf = [&]() {
+            nodes[nodeIndex].offset = begin;
+            nodes[nodeIndex].primitiveCount = static_cast<uint16_t>(count);
+        };
+        if (count == 1) {
+            makeLeaf();
+            return;
+        }
+
+        const auto centroidExtent = centroidBounds.getExtent();
+        int bestAxis = -1;
+        int bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        if (depth < kMaxSahDepth) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (centroidExtent[axis] <= 0.0f) {
+                    continue;
+                }
+                const auto min = centroidBounds.getMin()[axis];
+                const auto scale = static_cast<float>(kBinCount) / centroidExtent[axis];
+
+                Bin bins[kBinCount];
+                for (auto i = begin; i < end; ++i) {
+                    const auto primitive = primitiveIndices[i];
+                    auto& bin = bins[getBinIndex(centroids[primitive][axis], min, scale)];
+                    bin.bounds.expand(primitiveBounds[primitive]);
+                    ++bin.count;
+                }
+
+                // Sweep from the right to get the area and count of every right hand side, then from the left.
+                float rightArea[kBinCount - 1];
+                uint32_t rightCount[kBinCount - 1];
+                BoundingBox<float> rightBounds;
+                uint32_t rightSum = 0;
+                for (int i = kBinCount - 1; i > 0; --i) {
+                    rightBounds.expand(bins[i].bounds);
+                    rightSum += bins[i].count;
+                    rightArea[i - 1] = rightBounds.getSurfaceArea();
+                    rightCount[i - 1] = rightSum;
+                }
+
+                BoundingBox<float> leftBounds;
+                uint32_t leftSum = 0;
+                for (int i = 0; i < kBinCount - 1; ++i) {
+                    leftBounds.expand(bins[i].bounds);
+                    leftSum += bins[i].count;
+                    if (leftSum == 0 || rightCount[i] == 0) {
+                        continue;
+                    }
+                    const auto cost = leftBounds.getSurfaceArea() * getIntersectionCost(leftSum) +
+                                      rightArea[i] * getIntersectionCost(rightCount[i]);
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = i;
+                    }
+                }
+            }
+        }
+
+        const auto* first = primitiveIndices.data() + begin;
+        auto* middle = primitiveIndices.data() + begin;
+        auto* last = primitiveIndices.data() + end;
+        if (bestAxis >= 0) {
+            const auto area = bounds.getSurfaceArea();
+            const auto splitCost = kTraversalCost + bestCost / (area > 0.0f ? area : 1.0f);
+            const auto leafCost = getIntersectionCost(count);
+            if (splitCost >= leafCost && count <= kMaxLeafSize) {
+                makeLeaf();
+                return;
+            }
+
+            const auto min = centroidBounds.getMin()[bestAxis];
+            const auto scale = static_cast<float>(kBinCount) / centroidExtent[bestAxis];
+            middle = std::partition(primitiveIndices.data() + begin, last, [&](uint32_t primitive) {
+                return getBinIndex(centroids[primitive][bestAxis], min, scale) <= bestSplit;
+            });
+        } else if (count <= kMaxLeafSize) {
+            makeLeaf();
+            return;
+        }
+
+        if (middle == first || middle == last) {
+            // No usable SAH split (coincident centroids or depth limit): fall back to the object median.
+            int axis = 0;
+            if (centroidExtent[1] > centroidExtent[axis]) axis = 1;
+            if (centroidExtent[2] > centroidExtent[axis]) axis = 2;
+            middle = primitiveIndices.data() + begin + count / 2;
+            std::nth_element(primitiveIndices.data() + begin, middle, last, [&](uint32_t a, uint32_t b) {
+                return centroids[a][axis] < centroids[b][axis];
+            });
+            bestAxis = axis;
+        }
+
+        const auto leftChild = static_cast<uint32_t>(nodes.size());
+        nodes[nodeIndex].offset = leftChild;
+        nodes[nodeIndex].axis = static_cast<uint16_t>(bestAxis);
+        nodes.emplace_back();
+        nodes.emplace_back();
+
+        const auto split = static_cast<uint32_t>(middle - primitiveIndices.data());
+        assert(depth + 1 < kMaxDepth);
+        buildNode(leftChild, begin, split, depth + 1, primitiveBounds, centroids, nodes, primitiveIndices);
+        buildNode(leftChild + 1, split, end, depth + 1, primitiveBounds, centroids, nodes, primitiveIndices);
+    }
+}
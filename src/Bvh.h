@@ -0,0 +1,303 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "RayPacket.h"
+#include "SharedArray.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace crt {
+
+    class ThreadPool;
+
+    struct BvhNode {
+        BoundingBox<float> bounds;
+        // Index of the first primitive for leaves, index of the left child for interior nodes.
+        // The right child is always stored right after the left one.
+        uint32_t offset = 0;
+        uint16_t primitiveCount = 0;
+        uint16_t axis = 0;
+
+        [[nodiscard]] bool isLeaf() const { return primitiveCount > 0; }
+    };
+
+    struct BvhBuildStatistics {
+        size_t nodeCount = 0;
+        size_t leafCount = 0;
+        size_t maxDepth = 0;
+        size_t maxLeafPrimitiveCount = 0;
+        // Expected cost of a random ray, relative to the root bounds (a node test and a leaf block test both cost 1).
+        float sahCost = 0.0f;
+        // sahCost right after the last full build. Refits keep it, so sahCost / builtSahCost tells how much moving
+        // the primitives degraded the tree.
+        float builtSahCost = 0.0f;
+    };
+
+    enum class BvhBuildMethod {
+        // Top down binned SAH, the best trees but a serial build.
+        Sah,
+        // Parallel linear BVH: primitives sorted by Morton code, split at the highest differing code bit.
+        Lbvh,
+        // Parallel locally ordered clustering on top of the Morton order, slower than Lbvh but close to Sah quality.
+        Ploc,
+    };
+
+    struct BvhBuildOptions {
+        // Number of primitives the owner intersects at once (e.g. 8 triangles per SIMD block). The SAH then
+        // charges a leaf per started block, which favours fuller leaves.
+        uint32_t leafBlockSize = 1;
+        BvhBuildMethod method = BvhBuildMethod::Sah;
+        // Lbvh and Ploc only: 30 or 63 bit Morton codes. 63 bits still tell apart primitives that share one of the
+        // 1024^3 cells of 30 bit codes, which matters for dense scans, but take twice as many radix sort passes.
+        uint32_t mortonBits = 30;
+        // Ploc only: how many clusters to each side of a cluster are searched for its nearest neighbour.
+        uint32_t plocRadius = 8;
+        // Lbvh and Ploc only: workers to build with. Null uses a temporary pool for large inputs. Not kept after
+        // the build.
+        ThreadPool* threadPool = nullptr;
+        // Mesh only: children per node of the tree that is traversed. 2 keeps the binary nodes, 4 and 8 collapse
+        // them into a WideBvh with quantized child bounds after the build.
+        uint32_t width = 2;
+        // Mesh and Scene updates only: a refit whose SAH cost grows past this multiple of the cost after the last
+        // full build is thrown away and the tree is rebuilt.
+        float maxRefitSahRatio = 1.5f;
+    };
+
+    /**
+     * Bounding volume hierarchy over an indexed set of primitives, built with a binned surface area heuristic
+     * or one of the parallel builders of LinearBvhBuilder.
+     * The hierarchy only stores primitive indices, the owner supplies the actual intersection routine.
+     */
+    class Bvh {
+    public:
+        static constexpr size_t kMaxDepth = 64;
+        // Leaves never hold more primitives than this, so a leaf fits one 8 wide SIMD block.
+        static constexpr uint32_t kMaxLeafSize = 8;
+
+        Bvh() = default;
+
+        explicit Bvh(const std::vector<BoundingBox<float>>& primitiveBounds, const BvhBuildOptions& options = {}) {
+            build(primitiveBounds, options);
+        }
+
+        /**
+         * Adopts a hierarchy built earlier, e.g. one stored in a scene bundle, without rebuilding it.
+         */
+        Bvh(SharedArray<BvhNode> nodes, SharedArray<uint32_t> primitiveIndices,
+            const BvhBuildStatistics& statistics, const BvhBuildOptions& options)
+                : _nodes(std::move(nodes)), _primitiveIndices(std::move(primitiveIndices)),
+                  _statistics(statistics), _options(options) {}
+
+        void build(const std::vector<BoundingBox<float>>& primitiveBounds, const BvhBuildOptions& options = {});
+
+        /**
+         * Recomputes the node bounds bottom up after primitives moved, keeping the topology. Only leaves holding a
+         * primitive flagged in dirtyPrimitives and their ancestors are updated, an empty dirtyPrimitives flags all
+         * of them. Subtrees are refit in parallel on threadPool; null uses a temporary pool for large trees. Nodes
+         * no other Bvh shares are updated in place.
+         * A hierarchy adopted without primitive indices is refit as if leaf position i held primitive i.
+         */
+        void refit(const std::vector<BoundingBox<float>>& primitiveBounds,
+                   const std::vector<uint8_t>& dirtyPrimitives = {}, ThreadPool* threadPool = nullptr);
+
+        /**
+         * Whether refits degraded the tree past BvhBuildOptions::maxRefitSahRatio, so it should be rebuilt.
+         */
+        [[nodiscard]] bool needsRebuild() const {
+            return _statistics.sahCost > _options.maxRefitSahRatio * _statistics.builtSahCost;
+        }
+
+        [[nodiscard]] bool isEmpty() const { return _nodes.empty(); }
+
+        [[nodiscard]] const SharedArray<BvhNode>& getNodes() const { return _nodes; }
+
+        [[nodiscard]] const SharedArray<uint32_t>& getPrimitiveIndices() const { return _primitiveIndices; }
+
+        [[nodiscard]] const BvhBuildStatistics& getStatistics() const { return _statistics; }
+
+        [[nodiscard]] const BvhBuildOptions& getOptions() const { return _options; }
+
+        [[nodiscard]] BoundingBox<float> getBounds() const {
+            return _nodes.empty() ? BoundingBox<float>{} : _nodes.front().bounds;
+        }
+
+        /**
+         * Closest hit traversal. `intersector(primitiveIndex, tMin, tMax)` must return true on a hit closer
+         * than tMax and shrink tMax to the hit distance, so later nodes are culled against the closest hit.
+         */
+        template<typename Intersector>
+        bool intersect(const Ray& ray, float tMin, float& tMax, Intersector&& intersector) const {
+            return traverse<false>(ray, tMin, tMax, [&](uint32_t, const BvhNode& leaf, float tMin, float& tMax) {
+                bool hit = false;
+                for (uint32_t i = 0; i < leaf.primitiveCount; ++i) {
+                    hit |= intersector(_primitiveIndices[leaf.offset + i], tMin, tMax);
+                }
+                return hit;
+            });
+        }
+
+        /**
+         * Any hit traversal for occlusion queries, stops at the first primitive for which
+         * `intersector(primitiveIndex, tMin, tMax)` returns true. Nodes are culled against the fixed tMax.
+         */
+        template<typename Intersector>
+        bool occluded(const Ray& ray, float tMin, float tMax, Intersector&& intersector) const {
+            return traverse<true>(ray, tMin, tMax, [&](uint32_t, const BvhNode& leaf, float tMin, float tMax) {
+                for (uint32_t i = 0; i < leaf.primitiveCount; ++i) {
+                    if (intersector(_primitiveIndices[leaf.offset + i], tMin, tMax)) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+
+        /**
+         * Like intersect and occluded, but hands whole leaves to `leafIntersector(nodeIndex, leaf, tMin, tMax)`
+         * so the owner can test all primitives of a leaf at once.
+         */
+        template<typename LeafIntersector>
+        bool intersectLeaves(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const {
+            return traverse<false>(ray, tMin, tMax, leafIntersector);
+        }
+
+        template<typename LeafIntersector>
+        bool occludedLeaves(const Ray& ray, float tMin, float tMax, LeafIntersector&& leafIntersector) const {
+            return traverse<true>(ray, tMin, tMax, leafIntersector);
+        }
+
+        /**
+         * Closest hit traversal for a whole packet. A node is visited while any lane still enters it;
+         * `intersector(primitiveIndex)` intersects the packet and shrinks the lanes' tMax.
+         */
+        template<typename Intersector>
+        void intersectPacket(const RayPacket& packet, Intersector&& intersector) const {
+            intersectPacketLeaves(packet, [&](uint32_t, const BvhNode& leaf) {
+                for (uint32_t i = 0; i < leaf.primitiveCount; ++i) {
+                    intersector(_primitiveIndices[leaf.offset + i]);
+                }
+            });
+        }
+
+        /**
+         * Like intersectPacket, but hands whole leaves to `leafIntersector(nodeIndex, leaf)`.
+         */
+        template<typename LeafIntersector>
+        void intersectPacketLeaves(const RayPacket& packet, LeafIntersector&& leafIntersector) const;
+
+    private:
+        template<bool AnyHit, typename LeafIntersector>
+        bool traverse(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const;
+
+        [[nodiscard]] float getIntersectionCost(uint32_t primitiveCount) const;
+
+        void updateStatistics();
+
+        /**
+         * Refits the subtree under nodeIndex, returns whether its bounds were recomputed.
+         */
+        bool refitNode(uint32_t nodeIndex, const std::vector<BoundingBox<float>>& primitiveBounds,
+                       const std::vector<uint8_t>& dirtyPrimitives, BvhNode* nodes) const;
+
+        void buildNode(uint32_t nodeIndex, uint32_t begin, uint32_t end, size_t depth,
+                       const std::vector<BoundingBox<float>>& primitiveBounds,
+                       const std::vector<Vector3f>& centroids,
+                       std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitiveIndices);
+
+    private:
+        SharedArray<BvhNode> _nodes;
+        SharedArray<uint32_t> _primitiveIndices;
+        BvhBuildStatistics _statistics;
+        BvhBuildOptions _options;
+    };
+
+    template<bool AnyHit, typename LeafIntersector>
+    bool Bvh::traverse(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const {
+        if (_nodes.empty()) {
+            return false;
+        }
+
+        const auto& origin = ray.getOrigin();
+        const auto& direction = ray.getDirection();
+        const Vector3f invDirection{1.0f / direction.getX(), 1.0f / direction.getY(), 1.0f / direction.getZ()};
+        const bool directionIsNegative[3] = {invDirection.getX() < 0.0f,
+                                             invDirection.getY() < 0.0f,
+                                             invDirection.getZ() < 0.0f};
+
+        uint32_t stack[kMaxDepth];
+        size_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+        bool hit = false;
+        while (true) {
+            const auto& node = _nodes[nodeIndex];
+            if (node.bounds.hit(origin, invDirection, tMin, tMax)) {
+                if (node.isLeaf()) {
+                    if (leafIntersector(nodeIndex, node, tMin, tMax)) {
+                        if constexpr (AnyHit) {
+                            return true;
+                        }
+                        hit = true;
+                    }
+                } else {
+                    // Visit the child on the near side of the split first, so tMax shrinks as early as possible.
+                    if (directionIsNegative[node.axis]) {
+                        stack[stackSize++] = node.offset;
+                        nodeIndex = node.offset + 1;
+                    } else {
+                        stack[stackSize++] = node.offset + 1;
+                        nodeIndex = node.offset;
+                    }
+                    continue;
+                }
+            }
+            if (stackSize == 0) {
+                break;
+            }
+            nodeIndex = stack[--stackSize];
+        }
+        return hit;
+    }
+
+    template<typename LeafIntersector>
+    void Bvh::intersectPacketLeaves(const RayPacket& packet, LeafIntersector&& leafIntersector) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        // Packets are coherent, so the near child is picked from the summed direction of the active lanes.
+        float directionSum[3] = {0.0f, 0.0f, 0.0f};
+        for (int lane = 0; lane < packet.size; ++lane) {
+            if (packet.isActive(lane)) {
+                directionSum[0] += packet.directionX[lane];
+                directionSum[1] += packet.directionY[lane];
+                directionSum[2] += packet.directionZ[lane];
+            }
+        }
+
+        uint32_t stack[kMaxDepth];
+        size_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+        while (true) {
+            const auto& node = _nodes[nodeIndex];
+            if (PacketKernels::intersectBounds(packet, node.bounds)) {
+                if (node.isLeaf()) {
+                    leafIntersector(nodeIndex, node);
+                } else {
+                    if (directionSum[node.axis] < 0.0f) {
+                        stack[stackSize++] = node.offset;
+                        nodeIndex = node.offset + 1;
+                    } else {
+                        stack[stackSize++] = node.offset + 1;
+                        nodeIndex = node.offset;
+                    }
+                    continue;
+                }
+            }
+            if (stackSize == 0) {
+                break;
+            }
+            nodeIndex = stack[--stackSize];
+        }
+    }
+}
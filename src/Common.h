@@ -2,10 +2,16 @@
 
 #include <limits>
 #include <cmath>
+#include <type_traits>
 
 namespace crt {
     template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T>>>
     inline bool almostEqual(T a, T b, T epsilon = std::numeric_limits<T>::epsilon()) {
-        return std::abs(a - b) < epsilon;
+        if constexpr (std::is_integral_v<T>) {
+            // The integer epsilon is 0, integers are only "almost equal" when they are equal.
+            return a == b;
+        } else {
+            return std::abs(a - b) < epsilon;
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "CompactGeometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace crt {
+    CompactGeometry::CompactGeometry(const std::vector<Vector3f>& points,
+                                     const std::vector<Vector3i>& triangleVertexIndices) {
+        setPoints(points);
+
+        if (points.size() <= kMaxQuantizedValue + 1u) {
+            std::vector<uint16_t> indices;
+            indices.reserve(3 * triangleVertexIndices.size());
+            for (const auto& triangle: triangleVertexIndices) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    indices.push_back(static_cast<uint16_t>(triangle[corner]));
+                }
+            }
+            _indices16 = SharedArray<uint16_t>(std::move(indices));
+        } else {
+            std::vector<uint32_t> indices;
+            indices.reserve(3 * triangleVertexIndices.size());
+            for (const auto& triangle: triangleVertexIndices) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    indices.push_back(static_cast<uint32_t>(triangle[corner]));
+                }
+            }
+            _indices32 = SharedArray<uint32_t>(std::move(indices));
+        }
+    }
+
+    void CompactGeometry::setPoints(const std::vector<Vector3f>& points) {
+        BoundingBox<float> bounds;
+        for (const auto& point: points) {
+            bounds.expand(point);
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            _origin[axis] = bounds.getMin()[axis];
+            _scale[axis] = (bounds.getMax()[axis] - bounds.getMin()[axis]) / static_cast<float>(kMaxQuantizedValue);
+        }
+
+        std::vector<QuantizedPoint> quantizedPoints;
+        quantizedPoints.reserve(points.size());
+        for (const auto& point: points) {
+            uint16_t values[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                const auto value = _scale[axis] > 0.0f ? std::round((point[axis] - _origin[axis]) / _scale[axis])
+                                                       : 0.0f;
+                values[axis] = static_cast<uint16_t>(std::clamp(value, 0.0f,
+                                                                static_cast<float>(kMaxQuantizedValue)));
+            }
+            quantizedPoints.push_back({values[0], values[1], values[2]});
+        }
+        _points = SharedArray<QuantizedPoint>(std::move(quantizedPoints));
+    }
+
+    CompactGeometry CompactGeometry::getWithPoints(const std::vector<Vector3f>& points) const {
+        CompactGeometry result;
+        result.setPoints(points);
+        result._indices16 = _indices16;
+        result._indices32 = _indices32;
+        return result;
+    }
+
+    std::vector<Vector3i> CompactGeometry::getTriangleVertexIndices() const {
+        std::vector<Vector3i> triangleVertexIndices;
+        triangleVertexIndices.reserve(getTriangleCount());
+        for (uint32_t triangle = 0; triangle < getTriangleCount(); ++triangle) {
+            triangleVertexIndices.push_back({static_cast<int>(getVertexIndex(triangle, 0)),
+                                             static_cast<int>(getVertexIndex(triangle, 1)),
+                                             static_cast<int>(getVertexIndex(triangle, 2))});
+        }
+        return triangleVertexIndices;
+    }
+
+    CompactGeometry CompactGeometry::getReordered(const SharedArray<uint32_t>& order) const {
+        CompactGeometry result;
+        std::copy(_origin, _origin + 3, result._origin);
+        std::copy(_scale, _scale + 3, result._scale);
+        result._points = _points;
+        if (hasNarrowIndices()) {
+            std::vector<uint16_t> indices;
+            indices.reserve(3 * order.size());
+            for (const auto triangle: order) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    indices.push_back(_indices16[3 * static_cast<size_t>(triangle) + corner]);
+                }
+            }
+            result._indices16 = SharedArray<uint16_t>(std::move(indices));
+        } else {
+            std::vector<uint32_t> indices;
+            indices.reserve(3 * order.size());
+            for (const auto triangle: order) {
+                for (int corner = 0; corner < 3; ++corner) {
+                    indices.push_back(_indices32[3 * static_cast<size_t>(triangle) + corner]);
+                }
+            }
+            result._indices32 = SharedArray<uint32_t>(std::move(indices));
+        }
+        return result;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "SharedArray.h"
+#include "TriangleBlock.h"
+#include "Vector.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace crt {
+
+    struct QuantizedPoint {
+        uint16_t x;
+        uint16_t y;
+        uint16_t z;
+    };
+
+    /**
+     * Triangle mesh geometry in about a third of the memory of Vector3f points and Vector3i indices. Points are
+     * stored as 16 bit coordinates on a grid over their bounding box (6 bytes instead of 12), indices take 16
+     * bits per corner when there are at most 65536 points. Points are decoded when a triangle is read, all
+     * readers see the same decoded positions.
+     */
+    class CompactGeometry {
+    public:
+        static constexpr uint32_t kMaxQuantizedValue = 0xffff;
+
+        CompactGeometry() = default;
+
+        CompactGeometry(const std::vector<Vector3f>& points, const std::vector<Vector3i>& triangleVertexIndices);
+
+        [[nodiscard]] bool isEmpty() const { return _points.empty(); }
+
+        [[nodiscard]] size_t getPointCount() const { return _points.size(); }
+
+        [[nodiscard]] size_t getTriangleCount() const {
+            return (_indices16.empty() ? _indices32.size() : _indices16.size()) / 3;
+        }
+
+        [[nodiscard]] bool hasNarrowIndices() const { return !_indices16.empty(); }
+
+        [[nodiscard]] Vector3f getPoint(uint32_t index) const {
+            const auto& point = _points[index];
+            return {_origin[0] + static_cast<float>(point.x) * _scale[0],
+                    _origin[1] + static_cast<float>(point.y) * _scale[1],
+                    _origin[2] + static_cast<float>(point.z) * _scale[2]};
+        }
+
+        [[nodiscard]] uint32_t getVertexIndex(uint32_t triangle, int corner) const {
+            const auto index = 3 * static_cast<size_t>(triangle) + corner;
+            return _indices16.empty() ? _indices32[index] : _indices16[index];
+        }
+
+        void getTriangle(uint32_t triangle, Vector3f& outV0, Vector3f& outV1, Vector3f& outV2) const {
+            outV0 = getPoint(getVertexIndex(triangle, 0));
+            outV1 = getPoint(getVertexIndex(triangle, 1));
+            outV2 = getPoint(getVertexIndex(triangle, 2));
+        }
+
+        /**
+         * Decodes triangles [firstTriangle, firstTriangle + count) into the first lanes of outBlock, whose other
+         * lanes must be empty.
+         */
+        void getTriangleBlock(uint32_t firstTriangle, uint32_t count, TriangleBlock& outBlock) const {
+            for (uint32_t i = 0; i < count; ++i) {
+                Vector3f v0, v1, v2;
+                getTriangle(firstTriangle + i, v0, v1, v2);
+                outBlock.set(static_cast<int>(i), v0, v1, v2, firstTriangle + i);
+            }
+        }
+
+        /**
+         * Copy whose triangle i is triangle order[i] of this one, e.g. to store the triangles of every BVH leaf
+         * next to each other.
+         */
+        [[nodiscard]] CompactGeometry getReordered(const SharedArray<uint32_t>& order) const;
+
+        /**
+         * Copy with the same triangles over new positions for the points, quantized on a grid over their bounds.
+         * points must have getPointCount() entries.
+         */
+        [[nodiscard]] CompactGeometry getWithPoints(const std::vector<Vector3f>& points) const;
+
+        /**
+         * The vertex indices of every triangle, in stored order.
+         */
+        [[nodiscard]] std::vector<Vector3i> getTriangleVertexIndices() const;
+
+        [[nodiscard]] size_t getByteSize() const {
+            return _points.size() * sizeof(QuantizedPoint) + _indices16.size() * sizeof(uint16_t) +
+                   _indices32.size() * sizeof(uint32_t);
+        }
+
+    private:
+        void setPoints(const std::vector<Vector3f>& points);
+
+    private:
+        float _origin[3] = {};
+        float _scale[3] = {};
+        SharedArray<QuantizedPoint> _points;
+        // Three indices per triangle, only one of the arrays is used.
+        SharedArray<uint16_t> _indices16;
+        SharedArray<uint32_t> _indices32;
+    };
+}
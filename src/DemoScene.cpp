@@ -0,0 +1,188 @@
+#include "DemoScene.h"
+
+#include "Matrix.h"
+#include "MatrixUtils.h"
+#include "MeshLoader.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "WideBvh.h"
+
+#include <cstdio>
+#include <iostream>
+
+namespace crt {
+
+    std::vector<LightSource> DemoScene::getLightSources() {
+        return {
+                {{150.0f * 4.0f,  500.0f * 1.5f, 1200.0f}, {1.0f, 1.0f, 1.0f}},
+                {{-150.0f * 1.0f, 400.0f,        400.0f},  {0.3f, 0.3f, 0.3f}},
+//                {{0.0f, 120.0f,        -80.0f},  {0.3f, 0.3f, 0.3f}},
+        };
+    }
+
+    std::shared_ptr<Texture2D> DemoScene::loadMoonTexture(const std::string& resourceDir, std::string& outError) {
+        const auto width = 1024;
+        const auto height = 512;
+        const auto path = resourceDir + "/moon-1024-512-rgb24.raw";
+        std::vector<uint8_t> data(width * height * 3);
+        auto *fp = fopen(path.c_str(), "rb");
+        if (!fp) {
+            outError = path + ": cannot open the moon texture";
+            return nullptr;
+        }
+        const auto readSize = fread(data.data(), 1, data.size(), fp);
+        const auto atEnd = fgetc(fp) == EOF;
+        fclose(fp);
+        if (readSize != data.size() || !atEnd) {
+            outError = path + ": the moon texture is not 1024x512 RGB24";
+            return nullptr;
+        }
+
+        return std::make_shared<Texture2D>(width, height, data);
+    }
+
+    std::unique_ptr<Mesh> DemoScene::loadDragonMesh(const std::string& resourceDir,
+                                                    const BvhBuildOptions& bvhOptions,
+                                                    MeshStorage storage,
+                                                    bool quiet,
+                                                    std::string& outError) {
+        // Transformation matrix
+        Matrix4f transform = Matrix4f::makeIdentity();
+        transform = MatrixUtils::scale(1000.0f, 1000.0f, 1000.0f) * transform;
+        transform = MatrixUtils::rotateByY<float>(135.0) * transform;
+        transform = MatrixUtils::translate(-200.0f, -50.0f, 0.0f) * transform;
+
+        MeshLoader loader;
+        auto mesh = loader.loadMesh(resourceDir + "/dragon_vrip_res4.ply", transform, bvhOptions, storage);
+        if (!mesh) {
+            outError = loader.getError();
+            return nullptr;
+        }
+        if (!quiet) {
+            const auto& statistics = loader.getStatistics();
+            std::cout << "Dragon loaded: " << statistics.vertexCount << " vertices, " << statistics.triangleCount
+                      << " triangles in " << statistics.seconds * 1000.0 << " ms ("
+                      << statistics.getMegabytesPerSecond() << " MB/s)" << std::endl;
+            if (storage == MeshStorage::Compact) {
+                std::cout << "Dragon compact: " << statistics.duplicatePointCount << " duplicate vertices merged, "
+                          << (mesh->getCompactGeometry().hasNarrowIndices() ? 16 : 32) << " bit indices"
+                          << std::endl;
+            }
+        }
+        return mesh;
+    }
+
+    bool DemoScene::build(Scene& scene,
+                          const std::string& resourceDir,
+                          const BvhBuildOptions& bvhOptions,
+                          MeshStorage meshStorage,
+                          bool quiet,
+                          std::string& outError) {
+        auto moonTexture = loadMoonTexture(resourceDir, outError);
+        if (!moonTexture) {
+            return false;
+        }
+
+        {
+            const auto material = Material({0.01f, 0.01f, 0.01f},
+                                           {0.8f, 0.2f, 0.2f},
+                                           {.3f, .3f, .3f},
+                                           200.0f);
+            auto sphere = std::make_shared<Sphere>(Vector3f{0.0f, 50.0f, 0.0f}, 50.0f);
+            sphere->setMaterial(material);
+            scene.addSurface(sphere);
+        }
+
+//        {
+//            const auto material = Material({0.1f, 0.1f, 0.1f},
+//                                           {0.3f, 0.3f, 0.3f},
+//                                           {0.0f, 0.0f, 0.0f},
+//                                           0.0f);
+//            auto sphere = std::make_shared<Sphere>(Vector3f{80.0f, 30.0f, 50.0f}, 30.0f);
+//            sphere->setTexture(moonTexture);
+//            scene.addSurface(sphere);
+//        }
+
+        {
+            const auto material = Material({0.01f, 0.01f, 0.01f},
+                                           {0.1f, 0.5f, 0.1f},
+                                           {0.0f, 0.0f, 0.0f},
+                                           0.0f);
+            scene.addSurface(std::make_shared<Sphere>(Vector3f{130.0f, 50.0f, -50.0f}, 50.0f, material));
+        }
+
+
+        {
+            const Material& triangleMaterial = Material({0.01f, 0.01f, 0.01f},
+                                                        {0.0f, 0.0f, 0.0f},
+                                                        {0.6f, 0.6f, 0.6f},
+                                                        50.0f);
+
+            std::vector<Vector3f> vertices = {
+                    {-200.0f, 0.0f,   -200.0f},
+                    {100.0f,  0.0f,   -280.0f},
+                    {-200.0f, 300.0f, -200.0f},
+                    {100.0f,  300.0f, -280.0f},
+            };
+            scene.addSurface(std::make_shared<Triangle>(vertices[0], vertices[1], vertices[2], triangleMaterial));
+            scene.addSurface(std::make_shared<Triangle>(vertices[1], vertices[3], vertices[2], triangleMaterial));
+        }
+
+
+        {
+            const auto material = Material({0.3f, 0.3f, 0.3f},
+                                           {0.3f, 0.3f, 0.3f},
+                                           {0.0f, 0.0f, 0.0f},
+                                           0.0f);
+            auto moonSphere = std::make_shared<Sphere>(Vector3f{350.0f, 200.0f, -500.0f}, 200.0f,
+                                                       material);
+            moonSphere->setTexture(moonTexture);
+            scene.addSurface(moonSphere);
+        }
+
+        {
+            const Material& material = Material({},
+                                                {0.2f, 0.2f, 0.2f},
+                                                {0.03f, 0.03f, 0.03f},
+                                                0.0f);
+            scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f},
+                                                     Vector3f{0.0f, 0.0f, 0.0f}, material));
+        }
+
+        {
+            std::shared_ptr<Mesh> dragon = loadDragonMesh(resourceDir, bvhOptions, meshStorage, quiet, outError);
+            if (!dragon) {
+                return false;
+            }
+            const auto material = Material({0.01f, 0.01f, 0.01f},
+                                           {0.8f, 0.2f, 0.2f},
+                                           {.3f, .3f, .3f},
+                                           200.0f);
+            dragon->setMaterial(material);
+            scene.addSurface(dragon);
+
+            if (!quiet) {
+                const auto& bvhStatistics = dragon->getBvh().getStatistics();
+                std::cout << "Dragon BVH: " << dragon->getTriangleCount() << " triangles, "
+                          << bvhStatistics.nodeCount << " nodes, depth " << bvhStatistics.maxDepth
+                          << ", SAH cost " << bvhStatistics.sahCost << std::endl;
+                // Everything traversal reads besides the triangle blocks.
+                size_t nodeBytes = dragon->getBvh().getNodes().size() * sizeof(BvhNode) +
+                                   dragon->getBvh().getPrimitiveIndices().size() * sizeof(uint32_t) +
+                                   dragon->getLeafBlocks().size() * sizeof(uint32_t);
+                nodeBytes += dragon->getWideBvh4().getNodes().size() * sizeof(WideBvhNode<4>);
+                nodeBytes += dragon->getWideBvh8().getNodes().size() * sizeof(WideBvhNode<8>);
+                const auto triangleCount = static_cast<double>(dragon->getTriangleCount());
+                std::cout << "Dragon BVH width " << dragon->getBvhWidth() << ": "
+                          << static_cast<double>(nodeBytes) / triangleCount << " node bytes per triangle"
+                          << std::endl;
+                std::cout << "Dragon memory: " << dragon->getByteSize() / 1024 << " KiB, "
+                          << static_cast<double>(dragon->getByteSize()) / triangleCount << " bytes per triangle"
+                          << std::endl;
+            }
+        }
+
+        return true;
+    }
+}
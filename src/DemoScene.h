@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Mesh.h"
+#include "Scene.h"
+#include "Shading.h"
+#include "Texture2D.h"
+#include "Vector.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * The scene main renders by default: the Stanford dragon, two spheres, a textured moon, a mirror quad and the
+     * floor, lit by two point lights. Shared with the benchmarks so both trace the same geometry from the same
+     * camera. The resource directory holds the dragon model and the moon texture.
+     */
+    class DemoScene {
+    public:
+        static constexpr float kCameraNear = -0.1f;
+        static constexpr float kCameraFar = -100.0f;
+        static constexpr float kFieldOfViewDegrees = 60.0f;
+
+        [[nodiscard]] static Vector3f getCameraOrigin() { return {150.0f, 220.0f, 500.0f}; }
+
+        [[nodiscard]] static Vector3f getCameraTarget() { return {0.0f, 100.0f, 50.0f}; }
+
+        [[nodiscard]] static Vector3f getCameraUp() { return {0.0f, 1.0f, 0.0f}; }
+
+        [[nodiscard]] static std::vector<LightSource> getLightSources();
+
+        /**
+         * The 1024x512 RGB24 moon texture, nullptr when the file is missing or has a different size.
+         */
+        static std::shared_ptr<Texture2D> loadMoonTexture(const std::string& resourceDir, std::string& outError);
+
+        /**
+         * The dragon model placed in the scene. Unless quiet, prints the loader statistics.
+         */
+        static std::unique_ptr<Mesh> loadDragonMesh(const std::string& resourceDir,
+                                                    const BvhBuildOptions& bvhOptions,
+                                                    MeshStorage storage,
+                                                    bool quiet,
+                                                    std::string& outError);
+
+        /**
+         * Adds every surface to scene. Unless quiet, prints the loader statistics and the dragon's hierarchy and
+         * memory use.
+         */
+        static bool build(Scene& scene,
+                          const std::string& resourceDir,
+                          const BvhBuildOptions& bvhOptions,
+                          MeshStorage meshStorage,
+                          bool quiet,
+                          std::string& outError);
+    };
+}
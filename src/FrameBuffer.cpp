@@ -0,0 +1,48 @@
+#include "FrameBuffer.h"
+
+#include <algorithm>
+
+namespace crt {
+    bool FrameBuffer::begin(const SizeI& imageSize) {
+        if (imageSize.getWidth() <= 0 || imageSize.getHeight() <= 0) {
+            return fail("empty image");
+        }
+        _size.setWidth(imageSize.getWidth());
+        _size.setHeight(imageSize.getHeight());
+        // Keeps the allocation when frames of one size are rendered into the buffer again and again.
+        _pixels.resize(static_cast<size_t>(imageSize.getWidth()) * imageSize.getHeight());
+        _nextRow = 0;
+        return true;
+    }
+
+    bool FrameBuffer::writeRows(int y, int rowCount, const Vector3f* pixels) {
+        if (y != _nextRow || rowCount <= 0 || y + rowCount > _size.getHeight()) {
+            return fail("rows must be written in order");
+        }
+        const auto width = static_cast<size_t>(_size.getWidth());
+        std::copy(pixels, pixels + rowCount * width, _pixels.begin() + static_cast<std::ptrdiff_t>(y * width));
+        _nextRow += rowCount;
+        return true;
+    }
+
+    bool FrameBuffer::end() {
+        if (!isComplete()) {
+            return fail("frame is incomplete");
+        }
+        return true;
+    }
+
+    bool FrameBuffer::writeTo(ImageOutput& output) const {
+        if (!output.begin(_size)) {
+            return false;
+        }
+        const auto width = static_cast<size_t>(_size.getWidth());
+        for (int y = 0; y < _size.getHeight(); y += kBandHeight) {
+            const auto rowCount = std::min(kBandHeight, _size.getHeight() - y);
+            if (!output.writeRows(y, rowCount, _pixels.data() + y * width)) {
+                return false;
+            }
+        }
+        return output.end();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ImageOutput.h"
+
+#include <vector>
+
+namespace crt {
+
+    /**
+     * ImageOutput that keeps the whole frame in memory as linear RGB, so a finished frame can be encoded later,
+     * e.g. on another thread while the next frame renders.
+     */
+    class FrameBuffer : public ImageOutput {
+    public:
+        // Rows handed to the output per writeRows call by writeTo.
+        static constexpr int kBandHeight = 32;
+
+        bool begin(const SizeI& imageSize) override;
+
+        bool writeRows(int y, int rowCount, const Vector3f* pixels) override;
+
+        bool end() override;
+
+        /**
+         * Whether every row of the frame has been written.
+         */
+        [[nodiscard]] bool isComplete() const {
+            return _nextRow == _size.getHeight() && _nextRow > 0;
+        }
+
+        [[nodiscard]] const SizeI& getSize() const {
+            return _size;
+        }
+
+        [[nodiscard]] const std::vector<Vector3f>& getPixels() const {
+            return _pixels;
+        }
+
+        /**
+         * Streams the frame into output band by band. Returns false with the error in output.getError().
+         */
+        bool writeTo(ImageOutput& output) const;
+
+    private:
+        SizeI _size;
+        std::vector<Vector3f> _pixels;
+        int _nextRow = 0;
+    };
+}
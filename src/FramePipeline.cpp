@@ -0,0 +1,96 @@
+#include "FramePipeline.h"
+
+#include <chrono>
+#include <future>
+
+namespace crt {
+    namespace {
+        struct StageResult {
+            bool succeeded = true;
+            std::string error;
+            double seconds = 0.0;
+        };
+
+        template<typename Stage>
+        StageResult runStage(const Stage& stage) {
+            const auto start = std::chrono::steady_clock::now();
+            StageResult result;
+            result.succeeded = stage(result.error);
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        }
+    }
+
+    bool FramePipeline::run(uint32_t frameCount, const UpdateFunction& update, const RenderFunction& render,
+                            const WriteFunction& write, std::string& outError,
+                            FramePipelineStatistics* outStatistics) {
+        const auto start = std::chrono::steady_clock::now();
+        FramePipelineStatistics statistics;
+        bool succeeded = true;
+        // Records a finished stage, the first failure wins.
+        const auto collect = [&](const StageResult& result, double& seconds) {
+            seconds += result.seconds;
+            if (!result.succeeded && succeeded) {
+                succeeded = false;
+                outError = result.error;
+            }
+        };
+
+        FrameBuffer images[kSlotCount];
+        // Writes of the frames that last used each image, shared so the next write can wait for its predecessor.
+        std::shared_future<StageResult> writes[kSlotCount];
+        if (frameCount > 0) {
+            collect(runStage([&](std::string& error) { return update(0, 0, error); }), statistics.updateSeconds);
+        }
+        for (uint32_t frame = 0; frame < frameCount && succeeded; ++frame) {
+            const auto slot = frame % kSlotCount;
+            // The slot of the next frame was last rendered from two frames ago, so it is free to change.
+            std::future<StageResult> nextUpdate;
+            if (frame + 1 < frameCount) {
+                nextUpdate = std::async(std::launch::async, [&, frame]() {
+                    return runStage([&](std::string& error) {
+                        return update(frame + 1, (frame + 1) % kSlotCount, error);
+                    });
+                });
+            }
+
+            // The write of frame - kSlotCount may still be reading this image.
+            if (writes[slot].valid()) {
+                collect(writes[slot].get(), statistics.writeSeconds);
+                writes[slot] = {};
+            }
+            if (succeeded) {
+                collect(runStage([&](std::string& error) { return render(frame, slot, images[slot], error); }),
+                        statistics.renderSeconds);
+            }
+            if (nextUpdate.valid()) {
+                collect(nextUpdate.get(), statistics.updateSeconds);
+            }
+            if (!succeeded) {
+                break;
+            }
+
+            auto previousWrite = writes[(frame + kSlotCount - 1) % kSlotCount];
+            writes[slot] = std::async(std::launch::async, [&, frame, slot, previousWrite]() {
+                if (previousWrite.valid()) {
+                    previousWrite.wait();
+                }
+                return runStage([&](std::string& error) { return write(frame, images[slot], error); });
+            }).share();
+            ++statistics.frameCount;
+        }
+
+        // Collect in frame order, so a failed write is reported before any later one.
+        for (uint32_t i = 0; i < kSlotCount; ++i) {
+            const auto slot = (statistics.frameCount + i) % kSlotCount;
+            if (writes[slot].valid()) {
+                collect(writes[slot].get(), statistics.writeSeconds);
+            }
+        }
+        statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (outStatistics) {
+            *outStatistics = statistics;
+        }
+        return succeeded;
+    }
+}
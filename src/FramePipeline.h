@@ -0,0 +1,47 @@
+#pragma once
+
+#include "FrameBuffer.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace crt {
+
+    struct FramePipelineStatistics {
+        // Frames rendered and handed to the write stage.
+        uint32_t frameCount = 0;
+        double seconds = 0.0;
+        // Time spent in each stage summed over all frames. The stages overlap, so together they exceed seconds.
+        double updateSeconds = 0.0;
+        double renderSeconds = 0.0;
+        double writeSeconds = 0.0;
+    };
+
+    /**
+     * Runs a sequence of frames as a three stage pipeline: while frame N renders, frame N + 1 is brought up to date
+     * in the other scene slot and frame N - 1 is encoded and written. The owner keeps kSlotCount copies of
+     * everything a frame update changes; a slot is only updated while no frame renders from it. Each stage sees
+     * the frames in order, and writes never overlap each other.
+     */
+    class FramePipeline {
+    public:
+        static constexpr unsigned kSlotCount = 2;
+
+        // Brings scene slot `slot` to frame `frame`.
+        using UpdateFunction = std::function<bool(uint32_t frame, unsigned slot, std::string& outError)>;
+        // Renders frame from scene slot `slot` into outImage.
+        using RenderFunction = std::function<bool(uint32_t frame, unsigned slot, FrameBuffer& outImage,
+                                                  std::string& outError)>;
+        // Encodes and writes the rendered image of frame.
+        using WriteFunction = std::function<bool(uint32_t frame, const FrameBuffer& image, std::string& outError)>;
+
+        /**
+         * Runs frames [0, frameCount). Stops at the first stage that fails and returns false with its error,
+         * after every stage already running has finished.
+         */
+        static bool run(uint32_t frameCount, const UpdateFunction& update, const RenderFunction& render,
+                        const WriteFunction& write, std::string& outError,
+                        FramePipelineStatistics* outStatistics = nullptr);
+    };
+}
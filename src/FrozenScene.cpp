@@ -0,0 +1,192 @@
+#include "FrozenScene.h"
+
+#include "MathUtils.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+
+#include <typeinfo>
+
+namespace crt {
+    void FrozenScene::build(const std::vector<SurfacePtr>& surfaces) {
+        _bvh.build(collect(surfaces));
+    }
+
+    void FrozenScene::refit(const std::vector<SurfacePtr>& surfaces) {
+        const auto bounds = collect(surfaces);
+        if (_bvh.isEmpty() || _bvh.getPrimitiveIndices().size() != bounds.size()) {
+            _bvh.build(bounds);
+            return;
+        }
+        _bvh.refit(bounds);
+        if (_bvh.needsRebuild()) {
+            _bvh.build(bounds);
+        }
+    }
+
+    std::vector<BoundingBox<float>> FrozenScene::collect(const std::vector<SurfacePtr>& surfaces) {
+        _surfaces.clear();
+        _planes.clear();
+        _otherUnbounded.clear();
+        _spheres.clear();
+        _triangles.clear();
+        _meshes.clear();
+        _otherBounded.clear();
+
+        std::vector<BoundingBox<float>> sphereBounds;
+        std::vector<BoundingBox<float>> triangleBounds;
+        std::vector<BoundingBox<float>> meshBounds;
+        std::vector<BoundingBox<float>> otherBounds;
+        for (const auto& surfacePtr: surfaces) {
+            const auto* surface = surfacePtr.get();
+            const auto index = static_cast<uint32_t>(_surfaces.size());
+            _surfaces.push_back(surface);
+            // Exact types only: a subclass may override intersection, so it stays on the virtual path.
+            const auto& type = typeid(*surface);
+            BoundingBox<float> bounds;
+            const bool bounded = surface->boundingBox(bounds);
+            if (type == typeid(Plane)) {
+                const auto* plane = static_cast<const Plane*>(surface);
+                _planes.push_back({plane->getNormal(plane->getPoint()), plane->getPoint(), index});
+            } else if (!bounded) {
+                _otherUnbounded.push_back(surface);
+            } else if (type == typeid(Sphere)) {
+                const auto* sphere = static_cast<const Sphere*>(surface);
+                _spheres.push_back({sphere->getCenter(), sphere->getRadius(), index});
+                sphereBounds.push_back(bounds);
+            } else if (type == typeid(Triangle)) {
+                const auto& triangle = *static_cast<const Triangle*>(surface);
+                _triangles.push_back({triangle[0], triangle[1], triangle[2], index});
+                triangleBounds.push_back(bounds);
+            } else if (type == typeid(Mesh)) {
+                _meshes.push_back(static_cast<const Mesh*>(surface));
+                meshBounds.push_back(bounds);
+            } else {
+                _otherBounded.push_back(surface);
+                otherBounds.push_back(bounds);
+            }
+        }
+
+        auto bounds = std::move(sphereBounds);
+        bounds.insert(bounds.end(), triangleBounds.begin(), triangleBounds.end());
+        bounds.insert(bounds.end(), meshBounds.begin(), meshBounds.end());
+        bounds.insert(bounds.end(), otherBounds.begin(), otherBounds.end());
+        return bounds;
+    }
+
+    bool FrozenScene::intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const {
+        bool hasHit = false;
+        float t;
+        for (const auto& plane: _planes) {
+            if (MathUtils::rayIntersectsPlane(ray, plane.normal, plane.point, t) && t >= tMin && t < tMax) {
+                outHit = {t, 0, 0.0f, 0.0f, _surfaces[plane.surface]};
+                tMax = t;
+                hasHit = true;
+            }
+        }
+        SurfaceHit candidate{};
+        for (const auto* surface: _otherUnbounded) {
+            if (surface->intersect(ray, tMin, tMax, candidate) && candidate.t < tMax) {
+                outHit = candidate;
+                tMax = candidate.t;
+                hasHit = true;
+            }
+        }
+
+        hasHit |= _bvh.intersect(ray, tMin, tMax, [&](uint32_t index, float tMin, float& tMax) {
+            if (index < _spheres.size()) {
+                const auto& sphere = _spheres[index];
+                if (MathUtils::rayIntersectsSphere(ray, sphere.center, sphere.radius, t) && t >= tMin && t < tMax) {
+                    outHit = {t, 0, 0.0f, 0.0f, _surfaces[sphere.surface]};
+                    tMax = t;
+                    return true;
+                }
+                return false;
+            }
+            index -= static_cast<uint32_t>(_spheres.size());
+            if (index < _triangles.size()) {
+                const auto& triangle = _triangles[index];
+                float u, v;
+                if (MathUtils::rayIntersectsTriangle(ray, triangle.v0, triangle.v1, triangle.v2, t, u, v) &&
+                    t >= tMin && t < tMax) {
+                    outHit = {t, 0, u, v, _surfaces[triangle.surface]};
+                    tMax = t;
+                    return true;
+                }
+                return false;
+            }
+            index -= static_cast<uint32_t>(_triangles.size());
+            const bool hit = index < _meshes.size()
+                             ? _meshes[index]->Mesh::intersect(ray, tMin, tMax, candidate)
+                             : _otherBounded[index - _meshes.size()]->intersect(ray, tMin, tMax, candidate);
+            if (hit && candidate.t < tMax) {
+                outHit = candidate;
+                tMax = candidate.t;
+                return true;
+            }
+            return false;
+        });
+        return hasHit;
+    }
+
+    bool FrozenScene::occluded(const Ray& ray, float tMin, float tMax) const {
+        float t;
+        for (const auto& plane: _planes) {
+            if (MathUtils::rayIntersectsPlane(ray, plane.normal, plane.point, t) && t >= tMin && t <= tMax) {
+                return true;
+            }
+        }
+        for (const auto* surface: _otherUnbounded) {
+            if (surface->occluded(ray, tMin, tMax)) {
+                return true;
+            }
+        }
+        return _bvh.occluded(ray, tMin, tMax, [&](uint32_t index, float tMin, float tMax) {
+            if (index < _spheres.size()) {
+                const auto& sphere = _spheres[index];
+                return MathUtils::rayIntersectsSphere(ray, sphere.center, sphere.radius, tMin, tMax);
+            }
+            index -= static_cast<uint32_t>(_spheres.size());
+            if (index < _triangles.size()) {
+                const auto& triangle = _triangles[index];
+                float u, v;
+                return MathUtils::rayIntersectsTriangle(ray, triangle.v0, triangle.v1, triangle.v2, t, u, v) &&
+                       t >= tMin && t <= tMax;
+            }
+            index -= static_cast<uint32_t>(_triangles.size());
+            return index < _meshes.size()
+                   ? _meshes[index]->Mesh::occluded(ray, tMin, tMax)
+                   : _otherBounded[index - _meshes.size()]->occluded(ray, tMin, tMax);
+        });
+    }
+
+    void FrozenScene::hitPacket(RayPacket& packet, PacketHit& outHit) const {
+        for (const auto& plane: _planes) {
+            PacketKernels::intersectPlane(packet, outHit, plane.normal, plane.point, _surfaces[plane.surface]);
+        }
+        for (const auto* surface: _otherUnbounded) {
+            surface->hitPacket(packet, outHit);
+        }
+        _bvh.intersectPacket(packet, [&](uint32_t index) {
+            if (index < _spheres.size()) {
+                const auto& sphere = _spheres[index];
+                PacketKernels::intersectSphere(packet, outHit, sphere.center, sphere.radius,
+                                               _surfaces[sphere.surface]);
+                return;
+            }
+            index -= static_cast<uint32_t>(_spheres.size());
+            if (index < _triangles.size()) {
+                const auto& triangle = _triangles[index];
+                PacketKernels::intersectTriangle(packet, outHit, triangle.v0, triangle.v1, triangle.v2,
+                                                 _surfaces[triangle.surface], 0);
+                return;
+            }
+            index -= static_cast<uint32_t>(_triangles.size());
+            if (index < _meshes.size()) {
+                _meshes[index]->Mesh::hitPacket(packet, outHit);
+            } else {
+                _otherBounded[index - _meshes.size()]->hitPacket(packet, outHit);
+            }
+        });
+    }
+}
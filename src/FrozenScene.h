@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Bvh.h"
+#include "Mesh.h"
+#include "Surface.h"
+
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Read-only, data-oriented copy of a scene's geometry for traversal. Spheres, planes and triangles are
+     * copied into contiguous per-type arrays and intersected by plain loops and BVH leaves, meshes are called
+     * without virtual dispatch. Each record keeps the index of its authoring Surface, which only the closest
+     * hit is resolved against. Surface types it does not know keep working through their virtual interface.
+     */
+    class FrozenScene {
+    public:
+        void build(const std::vector<SurfacePtr>& surfaces);
+
+        /**
+         * Copies the surfaces again after some of them moved and refits the hierarchy instead of rebuilding it.
+         * The surfaces must be the ones of the last build, the hierarchy is rebuilt when the bounded ones changed
+         * or the refit degraded it past BvhBuildOptions::maxRefitSahRatio.
+         */
+        void refit(const std::vector<SurfacePtr>& surfaces);
+
+        bool intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const;
+
+        [[nodiscard]] bool occluded(const Ray& ray, float tMin, float tMax) const;
+
+        void hitPacket(RayPacket& packet, PacketHit& outHit) const;
+
+        /**
+         * Hierarchy over the bounded geometry: spheres first, then triangles, meshes and other bounded surfaces.
+         */
+        [[nodiscard]] const Bvh& getBvh() const {
+            return _bvh;
+        }
+
+    private:
+        struct SphereRecord {
+            Vector3f center;
+            float radius;
+            uint32_t surface;
+        };
+
+        struct PlaneRecord {
+            Vector3f normal;
+            Vector3f point;
+            uint32_t surface;
+        };
+
+        struct TriangleRecord {
+            Vector3f v0;
+            Vector3f v1;
+            Vector3f v2;
+            uint32_t surface;
+        };
+
+    private:
+        /**
+         * Fills the records from surfaces and returns the bounds of the bounded ones in BVH primitive order.
+         */
+        std::vector<BoundingBox<float>> collect(const std::vector<SurfacePtr>& surfaces);
+
+    private:
+        // Authoring surfaces by index, to hand them out with hits.
+        std::vector<const Surface*> _surfaces;
+
+        std::vector<PlaneRecord> _planes;
+        std::vector<const Surface*> _otherUnbounded;
+
+        // Bounded geometry in BVH primitive order.
+        std::vector<SphereRecord> _spheres;
+        std::vector<TriangleRecord> _triangles;
+        std::vector<const Mesh*> _meshes;
+        std::vector<const Surface*> _otherBounded;
+        Bvh _bvh;
+    };
+}
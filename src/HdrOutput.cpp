@@ -0,0 +1,81 @@
+#include "HdrOutput.h"
+
+#include <vector>
+
+#include <sys/types.h>
+
+// Float images pass 2 GiB at 16k x 16k, so offsets must not be limited to a 32 bit long.
+static_assert(sizeof(off_t) >= sizeof(int64_t), "build with _FILE_OFFSET_BITS=64");
+
+crt::HdrOutput::HdrOutput(std::string path, HdrFormat format) : _path(std::move(path)), _format(format) {}
+
+crt::HdrOutput::~HdrOutput() {
+    closeFile();
+}
+
+void crt::HdrOutput::closeFile() {
+    if (_file) {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+}
+
+bool crt::HdrOutput::begin(const SizeI& imageSize) {
+    if (imageSize.getWidth() <= 0 || imageSize.getHeight() <= 0) {
+        return fail("empty image");
+    }
+    closeFile();
+    _file = std::fopen(_path.c_str(), "wb");
+    if (!_file) {
+        return fail("cannot open " + _path);
+    }
+    _width = imageSize.getWidth();
+    _height = imageSize.getHeight();
+    _nextRow = 0;
+    _dataOffset = 0;
+    if (_format == HdrFormat::Pfm) {
+        // A negative scale declares little endian data.
+        const auto header = "PF\n" + std::to_string(imageSize.getWidth()) + " " +
+                            std::to_string(imageSize.getHeight()) + "\n-1.0\n";
+        if (std::fwrite(header.data(), header.size(), 1, _file) != 1) {
+            return fail("cannot write " + _path);
+        }
+        _dataOffset = static_cast<int64_t>(header.size());
+    }
+    return true;
+}
+
+bool crt::HdrOutput::writeRows(int y, int rowCount, const Vector3f* pixels) {
+    if (!_file || y != _nextRow || rowCount <= 0 || y + rowCount > _height) {
+        return fail("rows must be written in order");
+    }
+    const auto width = static_cast<size_t>(_width);
+    std::vector<float> row(width * 3);
+    for (int i = 0; i < rowCount; ++i) {
+        const auto* source = pixels + i * width;
+        for (size_t x = 0; x < width; ++x) {
+            row[x * 3 + 0] = source[x].getX();
+            row[x * 3 + 1] = source[x].getY();
+            row[x * 3 + 2] = source[x].getZ();
+        }
+        const auto fileRow = _format == HdrFormat::Pfm ? _height - 1 - (y + i) : y + i;
+        const auto rowBytes = static_cast<int64_t>(row.size() * sizeof(float));
+        const auto offset = _dataOffset + static_cast<int64_t>(fileRow) * rowBytes;
+        if (::fseeko(_file, static_cast<off_t>(offset), SEEK_SET) != 0 ||
+            std::fwrite(row.data(), row.size() * sizeof(float), 1, _file) != 1) {
+            return fail("cannot write " + _path);
+        }
+    }
+    _nextRow += rowCount;
+    return true;
+}
+
+bool crt::HdrOutput::end() {
+    if (!_file || _nextRow != _height) {
+        closeFile();
+        return fail("image is incomplete");
+    }
+    const bool closed = std::fclose(_file) == 0;
+    _file = nullptr;
+    return closed || fail("cannot write " + _path);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ImageOutput.h"
+
+#include <cstdint>
+#include <cstdio>
+
+namespace crt {
+
+    enum class HdrFormat {
+        // Portable float map: a short text header and little endian float RGB, rows stored bottom to top.
+        Pfm,
+        // Headerless little endian float RGB, rows stored top to bottom.
+        Raw,
+    };
+
+    /**
+     * Unclamped linear float output for compositing. Bands go to their final file offset as they arrive, so
+     * PFM's bottom-up row order costs no extra memory.
+     */
+    class HdrOutput : public ImageOutput {
+    public:
+        explicit HdrOutput(std::string path, HdrFormat format = HdrFormat::Pfm);
+
+        ~HdrOutput() override;
+
+        bool begin(const SizeI& imageSize) override;
+
+        bool writeRows(int y, int rowCount, const Vector3f* pixels) override;
+
+        bool end() override;
+
+    private:
+        void closeFile();
+
+    private:
+        std::string _path;
+        HdrFormat _format;
+        FILE* _file = nullptr;
+        int _width = 0;
+        int _height = 0;
+        int64_t _dataOffset = 0;
+        int _nextRow = 0;
+    };
+}
@@ -3,7 +3,23 @@
 #include "Ray.h"
 #include "Material.h"
 
+#include <cstdint>
+
 namespace crt {
+    class Surface;
+
+    /**
+     * What traversal keeps of a candidate intersection: distance, primitive and barycentrics. Normal, material
+     * and color are only worked out for the closest hit, see Surface::resolveHit.
+     */
+    struct SurfaceHit {
+        float t;
+        uint32_t primitive;
+        float u;
+        float v;
+        const Surface* surface;
+    };
+
     struct HitRecord {
     public:
         float t;
@@ -11,7 +27,8 @@ namespace crt {
         float v;
         Vector3f p;
         Vector3f normal;
-        Material material;
+        // Material of the surface that was hit, valid as long as that surface is.
+        const Material* material;
         Vector3f color;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Size.h"
+#include "Vector.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace crt {
+
+    /**
+     * Quantizes a linear color channel to 8 bits the way the renderer always has: clamp, scale and truncate.
+     */
+    inline uint8_t toUnorm8(float value) {
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255);
+    }
+
+    /**
+     * Destination for a streamed image. The renderer hands over finished bands of rows from top to bottom, so an
+     * output only ever holds a band instead of the whole frame.
+     */
+    class ImageOutput {
+    public:
+        virtual ~ImageOutput() = default;
+
+        virtual bool begin(const SizeI& imageSize) = 0;
+
+        /**
+         * Rows [y, y + rowCount) as row major linear RGB. Rows arrive in order and each exactly once.
+         */
+        virtual bool writeRows(int y, int rowCount, const Vector3f* pixels) = 0;
+
+        /**
+         * Flushes the remaining data and closes the output. Called after the last row.
+         */
+        virtual bool end() = 0;
+
+        [[nodiscard]] const std::string& getError() const {
+            return _error;
+        }
+
+    protected:
+        bool fail(std::string error) {
+            _error = std::move(error);
+            return false;
+        }
+
+    private:
+        std::string _error;
+    };
+}
@@ -0,0 +1,600 @@
+#include "LinearBvhBuilder.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <optional>
+
+namespace crt {
+    namespace {
+        // Elements per parallel task: large enough to amortize handing out a task, small enough to balance load.
+        constexpr size_t kChunkSize = 16 * 1024;
+        // Below this many primitives a temporary pool costs more than it saves.
+        constexpr size_t kParallelThreshold = 64 * 1024;
+        constexpr int kMaxRadixBits = 11;
+        // Lbvh builds this many subtrees in parallel, regardless of the thread count so the layout is the same.
+        constexpr size_t kSubtreeCount = 256;
+        // Same costs as the SAH builder, so Ploc collapses subtrees into leaves where Sah would stop splitting.
+        constexpr float kTraversalCost = 1.0f;
+        constexpr float kIntersectionCost = 1.0f;
+        constexpr uint32_t kNoChild = std::numeric_limits<uint32_t>::max();
+
+        size_t getChunkCount(size_t count) {
+            return (count + kChunkSize - 1) / kChunkSize;
+        }
+
+        /**
+         * Calls function(chunk, begin, end) for the kChunkSize sized chunks of [0, count) on the pool.
+         */
+        template<typename Function>
+        void parallelChunks(ThreadPool& threadPool, size_t count, const Function& function) {
+            threadPool.parallelFor(static_cast<uint32_t>(getChunkCount(count)), [&](uint32_t chunk, unsigned) {
+                const auto begin = static_cast<size_t>(chunk) * kChunkSize;
+                function(chunk, begin, std::min(count, begin + kChunkSize));
+            });
+        }
+
+        uint32_t ceilLog2(size_t value) {
+            uint32_t bits = 0;
+            while ((size_t{1} << bits) < value) {
+                ++bits;
+            }
+            return bits;
+        }
+
+        int getHighestBit(uint32_t value) {
+            return 31 - __builtin_clz(value);
+        }
+
+        int getHighestBit(uint64_t value) {
+            return 63 - __builtin_clzll(value);
+        }
+
+        uint32_t expandBits10(uint32_t value) {
+            value &= 0x3ffu;
+            value = (value | value << 16) & 0x030000ffu;
+            value = (value | value << 8) & 0x0300f00fu;
+            value = (value | value << 4) & 0x030c30c3u;
+            value = (value | value << 2) & 0x09249249u;
+            return value;
+        }
+
+        uint64_t expandBits21(uint64_t value) {
+            value &= 0x1fffffu;
+            value = (value | value << 32) & 0x001f00000000ffffu;
+            value = (value | value << 16) & 0x001f0000ff0000ffu;
+            value = (value | value << 8) & 0x100f00f00f00f00fu;
+            value = (value | value << 4) & 0x10c30c30c30c30c3u;
+            value = (value | value << 2) & 0x1249249249249249u;
+            return value;
+        }
+
+        /**
+         * Orders Ploc neighbours of equal distance, as they are common on regular tessellations. The key is the same
+         * from both sides of a pair, so the smallest pair overall is always mutual and some pair merges. Preferring
+         * adjacent pairs that start at an even position makes runs of equal distances merge pairwise, instead of
+         * one pair per iteration.
+         */
+        uint64_t getTieKey(size_t i, size_t j) {
+            const auto first = std::min(i, j);
+            return static_cast<uint64_t>(std::max(i, j) - first) << 33 | static_cast<uint64_t>(first & 1) << 32 | first;
+        }
+
+        float getUnionArea(const BoundingBox<float>& a, const BoundingBox<float>& b) {
+            auto bounds = a;
+            bounds.expand(b);
+            return bounds.getSurfaceArea();
+        }
+
+        /**
+         * Picks the split axis of two siblings as the one their centers differ most along. Returns true if they
+         * have to be swapped, as traversal takes the left child to be the lower one along the axis.
+         */
+        bool orderChildren(const BoundingBox<float>& left, const BoundingBox<float>& right, uint16_t& outAxis) {
+            const auto offset = right.getCenter() - left.getCenter();
+            int axis = 0;
+            for (int i = 1; i < 3; ++i) {
+                if (std::abs(offset[i]) > std::abs(offset[axis])) {
+                    axis = i;
+                }
+            }
+            outAxis = static_cast<uint16_t>(axis);
+            return offset[axis] < 0.0f;
+        }
+
+        /**
+         * Sets the bounds and axis of an interior node from its children, swapping them if needed.
+         */
+        void finishInteriorNode(std::vector<BvhNode>& nodes, uint32_t nodeIndex) {
+            auto& node = nodes[nodeIndex];
+            auto& left = nodes[node.offset];
+            auto& right = nodes[node.offset + 1];
+            node.bounds = left.bounds;
+            node.bounds.expand(right.bounds);
+            if (orderChildren(left.bounds, right.bounds, node.axis)) {
+                std::swap(left, right);
+            }
+        }
+
+        /**
+         * Stable least significant digit radix sort of keyBits wide keys, values move along with their keys.
+         * Every pass histograms chunks in parallel, then scatters each chunk behind the earlier chunks' keys
+         * of the same digit.
+         */
+        template<typename Key>
+        void radixSort(ThreadPool& threadPool, int keyBits, std::vector<Key>& keys, std::vector<uint32_t>& values) {
+            const auto count = keys.size();
+            const auto passCount = (keyBits + kMaxRadixBits - 1) / kMaxRadixBits;
+            const auto digitBits = (keyBits + passCount - 1) / passCount;
+            const auto bucketCount = size_t{1} << digitBits;
+            const auto digitMask = static_cast<Key>(bucketCount - 1);
+            const auto chunkCount = std::clamp<size_t>(count / kChunkSize, 1, threadPool.getThreadCount() * 4);
+            const auto chunkSize = (count + chunkCount - 1) / chunkCount;
+
+            std::vector<uint32_t> offsets(chunkCount * bucketCount);
+            std::vector<Key> keyBuffer(count);
+            std::vector<uint32_t> valueBuffer(count);
+            for (int pass = 0; pass < passCount; ++pass) {
+                const auto shift = pass * digitBits;
+                threadPool.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunk, unsigned) {
+                    auto* counts = offsets.data() + chunk * bucketCount;
+                    std::fill(counts, counts + bucketCount, 0u);
+                    const auto end = std::min(count, (chunk + 1) * chunkSize);
+                    for (auto i = chunk * chunkSize; i < end; ++i) {
+                        ++counts[(keys[i] >> shift) & digitMask];
+                    }
+                });
+
+                uint32_t sum = 0;
+                bool singleDigit = false;
+                for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+                    const auto bucketBegin = sum;
+                    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                        const auto chunkCountInBucket = offsets[chunk * bucketCount + bucket];
+                        offsets[chunk * bucketCount + bucket] = sum;
+                        sum += chunkCountInBucket;
+                    }
+                    singleDigit |= sum - bucketBegin == count;
+                }
+                if (singleDigit) {
+                    // Every key has the same digit, e.g. the unused top bits of small inputs.
+                    continue;
+                }
+
+                threadPool.parallelFor(static_cast<uint32_t>(chunkCount), [&](uint32_t chunk, unsigned) {
+                    auto* chunkOffsets = offsets.data() + chunk * bucketCount;
+                    const auto end = std::min(count, (chunk + 1) * chunkSize);
+                    for (auto i = chunk * chunkSize; i < end; ++i) {
+                        const auto position = chunkOffsets[(keys[i] >> shift) & digitMask]++;
+                        keyBuffer[position] = keys[i];
+                        valueBuffer[position] = values[i];
+                    }
+                });
+                std::swap(keys, keyBuffer);
+                std::swap(values, valueBuffer);
+            }
+        }
+
+        template<typename Key>
+        class Builder {
+        public:
+            Builder(const std::vector<BoundingBox<float>>& primitiveBounds, const BvhBuildOptions& options,
+                    ThreadPool& threadPool) : _primitiveBounds(primitiveBounds), _options(options),
+                                              _threadPool(threadPool) {}
+
+            void build(std::vector<BvhNode>& outNodes, std::vector<uint32_t>& outPrimitiveIndices) {
+                sortPrimitives();
+                if (_options.method == BvhBuildMethod::Ploc && buildPloc(outNodes, outPrimitiveIndices)) {
+                    return;
+                }
+                // Also the fallback for the rare Ploc tree that came out deeper than traversal allows.
+                buildLbvh(outNodes);
+                outPrimitiveIndices = std::move(_primitiveIndices);
+            }
+
+        private:
+            static constexpr int kCodeBits = sizeof(Key) == 4 ? 30 : 63;
+            static constexpr uint32_t kCellCount = 1u << (kCodeBits / 3);
+
+            struct Subtree {
+                uint32_t nodeIndex;
+                uint32_t begin;
+                uint32_t end;
+                size_t depth;
+            };
+
+            struct Cluster {
+                BoundingBox<float> bounds;
+                // Child clusters, or kNoChild and the primitive index for single primitive clusters.
+                uint32_t left;
+                uint32_t right;
+            };
+
+            void sortPrimitives() {
+                const auto count = _primitiveBounds.size();
+                std::vector<BoundingBox<float>> chunkBounds(getChunkCount(count));
+                parallelChunks(_threadPool, count, [&](uint32_t chunk, size_t begin, size_t end) {
+                    BoundingBox<float> bounds;
+                    for (auto i = begin; i < end; ++i) {
+                        bounds.expand(_primitiveBounds[i].getCenter());
+                    }
+                    chunkBounds[chunk] = bounds;
+                });
+                BoundingBox<float> centroidBounds;
+                for (const auto& bounds: chunkBounds) {
+                    centroidBounds.expand(bounds);
+                }
+
+                const auto min = centroidBounds.getMin();
+                const auto extent = centroidBounds.getExtent();
+                float scale[3];
+                for (int axis = 0; axis < 3; ++axis) {
+                    scale[axis] = extent[axis] > 0.0f ? static_cast<float>(kCellCount) / extent[axis] : 0.0f;
+                }
+                _codes.resize(count);
+                _primitiveIndices.resize(count);
+                parallelChunks(_threadPool, count, [&](uint32_t, size_t begin, size_t end) {
+                    for (auto i = begin; i < end; ++i) {
+                        const auto offset = _primitiveBounds[i].getCenter() - min;
+                        uint32_t cell[3];
+                        for (int axis = 0; axis < 3; ++axis) {
+                            cell[axis] = std::min(static_cast<uint32_t>(offset[axis] * scale[axis]), kCellCount - 1);
+                        }
+                        if constexpr (sizeof(Key) == 4) {
+                            _codes[i] = LinearBvhBuilder::getMortonCode30(cell[0], cell[1], cell[2]);
+                        } else {
+                            _codes[i] = LinearBvhBuilder::getMortonCode63(cell[0], cell[1], cell[2]);
+                        }
+                        _primitiveIndices[i] = static_cast<uint32_t>(i);
+                    }
+                });
+                radixSort(_threadPool, kCodeBits, _codes, _primitiveIndices);
+                _sortedBounds.resize(count);
+                parallelChunks(_threadPool, count, [&](uint32_t, size_t begin, size_t end) {
+                    for (auto i = begin; i < end; ++i) {
+                        _sortedBounds[i] = _primitiveBounds[_primitiveIndices[i]];
+                    }
+                });
+            }
+
+            [[nodiscard]] uint32_t getLeafSize() const {
+                return _options.leafBlockSize;
+            }
+
+            /**
+             * Splits a sorted range at the highest bit in which its first and last code differ. Ranges of equal
+             * codes, and ranges that could otherwise not reach leaf size within Bvh::kMaxDepth, are split at the
+             * middle, which halves the depth they still need.
+             */
+            [[nodiscard]] uint32_t findSplit(uint32_t begin, uint32_t end, size_t depth) const {
+                const auto count = end - begin;
+                const auto first = _codes[begin];
+                const auto last = _codes[end - 1];
+                const auto neededDepth = ceilLog2((count + getLeafSize() - 1) / getLeafSize());
+                if (first == last || depth + neededDepth + 1 >= Bvh::kMaxDepth) {
+                    return begin + count / 2;
+                }
+                const auto bit = Key{1} << getHighestBit(first ^ last);
+                const auto split = std::partition_point(_codes.begin() + begin, _codes.begin() + end,
+                                                        [bit](Key code) { return (code & bit) == 0; });
+                return static_cast<uint32_t>(split - _codes.begin());
+            }
+
+            void buildLbvh(std::vector<BvhNode>& outNodes) {
+                // Split serially until there are enough subtrees to keep every worker busy, then build the subtrees
+                // in parallel and append them one after the other behind the top nodes.
+                const auto count = static_cast<uint32_t>(_codes.size());
+                const auto grain = std::max<size_t>(kChunkSize / 4, count / kSubtreeCount);
+                std::vector<BvhNode> topNodes(1);
+                std::vector<Subtree> subtrees;
+                splitTop(topNodes, subtrees, 0, 0, count, 1, grain);
+
+                std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+                _threadPool.parallelFor(static_cast<uint32_t>(subtrees.size()), [&](uint32_t i, unsigned) {
+                    const auto& subtree = subtrees[i];
+                    auto& nodes = subtreeNodes[i];
+                    nodes.reserve(subtree.end - subtree.begin);
+                    nodes.emplace_back();
+                    buildNode(nodes, 0, subtree.begin, subtree.end, subtree.depth);
+                });
+
+                std::vector<size_t> subtreeBases(subtrees.size());
+                auto nodeCount = topNodes.size();
+                for (size_t i = 0; i < subtrees.size(); ++i) {
+                    subtreeBases[i] = nodeCount;
+                    nodeCount += subtreeNodes[i].size() - 1;
+                }
+                outNodes.resize(nodeCount);
+                std::copy(topNodes.begin(), topNodes.end(), outNodes.begin());
+                _threadPool.parallelFor(static_cast<uint32_t>(subtrees.size()), [&](uint32_t i, unsigned) {
+                    const auto base = subtreeBases[i];
+                    const auto relocate = [base](BvhNode node) {
+                        if (!node.isLeaf()) {
+                            node.offset = static_cast<uint32_t>(base + node.offset - 1);
+                        }
+                        return node;
+                    };
+                    auto& nodes = subtreeNodes[i];
+                    outNodes[subtrees[i].nodeIndex] = relocate(nodes[0]);
+                    for (size_t j = 1; j < nodes.size(); ++j) {
+                        outNodes[base + j - 1] = relocate(nodes[j]);
+                    }
+                    nodes = {};
+                });
+
+                // Top nodes were allocated after their parents, so walking them backwards finishes children first.
+                std::vector<bool> isSubtreeRoot(topNodes.size(), false);
+                for (const auto& subtree: subtrees) {
+                    isSubtreeRoot[subtree.nodeIndex] = true;
+                }
+                for (auto nodeIndex = static_cast<uint32_t>(topNodes.size()); nodeIndex-- > 0;) {
+                    if (!isSubtreeRoot[nodeIndex]) {
+                        finishInteriorNode(outNodes, nodeIndex);
+                    }
+                }
+            }
+
+            void splitTop(std::vector<BvhNode>& topNodes, std::vector<Subtree>& subtrees, uint32_t nodeIndex,
+                          uint32_t begin, uint32_t end, size_t depth, size_t grain) const {
+                if (end - begin <= grain || end - begin <= getLeafSize()) {
+                    subtrees.push_back({nodeIndex, begin, end, depth});
+                    return;
+                }
+                const auto split = findSplit(begin, end, depth);
+                const auto leftChild = static_cast<uint32_t>(topNodes.size());
+                topNodes[nodeIndex].offset = leftChild;
+                topNodes.emplace_back();
+                topNodes.emplace_back();
+                splitTop(topNodes, subtrees, leftChild, begin, split, depth + 1, grain);
+                splitTop(topNodes, subtrees, leftChild + 1, split, end, depth + 1, grain);
+            }
+
+            void buildNode(std::vector<BvhNode>& nodes, uint32_t nodeIndex, uint32_t begin, uint32_t end,
+                           size_t depth) const {
+                const auto count = end - begin;
+                if (count <= getLeafSize()) {
+                    auto& node = nodes[nodeIndex];
+                    for (auto i = begin; i < end; ++i) {
+                        node.bounds.expand(_sortedBounds[i]);
+                    }
+                    node.offset = begin;
+                    node.primitiveCount = static_cast<uint16_t>(count);
+                    return;
+                }
+
+                assert(depth + 1 < Bvh::kMaxDepth);
+                const auto split = findSplit(begin, end, depth);
+                const auto leftChild = static_cast<uint32_t>(nodes.size());
+                nodes[nodeIndex].offset = leftChild;
+                nodes.emplace_back();
+                nodes.emplace_back();
+                buildNode(nodes, leftChild, begin, split, depth + 1);
+                buildNode(nodes, leftChild + 1, split, end, depth + 1);
+                finishInteriorNode(nodes, nodeIndex);
+            }
+
+            [[nodiscard]] float getIntersectionCost(uint32_t primitiveCount) const {
+                const auto blockCount = (primitiveCount + _options.leafBlockSize - 1) / _options.leafBlockSize;
+                return kIntersectionCost * static_cast<float>(blockCount);
+            }
+
+            /**
+             * Repeatedly merges every pair of clusters that are each other's nearest neighbour, where the distance
+             * is the surface area of the merged bounds and only clusters within plocRadius positions of the Morton
+             * order are candidates. Returns false if the tree is deeper than traversal allows.
+             */
+            bool buildPloc(std::vector<BvhNode>& outNodes, std::vector<uint32_t>& outPrimitiveIndices) {
+                const auto primitiveCount = _primitiveIndices.size();
+                std::vector<Cluster> clusters(2 * primitiveCount - 1);
+                std::vector<uint32_t> current(primitiveCount);
+                parallelChunks(_threadPool, primitiveCount, [&](uint32_t, size_t begin, size_t end) {
+                    for (auto i = begin; i < end; ++i) {
+                        clusters[i] = {_sortedBounds[i], kNoChild, _primitiveIndices[i]};
+                        current[i] = static_cast<uint32_t>(i);
+                    }
+                });
+
+                const auto radius = std::max<size_t>(_options.plocRadius, 1);
+                std::vector<uint32_t> next(primitiveCount);
+                std::vector<uint32_t> nearest(primitiveCount);
+                std::vector<uint32_t> chunkMerges;
+                std::vector<uint32_t> chunkSurvivors;
+                auto clusterCount = primitiveCount;
+                auto nodeCount = static_cast<uint32_t>(primitiveCount);
+                while (clusterCount > 1) {
+                    parallelChunks(_threadPool, clusterCount, [&](uint32_t, size_t begin, size_t end) {
+                        for (auto i = begin; i < end; ++i) {
+                            const auto& bounds = clusters[current[i]].bounds;
+                            const auto first = i >= radius ? i - radius : 0;
+                            const auto last = std::min(clusterCount, i + radius + 1);
+                            auto best = first == i ? i + 1 : first;
+                            auto bestArea = getUnionArea(bounds, clusters[current[best]].bounds);
+                            for (auto j = first; j < last; ++j) {
+                                if (j == i || j == best) {
+                                    continue;
+                                }
+                                const auto area = getUnionArea(bounds, clusters[current[j]].bounds);
+                                if (area < bestArea || (area == bestArea && getTieKey(i, j) < getTieKey(i, best))) {
+                                    bestArea = area;
+                                    best = j;
+                                }
+                            }
+                            nearest[i] = static_cast<uint32_t>(best);
+                        }
+                    });
+
+                    // A mutual pair merges into a new cluster that takes the place of its lower member.
+                    const auto chunkCount = getChunkCount(clusterCount);
+                    chunkMerges.assign(chunkCount, 0);
+                    chunkSurvivors.assign(chunkCount, 0);
+                    parallelChunks(_threadPool, clusterCount, [&](uint32_t chunk, size_t begin, size_t end) {
+                        for (auto i = begin; i < end; ++i) {
+                            const auto neighbour = nearest[i];
+                            const auto mutual = nearest[neighbour] == i;
+                            chunkMerges[chunk] += mutual && i < neighbour;
+                            chunkSurvivors[chunk] += !mutual || i < neighbour;
+                        }
+                    });
+                    uint32_t mergeCount = 0;
+                    uint32_t survivorCount = 0;
+                    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                        const auto merges = chunkMerges[chunk];
+                        const auto survivors = chunkSurvivors[chunk];
+                        chunkMerges[chunk] = mergeCount;
+                        chunkSurvivors[chunk] = survivorCount;
+                        mergeCount += merges;
+                        survivorCount += survivors;
+                    }
+                    assert(mergeCount > 0);
+
+                    parallelChunks(_threadPool, clusterCount, [&](uint32_t chunk, size_t begin, size_t end) {
+                        auto mergeIndex = nodeCount + chunkMerges[chunk];
+                        auto survivorIndex = chunkSurvivors[chunk];
+                        for (auto i = begin; i < end; ++i) {
+                            const auto neighbour = nearest[i];
+                            const auto mutual = nearest[neighbour] == i;
+                            if (mutual && neighbour < i) {
+                                continue;
+                            }
+                            auto cluster = current[i];
+                            if (mutual) {
+                                auto bounds = clusters[cluster].bounds;
+                                bounds.expand(clusters[current[neighbour]].bounds);
+                                clusters[mergeIndex] = {bounds, cluster, current[neighbour]};
+                                cluster = mergeIndex++;
+                            }
+                            next[survivorIndex++] = cluster;
+                        }
+                    });
+                    nodeCount += mergeCount;
+                    clusterCount = survivorCount;
+                    std::swap(current, next);
+                }
+
+                const auto collapse = getCollapsedClusters(clusters, primitiveCount);
+                return flattenClusters(clusters, collapse, current[0], outNodes, outPrimitiveIndices);
+            }
+
+            /**
+             * Marks the clusters that are cheaper as one leaf than as a subtree. Merged clusters come after their
+             * children, so one forward pass sees the children's costs first.
+             */
+            std::vector<bool> getCollapsedClusters(const std::vector<Cluster>& clusters, size_t primitiveCount) const {
+                std::vector<bool> collapse(clusters.size(), true);
+                std::vector<uint32_t> primitiveCounts(clusters.size(), 1);
+                std::vector<float> costs(clusters.size());
+                for (size_t i = 0; i < primitiveCount; ++i) {
+                    costs[i] = clusters[i].bounds.getSurfaceArea() * getIntersectionCost(1);
+                }
+                for (auto i = primitiveCount; i < clusters.size(); ++i) {
+                    const auto& cluster = clusters[i];
+                    const auto count = primitiveCounts[cluster.left] + primitiveCounts[cluster.right];
+                    const auto area = cluster.bounds.getSurfaceArea();
+                    const auto splitCost = area * kTraversalCost + costs[cluster.left] + costs[cluster.right];
+                    const auto leafCost = area * getIntersectionCost(count);
+                    primitiveCounts[i] = count;
+                    collapse[i] = count <= Bvh::kMaxLeafSize && leafCost <= splitCost;
+                    costs[i] = collapse[i] ? leafCost : splitCost;
+                }
+                return collapse;
+            }
+
+            bool flattenClusters(const std::vector<Cluster>& clusters, const std::vector<bool>& collapse,
+                                 uint32_t root, std::vector<BvhNode>& outNodes,
+                                 std::vector<uint32_t>& outPrimitiveIndices) const {
+                struct Entry {
+                    uint32_t cluster;
+                    uint32_t nodeIndex;
+                    size_t depth;
+                };
+
+                outNodes.clear();
+                outNodes.reserve(_primitiveIndices.size());
+                outNodes.emplace_back();
+                outPrimitiveIndices.clear();
+                outPrimitiveIndices.reserve(_primitiveIndices.size());
+                std::vector<Entry> stack{{root, 0, 1}};
+                while (!stack.empty()) {
+                    const auto entry = stack.back();
+                    stack.pop_back();
+                    const auto& cluster = clusters[entry.cluster];
+                    auto& node = outNodes[entry.nodeIndex];
+                    node.bounds = cluster.bounds;
+                    if (collapse[entry.cluster]) {
+                        node.offset = static_cast<uint32_t>(outPrimitiveIndices.size());
+                        uint32_t pending[2 * Bvh::kMaxLeafSize];
+                        size_t pendingCount = 0;
+                        pending[pendingCount++] = entry.cluster;
+                        while (pendingCount > 0) {
+                            const auto& member = clusters[pending[--pendingCount]];
+                            if (member.left == kNoChild) {
+                                outPrimitiveIndices.push_back(member.right);
+                            } else {
+                                pending[pendingCount++] = member.right;
+                                pending[pendingCount++] = member.left;
+                            }
+                        }
+                        node.primitiveCount = static_cast<uint16_t>(outPrimitiveIndices.size() - node.offset);
+                        continue;
+                    }
+
+                    if (entry.depth + 1 >= Bvh::kMaxDepth) {
+                        return false;
+                    }
+                    auto left = cluster.left;
+                    auto right = cluster.right;
+                    if (orderChildren(clusters[left].bounds, clusters[right].bounds, node.axis)) {
+                        std::swap(left, right);
+                    }
+                    const auto leftChild = static_cast<uint32_t>(outNodes.size());
+                    node.offset = leftChild;
+                    outNodes.emplace_back();
+                    outNodes.emplace_back();
+                    stack.push_back({right, leftChild + 1, entry.depth + 1});
+                    stack.push_back({left, leftChild, entry.depth + 1});
+                }
+                outNodes.shrink_to_fit();
+                return true;
+            }
+
+        private:
+            const std::vector<BoundingBox<float>>& _primitiveBounds;
+            const BvhBuildOptions& _options;
+            ThreadPool& _threadPool;
+            // Morton codes in sorted order, and the primitive each belongs to.
+            std::vector<Key> _codes;
+            std::vector<uint32_t> _primitiveIndices;
+            // Primitive bounds in sorted order, gathered once so the builders read them sequentially.
+            std::vector<BoundingBox<float>> _sortedBounds;
+        };
+    }
+
+    void LinearBvhBuilder::build(const std::vector<BoundingBox<float>>& primitiveBounds,
+                                 const BvhBuildOptions& options, std::vector<BvhNode>& outNodes,
+                                 std::vector<uint32_t>& outPrimitiveIndices) {
+        assert(!primitiveBounds.empty() && options.method != BvhBuildMethod::Sah);
+        std::optional<ThreadPool> localThreadPool;
+        auto* threadPool = options.threadPool;
+        if (!threadPool) {
+            localThreadPool.emplace(primitiveBounds.size() >= kParallelThreshold ? 0u : 1u);
+            threadPool = &*localThreadPool;
+        }
+
+        if (options.mortonBits > 30) {
+            Builder<uint64_t>(primitiveBounds, options, *threadPool).build(outNodes, outPrimitiveIndices);
+        } else {
+            Builder<uint32_t>(primitiveBounds, options, *threadPool).build(outNodes, outPrimitiveIndices);
+        }
+    }
+
+    uint32_t LinearBvhBuilder::getMortonCode30(uint32_t x, uint32_t y, uint32_t z) {
+        return expandBits10(x) << 2 | expandBits10(y) << 1 | expandBits10(z);
+    }
+
+    uint64_t LinearBvhBuilder::getMortonCode63(uint32_t x, uint32_t y, uint32_t z) {
+        return expandBits21(x) << 2 | expandBits21(y) << 1 | expandBits21(z);
+    }
+}
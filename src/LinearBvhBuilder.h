@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Bvh.h"
+
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Parallel BVH builders for huge or frequently rebuilt geometry. Both sort the primitive centroids along a
+     * Morton curve with a parallel radix sort. Lbvh then splits the sorted range top down at the highest differing
+     * code bit, Ploc instead merges nearest neighbour clusters bottom up within a small window of the sorted order
+     * and collapses small subtrees into leaves where the SAH says so.
+     */
+    namespace LinearBvhBuilder {
+        /**
+         * Builds the nodes for options.method (Lbvh or Ploc) in the layout Bvh traverses: the root first, the
+         * right child right after the left one, leaves of at most options.leafBlockSize (Lbvh) or
+         * Bvh::kMaxLeafSize (Ploc) primitives and less than Bvh::kMaxDepth levels. outPrimitiveIndices receives
+         * the primitive indices in leaf order. primitiveBounds must not be empty.
+         */
+        void build(const std::vector<BoundingBox<float>>& primitiveBounds, const BvhBuildOptions& options,
+                   std::vector<BvhNode>& outNodes, std::vector<uint32_t>& outPrimitiveIndices);
+
+        /**
+         * Morton code of a point quantized to 10 bits (30 bit codes) or 21 bits (63 bit codes) per axis, with x in
+         * the highest bit of every triple.
+         */
+        uint32_t getMortonCode30(uint32_t x, uint32_t y, uint32_t z);
+
+        uint64_t getMortonCode63(uint32_t x, uint32_t y, uint32_t z);
+    }
+}
@@ -0,0 +1,77 @@
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace crt {
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+            : _data(std::exchange(other._data, nullptr)),
+              _size(std::exchange(other._size, 0)),
+              _isOpen(std::exchange(other._isOpen, false)),
+              _error(std::move(other._error)) {}
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+            _isOpen = std::exchange(other._isOpen, false);
+            _error = std::move(other._error);
+        }
+        return *this;
+    }
+
+    bool MappedFile::open(const std::string& path) {
+        close();
+        _error.clear();
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            _error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        struct stat status{};
+        if (::fstat(fd, &status) != 0) {
+            _error = path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+
+        _size = static_cast<size_t>(status.st_size);
+        if (_size > 0) {
+            void* mapping = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                _error = path + ": " + std::strerror(errno);
+                _size = 0;
+                ::close(fd);
+                return false;
+            }
+            // Loaders read the whole file, usually from several threads at once.
+            ::madvise(mapping, _size, MADV_WILLNEED);
+            _data = static_cast<const char*>(mapping);
+        }
+        // The mapping stays valid after the descriptor is closed.
+        ::close(fd);
+        _isOpen = true;
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (_data) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+        _data = nullptr;
+        _size = 0;
+        _isOpen = false;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace crt {
+
+    /**
+     * Read-only memory mapping of a whole file. The mapping lives as long as the object, so views into
+     * getData() must not outlive it.
+     */
+    class MappedFile {
+    public:
+        MappedFile() = default;
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept;
+
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * Maps path, replacing any previous mapping. On failure returns false and getError() says why.
+         */
+        bool open(const std::string& path);
+
+        void close();
+
+        [[nodiscard]] bool isOpen() const { return _isOpen; }
+
+        [[nodiscard]] const char* getData() const { return _data; }
+
+        [[nodiscard]] size_t getSize() const { return _size; }
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+    private:
+        const char* _data = nullptr;
+        size_t _size = 0;
+        bool _isOpen = false;
+        std::string _error;
+    };
+}
@@ -1,4 +1,8 @@
 #include "MathUtils.h"
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
 
 namespace crt::MathUtils {
     bool rayIntersectsTriangle(const Ray& ray,
@@ -7,6 +11,7 @@ namespace crt::MathUtils {
                                const Vector3f& v2,
                                float& t,
                                float& u, float& v) {
+        CRT_COUNT(triangleTests, 1);
         const auto& v0v1 = v1 - v0;
         const auto& v0v2 = v2 - v0;
         auto pvec = ray.getDirection().cross(v0v2);
@@ -34,6 +39,7 @@ namespace crt::MathUtils {
                                const Vector3f& v0,
                                const Vector3f& v1,
                                const Vector3f& v2) {
+        CRT_COUNT(triangleTests, 1);
         const auto& v0v1 = v1 - v0;
         const auto& v0v2 = v2 - v1;
         auto pvec = ray.getDirection().cross(v0v2);
@@ -45,5 +51,63 @@ namespace crt::MathUtils {
 #endif
         return true;
     }
-}
 
+    bool rayIntersectsSphere(const Ray& ray, const Vector3f& center, float radius, float& t) {
+        CRT_COUNT(primitiveTests, 1);
+        const auto& oc = ray.getOrigin() - center;
+        const float a = ray.getDirection().dot(ray.getDirection());
+        const float b = 2.0f * oc.dot(ray.getDirection());
+        const float c = oc.dot(oc) - radius * radius;
+        const float discriminant = b * b - 4.0f * a * c;
+        if (discriminant < 0.0f) {
+            return false;
+        }
+        if (discriminant == 0.0f) {
+            t = -b / (2.0f * a);
+            return true;
+        } else {
+            const float t1 = (-b - std::sqrt(discriminant)) / (2.0f * a);
+            const float t2 = (-b + std::sqrt(discriminant)) / (2.0f * a);
+            if (t1 < 0.0f && t2 < 0.0f) {
+                return false;
+            }
+            if (t1 < 0.0f) {
+                t = t2;
+            } else if (t2 < 0.0f) {
+                t = t1;
+            } else {
+                t = std::min(t1, t2);
+            }
+            return true;
+        }
+    }
+
+    bool rayIntersectsSphere(const Ray& ray, const Vector3f& center, float radius, float tMin, float tMax) {
+        CRT_COUNT(primitiveTests, 1);
+        const auto& oc = ray.getOrigin() - center;
+        const float a = ray.getDirection().dot(ray.getDirection());
+        const float halfB = oc.dot(ray.getDirection());
+        const float c = oc.dot(oc) - radius * radius;
+        const float discriminant = halfB * halfB - a * c;
+        if (discriminant < 0.0f) {
+            return false;
+        }
+        const float sqrtDiscriminant = std::sqrt(discriminant);
+        const float t1 = (-halfB - sqrtDiscriminant) / a;
+        if (t1 >= tMin && t1 <= tMax) {
+            return true;
+        }
+        const float t2 = (-halfB + sqrtDiscriminant) / a;
+        return t2 >= tMin && t2 <= tMax;
+    }
+
+    bool rayIntersectsPlane(const Ray& ray, const Vector3f& normal, const Vector3f& point, float& t) {
+        CRT_COUNT(primitiveTests, 1);
+        float denom = normal.dot(ray.getDirection());
+        if (denom < 0) {
+            t = (point - ray.getOrigin()).dot(normal) / denom;
+            return t >= 0;
+        }
+        return false;
+    }
+}
@@ -16,4 +16,19 @@ namespace crt::MathUtils {
                                const Vector3f& v0,
                                const Vector3f& v1,
                                const Vector3f& v2);
+
+    /**
+     * Nearest non-negative root of the ray/sphere quadratic.
+     */
+    bool rayIntersectsSphere(const Ray& ray, const Vector3f& center, float radius, float& t);
+
+    /**
+     * True if either root lies within [tMin, tMax], so a ray leaving the sphere from inside counts as well.
+     */
+    bool rayIntersectsSphere(const Ray& ray, const Vector3f& center, float radius, float tMin, float tMax);
+
+    /**
+     * Intersection with the front side of the plane, for rays not starting behind it.
+     */
+    bool rayIntersectsPlane(const Ray& ray, const Vector3f& normal, const Vector3f& point, float& t);
 };
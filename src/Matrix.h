@@ -159,7 +159,7 @@ namespace crt {
         }
 
         bool operator!=(const Matrix& rhs) const {
-            return *this != rhs;
+            return !(*this == rhs);
         }
 
         Matrix& transpose() {
@@ -220,7 +220,6 @@ namespace crt {
                     result(r, c) = (r == c) ? 1 : 0;
                 }
             }
-            return result;
         }
 
         [[nodiscard]] bool isIdentify() const {
@@ -272,18 +271,22 @@ namespace crt {
 
             if constexpr (Rows == 1) {
                 return (*this)(0, 0);
-            }
-
-            Matrix<Scalar, Rows - 1, Cols - 1> subMatrix;
-            for (size_t r = 0; r < Rows; ++r) {
-                for (size_t c = 0; c < Cols; ++c) {
-                    if (r != row && c != col) {
-                        subMatrix(r, c) = (*this)(r, c);
+            } else {
+                Matrix<Scalar, Rows - 1, Cols - 1> subMatrix;
+                for (size_t r = 0, subRow = 0; r < Rows; ++r) {
+                    if (r == row) {
+                        continue;
+                    }
+                    for (size_t c = 0, subCol = 0; c < Cols; ++c) {
+                        if (c != col) {
+                            subMatrix(subRow, subCol++) = (*this)(r, c);
+                        }
                     }
+                    ++subRow;
                 }
-            }
 
-            return (row + col) % 2 == 0 ? subMatrix.determinant() : -subMatrix.determinant();
+                return (row + col) % 2 == 0 ? subMatrix.determinant() : -subMatrix.determinant();
+            }
         }
 
     private:
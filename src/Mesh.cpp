@@ -1,32 +1,474 @@
 #include "Mesh.h"
 
 #include "MathUtils.h"
+#include "Statistics.h"
+#include "ThreadPool.h"
+
+#include <optional>
+#include <type_traits>
 
 namespace crt {
-    bool Mesh::hit(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const {
+    namespace {
+        // Smaller meshes are updated on the calling thread when no pool is given.
+        constexpr size_t kParallelUpdateThreshold = 64 * 1024;
+        constexpr size_t kUpdateChunkSize = 16 * 1024;
+
+        /**
+         * Calls function(begin, end) for chunks of [0, count), on threadPool when there is one.
+         */
+        template<typename Function>
+        void forEachChunk(ThreadPool* threadPool, size_t count, const Function& function) {
+            if (!threadPool || count <= kUpdateChunkSize) {
+                function(size_t{0}, count);
+                return;
+            }
+            const auto chunkCount = static_cast<uint32_t>((count + kUpdateChunkSize - 1) / kUpdateChunkSize);
+            threadPool->parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+                const auto begin = static_cast<size_t>(chunk) * kUpdateChunkSize;
+                function(begin, std::min(count, begin + kUpdateChunkSize));
+            });
+        }
+    }
+
+    void Mesh::buildBvh(const BvhBuildOptions& options) {
+        std::vector<BoundingBox<float>> triangleBounds;
+        triangleBounds.reserve(_triangleVertexIndices.size());
+        for (const auto& triangleVertexIndices: _triangleVertexIndices) {
+            BoundingBox<float> bounds;
+            bounds.expand(_points[triangleVertexIndices[0]]);
+            bounds.expand(_points[triangleVertexIndices[1]]);
+            bounds.expand(_points[triangleVertexIndices[2]]);
+            triangleBounds.push_back(bounds);
+        }
+        _boundingBox = {};
+        for (const auto& point: _points) {
+            _boundingBox.expand(point);
+        }
+        auto bvhOptions = options;
+        bvhOptions.leafBlockSize = TriangleBlock::kSize;
+        _bvh.build(triangleBounds, bvhOptions);
+
+        static_assert(Bvh::kMaxLeafSize <= TriangleBlock::kSize);
+        const auto& nodes = _bvh.getNodes();
+        const auto& primitiveIndices = _bvh.getPrimitiveIndices();
+        std::vector<TriangleBlock> triangleBlocks;
+        triangleBlocks.reserve(_bvh.getStatistics().leafCount);
+        std::vector<uint32_t> leafBlocks(nodes.size(), 0);
+        for (size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex) {
+            const auto& node = nodes[nodeIndex];
+            if (!node.isLeaf()) {
+                continue;
+            }
+            leafBlocks[nodeIndex] = static_cast<uint32_t>(triangleBlocks.size());
+            auto& block = triangleBlocks.emplace_back();
+            for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+                const auto triangle = primitiveIndices[node.offset + i];
+                const auto& triangleVertexIndices = _triangleVertexIndices[triangle];
+                block.set(static_cast<int>(i),
+                          _points[triangleVertexIndices[0]],
+                          _points[triangleVertexIndices[1]],
+                          _points[triangleVertexIndices[2]],
+                          triangle);
+            }
+        }
+        _triangleBlocks = SharedArray<TriangleBlock>(std::move(triangleBlocks));
+        _leafBlocks = SharedArray<uint32_t>(std::move(leafBlocks));
+
+        if (bvhOptions.width == 4 || bvhOptions.width == 8) {
+            // Wide leaves are numbered like the blocks above, so _leafBlocks can go with the binary nodes.
+            collapseBvh(bvhOptions);
+            _leafBlocks = {};
+        }
+    }
+
+    void Mesh::buildCompact(const std::vector<Vector3f>& points, const std::vector<Vector3i>& triangleVertexIndices,
+                            const BvhBuildOptions& options) {
+        // Bounds come from the decoded points, so the hierarchy encloses the triangles that are intersected.
+        const CompactGeometry geometry(points, triangleVertexIndices);
+        std::vector<BoundingBox<float>> triangleBounds;
+        triangleBounds.reserve(geometry.getTriangleCount());
+        _boundingBox = {};
+        for (uint32_t triangle = 0; triangle < geometry.getTriangleCount(); ++triangle) {
+            Vector3f v0, v1, v2;
+            geometry.getTriangle(triangle, v0, v1, v2);
+            BoundingBox<float> bounds;
+            bounds.expand(v0);
+            bounds.expand(v1);
+            bounds.expand(v2);
+            _boundingBox.expand(bounds);
+            triangleBounds.push_back(bounds);
+        }
+        auto bvhOptions = options;
+        bvhOptions.leafBlockSize = TriangleBlock::kSize;
+        _bvh.build(triangleBounds, bvhOptions);
+
+        // In leaf order, leaf offsets index triangles directly and the primitive indices are not needed.
+        _compactGeometry = geometry.getReordered(_bvh.getPrimitiveIndices());
+        if (bvhOptions.width == 4 || bvhOptions.width == 8) {
+            std::vector<uint32_t> leafTriangles;
+            leafTriangles.reserve(_bvh.getStatistics().leafCount);
+            for (const auto& node: _bvh.getNodes()) {
+                if (node.isLeaf()) {
+                    leafTriangles.push_back(node.offset);
+                }
+            }
+            _leafTriangles = SharedArray<uint32_t>(std::move(leafTriangles));
+            collapseBvh(bvhOptions);
+        } else {
+            _bvh = Bvh(_bvh.getNodes(), {}, _bvh.getStatistics(), _bvh.getOptions());
+        }
+    }
+
+    void Mesh::collapseBvh(const BvhBuildOptions& options) {
+        if (options.width == 4) {
+            _wideBvh4 = WideBvh<4>(_bvh);
+        } else {
+            _wideBvh8 = WideBvh<8>(_bvh);
+        }
+        _bvh = Bvh({}, {}, _bvh.getStatistics(), _bvh.getOptions());
+    }
+
+    bool Mesh::updatePoints(const std::vector<Vector3f>& points, const std::vector<uint32_t>& movedPoints,
+                            ThreadPool* threadPool) {
+        if (points.size() != getPointCount()) {
+            return false;
+        }
+        for (const auto point: movedPoints) {
+            if (point >= points.size()) {
+                return false;
+            }
+        }
+        std::optional<ThreadPool> localThreadPool;
+        if (!threadPool && getTriangleCount() >= kParallelUpdateThreshold) {
+            localThreadPool.emplace();
+            threadPool = &*localThreadPool;
+        }
+
+        std::vector<uint8_t> dirtyTriangles;
+        if (isCompact()) {
+            // The quantization grid follows the new bounds, every decoded point may move.
+            _compactGeometry = _compactGeometry.getWithPoints(points);
+        } else {
+            std::copy(points.begin(), points.end(), _points.getMutableData());
+            if (!movedPoints.empty()) {
+                std::vector<uint8_t> moved(points.size(), 0);
+                for (const auto point: movedPoints) {
+                    moved[point] = 1;
+                }
+                dirtyTriangles.resize(_triangleVertexIndices.size());
+                forEachChunk(threadPool, dirtyTriangles.size(), [&](size_t begin, size_t end) {
+                    for (auto i = begin; i < end; ++i) {
+                        const auto& triangle = _triangleVertexIndices[i];
+                        dirtyTriangles[i] = moved[triangle[0]] | moved[triangle[1]] | moved[triangle[2]];
+                    }
+                });
+            }
+        }
+        refitBvh(points, dirtyTriangles, threadPool);
+        return true;
+    }
+
+    bool Mesh::transform(const Matrix4f& transform) {
+        std::vector<Vector3f> points(getPointCount());
+        for (uint32_t i = 0; i < points.size(); ++i) {
+            const auto point = isCompact() ? _compactGeometry.getPoint(i) : _points[i];
+            points[i] = (transform * Vector4f{point.getX(), point.getY(), point.getZ(), 1.0f}).getXYZ();
+        }
+        return updatePoints(points);
+    }
+
+    void Mesh::refitBvh(const std::vector<Vector3f>& points, const std::vector<uint8_t>& dirtyTriangles,
+                        ThreadPool* threadPool) {
+        const auto rebuild = [&]() {
+            auto options = _bvh.getOptions();
+            options.threadPool = threadPool;
+            if (isCompact()) {
+                const auto triangleVertexIndices = _compactGeometry.getTriangleVertexIndices();
+                _wideBvh4 = {};
+                _wideBvh8 = {};
+                _leafTriangles = {};
+                buildCompact(points, triangleVertexIndices, options);
+            } else {
+                buildBvh(options);
+            }
+        };
+
+        if (_wideBvh4.isEmpty() && _wideBvh8.isEmpty()) {
+            std::vector<BoundingBox<float>> triangleBounds(getTriangleCount());
+            forEachChunk(threadPool, triangleBounds.size(), [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    Vector3f v0, v1, v2;
+                    getTriangle(static_cast<uint32_t>(i), v0, v1, v2);
+                    triangleBounds[i] = {};
+                    triangleBounds[i].expand(v0);
+                    triangleBounds[i].expand(v1);
+                    triangleBounds[i].expand(v2);
+                }
+            });
+            _boundingBox = {};
+            for (const auto& bounds: triangleBounds) {
+                _boundingBox.expand(bounds);
+            }
+            _bvh.refit(triangleBounds, dirtyTriangles, threadPool);
+            if (_bvh.needsRebuild()) {
+                rebuild();
+            } else if (!isCompact()) {
+                updateTriangleBlocks(dirtyTriangles);
+            }
+            return;
+        }
+
+        // Wide leaves are numbered in binary node order, which is also the order of the compact triangles and the
+        // triangle blocks. Their triangle counts are only stored in the wide nodes.
+        std::vector<uint32_t> leafTriangleCounts(isCompact() ? _leafTriangles.size() : _triangleBlocks.size(), 0);
+        const auto countLeaves = [&](const auto& wideBvh) {
+            using Node = typename std::decay_t<decltype(wideBvh)>::Node;
+            for (const auto& node: wideBvh.getNodes()) {
+                for (int slot = 0; slot < node.childCount; ++slot) {
+                    if (Node::isLeaf(node.children[slot])) {
+                        leafTriangleCounts[Node::getLeafIndex(node.children[slot])] =
+                                Node::getLeafPrimitiveCount(node.children[slot]);
+                    }
+                }
+            }
+        };
+        if (!_wideBvh8.isEmpty()) {
+            countLeaves(_wideBvh8);
+        } else {
+            countLeaves(_wideBvh4);
+        }
+
+        std::vector<BoundingBox<float>> leafBounds(leafTriangleCounts.size());
+        auto* triangleBlocks = isCompact() ? nullptr : _triangleBlocks.getMutableData();
+        forEachChunk(threadPool, leafBounds.size(), [&](size_t begin, size_t end) {
+            for (auto leaf = begin; leaf < end; ++leaf) {
+                const auto getLeafTriangle = [&](uint32_t i) {
+                    return isCompact() ? _leafTriangles[leaf] + i : triangleBlocks[leaf].triangle[i];
+                };
+                bool dirty = dirtyTriangles.empty();
+                for (uint32_t i = 0; i < leafTriangleCounts[leaf] && !dirty; ++i) {
+                    dirty = dirtyTriangles[getLeafTriangle(i)] != 0;
+                }
+                for (uint32_t i = 0; i < leafTriangleCounts[leaf]; ++i) {
+                    const auto triangle = getLeafTriangle(i);
+                    Vector3f v0, v1, v2;
+                    getTriangle(triangle, v0, v1, v2);
+                    leafBounds[leaf].expand(v0);
+                    leafBounds[leaf].expand(v1);
+                    leafBounds[leaf].expand(v2);
+                    if (!isCompact() && dirty) {
+                        triangleBlocks[leaf].set(static_cast<int>(i), v0, v1, v2, triangle);
+                    }
+                }
+            }
+        });
+        _boundingBox = {};
+        for (const auto& bounds: leafBounds) {
+            _boundingBox.expand(bounds);
+        }
+
+        const auto maxSahRatio = _bvh.getOptions().maxRefitSahRatio;
+        if (!_wideBvh8.isEmpty()) {
+            _wideBvh8.refit(leafBounds, threadPool);
+            if (_wideBvh8.needsRebuild(maxSahRatio)) {
+                rebuild();
+            }
+        } else {
+            _wideBvh4.refit(leafBounds, threadPool);
+            if (_wideBvh4.needsRebuild(maxSahRatio)) {
+                rebuild();
+            }
+        }
+    }
+
+    void Mesh::updateTriangleBlocks(const std::vector<uint8_t>& dirtyTriangles) {
+        const auto& nodes = _bvh.getNodes();
+        const auto& primitiveIndices = _bvh.getPrimitiveIndices();
+        auto* triangleBlocks = _triangleBlocks.getMutableData();
+        for (size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex) {
+            const auto& node = nodes[nodeIndex];
+            if (!node.isLeaf()) {
+                continue;
+            }
+            bool dirty = dirtyTriangles.empty();
+            for (uint32_t i = 0; i < node.primitiveCount && !dirty; ++i) {
+                dirty = dirtyTriangles[primitiveIndices[node.offset + i]] != 0;
+            }
+            if (!dirty) {
+                continue;
+            }
+            auto& block = triangleBlocks[_leafBlocks[nodeIndex]];
+            for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+                const auto triangle = primitiveIndices[node.offset + i];
+                Vector3f v0, v1, v2;
+                getTriangle(triangle, v0, v1, v2);
+                block.set(static_cast<int>(i), v0, v1, v2, triangle);
+            }
+        }
+    }
+
+    size_t Mesh::getByteSize() const {
+        return _points.size() * sizeof(Vector3f) + _triangleVertexIndices.size() * sizeof(Vector3i) +
+               _compactGeometry.getByteSize() + _bvh.getNodes().size() * sizeof(BvhNode) +
+               _bvh.getPrimitiveIndices().size() * sizeof(uint32_t) +
+               _wideBvh4.getNodes().size() * sizeof(WideBvhNode<4>) +
+               _wideBvh8.getNodes().size() * sizeof(WideBvhNode<8>) +
+               _triangleBlocks.size() * sizeof(TriangleBlock) + _leafBlocks.size() * sizeof(uint32_t) +
+               _leafTriangles.size() * sizeof(uint32_t);
+    }
+
+    void Mesh::resolveHit(const Ray& ray, float t, uint32_t triangle, float u, float v,
+                          HitRecord& outRecord) const {
+        Vector3f v0, v1, v2;
+        getTriangle(triangle, v0, v1, v2);
+        outRecord.t = t;
+        outRecord.u = u;
+        outRecord.v = v;
+        outRecord.p = ray.getPoint(t);
+        outRecord.normal = (v1 - v0).cross(v2 - v0).normalize();
+        outRecord.material = &getMaterial();
+        outRecord.color = getColor(outRecord.p, ray.getFootprint(t));
+    }
+
+    bool Mesh::intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const {
+        CRT_COUNT(meshQueries, 1);
+        uint32_t closestTriangle = 0;
+        float closestU = 0.0f;
+        float closestV = 0.0f;
+        float closestT = tMax;
+        bool hit;
+        if (isCompact()) {
+            const auto intersectTriangles = [&](uint32_t firstTriangle, uint32_t triangleCount,
+                                                float tMin, float& tMax) {
+                TriangleBlock block;
+                _compactGeometry.getTriangleBlock(firstTriangle, triangleCount, block);
+                return block.intersectClosest(ray, tMin, tMax, closestTriangle, closestU, closestV);
+            };
+            const auto intersectLeaf = [&](uint32_t leaf, uint32_t triangleCount, float tMin, float& tMax) {
+                return intersectTriangles(_leafTriangles[leaf], triangleCount, tMin, tMax);
+            };
+            if (!_wideBvh8.isEmpty()) {
+                hit = _wideBvh8.intersectLeaves(ray, tMin, closestT, intersectLeaf);
+            } else if (!_wideBvh4.isEmpty()) {
+                hit = _wideBvh4.intersectLeaves(ray, tMin, closestT, intersectLeaf);
+            } else {
+                hit = _bvh.intersectLeaves(ray, tMin, closestT, [&](uint32_t, const BvhNode& leaf,
+                                                                    float tMin, float& tMax) {
+                    return intersectTriangles(leaf.offset, leaf.primitiveCount, tMin, tMax);
+                });
+            }
+        } else {
+            const auto intersectBlock = [&](uint32_t block, uint32_t, float tMin, float& tMax) {
+                return _triangleBlocks[block].intersectClosest(ray, tMin, tMax, closestTriangle, closestU, closestV);
+            };
+            if (!_wideBvh8.isEmpty()) {
+                hit = _wideBvh8.intersectLeaves(ray, tMin, closestT, intersectBlock);
+            } else if (!_wideBvh4.isEmpty()) {
+                hit = _wideBvh4.intersectLeaves(ray, tMin, closestT, intersectBlock);
+            } else {
+                hit = _bvh.intersectLeaves(ray, tMin, closestT, [&](uint32_t nodeIndex, const BvhNode&,
+                                                                    float tMin, float& tMax) {
+                    return intersectBlock(_leafBlocks[nodeIndex], 0, tMin, tMax);
+                });
+            }
+        }
+        if (hit) {
+            outHit = {closestT, closestTriangle, closestU, closestV, this};
+        }
+        return hit;
+    }
+
+    void Mesh::hitPacket(RayPacket& packet, PacketHit& outHit) const {
+        CRT_COUNT(meshQueries, 1);
+        const auto intersectTriangle = [&](uint32_t triangle) {
+            Vector3f v0, v1, v2;
+            getTriangle(triangle, v0, v1, v2);
+            PacketKernels::intersectTriangle(packet, outHit, v0, v1, v2, this, triangle);
+        };
+        const auto intersectLeaf = [&](uint32_t leaf, uint32_t triangleCount) {
+            for (uint32_t i = 0; i < triangleCount; ++i) {
+                intersectTriangle(isCompact() ? _leafTriangles[leaf] + i : _triangleBlocks[leaf].triangle[i]);
+            }
+        };
+        if (!_wideBvh8.isEmpty()) {
+            _wideBvh8.intersectPacket(packet, intersectLeaf);
+        } else if (!_wideBvh4.isEmpty()) {
+            _wideBvh4.intersectPacket(packet, intersectLeaf);
+        } else if (isCompact()) {
+            // There are no primitive indices, leaf offsets are triangle indices.
+            _bvh.intersectPacketLeaves(packet, [&](uint32_t, const BvhNode& leaf) {
+                for (uint32_t i = 0; i < leaf.primitiveCount; ++i) {
+                    intersectTriangle(leaf.offset + i);
+                }
+            });
+        } else {
+            _bvh.intersectPacket(packet, intersectTriangle);
+        }
+    }
+
+    bool Mesh::occluded(const Ray& ray, float tMin, float tMax) const {
+        CRT_COUNT(meshQueries, 1);
+        if (isCompact()) {
+            const auto occludedTriangles = [&](uint32_t firstTriangle, uint32_t triangleCount,
+                                               float tMin, float tMax) {
+                TriangleBlock block;
+                _compactGeometry.getTriangleBlock(firstTriangle, triangleCount, block);
+                SimdFloat<TriangleBlock::kSize> t, u, v;
+                return block.intersect(ray, tMin, tMax, t, u, v) != 0;
+            };
+            const auto occludedLeaf = [&](uint32_t leaf, uint32_t triangleCount, float tMin, float tMax) {
+                return occludedTriangles(_leafTriangles[leaf], triangleCount, tMin, tMax);
+            };
+            if (!_wideBvh8.isEmpty()) {
+                return _wideBvh8.occludedLeaves(ray, tMin, tMax, occludedLeaf);
+            }
+            if (!_wideBvh4.isEmpty()) {
+                return _wideBvh4.occludedLeaves(ray, tMin, tMax, occludedLeaf);
+            }
+            return _bvh.occludedLeaves(ray, tMin, tMax, [&](uint32_t, const BvhNode& leaf, float tMin, float tMax) {
+                return occludedTriangles(leaf.offset, leaf.primitiveCount, tMin, tMax);
+            });
+        }
+
+        const auto occludedBlock = [&](uint32_t block, uint32_t, float tMin, float tMax) {
+            SimdFloat<TriangleBlock::kSize> t, u, v;
+            return _triangleBlocks[block].intersect(ray, tMin, tMax, t, u, v) != 0;
+        };
+        if (!_wideBvh8.isEmpty()) {
+            return _wideBvh8.occludedLeaves(ray, tMin, tMax, occludedBlock);
+        }
+        if (!_wideBvh4.isEmpty()) {
+            return _wideBvh4.occludedLeaves(ray, tMin, tMax, occludedBlock);
+        }
+        return _bvh.occludedLeaves(ray, tMin, tMax, [&](uint32_t nodeIndex, const BvhNode&, float tMin, float tMax) {
+            return occludedBlock(_leafBlocks[nodeIndex], 0, tMin, tMax);
+        });
+    }
+
+    bool Mesh::hitBruteForce(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const {
+        CRT_COUNT(meshQueries, 1);
         if (!_boundingBox.hit(ray, tMin, tMax)) {
             return false;
         }
 
         bool hit = false;
         float closestT = tMax;
-        for (const auto& triangleVertexIndices: _triangleVertexIndices) {
-            const Vector3f& v0 = _points[triangleVertexIndices[0]];
-            const Vector3f& v1 = _points[triangleVertexIndices[1]];
-            const Vector3f& v2 = _points[triangleVertexIndices[2]];
+        SurfaceHit closest{};
+        for (size_t i = 0; i < getTriangleCount(); ++i) {
+            Vector3f v0, v1, v2;
+            getTriangle(static_cast<uint32_t>(i), v0, v1, v2);
             float t, u, v;
             if (MathUtils::rayIntersectsTriangle(ray, v0, v1, v2, t, u, v)) {
                 if (t > tMin && t < closestT) {
                     closestT = t;
-                    outRecord.t = t;
-                    outRecord.p = ray.getPoint(t);
-                    outRecord.normal = (v1 - v0).cross(v2 - v0).normalize();
-                    outRecord.material = getMaterial();
+                    closest = {t, static_cast<uint32_t>(i), u, v, this};
                     hit = true;
                 }
             }
         }
+        if (hit) {
+            resolveHit(ray, closest.t, closest.primitive, closest.u, closest.v, outRecord);
+        }
         return hit;
     }
 }
-
@@ -2,39 +2,242 @@
 
 #include "Surface.h"
 #include "BoundingBox.h"
+#include "Bvh.h"
+#include "CompactGeometry.h"
+#include "TriangleBlock.h"
+#include "SharedArray.h"
+#include "WideBvh.h"
 
 namespace crt {
 
+    enum class MeshStorage {
+        // Vector3f points and Vector3i indices, plus the triangles of every BVH leaf as a ready TriangleBlock.
+        Full,
+        // CompactGeometry with the triangles stored in BVH leaf order. Leaves are decoded into a TriangleBlock
+        // whenever a ray reaches them: several times less memory, slower intersection.
+        Compact,
+    };
+
     class Mesh : public Surface {
     public:
+        /**
+         * Builds the BVH with bvhOptions, whose leafBlockSize is always replaced by TriangleBlock::kSize. With a
+         * bvhOptions.width of 4 or 8 only the collapsed wide tree is kept. Compact storage keeps the geometry
+         * as CompactGeometry only, see MeshStorage.
+         */
         Mesh(const std::vector<Vector3f>& points,
-             const std::vector<Vector3i>& triangleVertexIndices) : _points(points),
-                                                                   _triangleVertexIndices(triangleVertexIndices),
-                                                                   _boundingBox{} {
-            for (const auto& point: _points) {
-                _boundingBox.expand(point);
+             const std::vector<Vector3i>& triangleVertexIndices,
+             const BvhBuildOptions& bvhOptions = {},
+             MeshStorage storage = MeshStorage::Full) {
+            if (storage == MeshStorage::Compact) {
+                buildCompact(points, triangleVertexIndices, bvhOptions);
+            } else {
+                _points = SharedArray<Vector3f>(points);
+                _triangleVertexIndices = SharedArray<Vector3i>(triangleVertexIndices);
+                buildBvh(bvhOptions);
             }
         }
 
         Mesh(std::vector<Vector3f>&& points,
-             std::vector<Vector3i>&& triangleVertexIndices) : _points(std::move(points)),
-                                                              _triangleVertexIndices(
-                                                                      std::move(triangleVertexIndices)),
-                                                              _boundingBox{} {
-            for (const auto& point: _points) {
-                _boundingBox.expand(point);
+             std::vector<Vector3i>&& triangleVertexIndices,
+             const BvhBuildOptions& bvhOptions = {},
+             MeshStorage storage = MeshStorage::Full) {
+            if (storage == MeshStorage::Compact) {
+                buildCompact(points, triangleVertexIndices, bvhOptions);
+            } else {
+                _points = SharedArray<Vector3f>(std::move(points));
+                _triangleVertexIndices = SharedArray<Vector3i>(std::move(triangleVertexIndices));
+                buildBvh(bvhOptions);
             }
         }
 
-        bool hit(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const override;
+        /**
+         * Uses prebuilt acceleration data as is, e.g. straight from a mapped scene bundle. The bounding box is
+         * taken from the BVH root.
+         */
+        Mesh(SharedArray<Vector3f> points,
+             SharedArray<Vector3i> triangleVertexIndices,
+             Bvh bvh,
+             SharedArray<TriangleBlock> triangleBlocks,
+             SharedArray<uint32_t> leafBlocks) : _points(std::move(points)),
+                                                 _triangleVertexIndices(std::move(triangleVertexIndices)),
+                                                 _boundingBox(bvh.getBounds()),
+                                                 _bvh(std::move(bvh)),
+                                                 _triangleBlocks(std::move(triangleBlocks)),
+                                                 _leafBlocks(std::move(leafBlocks)) {}
+
+        /**
+         * Like the constructor above for a mesh traversed through a wide tree. bvh only carries the statistics
+         * and options of the binary build, the bounding box is taken from the wide root.
+         */
+        template<int Width>
+        Mesh(SharedArray<Vector3f> points,
+             SharedArray<Vector3i> triangleVertexIndices,
+             Bvh bvh,
+             WideBvh<Width> wideBvh,
+             SharedArray<TriangleBlock> triangleBlocks) : _points(std::move(points)),
+                                                          _triangleVertexIndices(std::move(triangleVertexIndices)),
+                                                          _boundingBox(wideBvh.getBounds()),
+                                                          _bvh(std::move(bvh)),
+                                                          _triangleBlocks(std::move(triangleBlocks)) {
+            if constexpr (Width == 4) {
+                _wideBvh4 = std::move(wideBvh);
+            } else {
+                _wideBvh8 = std::move(wideBvh);
+            }
+        }
+
+        /**
+         * Moves the points, which keep the count and order the mesh was built with, and refits the BVH instead of
+         * rebuilding it. Only leaves holding a triangle with a point in movedPoints get new bounds, all of them when
+         * movedPoints is empty. The tree is rebuilt when the refit degrades it past
+         * BvhBuildOptions::maxRefitSahRatio. Compact meshes requantize every point and refit every leaf. Fails for
+         * a different point count or a moved point out of range. Must not run while the mesh is traced.
+         */
+        bool updatePoints(const std::vector<Vector3f>& points, const std::vector<uint32_t>& movedPoints = {},
+                          ThreadPool* threadPool = nullptr);
+
+        /**
+         * Transforms every point through updatePoints. Compact meshes transform their decoded points, so repeated
+         * transforms accumulate quantization error.
+         */
+        bool transform(const Matrix4f& transform) override;
+
+        bool intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const override;
+
+        /**
+         * Reference path that tests every triangle without the BVH.
+         */
+        bool hitBruteForce(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const;
+
+        [[nodiscard]] bool occluded(const Ray& ray, float tMin, float tMax) const override;
+
+        void hitPacket(RayPacket& packet, PacketHit& outHit) const override;
+
+        void resolveHit(const Ray& ray, float t, uint32_t primitive, float u, float v,
+                        HitRecord& outRecord) const override;
+
+        bool boundingBox(BoundingBox<float>& outBox) const override {
+            outBox = _boundingBox;
+            return true;
+        }
 
         Vector2f getUV(const Vector3f& p) const override {
             return crt::Vector2f();
         }
 
+        [[nodiscard]] size_t getTriangleCount() const {
+            return isCompact() ? _compactGeometry.getTriangleCount() : _triangleVertexIndices.size();
+        }
+
+        [[nodiscard]] size_t getPointCount() const {
+            return isCompact() ? _compactGeometry.getPointCount() : _points.size();
+        }
+
+        [[nodiscard]] bool isCompact() const {
+            return !_compactGeometry.isEmpty();
+        }
+
+        /**
+         * Bytes of geometry and acceleration data held by the mesh, shared arrays included.
+         */
+        [[nodiscard]] size_t getByteSize() const;
+
+        [[nodiscard]] const BoundingBox<float>& getBoundingBox() const {
+            return _boundingBox;
+        }
+
+        [[nodiscard]] const Bvh& getBvh() const {
+            return _bvh;
+        }
+
+        /**
+         * Children per node of the traversed tree: 2 for the binary Bvh, 4 or 8 for a wide one.
+         */
+        [[nodiscard]] uint32_t getBvhWidth() const {
+            return !_wideBvh8.isEmpty() ? 8 : !_wideBvh4.isEmpty() ? 4 : 2;
+        }
+
+        [[nodiscard]] const WideBvh<4>& getWideBvh4() const {
+            return _wideBvh4;
+        }
+
+        [[nodiscard]] const WideBvh<8>& getWideBvh8() const {
+            return _wideBvh8;
+        }
+
+        /**
+         * The geometry of a compact mesh, getPoints and getTriangleVertexIndices are empty then.
+         */
+        [[nodiscard]] const CompactGeometry& getCompactGeometry() const {
+            return _compactGeometry;
+        }
+
+        [[nodiscard]] const SharedArray<Vector3f>& getPoints() const {
+            return _points;
+        }
+
+        [[nodiscard]] const SharedArray<Vector3i>& getTriangleVertexIndices() const {
+            return _triangleVertexIndices;
+        }
+
+        [[nodiscard]] const SharedArray<TriangleBlock>& getTriangleBlocks() const {
+            return _triangleBlocks;
+        }
+
+        [[nodiscard]] const SharedArray<uint32_t>& getLeafBlocks() const {
+            return _leafBlocks;
+        }
+
+    private:
+        void buildBvh(const BvhBuildOptions& options);
+
+        void buildCompact(const std::vector<Vector3f>& points, const std::vector<Vector3i>& triangleVertexIndices,
+                          const BvhBuildOptions& options);
+
+        /**
+         * Drops the binary nodes for a wide tree when options ask for one.
+         */
+        void collapseBvh(const BvhBuildOptions& options);
+
+        /**
+         * Refits the tree after the points moved to points, rebuilding it when the refit degraded it too much.
+         * dirtyTriangles flags the triangles with a moved point, empty flags all of them.
+         */
+        void refitBvh(const std::vector<Vector3f>& points, const std::vector<uint8_t>& dirtyTriangles,
+                      ThreadPool* threadPool);
+
+        /**
+         * Rewrites the triangle blocks of the leaves holding a dirty triangle.
+         */
+        void updateTriangleBlocks(const std::vector<uint8_t>& dirtyTriangles);
+
+        void getTriangle(uint32_t triangle, Vector3f& outV0, Vector3f& outV1, Vector3f& outV2) const {
+            if (isCompact()) {
+                _compactGeometry.getTriangle(triangle, outV0, outV1, outV2);
+            } else {
+                const auto& triangleVertexIndices = _triangleVertexIndices[triangle];
+                outV0 = _points[triangleVertexIndices[0]];
+                outV1 = _points[triangleVertexIndices[1]];
+                outV2 = _points[triangleVertexIndices[2]];
+            }
+        }
+
     private:
-        std::vector<Vector3f> _points;
-        std::vector<Vector3i> _triangleVertexIndices;
+        SharedArray<Vector3f> _points;
+        SharedArray<Vector3i> _triangleVertexIndices;
+        CompactGeometry _compactGeometry;
         BoundingBox<float> _boundingBox;
+        // Without nodes when a wide tree is used, it then only keeps the statistics of the binary build. Compact
+        // meshes drop the primitive indices, their triangles are stored in leaf order instead.
+        Bvh _bvh;
+        WideBvh<4> _wideBvh4;
+        WideBvh<8> _wideBvh8;
+        // The triangles of every BVH leaf, indexed through _leafBlocks by node index for the binary tree and
+        // directly by leaf index for the wide ones. Compact meshes have no blocks.
+        SharedArray<TriangleBlock> _triangleBlocks;
+        SharedArray<uint32_t> _leafBlocks;
+        // Compact meshes with a wide tree: the first triangle of every leaf, by leaf index.
+        SharedArray<uint32_t> _leafTriangles;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,832 @@
+#include "MeshLoader.h"
+
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+namespace crt {
+    namespace {
+        constexpr bool kHostIsLittleEndian = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+        // Vertices or faces decoded per task when a binary body is split across threads.
+        constexpr size_t kBinaryBatchSize = 1 << 16;
+
+        enum class PlyType { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+        enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+        struct PlyProperty {
+            std::string name;
+            PlyType type = PlyType::Invalid;
+            // List properties store a count of countType followed by that many values of type.
+            bool isList = false;
+            PlyType countType = PlyType::Invalid;
+        };
+
+        size_t getPlyTypeSize(PlyType type) {
+            switch (type) {
+                case PlyType::Int8:
+                case PlyType::UInt8:
+                    return 1;
+                case PlyType::Int16:
+                case PlyType::UInt16:
+                    return 2;
+                case PlyType::Int32:
+                case PlyType::UInt32:
+                case PlyType::Float32:
+                    return 4;
+                case PlyType::Float64:
+                    return 8;
+                default:
+                    return 0;
+            }
+        }
+
+        PlyType parsePlyType(std::string_view name) {
+            if (name == "char" || name == "int8") return PlyType::Int8;
+            if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+            if (name == "short" || name == "int16") return PlyType::Int16;
+            if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+            if (name == "int" || name == "int32") return PlyType::Int32;
+            if (name == "uint" || name == "uint32") return PlyType::UInt32;
+            if (name == "float" || name == "float32") return PlyType::Float32;
+            if (name == "double" || name == "float64") return PlyType::Float64;
+            return PlyType::Invalid;
+        }
+
+        struct PlyElement {
+            std::string name;
+            size_t count = 0;
+            std::vector<PlyProperty> properties;
+
+            // Byte size of one binary instance, 0 if it contains lists and has to be walked.
+            [[nodiscard]] size_t getFixedSize() const {
+                size_t size = 0;
+                for (const auto& property: properties) {
+                    if (property.isList) {
+                        return 0;
+                    }
+                    size += getPlyTypeSize(property.type);
+                }
+                return size;
+            }
+
+            [[nodiscard]] int findProperty(std::string_view propertyName) const {
+                for (size_t i = 0; i < properties.size(); ++i) {
+                    if (properties[i].name == propertyName) {
+                        return static_cast<int>(i);
+                    }
+                }
+                return -1;
+            }
+        };
+
+        struct PlyHeader {
+            PlyFormat format = PlyFormat::Ascii;
+            std::vector<PlyElement> elements;
+            size_t bodyOffset = 0;
+            // Positions of the geometry inside elements, -1 when absent.
+            int vertexElement = -1;
+            int faceElement = -1;
+            int xProperty = -1;
+            int yProperty = -1;
+            int zProperty = -1;
+            int indicesProperty = -1;
+        };
+
+        std::vector<std::string_view> splitWords(std::string_view line) {
+            std::vector<std::string_view> words;
+            size_t position = 0;
+            while (position < line.size()) {
+                while (position < line.size() && (line[position] == ' ' || line[position] == '\t')) {
+                    ++position;
+                }
+                const auto start = position;
+                while (position < line.size() && line[position] != ' ' && line[position] != '\t') {
+                    ++position;
+                }
+                if (position > start) {
+                    words.push_back(line.substr(start, position - start));
+                }
+            }
+            return words;
+        }
+
+        bool parsePlyHeader(const char* data, size_t size, PlyHeader& outHeader, std::string& outError) {
+            size_t position = 0;
+            bool hasFormat = false;
+            for (size_t lineNumber = 1;; ++lineNumber) {
+                if (position >= size) {
+                    outError = "PLY header is not terminated by end_header";
+                    return false;
+                }
+                const auto* lineEnd = static_cast<const char*>(std::memchr(data + position, '\n', size - position));
+                const auto lineLength = lineEnd ? static_cast<size_t>(lineEnd - data) - position : size - position;
+                std::string_view line(data + position, lineLength);
+                position += lineLength + 1;
+                if (!line.empty() && line.back() == '\r') {
+                    line.remove_suffix(1);
+                }
+
+                const auto words = splitWords(line);
+                const auto lineError = [&](const std::string& message) {
+                    outError = "PLY header line " + std::to_string(lineNumber) + ": " + message;
+                    return false;
+                };
+                if (lineNumber == 1) {
+                    if (words.size() != 1 || words[0] != "ply") {
+                        return lineError("missing 'ply' magic");
+                    }
+                    continue;
+                }
+                if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+                    continue;
+                }
+                if (words[0] == "format") {
+                    if (words.size() != 3) {
+                        return lineError("malformed format");
+                    }
+                    if (words[1] == "ascii") {
+                        outHeader.format = PlyFormat::Ascii;
+                    } else if (words[1] == "binary_little_endian") {
+                        outHeader.format = PlyFormat::BinaryLittleEndian;
+                    } else if (words[1] == "binary_big_endian") {
+                        outHeader.format = PlyFormat::BinaryBigEndian;
+                    } else {
+                        return lineError("unknown format " + std::string(words[1]));
+                    }
+                    hasFormat = true;
+                } else if (words[0] == "element") {
+                    PlyElement element;
+                    if (words.size() != 3 ||
+                        std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count).ec !=
+                        std::errc()) {
+                        return lineError("malformed element");
+                    }
+                    element.name = words[1];
+                    outHeader.elements.push_back(std::move(element));
+                } else if (words[0] == "property") {
+                    if (outHeader.elements.empty()) {
+                        return lineError("property outside of an element");
+                    }
+                    PlyProperty property;
+                    if (words.size() == 5 && words[1] == "list") {
+                        property.isList = true;
+                        property.countType = parsePlyType(words[2]);
+                        property.type = parsePlyType(words[3]);
+                        property.name = words[4];
+                        if (property.countType == PlyType::Invalid || property.type == PlyType::Invalid) {
+                            return lineError("unknown list type");
+                        }
+                    } else if (words.size() == 3) {
+                        property.type = parsePlyType(words[1]);
+                        property.name = words[2];
+                        if (property.type == PlyType::Invalid) {
+                            return lineError("unknown type " + std::string(words[1]));
+                        }
+                    } else {
+                        return lineError("malformed property");
+                    }
+                    outHeader.elements.back().properties.push_back(std::move(property));
+                } else if (words[0] == "end_header") {
+                    outHeader.bodyOffset = position;
+                    break;
+                } else {
+                    return lineError("unexpected keyword " + std::string(words[0]));
+                }
+            }
+            if (!hasFormat) {
+                outError = "PLY header has no format line";
+                return false;
+            }
+
+            for (size_t i = 0; i < outHeader.elements.size(); ++i) {
+                const auto& element = outHeader.elements[i];
+                if (element.name == "vertex") {
+                    outHeader.vertexElement = static_cast<int>(i);
+                    outHeader.xProperty = element.findProperty("x");
+                    outHeader.yProperty = element.findProperty("y");
+                    outHeader.zProperty = element.findProperty("z");
+                } else if (element.name == "face") {
+                    outHeader.faceElement = static_cast<int>(i);
+                    outHeader.indicesProperty = element.findProperty("vertex_indices");
+                    if (outHeader.indicesProperty < 0) {
+                        outHeader.indicesProperty = element.findProperty("vertex_index");
+                    }
+                }
+            }
+            if (outHeader.vertexElement < 0 || outHeader.xProperty < 0 || outHeader.yProperty < 0 ||
+                outHeader.zProperty < 0) {
+                outError = "PLY file has no vertex element with x, y and z";
+                return false;
+            }
+            const auto& vertexElement = outHeader.elements[outHeader.vertexElement];
+            for (const auto index: {outHeader.xProperty, outHeader.yProperty, outHeader.zProperty}) {
+                if (vertexElement.properties[index].isList) {
+                    outError = "PLY vertex coordinates must not be lists";
+                    return false;
+                }
+            }
+            if (outHeader.faceElement >= 0 &&
+                (outHeader.indicesProperty < 0 ||
+                 !outHeader.elements[outHeader.faceElement].properties[outHeader.indicesProperty].isList)) {
+                outError = "PLY face element has no vertex_indices list";
+                return false;
+            }
+            return true;
+        }
+
+        template<typename T>
+        T loadValue(const char* data, bool swapBytes) {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, data, sizeof(T));
+            if (swapBytes) {
+                std::reverse(bytes, bytes + sizeof(T));
+            }
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        double readPlyValue(const char* data, PlyType type, bool swapBytes) {
+            switch (type) {
+                case PlyType::Int8:
+                    return loadValue<int8_t>(data, swapBytes);
+                case PlyType::UInt8:
+                    return loadValue<uint8_t>(data, swapBytes);
+                case PlyType::Int16:
+                    return loadValue<int16_t>(data, swapBytes);
+                case PlyType::UInt16:
+                    return loadValue<uint16_t>(data, swapBytes);
+                case PlyType::Int32:
+                    return loadValue<int32_t>(data, swapBytes);
+                case PlyType::UInt32:
+                    return loadValue<uint32_t>(data, swapBytes);
+                case PlyType::Float32:
+                    return loadValue<float>(data, swapBytes);
+                case PlyType::Float64:
+                    return loadValue<double>(data, swapBytes);
+                default:
+                    return 0.0;
+            }
+        }
+
+        /**
+         * Triangulates a polygon as a fan around its first vertex. Fails on indices outside [0, vertexCount).
+         */
+        bool appendPolygon(const int64_t* indices, size_t indexCount, size_t vertexCount,
+                           std::vector<Vector3i>& outTriangles) {
+            for (size_t i = 0; i < indexCount; ++i) {
+                if (indices[i] < 0 || static_cast<uint64_t>(indices[i]) >= vertexCount) {
+                    return false;
+                }
+            }
+            for (size_t i = 2; i < indexCount; ++i) {
+                outTriangles.push_back({static_cast<int>(indices[0]),
+                                        static_cast<int>(indices[i - 1]),
+                                        static_cast<int>(indices[i])});
+            }
+            return true;
+        }
+
+        template<typename Function>
+        void parallelBatches(ThreadPool& threadPool, size_t count, size_t batchSize, const Function& function) {
+            const auto batchCount = static_cast<uint32_t>((count + batchSize - 1) / batchSize);
+            threadPool.parallelFor(batchCount, [&](uint32_t batch, unsigned) {
+                const auto begin = static_cast<size_t>(batch) * batchSize;
+                function(begin, std::min(count, begin + batchSize));
+            });
+        }
+
+        const char* skipSpaces(const char* position, const char* end) {
+            while (position < end && (*position == ' ' || *position == '\t' || *position == '\r')) {
+                ++position;
+            }
+            return position;
+        }
+
+        bool skipToken(const char*& position, const char* end) {
+            position = skipSpaces(position, end);
+            const auto* start = position;
+            while (position < end && *position != ' ' && *position != '\t' && *position != '\r') {
+                ++position;
+            }
+            return position > start;
+        }
+
+        template<typename T>
+        bool parseNumber(const char*& position, const char* end, T& outValue) {
+            position = skipSpaces(position, end);
+            if (position < end && *position == '+') {
+                ++position;
+            }
+            const auto [next, error] = std::from_chars(position, end, outValue);
+            if (error != std::errc()) {
+                return false;
+            }
+            position = next;
+            return true;
+        }
+
+        /**
+         * Calls lineFunction(begin, end) for every line of [begin, end) that is not blank, with the line end
+         * excluding the newline. Stops early and returns false as soon as lineFunction does.
+         */
+        template<typename LineFunction>
+        bool forEachLine(const char* begin, const char* end, const LineFunction& lineFunction) {
+            while (begin < end) {
+                const auto* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                const auto* lineEnd = newline ? newline : end;
+                const auto* first = skipSpaces(begin, lineEnd);
+                if (first < lineEnd && !lineFunction(first, lineEnd)) {
+                    return false;
+                }
+                begin = newline ? newline + 1 : end;
+            }
+            return true;
+        }
+
+        std::string_view getKeyword(const char* begin, const char* end) {
+            const auto* position = begin;
+            while (position < end && *position != ' ' && *position != '\t' && *position != '\r') {
+                ++position;
+            }
+            return {begin, static_cast<size_t>(position - begin)};
+        }
+
+        bool decodeBinaryPly(const PlyHeader& header, const char* body, const char* end, ThreadPool& threadPool,
+                             MeshData& outData, std::string& outError) {
+            const bool swapBytes = (header.format == PlyFormat::BinaryBigEndian) == kHostIsLittleEndian;
+            const auto truncated = [&](const PlyElement& element) {
+                outError = "PLY body ends inside element " + element.name;
+                return false;
+            };
+
+            const auto* position = body;
+            for (size_t elementIndex = 0; elementIndex < header.elements.size(); ++elementIndex) {
+                const auto& element = header.elements[elementIndex];
+                const auto fixedSize = element.getFixedSize();
+
+                if (static_cast<int>(elementIndex) == header.vertexElement && fixedSize > 0) {
+                    if (static_cast<size_t>(end - position) / fixedSize < element.count) {
+                        return truncated(element);
+                    }
+                    size_t offsets[3] = {};
+                    PlyType types[3] = {};
+                    const int coordinates[3] = {header.xProperty, header.yProperty, header.zProperty};
+                    for (int axis = 0; axis < 3; ++axis) {
+                        for (int i = 0; i < coordinates[axis]; ++i) {
+                            offsets[axis] += getPlyTypeSize(element.properties[i].type);
+                        }
+                        types[axis] = element.properties[coordinates[axis]].type;
+                    }
+                    outData.points.resize(element.count);
+                    parallelBatches(threadPool, element.count, kBinaryBatchSize, [&](size_t begin, size_t batchEnd) {
+                        for (auto i = begin; i < batchEnd; ++i) {
+                            const auto* vertex = position + i * fixedSize;
+                            outData.points[i] = {
+                                    static_cast<float>(readPlyValue(vertex + offsets[0], types[0], swapBytes)),
+                                    static_cast<float>(readPlyValue(vertex + offsets[1], types[1], swapBytes)),
+                                    static_cast<float>(readPlyValue(vertex + offsets[2], types[2], swapBytes))};
+                        }
+                    });
+                    position += fixedSize * element.count;
+                    continue;
+                }
+
+                const bool isFace = static_cast<int>(elementIndex) == header.faceElement;
+                if (isFace && element.properties.size() == 1) {
+                    // Fast path for pure triangle meshes: every face has the same size, so faces can be decoded
+                    // in parallel. The first face that is not a triangle sends us to the sequential walk below.
+                    const auto& list = element.properties.front();
+                    const auto countSize = getPlyTypeSize(list.countType);
+                    const auto indexSize = getPlyTypeSize(list.type);
+                    const auto stride = countSize + 3 * indexSize;
+                    if (static_cast<size_t>(end - position) / stride >= element.count) {
+                        const auto vertexCount = outData.points.size();
+                        std::atomic<bool> allTriangles{true};
+                        std::atomic<bool> indicesInRange{true};
+                        outData.triangleVertexIndices.resize(element.count);
+                        parallelBatches(threadPool, element.count, kBinaryBatchSize,
+                                        [&](size_t begin, size_t batchEnd) {
+                            for (auto i = begin; i < batchEnd && allTriangles.load(std::memory_order_relaxed); ++i) {
+                                const auto* face = position + i * stride;
+                                if (readPlyValue(face, list.countType, swapBytes) != 3.0) {
+                                    allTriangles = false;
+                                    return;
+                                }
+                                int indices[3];
+                                for (int k = 0; k < 3; ++k) {
+                                    const auto index = readPlyValue(face + countSize + k * indexSize, list.type,
+                                                                    swapBytes);
+                                    if (index < 0.0 || index >= static_cast<double>(vertexCount)) {
+                                        indicesInRange = false;
+                                        indices[k] = 0;
+                                    } else {
+                                        indices[k] = static_cast<int>(index);
+                                    }
+                                }
+                                outData.triangleVertexIndices[i] = {indices[0], indices[1], indices[2]};
+                            }
+                        });
+                        if (allTriangles) {
+                            if (!indicesInRange) {
+                                outError = "PLY face references a vertex that does not exist";
+                                return false;
+                            }
+                            position += stride * element.count;
+                            continue;
+                        }
+                        outData.triangleVertexIndices.clear();
+                    }
+                }
+
+                if (fixedSize > 0) {
+                    if (static_cast<size_t>(end - position) / fixedSize < element.count) {
+                        return truncated(element);
+                    }
+                    position += fixedSize * element.count;
+                    continue;
+                }
+
+                // Elements with lists have to be walked one instance at a time.
+                std::vector<int64_t> indices;
+                for (size_t instance = 0; instance < element.count; ++instance) {
+                    for (size_t propertyIndex = 0; propertyIndex < element.properties.size(); ++propertyIndex) {
+                        const auto& property = element.properties[propertyIndex];
+                        const auto valueSize = getPlyTypeSize(property.type);
+                        size_t valueCount = 1;
+                        if (property.isList) {
+                            const auto countSize = getPlyTypeSize(property.countType);
+                            if (static_cast<size_t>(end - position) < countSize) {
+                                return truncated(element);
+                            }
+                            valueCount = static_cast<size_t>(readPlyValue(position, property.countType, swapBytes));
+                            position += countSize;
+                        }
+                        if (static_cast<size_t>(end - position) / valueSize < valueCount) {
+                            return truncated(element);
+                        }
+                        if (isFace && static_cast<int>(propertyIndex) == header.indicesProperty) {
+                            indices.resize(valueCount);
+                            for (size_t i = 0; i < valueCount; ++i) {
+                                indices[i] = static_cast<int64_t>(
+                                        readPlyValue(position + i * valueSize, property.type, swapBytes));
+                            }
+                            if (!appendPolygon(indices.data(), valueCount, outData.points.size(),
+                                               outData.triangleVertexIndices)) {
+                                outError = "PLY face " + std::to_string(instance) +
+                                           " references a vertex that does not exist";
+                                return false;
+                            }
+                        }
+                        position += valueSize * valueCount;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+
+    MeshLoader::MeshLoader(unsigned threadCount, size_t chunkSize) : _threadPool(threadCount),
+                                                                     _chunkSize(std::max<size_t>(chunkSize, 1)) {}
+
+    bool MeshLoader::fail(std::string error) {
+        _error = std::move(error);
+        return false;
+    }
+
+    std::vector<MeshLoader::Chunk> MeshLoader::splitIntoChunks(const char* begin, const char* end) const {
+        std::vector<Chunk> chunks;
+        while (begin < end) {
+            const auto* chunkEnd = begin + std::min(_chunkSize, static_cast<size_t>(end - begin));
+            if (chunkEnd < end) {
+                // Extend to the end of the line the cut fell into.
+                const auto* newline = static_cast<const char*>(std::memchr(chunkEnd - 1, '\n', end - chunkEnd + 1));
+                chunkEnd = newline ? newline + 1 : end;
+            }
+            chunks.push_back({begin, chunkEnd});
+            begin = chunkEnd;
+        }
+        return chunks;
+    }
+
+    bool MeshLoader::load(const std::string& path, MeshData& outData) {
+        const auto start = std::chrono::steady_clock::now();
+        MappedFile file;
+        if (!file.open(path)) {
+            return fail(file.getError());
+        }
+
+        const auto* data = file.getData();
+        const auto size = file.getSize();
+        const bool isPly = size >= 4 && std::memcmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r');
+        const auto extension = path.size() >= 4 ? path.substr(path.size() - 4) : std::string();
+        bool loaded;
+        if (isPly) {
+            loaded = loadPly(data, size, outData);
+        } else if (extension == ".obj" || extension == ".OBJ") {
+            loaded = loadObj(data, size, outData);
+        } else {
+            return fail(path + ": neither a PLY nor an OBJ file");
+        }
+        if (!loaded) {
+            _error = path + ": " + _error;
+            return false;
+        }
+        _statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    std::unique_ptr<Mesh> MeshLoader::loadMesh(const std::string& path, const Matrix4f& transform,
+                                               const BvhBuildOptions& bvhOptions, MeshStorage storage) {
+        MeshData data;
+        if (!load(path, data)) {
+            return nullptr;
+        }
+        if (transform != Matrix4f::makeIdentity()) {
+            parallelBatches(_threadPool, data.points.size(), kBinaryBatchSize, [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    const auto& point = data.points[i];
+                    data.points[i] = (transform * Vector4f{point.getX(), point.getY(), point.getZ(), 1.0f}).getXYZ();
+                }
+            });
+        }
+        if (storage == MeshStorage::Compact) {
+            _statistics.duplicatePointCount = removeDuplicatePoints(data);
+        }
+        auto meshBvhOptions = bvhOptions;
+        if (!meshBvhOptions.threadPool) {
+            meshBvhOptions.threadPool = &_threadPool;
+        }
+        return std::make_unique<Mesh>(std::move(data.points), std::move(data.triangleVertexIndices), meshBvhOptions,
+                                      storage);
+    }
+
+    size_t MeshLoader::removeDuplicatePoints(MeshData& data) {
+        // Sorting by coordinates, then index, puts equal points next to each other, lowest index first.
+        std::vector<uint32_t> order(data.points.size());
+        for (uint32_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        const auto less = [&](uint32_t a, uint32_t b) {
+            const auto& pa = data.points[a];
+            const auto& pb = data.points[b];
+            if (pa.getX() != pb.getX()) {
+                return pa.getX() < pb.getX();
+            }
+            if (pa.getY() != pb.getY()) {
+                return pa.getY() < pb.getY();
+            }
+            if (pa.getZ() != pb.getZ()) {
+                return pa.getZ() < pb.getZ();
+            }
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+
+        // Every point maps to the lowest index with the same coordinates.
+        std::vector<uint32_t> firstEqual(data.points.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            const auto& point = data.points[order[i]];
+            const bool sameAsPrevious = i > 0 && data.points[order[i - 1]].getX() == point.getX() &&
+                                        data.points[order[i - 1]].getY() == point.getY() &&
+                                        data.points[order[i - 1]].getZ() == point.getZ();
+            firstEqual[order[i]] = sameAsPrevious ? firstEqual[order[i - 1]] : order[i];
+        }
+
+        std::vector<uint32_t> remap(data.points.size());
+        std::vector<Vector3f> points;
+        points.reserve(data.points.size());
+        for (uint32_t i = 0; i < data.points.size(); ++i) {
+            if (firstEqual[i] == i) {
+                remap[i] = static_cast<uint32_t>(points.size());
+                points.push_back(data.points[i]);
+            } else {
+                remap[i] = remap[firstEqual[i]];
+            }
+        }
+        const auto removedCount = data.points.size() - points.size();
+        if (removedCount == 0) {
+            return 0;
+        }
+        for (auto& triangle: data.triangleVertexIndices) {
+            triangle = Vector3i{static_cast<int>(remap[triangle[0]]),
+                                static_cast<int>(remap[triangle[1]]),
+                                static_cast<int>(remap[triangle[2]])};
+        }
+        data.points = std::move(points);
+        return removedCount;
+    }
+
+    bool MeshLoader::loadPly(const char* data, size_t size, MeshData& outData) {
+        const auto start = std::chrono::steady_clock::now();
+        outData = {};
+        PlyHeader header;
+        std::string error;
+        if (!parsePlyHeader(data, size, header, error)) {
+            return fail(std::move(error));
+        }
+
+        const auto* body = data + header.bodyOffset;
+        const auto* end = data + size;
+        if (header.format != PlyFormat::Ascii) {
+            if (!decodeBinaryPly(header, body, end, _threadPool, outData, error)) {
+                return fail(std::move(error));
+            }
+        } else {
+            // Every non-blank line holds one element instance, so element e covers the lines
+            // [elementStarts[e], elementStarts[e + 1]).
+            std::vector<size_t> elementStarts(header.elements.size() + 1, 0);
+            for (size_t i = 0; i < header.elements.size(); ++i) {
+                elementStarts[i + 1] = elementStarts[i] + header.elements[i].count;
+            }
+
+            const auto chunks = splitIntoChunks(body, end);
+            const auto chunkCount = static_cast<uint32_t>(chunks.size());
+            std::vector<size_t> firstLines(chunks.size() + 1, 0);
+            _threadPool.parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+                size_t lineCount = 0;
+                forEachLine(chunks[chunk].begin, chunks[chunk].end, [&](const char*, const char*) {
+                    ++lineCount;
+                    return true;
+                });
+                firstLines[chunk + 1] = lineCount;
+            });
+            for (size_t i = 0; i < chunks.size(); ++i) {
+                firstLines[i + 1] += firstLines[i];
+            }
+            if (firstLines.back() != elementStarts.back()) {
+                return fail("PLY body has " + std::to_string(firstLines.back()) + " lines, the header declares " +
+                            std::to_string(elementStarts.back()) + " element instances");
+            }
+
+            const auto vertexStart = elementStarts[header.vertexElement];
+            const auto vertexCount = header.elements[header.vertexElement].count;
+            outData.points.resize(vertexCount);
+            std::vector<std::vector<Vector3i>> chunkTriangles(chunks.size());
+            std::vector<std::string> chunkErrors(chunks.size());
+            _threadPool.parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+                auto lineIndex = firstLines[chunk];
+                auto elementIndex = static_cast<size_t>(
+                        std::upper_bound(elementStarts.begin(), elementStarts.end(), lineIndex) -
+                        elementStarts.begin() - 1);
+                std::vector<int64_t> indices;
+                forEachLine(chunks[chunk].begin, chunks[chunk].end, [&](const char* position, const char* lineEnd) {
+                    while (lineIndex >= elementStarts[elementIndex + 1]) {
+                        ++elementIndex;
+                    }
+                    const auto& element = header.elements[elementIndex];
+                    const bool isVertex = static_cast<int>(elementIndex) == header.vertexElement;
+                    const bool isFace = static_cast<int>(elementIndex) == header.faceElement;
+                    const auto lineError = [&]() {
+                        chunkErrors[chunk] = "PLY line " + std::to_string(lineIndex + 1) + " of the body is not a " +
+                                             element.name;
+                        return false;
+                    };
+                    if (isVertex || isFace) {
+                        float coordinates[3] = {};
+                        for (size_t propertyIndex = 0; propertyIndex < element.properties.size(); ++propertyIndex) {
+                            const auto& property = element.properties[propertyIndex];
+                            const auto index = static_cast<int>(propertyIndex);
+                            if (property.isList) {
+                                size_t valueCount = 0;
+                                // Every value takes a separator and a digit, which bounds the count before it is
+                                // used to size anything.
+                                if (!parseNumber(position, lineEnd, valueCount) ||
+                                    valueCount > static_cast<size_t>(lineEnd - position) / 2) {
+                                    return lineError();
+                                }
+                                const bool isIndices = isFace && index == header.indicesProperty;
+                                indices.resize(valueCount);
+                                for (size_t i = 0; i < valueCount; ++i) {
+                                    if (isIndices ? !parseNumber(position, lineEnd, indices[i])
+                                                  : !skipToken(position, lineEnd)) {
+                                        return lineError();
+                                    }
+                                }
+                                if (isIndices && !appendPolygon(indices.data(), valueCount, vertexCount,
+                                                                chunkTriangles[chunk])) {
+                                    chunkErrors[chunk] = "PLY line " + std::to_string(lineIndex + 1) +
+                                                         " references a vertex that does not exist";
+                                    return false;
+                                }
+                            } else if (isVertex && (index == header.xProperty || index == header.yProperty ||
+                                                    index == header.zProperty)) {
+                                const int axis = index == header.xProperty ? 0 : index == header.yProperty ? 1 : 2;
+                                if (!parseNumber(position, lineEnd, coordinates[axis])) {
+                                    return lineError();
+                                }
+                            } else if (!skipToken(position, lineEnd)) {
+                                return lineError();
+                            }
+                        }
+                        if (isVertex) {
+                            outData.points[lineIndex - vertexStart] = {coordinates[0], coordinates[1],
+                                                                       coordinates[2]};
+                        }
+                    }
+                    ++lineIndex;
+                    return true;
+                });
+            });
+            for (const auto& chunkError: chunkErrors) {
+                if (!chunkError.empty()) {
+                    return fail(chunkError);
+                }
+            }
+            for (const auto& triangles: chunkTriangles) {
+                outData.triangleVertexIndices.insert(outData.triangleVertexIndices.end(),
+                                                     triangles.begin(), triangles.end());
+            }
+        }
+
+        _statistics.byteCount = size;
+        _statistics.vertexCount = outData.points.size();
+        _statistics.triangleCount = outData.triangleVertexIndices.size();
+        _statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    bool MeshLoader::loadObj(const char* data, size_t size, MeshData& outData) {
+        const auto start = std::chrono::steady_clock::now();
+        outData = {};
+        const auto chunks = splitIntoChunks(data, data + size);
+        const auto chunkCount = static_cast<uint32_t>(chunks.size());
+
+        // First pass counts the vertices of every chunk, so relative (negative) face indices and the final
+        // vertex positions are known before the parsing pass.
+        std::vector<size_t> vertexStarts(chunks.size() + 1, 0);
+        _threadPool.parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+            size_t vertexCount = 0;
+            forEachLine(chunks[chunk].begin, chunks[chunk].end, [&](const char* begin, const char* end) {
+                vertexCount += getKeyword(begin, end) == "v";
+                return true;
+            });
+            vertexStarts[chunk + 1] = vertexCount;
+        });
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            vertexStarts[i + 1] += vertexStarts[i];
+        }
+
+        const auto vertexCount = vertexStarts.back();
+        outData.points.resize(vertexCount);
+        std::vector<std::vector<Vector3i>> chunkTriangles(chunks.size());
+        std::vector<std::string> chunkErrors(chunks.size());
+        _threadPool.parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+            auto vertexIndex = vertexStarts[chunk];
+            std::vector<int64_t> indices;
+            forEachLine(chunks[chunk].begin, chunks[chunk].end, [&](const char* position, const char* end) {
+                const auto keyword = getKeyword(position, end);
+                position += keyword.size();
+                if (keyword == "v") {
+                    float x, y, z;
+                    if (!parseNumber(position, end, x) || !parseNumber(position, end, y) ||
+                        !parseNumber(position, end, z)) {
+                        chunkErrors[chunk] = "OBJ vertex " + std::to_string(vertexIndex + 1) + " is malformed";
+                        return false;
+                    }
+                    outData.points[vertexIndex++] = {x, y, z};
+                } else if (keyword == "f") {
+                    indices.clear();
+                    for (position = skipSpaces(position, end); position < end; position = skipSpaces(position, end)) {
+                        int64_t index = 0;
+                        if (!parseNumber(position, end, index) || index == 0) {
+                            chunkErrors[chunk] = "OBJ face after vertex " + std::to_string(vertexIndex) +
+                                                 " is malformed";
+                            return false;
+                        }
+                        // Texture and normal indices ("v/vt/vn") are not needed.
+                        skipToken(position, end);
+                        indices.push_back(index > 0 ? index - 1 : static_cast<int64_t>(vertexIndex) + index);
+                    }
+                    if (!appendPolygon(indices.data(), indices.size(), vertexCount, chunkTriangles[chunk])) {
+                        chunkErrors[chunk] = "OBJ face after vertex " + std::to_string(vertexIndex) +
+                                             " references a vertex that does not exist";
+                        return false;
+                    }
+                }
+                return true;
+            });
+        });
+        for (const auto& chunkError: chunkErrors) {
+            if (!chunkError.empty()) {
+                return fail(chunkError);
+            }
+        }
+        for (const auto& triangles: chunkTriangles) {
+            outData.triangleVertexIndices.insert(outData.triangleVertexIndices.end(), triangles.begin(),
+                                                 triangles.end());
+        }
+
+        _statistics.byteCount = size;
+        _statistics.vertexCount = outData.points.size();
+        _statistics.triangleCount = outData.triangleVertexIndices.size();
+        _statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Matrix.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include "Vector.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    struct MeshData {
+        std::vector<Vector3f> points;
+        std::vector<Vector3i> triangleVertexIndices;
+    };
+
+    struct MeshLoadStatistics {
+        size_t byteCount = 0;
+        size_t vertexCount = 0;
+        size_t triangleCount = 0;
+        // Points removed by removeDuplicatePoints during loadMesh.
+        size_t duplicatePointCount = 0;
+        // Wall time from opening the file to decoded geometry, excluding the BVH build.
+        double seconds = 0.0;
+
+        [[nodiscard]] double getMegabytesPerSecond() const {
+            return seconds > 0.0 ? static_cast<double>(byteCount) / 1e6 / seconds : 0.0;
+        }
+    };
+
+    /**
+     * Loads triangle meshes from PLY (ASCII, binary little and big endian) and Wavefront OBJ files.
+     * Files are memory mapped; binary bodies are decoded in place and ASCII bodies are cut into line aligned
+     * chunks that are parsed in parallel. Polygons are triangulated as fans, other PLY elements and
+     * properties and other OBJ statements are skipped.
+     */
+    class MeshLoader {
+    public:
+        static constexpr size_t kDefaultChunkSize = 1 << 20;
+
+        /**
+         * @param threadCount number of parsing threads, 0 uses every hardware thread
+         * @param chunkSize approximate number of ASCII bytes per parallel task
+         */
+        explicit MeshLoader(unsigned threadCount = 0, size_t chunkSize = kDefaultChunkSize);
+
+        /**
+         * Loads a .ply or .obj file; PLY files are recognized by their magic regardless of the extension.
+         * On failure returns false and getError() describes the problem.
+         */
+        bool load(const std::string& path, MeshData& outData);
+
+        /**
+         * Loads path, applies transform to every point and builds the Mesh. Parallel BVH builders run on the
+         * loader's threads unless bvhOptions names a pool. Compact meshes also get their duplicate points
+         * merged. Returns null on failure.
+         */
+        std::unique_ptr<Mesh> loadMesh(const std::string& path,
+                                       const Matrix4f& transform = Matrix4f::makeIdentity(),
+                                       const BvhBuildOptions& bvhOptions = {},
+                                       MeshStorage storage = MeshStorage::Full);
+
+        /**
+         * Merges points with identical coordinates and points the triangles at the first of them, keeping the
+         * order of the remaining points. Returns the number of removed points.
+         */
+        static size_t removeDuplicatePoints(MeshData& data);
+
+        bool loadPly(const char* data, size_t size, MeshData& outData);
+
+        bool loadObj(const char* data, size_t size, MeshData& outData);
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+        [[nodiscard]] const MeshLoadStatistics& getStatistics() const { return _statistics; }
+
+    private:
+        struct Chunk {
+            const char* begin;
+            const char* end;
+        };
+
+        [[nodiscard]] std::vector<Chunk> splitIntoChunks(const char* begin, const char* end) const;
+
+        bool fail(std::string error);
+
+    private:
+        ThreadPool _threadPool;
+        size_t _chunkSize;
+        std::string _error;
+        MeshLoadStatistics _statistics;
+    };
+}
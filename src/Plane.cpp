@@ -1,5 +1,7 @@
 #include "Plane.h"
 
+#include "MathUtils.h"
+
 namespace crt {
     Plane::Plane(const Vector3f &normal,
                  const Vector3f &point,
@@ -14,27 +16,26 @@ namespace crt {
                                                                              _point(std::move(point)) {}
 
     bool Plane::intersect(const Ray &ray, float &t) const {
-        float denom = _normal.dot(ray.getDirection());
-        if (denom < 0) {
-            t = (_point - ray.getOrigin()).dot(_normal) / denom;
-            return t >= 0;
-        }
-        return false;
+        return MathUtils::rayIntersectsPlane(ray, _normal, _point, t);
     }
 
-    bool Plane::hit(const Ray &ray, float tMin, float tMax, HitRecord &outRecord) const {
+    bool Plane::intersect(const Ray &ray, float tMin, float tMax, SurfaceHit &outHit) const {
         float t;
         if (intersect(ray, t) && t >= tMin && t <= tMax) {
-            outRecord.t = t;
-            outRecord.p = ray.getPoint(t);
-            outRecord.normal = _normal;
-            outRecord.material = getMaterial();
-            outRecord.color = getColor(outRecord.p);
+            outHit = {t, 0, 0.0f, 0.0f, this};
             return true;
         }
         return false;
     }
 
+    void Plane::resolveHit(const Ray &ray, float t, uint32_t, float, float, HitRecord &outRecord) const {
+        outRecord.t = t;
+        outRecord.p = ray.getPoint(t);
+        outRecord.normal = _normal;
+        outRecord.material = &getMaterial();
+        outRecord.color = getColor(outRecord.p, ray.getFootprint(t));
+    }
+
     Vector2f Plane::getUV(const Vector3f &p) const {
         // TODO: implement
         return crt::Vector2f();
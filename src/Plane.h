@@ -21,7 +21,23 @@ namespace crt {
 
         bool intersect(const Ray &ray, float &t) const;
 
-        bool hit(const Ray &ray, float tMin, float tMax, HitRecord &outRecord) const override;
+        bool intersect(const Ray &ray, float tMin, float tMax, SurfaceHit &outHit) const override;
+
+        [[nodiscard]] bool occluded(const Ray &ray, float tMin, float tMax) const override {
+            float t;
+            return intersect(ray, t) && t >= tMin && t <= tMax;
+        }
+
+        void hitPacket(RayPacket &packet, PacketHit &outHit) const override {
+            PacketKernels::intersectPlane(packet, outHit, _normal, _point, this);
+        }
+
+        void resolveHit(const Ray &ray, float t, uint32_t primitive, float u, float v,
+                        HitRecord &outRecord) const override;
+
+        bool boundingBox(BoundingBox<float> &) const override {
+            return false;
+        }
 
     private:
         Vector3f _normal;
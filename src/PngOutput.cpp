@@ -0,0 +1,280 @@
+#include "PngOutput.h"
+
+#include <zlib.h>
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    constexpr size_t kWindowSize = 32 * 1024;
+    constexpr size_t kBytesPerPixel = 3;
+
+    enum PngFilter : uint8_t {
+        None = 0,
+        Sub = 1,
+        Up = 2,
+        Average = 3,
+        Paeth = 4,
+    };
+
+    uint8_t paethPredictor(int left, int up, int upLeft) {
+        const auto estimate = left + up - upLeft;
+        const auto distanceLeft = std::abs(estimate - left);
+        const auto distanceUp = std::abs(estimate - up);
+        const auto distanceUpLeft = std::abs(estimate - upLeft);
+        if (distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft) {
+            return static_cast<uint8_t>(left);
+        }
+        return static_cast<uint8_t>(distanceUp <= distanceUpLeft ? up : upLeft);
+    }
+
+    /**
+     * Writes the filter byte and the filtered row into outLine. Tries every filter and keeps the one with the
+     * smallest sum of absolute signed residuals, the usual heuristic of PNG encoders.
+     */
+    void filterRow(const uint8_t* row, const uint8_t* previousRow, size_t rowBytes, uint8_t* outLine,
+                   std::vector<uint8_t>& scratch) {
+        scratch.resize(rowBytes);
+        uint32_t bestCost = UINT32_MAX;
+        for (const auto filter: {None, Sub, Up, Average, Paeth}) {
+            uint32_t cost = 0;
+            for (size_t i = 0; i < rowBytes; ++i) {
+                const int left = i >= kBytesPerPixel ? row[i - kBytesPerPixel] : 0;
+                const int up = previousRow[i];
+                const int upLeft = i >= kBytesPerPixel ? previousRow[i - kBytesPerPixel] : 0;
+                uint8_t prediction = 0;
+                switch (filter) {
+                    case None:
+                        break;
+                    case Sub:
+                        prediction = static_cast<uint8_t>(left);
+                        break;
+                    case Up:
+                        prediction = static_cast<uint8_t>(up);
+                        break;
+                    case Average:
+                        prediction = static_cast<uint8_t>((left + up) / 2);
+                        break;
+                    case Paeth:
+                        prediction = paethPredictor(left, up, upLeft);
+                        break;
+                }
+                const auto residual = static_cast<uint8_t>(row[i] - prediction);
+                scratch[i] = residual;
+                cost += static_cast<uint32_t>(std::abs(static_cast<int8_t>(residual)));
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                outLine[0] = filter;
+                std::memcpy(outLine + 1, scratch.data(), rowBytes);
+            }
+        }
+    }
+
+    void appendBigEndian(std::vector<uint8_t>& buffer, uint32_t value) {
+        buffer.push_back(static_cast<uint8_t>(value >> 24));
+        buffer.push_back(static_cast<uint8_t>(value >> 16));
+        buffer.push_back(static_cast<uint8_t>(value >> 8));
+        buffer.push_back(static_cast<uint8_t>(value));
+    }
+
+    /**
+     * Raw deflates input as one piece of a larger stream. The window starts out with dictionary, the bytes
+     * preceding input in the stream, and the output ends on a byte boundary so pieces can be concatenated.
+     */
+    bool deflateChunk(const uint8_t* input, size_t inputSize, const uint8_t* dictionary, size_t dictionarySize,
+                      int level, bool last, std::vector<uint8_t>& output) {
+        z_stream stream{};
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        bool succeeded = dictionarySize == 0 ||
+                         deflateSetDictionary(&stream, dictionary, static_cast<uInt>(dictionarySize)) == Z_OK;
+        // The bound does not cover the empty block a sync flush appends, the loop grows the buffer if needed.
+        output.resize(deflateBound(&stream, static_cast<uLong>(inputSize)) + 16);
+        stream.next_in = const_cast<Bytef*>(input);
+        stream.avail_in = static_cast<uInt>(inputSize);
+        size_t written = 0;
+        while (succeeded) {
+            stream.next_out = output.data() + written;
+            stream.avail_out = static_cast<uInt>(output.size() - written);
+            const auto result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+            written = output.size() - stream.avail_out;
+            if (result == Z_STREAM_END || (result == Z_OK && !last && stream.avail_out != 0)) {
+                break;
+            }
+            succeeded = result == Z_OK || result == Z_BUF_ERROR;
+            output.resize(output.size() * 2);
+        }
+        output.resize(written);
+        deflateEnd(&stream);
+        return succeeded;
+    }
+}
+
+crt::PngOutput::PngOutput(std::string path, int compressionLevel, unsigned threadCount)
+        : _path(std::move(path)), _compressionLevel(compressionLevel), _threadPool(threadCount) {}
+
+crt::PngOutput::~PngOutput() {
+    closeFile();
+}
+
+void crt::PngOutput::closeFile() {
+    if (_file) {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+}
+
+bool crt::PngOutput::begin(const SizeI& imageSize) {
+    static_assert(kChunkSize >= kWindowSize, "chunks take their dictionary from the previous chunk only");
+    if (imageSize.getWidth() <= 0 || imageSize.getHeight() <= 0) {
+        return fail("empty image");
+    }
+    if (_compressionLevel < 0 || _compressionLevel > 9) {
+        return fail("compression level must be between 0 and 9");
+    }
+    closeFile();
+    _file = std::fopen(_path.c_str(), "wb");
+    if (!_file) {
+        return fail("cannot open " + _path);
+    }
+    _width = imageSize.getWidth();
+    _height = imageSize.getHeight();
+    _nextRow = 0;
+    _previousRow.assign(static_cast<size_t>(imageSize.getWidth()) * kBytesPerPixel, 0);
+    _dictionary.clear();
+    _adler = adler32(0, Z_NULL, 0);
+
+    static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (std::fwrite(signature, sizeof(signature), 1, _file) != 1) {
+        return fail("cannot write " + _path);
+    }
+    std::vector<uint8_t> header;
+    appendBigEndian(header, static_cast<uint32_t>(imageSize.getWidth()));
+    appendBigEndian(header, static_cast<uint32_t>(imageSize.getHeight()));
+    // 8 bits per channel, RGB, deflate, adaptive filtering, not interlaced.
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    return writeChunk("IHDR", {&header});
+}
+
+bool crt::PngOutput::writeRows(int y, int rowCount, const Vector3f* pixels) {
+    if (!_file || y != _nextRow || rowCount <= 0 || y + rowCount > _height) {
+        return fail("rows must be written in order");
+    }
+    const auto width = static_cast<size_t>(_width);
+    const auto rowBytes = width * kBytesPerPixel;
+    const auto lineBytes = rowBytes + 1;
+
+    std::vector<uint8_t> rows(rowCount * rowBytes);
+    _threadPool.parallelFor(rowCount, [&](uint32_t row, unsigned) {
+        const auto* source = pixels + row * width;
+        auto* target = rows.data() + row * rowBytes;
+        for (size_t x = 0; x < width; ++x) {
+            target[x * 3 + 0] = toUnorm8(source[x].getX());
+            target[x * 3 + 1] = toUnorm8(source[x].getY());
+            target[x * 3 + 2] = toUnorm8(source[x].getZ());
+        }
+    });
+    std::vector<uint8_t> filtered(rowCount * lineBytes);
+    _threadPool.parallelFor(rowCount, [&](uint32_t row, unsigned) {
+        thread_local std::vector<uint8_t> scratch;
+        const auto* previousRow = row == 0 ? _previousRow.data() : rows.data() + (row - 1) * rowBytes;
+        filterRow(rows.data() + row * rowBytes, previousRow, rowBytes, filtered.data() + row * lineBytes, scratch);
+    });
+
+    const bool lastBand = y + rowCount == _height;
+    const auto chunkCount = static_cast<uint32_t>((filtered.size() + kChunkSize - 1) / kChunkSize);
+    std::vector<std::vector<uint8_t>> compressed(chunkCount);
+    std::vector<uLong> chunkAdlers(chunkCount);
+    std::vector<uint8_t> chunkSucceeded(chunkCount);
+    _threadPool.parallelFor(chunkCount, [&](uint32_t chunk, unsigned) {
+        const auto begin = chunk * kChunkSize;
+        const auto size = std::min(kChunkSize, filtered.size() - begin);
+        const auto* dictionary = chunk == 0 ? _dictionary.data() : filtered.data() + begin - kWindowSize;
+        const auto dictionarySize = chunk == 0 ? _dictionary.size() : kWindowSize;
+        chunkSucceeded[chunk] = deflateChunk(filtered.data() + begin, size, dictionary, dictionarySize,
+                                             _compressionLevel, lastBand && chunk + 1 == chunkCount,
+                                             compressed[chunk]);
+        chunkAdlers[chunk] = adler32(adler32(0, Z_NULL, 0), filtered.data() + begin, static_cast<uInt>(size));
+    });
+    for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+        if (!chunkSucceeded[chunk]) {
+            return fail("deflate failed");
+        }
+        const auto size = std::min(kChunkSize, filtered.size() - chunk * kChunkSize);
+        _adler = adler32_combine(_adler, chunkAdlers[chunk], static_cast<z_off_t>(size));
+    }
+
+    std::vector<uint8_t> prefix;
+    if (y == 0) {
+        // zlib header: deflate with a 32 KiB window, the level hint, and the check bits.
+        const uint8_t levelHint = _compressionLevel < 2 ? 0
+                                  : _compressionLevel < 6 ? 1
+                                  : _compressionLevel == 6 ? 2 : 3;
+        const uint8_t method = 0x78;
+        auto flags = static_cast<uint8_t>(levelHint << 6);
+        flags = static_cast<uint8_t>(flags + 31 - (method * 256 + flags) % 31);
+        prefix = {method, flags};
+    }
+    std::vector<uint8_t> suffix;
+    if (lastBand) {
+        appendBigEndian(suffix, static_cast<uint32_t>(_adler));
+    }
+    std::vector<const std::vector<uint8_t>*> parts{&prefix};
+    for (const auto& chunk: compressed) {
+        parts.push_back(&chunk);
+    }
+    parts.push_back(&suffix);
+    if (!writeChunk("IDAT", parts)) {
+        return false;
+    }
+
+    std::memcpy(_previousRow.data(), rows.data() + (rowCount - 1) * rowBytes, rowBytes);
+    if (filtered.size() >= kWindowSize) {
+        _dictionary.assign(filtered.end() - kWindowSize, filtered.end());
+    } else {
+        _dictionary.insert(_dictionary.end(), filtered.begin(), filtered.end());
+        if (_dictionary.size() > kWindowSize) {
+            _dictionary.erase(_dictionary.begin(), _dictionary.end() - kWindowSize);
+        }
+    }
+    _nextRow += rowCount;
+    return true;
+}
+
+bool crt::PngOutput::end() {
+    if (!_file || _nextRow != _height) {
+        closeFile();
+        return fail("image is incomplete");
+    }
+    if (!writeChunk("IEND", {})) {
+        closeFile();
+        return false;
+    }
+    const bool closed = std::fclose(_file) == 0;
+    _file = nullptr;
+    return closed || fail("cannot write " + _path);
+}
+
+bool crt::PngOutput::writeChunk(const char* type, const std::vector<const std::vector<uint8_t>*>& parts) {
+    uint32_t length = 0;
+    for (const auto* part: parts) {
+        length += static_cast<uint32_t>(part->size());
+    }
+    std::vector<uint8_t> header;
+    appendBigEndian(header, length);
+    header.insert(header.end(), type, type + 4);
+    auto crc = crc32(0, header.data() + 4, 4);
+    bool succeeded = std::fwrite(header.data(), header.size(), 1, _file) == 1;
+    for (const auto* part: parts) {
+        if (!part->empty()) {
+            crc = crc32(crc, part->data(), static_cast<uInt>(part->size()));
+            succeeded = succeeded && std::fwrite(part->data(), part->size(), 1, _file) == 1;
+        }
+    }
+    std::vector<uint8_t> trailer;
+    appendBigEndian(trailer, static_cast<uint32_t>(crc));
+    succeeded = succeeded && std::fwrite(trailer.data(), trailer.size(), 1, _file) == 1;
+    return succeeded || fail("cannot write " + _path);
+}
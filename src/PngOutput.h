@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ImageOutput.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Streaming 8-bit RGB PNG writer. Every band of rows is filtered, cut into chunks and deflated on a thread
+     * pool; each chunk is primed with the 32 KiB before it, so the result compresses almost as well as a serial
+     * deflate while the file only ever holds one band in memory.
+     */
+    class PngOutput : public ImageOutput {
+    public:
+        static constexpr int kDefaultCompressionLevel = 6;
+        // Uncompressed bytes per deflate task.
+        static constexpr size_t kChunkSize = 64 * 1024;
+
+        /**
+         * @param compressionLevel zlib level, 0 stores the data uncompressed and 9 compresses best
+         * @param threadCount compression threads, 0 uses every hardware thread
+         */
+        explicit PngOutput(std::string path, int compressionLevel = kDefaultCompressionLevel,
+                           unsigned threadCount = 0);
+
+        ~PngOutput() override;
+
+        bool begin(const SizeI& imageSize) override;
+
+        bool writeRows(int y, int rowCount, const Vector3f* pixels) override;
+
+        bool end() override;
+
+    private:
+        bool writeChunk(const char* type, const std::vector<const std::vector<uint8_t>*>& parts);
+
+        void closeFile();
+
+    private:
+        std::string _path;
+        int _compressionLevel;
+        ThreadPool _threadPool;
+        FILE* _file = nullptr;
+        int _width = 0;
+        int _height = 0;
+        int _nextRow = 0;
+        // Unfiltered bytes of the last row written, the filters of the next band predict from it.
+        std::vector<uint8_t> _previousRow;
+        // Tail of the filtered stream so far, primes the first chunk of the next band.
+        std::vector<uint8_t> _dictionary;
+        unsigned long _adler = 1;
+    };
+}
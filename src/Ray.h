@@ -5,10 +5,15 @@
 namespace crt {
     class Ray {
     public:
-        constexpr Ray(const Vector3f& origin, const Vector3f& direction) : _origin(origin), _direction(direction) {}
+        /**
+         * @param spreadAngle opening angle of the cone the ray stands for, e.g. the angle one pixel covers for
+         *        camera rays. 0 treats the ray as infinitely thin.
+         */
+        constexpr Ray(const Vector3f& origin, const Vector3f& direction, float spreadAngle = 0.0f)
+                : _origin(origin), _direction(direction), _spreadAngle(spreadAngle) {}
 
-        constexpr Ray(Vector3f&& origin, Vector3f&& direction) : _origin(std::move(origin)),
-                                                                 _direction(std::move(direction)) {}
+        constexpr Ray(Vector3f&& origin, Vector3f&& direction, float spreadAngle = 0.0f)
+                : _origin(std::move(origin)), _direction(std::move(direction)), _spreadAngle(spreadAngle) {}
 
         [[nodiscard]] constexpr const Vector3f& getOrigin() const {
             return _origin;
@@ -18,12 +23,24 @@ namespace crt {
             return _direction;
         }
 
-        [[nodiscard]] constexpr Vector3f getPoint(float t) const {
+        [[nodiscard]] Vector3f getPoint(float t) const {
             return _origin + _direction * t;
         }
 
+        [[nodiscard]] constexpr float getSpreadAngle() const {
+            return _spreadAngle;
+        }
+
+        /**
+         * Width of the ray cone at distance t, used to filter textures.
+         */
+        [[nodiscard]] constexpr float getFootprint(float t) const {
+            return _spreadAngle * t;
+        }
+
     private:
         Vector3f _origin;
         Vector3f _direction;
+        float _spreadAngle;
     };
 }
\ No newline at end of file
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "Simd.h"
+#include "Statistics.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace crt {
+
+    class Surface;
+
+    /**
+     * Structure-of-arrays bundle of up to kMaxSize rays, traced together through the scene. The active size is
+     * 4, 8 or 16; lanes past it and lanes without a ray carry an empty [tMin, tMax] interval, so every kernel
+     * rejects them without an explicit mask. tMax shrinks to the closest hit found so far.
+     */
+    struct RayPacket {
+        static constexpr int kMaxSize = 16;
+
+        alignas(32) float originX[kMaxSize];
+        alignas(32) float originY[kMaxSize];
+        alignas(32) float originZ[kMaxSize];
+        alignas(32) float directionX[kMaxSize];
+        alignas(32) float directionY[kMaxSize];
+        alignas(32) float directionZ[kMaxSize];
+        alignas(32) float invDirectionX[kMaxSize];
+        alignas(32) float invDirectionY[kMaxSize];
+        alignas(32) float invDirectionZ[kMaxSize];
+        alignas(32) float tMin[kMaxSize];
+        alignas(32) float tMax[kMaxSize];
+        float spreadAngle[kMaxSize];
+        int size = kMaxSize;
+
+        explicit RayPacket(int packetSize = kMaxSize) {
+            reset(packetSize);
+        }
+
+        void reset(int packetSize) {
+            size = packetSize;
+            for (int lane = 0; lane < kMaxSize; ++lane) {
+                setRay(lane, Ray{Vector3f{0.0f, 0.0f, 0.0f}, Vector3f{1.0f, 1.0f, 1.0f}},
+                       std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+            }
+        }
+
+        void setRay(int lane, const Ray& ray, float laneTMin, float laneTMax) {
+            const auto& origin = ray.getOrigin();
+            const auto& direction = ray.getDirection();
+            originX[lane] = origin.getX();
+            originY[lane] = origin.getY();
+            originZ[lane] = origin.getZ();
+            directionX[lane] = direction.getX();
+            directionY[lane] = direction.getY();
+            directionZ[lane] = direction.getZ();
+            invDirectionX[lane] = 1.0f / direction.getX();
+            invDirectionY[lane] = 1.0f / direction.getY();
+            invDirectionZ[lane] = 1.0f / direction.getZ();
+            tMin[lane] = laneTMin;
+            tMax[lane] = laneTMax;
+            spreadAngle[lane] = ray.getSpreadAngle();
+        }
+
+        [[nodiscard]] Ray getRay(int lane) const {
+            return {Vector3f{originX[lane], originY[lane], originZ[lane]},
+                    Vector3f{directionX[lane], directionY[lane], directionZ[lane]},
+                    spreadAngle[lane]};
+        }
+
+        [[nodiscard]] bool isActive(int lane) const {
+            return tMin[lane] <= tMax[lane];
+        }
+
+        /**
+         * Number of SIMD groups covering the active size.
+         */
+        [[nodiscard]] int getGroupCount() const {
+            return (size + kSimdWidth - 1) / kSimdWidth;
+        }
+    };
+
+    /**
+     * Closest hit per lane of a RayPacket. The hit distance is the lane's tMax; surface is null for misses.
+     */
+    struct PacketHit {
+        const Surface* surface[RayPacket::kMaxSize];
+        uint32_t primitive[RayPacket::kMaxSize];
+        alignas(32) float u[RayPacket::kMaxSize];
+        alignas(32) float v[RayPacket::kMaxSize];
+
+        PacketHit() {
+            reset();
+        }
+
+        void reset() {
+            for (int lane = 0; lane < RayPacket::kMaxSize; ++lane) {
+                surface[lane] = nullptr;
+                primitive[lane] = 0;
+                u[lane] = 0.0f;
+                v[lane] = 0.0f;
+            }
+        }
+
+        /**
+         * Records a hit for the lanes in mask; t, u and v are the kernel results of SIMD group `group`.
+         */
+        template<int Width>
+        void update(RayPacket& packet, int group, const SimdMask<Width>& mask, const SimdFloat<Width>& t,
+                    const SimdFloat<Width>& hitU, const SimdFloat<Width>& hitV,
+                    const Surface* hitSurface, uint32_t hitPrimitive) {
+            const auto offset = group * Width;
+            select(mask, t, SimdFloat<Width>::load(packet.tMax + offset)).store(packet.tMax + offset);
+            select(mask, hitU, SimdFloat<Width>::load(u + offset)).store(u + offset);
+            select(mask, hitV, SimdFloat<Width>::load(v + offset)).store(v + offset);
+            for (auto bits = mask.getBits(); bits != 0; bits &= bits - 1) {
+                const auto lane = offset + __builtin_ctz(bits);
+                surface[lane] = hitSurface;
+                primitive[lane] = hitPrimitive;
+            }
+        }
+    };
+
+    /**
+     * SIMD intersection kernels working on a whole RayPacket, kSimdWidth lanes at a time.
+     */
+    namespace PacketKernels {
+        using Float = SimdFloatN;
+        using Mask = SimdMaskN;
+
+        /**
+         * True if any active lane enters the box before its current closest hit.
+         */
+        inline bool intersectBounds(const RayPacket& packet, const BoundingBox<float>& bounds) {
+            CRT_COUNT(boxTests, 1);
+            constexpr float kRobustness = 1.0f + 3.0f * std::numeric_limits<float>::epsilon();
+            const auto& boundsMin = bounds.getMin();
+            const auto& boundsMax = bounds.getMax();
+            const Float minX(boundsMin.getX()), minY(boundsMin.getY()), minZ(boundsMin.getZ());
+            const Float maxX(boundsMax.getX()), maxY(boundsMax.getY()), maxZ(boundsMax.getZ());
+            for (int group = 0; group < packet.getGroupCount(); ++group) {
+                const auto offset = group * kSimdWidth;
+                const auto originX = Float::load(packet.originX + offset);
+                const auto originY = Float::load(packet.originY + offset);
+                const auto originZ = Float::load(packet.originZ + offset);
+                const auto invDirectionX = Float::load(packet.invDirectionX + offset);
+                const auto invDirectionY = Float::load(packet.invDirectionY + offset);
+                const auto invDirectionZ = Float::load(packet.invDirectionZ + offset);
+
+                const auto t0X = (minX - originX) * invDirectionX;
+                const auto t1X = (maxX - originX) * invDirectionX;
+                const auto t0Y = (minY - originY) * invDirectionY;
+                const auto t1Y = (maxY - originY) * invDirectionY;
+                const auto t0Z = (minZ - originZ) * invDirectionZ;
+                const auto t1Z = (maxZ - originZ) * invDirectionZ;
+
+                // The slab terms come first so a NaN slab (origin on the plane, parallel ray) is ignored.
+                auto tNear = Float::load(packet.tMin + offset);
+                tNear = max(min(t0X, t1X), tNear);
+                tNear = max(min(t0Y, t1Y), tNear);
+                tNear = max(min(t0Z, t1Z), tNear);
+                auto tFar = Float::load(packet.tMax + offset);
+                tFar = min(max(t0X, t1X) * Float(kRobustness), tFar);
+                tFar = min(max(t0Y, t1Y) * Float(kRobustness), tFar);
+                tFar = min(max(t0Z, t1Z) * Float(kRobustness), tFar);
+                if ((tNear <= tFar).any()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Möller-Trumbore against every lane, mirrors MathUtils::rayIntersectsTriangle. Accepts tMin < t < tMax.
+         */
+        inline void intersectTriangle(RayPacket& packet, PacketHit& hit,
+                                      const Vector3f& v0, const Vector3f& v1, const Vector3f& v2,
+                                      const Surface* surface, uint32_t primitive) {
+            CRT_COUNT(triangleTests, 1);
+            const auto edge1 = v1 - v0;
+            const auto edge2 = v2 - v0;
+            const Float edge1X(edge1.getX()), edge1Y(edge1.getY()), edge1Z(edge1.getZ());
+            const Float edge2X(edge2.getX()), edge2Y(edge2.getY()), edge2Z(edge2.getZ());
+            const Float v0X(v0.getX()), v0Y(v0.getY()), v0Z(v0.getZ());
+            const Float zero(0.0f);
+            const Float one(1.0f);
+            const Float epsilon(std::numeric_limits<float>::epsilon());
+            for (int group = 0; group < packet.getGroupCount(); ++group) {
+                const auto offset = group * kSimdWidth;
+                const auto directionX = Float::load(packet.directionX + offset);
+                const auto directionY = Float::load(packet.directionY + offset);
+                const auto directionZ = Float::load(packet.directionZ + offset);
+
+                const auto pX = directionY * edge2Z - directionZ * edge2Y;
+                const auto pY = directionZ * edge2X - directionX * edge2Z;
+                const auto pZ = directionX * edge2Y - directionY * edge2X;
+                const auto det = edge1X * pX + edge1Y * pY + edge1Z * pZ;
+                const auto invDet = one / det;
+
+                const auto tX = Float::load(packet.originX + offset) - v0X;
+                const auto tY = Float::load(packet.originY + offset) - v0Y;
+                const auto tZ = Float::load(packet.originZ + offset) - v0Z;
+                const auto u = (tX * pX + tY * pY + tZ * pZ) * invDet;
+
+                const auto qX = tY * edge1Z - tZ * edge1Y;
+                const auto qY = tZ * edge1X - tX * edge1Z;
+                const auto qZ = tX * edge1Y - tY * edge1X;
+                const auto v = (directionX * qX + directionY * qY + directionZ * qZ) * invDet;
+                const auto t = (edge2X * qX + edge2Y * qY + edge2Z * qZ) * invDet;
+
+                const auto mask = (abs(det) >= epsilon) & (u >= zero) & (u <= one) & (v >= zero) & (u + v <= one) &
+                                  (t > Float::load(packet.tMin + offset)) & (t < Float::load(packet.tMax + offset));
+                if (mask.any()) {
+                    hit.update(packet, group, mask, t, u, v, surface, primitive);
+                }
+            }
+        }
+
+        /**
+         * Mirrors Sphere::intersect: the nearest non-negative root, which must then lie in [tMin, tMax].
+         */
+        inline void intersectSphere(RayPacket& packet, PacketHit& hit, const Vector3f& center, float radius,
+                                    const Surface* surface) {
+            CRT_COUNT(primitiveTests, 1);
+            const Float centerX(center.getX()), centerY(center.getY()), centerZ(center.getZ());
+            const Float radiusSquared(radius * radius);
+            const Float zero(0.0f);
+            const Float two(2.0f);
+            const Float four(4.0f);
+            for (int group = 0; group < packet.getGroupCount(); ++group) {
+                const auto offset = group * kSimdWidth;
+                const auto directionX = Float::load(packet.directionX + offset);
+                const auto directionY = Float::load(packet.directionY + offset);
+                const auto directionZ = Float::load(packet.directionZ + offset);
+                const auto ocX = Float::load(packet.originX + offset) - centerX;
+                const auto ocY = Float::load(packet.originY + offset) - centerY;
+                const auto ocZ = Float::load(packet.originZ + offset) - centerZ;
+
+                const auto a = directionX * directionX + directionY * directionY + directionZ * directionZ;
+                const auto b = two * (ocX * directionX + ocY * directionY + ocZ * directionZ);
+                const auto c = ocX * ocX + ocY * ocY + ocZ * ocZ - radiusSquared;
+                const auto discriminant = b * b - four * a * c;
+                const auto sqrtDiscriminant = sqrt(max(discriminant, zero));
+                const auto twoA = two * a;
+                const auto t1 = (zero - b - sqrtDiscriminant) / twoA;
+                const auto t2 = (zero - b + sqrtDiscriminant) / twoA;
+                const auto t = select(t1 >= zero, t1, t2);
+
+                const auto mask = (discriminant >= zero) & (t >= zero) &
+                                  (t >= Float::load(packet.tMin + offset)) & (t <= Float::load(packet.tMax + offset));
+                if (mask.any()) {
+                    hit.update(packet, group, mask, t, zero, zero, surface, 0);
+                }
+            }
+        }
+
+        /**
+         * Mirrors Plane::intersect: only the front side, t >= 0, within [tMin, tMax].
+         */
+        inline void intersectPlane(RayPacket& packet, PacketHit& hit, const Vector3f& normal, const Vector3f& point,
+                                   const Surface* surface) {
+            CRT_COUNT(primitiveTests, 1);
+            const Float normalX(normal.getX()), normalY(normal.getY()), normalZ(normal.getZ());
+            const Float pointX(point.getX()), pointY(point.getY()), pointZ(point.getZ());
+            const Float zero(0.0f);
+            for (int group = 0; group < packet.getGroupCount(); ++group) {
+                const auto offset = group * kSimdWidth;
+                const auto denominator = normalX * Float::load(packet.directionX + offset) +
+                                         normalY * Float::load(packet.directionY + offset) +
+                                         normalZ * Float::load(packet.directionZ + offset);
+                const auto t = ((pointX - Float::load(packet.originX + offset)) * normalX +
+                                (pointY - Float::load(packet.originY + offset)) * normalY +
+                                (pointZ - Float::load(packet.originZ + offset)) * normalZ) / denominator;
+
+                const auto mask = (denominator < zero) & (t >= zero) &
+                                  (t >= Float::load(packet.tMin + offset)) & (t <= Float::load(packet.tMax + offset));
+                if (mask.any()) {
+                    hit.update(packet, group, mask, t, zero, zero, surface, 0);
+                }
+            }
+        }
+    }
+}
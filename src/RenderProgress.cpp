@@ -0,0 +1,100 @@
+#include "RenderProgress.h"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace crt {
+    namespace {
+        void printDuration(std::ostream& output, double seconds) {
+            const auto total = static_cast<long long>(seconds + 0.5);
+            output << std::setfill('0') << std::setw(2) << total / 3600 << ':'
+                   << std::setw(2) << (total / 60) % 60 << ':'
+                   << std::setw(2) << total % 60 << std::setfill(' ');
+        }
+    }
+
+    RenderProgress::~RenderProgress() {
+        if (_reporter.joinable()) {
+            end();
+        }
+    }
+
+    void RenderProgress::begin(size_t tileCount, uint64_t totalPixelCount) {
+        if (_reporter.joinable()) {
+            end();
+        }
+        _tileCounters = std::make_unique<TileCounter[]>(tileCount);
+        _tileCount = tileCount;
+        _totalPixelCount = totalPixelCount;
+        _startTime = Clock::now();
+        _stopping = false;
+        if (!_quiet) {
+            _reporter = std::thread(&RenderProgress::reportLoop, this);
+        }
+    }
+
+    void RenderProgress::end() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _stopCondition.notify_all();
+        if (_reporter.joinable()) {
+            _reporter.join();
+        }
+        if (_quiet) {
+            return;
+        }
+
+        const auto seconds = std::chrono::duration<double>(Clock::now() - _startTime).count();
+        const auto rays = getRayCount();
+        _output << "Rendered " << getPixelCount() << " pixels, " << rays << " rays in "
+                << std::fixed << std::setprecision(2) << seconds << " s ("
+                << (seconds > 0.0 ? static_cast<double>(rays) / seconds / 1e6 : 0.0) << " Mrays/s)"
+                << std::defaultfloat << std::endl;
+    }
+
+    uint64_t RenderProgress::getPixelCount() const {
+        uint64_t pixels = 0;
+        for (size_t i = 0; i < _tileCount; ++i) {
+            pixels += _tileCounters[i].pixels.load(std::memory_order_relaxed);
+        }
+        return pixels;
+    }
+
+    uint64_t RenderProgress::getRayCount() const {
+        uint64_t rays = 0;
+        for (size_t i = 0; i < _tileCount; ++i) {
+            rays += _tileCounters[i].rays.load(std::memory_order_relaxed);
+        }
+        return rays;
+    }
+
+    void RenderProgress::reportLoop() {
+        auto lastTime = _startTime;
+        uint64_t lastRays = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stopCondition.wait_for(lock, _reportInterval, [this]() { return _stopping; })) {
+            const auto now = Clock::now();
+            const auto pixels = getPixelCount();
+            const auto rays = getRayCount();
+            const auto elapsed = std::chrono::duration<double>(now - _startTime).count();
+            const auto interval = std::chrono::duration<double>(now - lastTime).count();
+            const auto total = getTotalPixelCount();
+            const auto fraction = total > 0 ? std::min(1.0, static_cast<double>(pixels) / static_cast<double>(total))
+                                            : 1.0;
+
+            _output << "Rendering " << std::fixed << std::setprecision(1) << std::setw(5) << fraction * 100.0 << "% | "
+                    << std::setprecision(2) << static_cast<double>(rays - lastRays) / interval / 1e6 << " Mrays/s | ETA ";
+            if (pixels > 0) {
+                printDuration(_output, elapsed * (1.0 - fraction) / fraction);
+            } else {
+                _output << "--:--:--";
+            }
+            _output << std::defaultfloat << '\n' << std::flush;
+
+            lastTime = now;
+            lastRays = rays;
+        }
+    }
+}
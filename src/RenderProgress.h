@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace crt {
+
+    /**
+     * Render progress and throughput telemetry. Render workers only bump relaxed atomic counters of the tile they
+     * are shading; a single reporter thread sums them up and prints a throttled status line.
+     */
+    class RenderProgress {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::milliseconds kDefaultReportInterval{500};
+
+        explicit RenderProgress(std::ostream& output = std::cout,
+                                std::chrono::milliseconds reportInterval = kDefaultReportInterval)
+                : _output(output), _reportInterval(reportInterval) {}
+
+        ~RenderProgress();
+
+        RenderProgress(const RenderProgress&) = delete;
+
+        RenderProgress& operator=(const RenderProgress&) = delete;
+
+        /**
+         * Quiet mode keeps the counters but never prints, for batch jobs.
+         */
+        void setQuiet(bool quiet) {
+            _quiet = quiet;
+        }
+
+        [[nodiscard]] bool isQuiet() const {
+            return _quiet;
+        }
+
+        /**
+         * Resets the counters and starts the reporter thread. Called by the renderer before the first tile.
+         */
+        void begin(size_t tileCount, uint64_t totalPixelCount);
+
+        /**
+         * Lowers the expected total by work that turned out not to be needed, such as the samples left of pixels
+         * that converged early, so the percentage and ETA follow the work actually done.
+         */
+        void removeFromTotal(uint64_t pixelCount) {
+            _totalPixelCount.fetch_sub(pixelCount, std::memory_order_relaxed);
+        }
+
+        void addPixels(uint32_t tileIndex, uint32_t pixelCount, uint64_t rayCount) {
+            auto& counter = _tileCounters[tileIndex];
+            counter.pixels.fetch_add(pixelCount, std::memory_order_relaxed);
+            counter.rays.fetch_add(rayCount, std::memory_order_relaxed);
+        }
+
+        /**
+         * Stops the reporter thread and prints the summary of the whole render.
+         */
+        void end();
+
+        [[nodiscard]] uint64_t getPixelCount() const;
+
+        [[nodiscard]] uint64_t getRayCount() const;
+
+        [[nodiscard]] uint64_t getTotalPixelCount() const {
+            return _totalPixelCount.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct alignas(64) TileCounter {
+            std::atomic<uint64_t> pixels{0};
+            std::atomic<uint64_t> rays{0};
+        };
+
+        void reportLoop();
+
+    private:
+        std::ostream& _output;
+        std::chrono::milliseconds _reportInterval;
+        bool _quiet = false;
+
+        std::unique_ptr<TileCounter[]> _tileCounters;
+        size_t _tileCount = 0;
+        std::atomic<uint64_t> _totalPixelCount{0};
+        Clock::time_point _startTime;
+
+        std::thread _reporter;
+        std::mutex _mutex;
+        std::condition_variable _stopCondition;
+        bool _stopping = false;
+    };
+}
@@ -0,0 +1,314 @@
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace crt {
+    namespace {
+        // Keeps the even bits of a Morton code, i.e. extracts one coordinate.
+        uint32_t compactBits(uint32_t code) {
+            code &= 0x55555555u;
+            code = (code ^ (code >> 1)) & 0x33333333u;
+            code = (code ^ (code >> 2)) & 0x0f0f0f0fu;
+            code = (code ^ (code >> 4)) & 0x00ff00ffu;
+            code = (code ^ (code >> 8)) & 0x0000ffffu;
+            return code;
+        }
+    }
+
+    Renderer::Renderer(unsigned threadCount, int tileSize) : _tileSize(tileSize), _threadPool(threadCount) {
+        assert(tileSize > 0 && (tileSize & (tileSize - 1)) == 0);
+        const auto pixelCount = static_cast<uint32_t>(tileSize * tileSize);
+        _mortonOffsets.reserve(pixelCount);
+        for (uint32_t code = 0; code < pixelCount; ++code) {
+            _mortonOffsets.emplace_back(static_cast<uint16_t>(compactBits(code)),
+                                        static_cast<uint16_t>(compactBits(code >> 1)));
+        }
+    }
+
+    std::vector<RenderTile> Renderer::makeTiles(const SizeI& imageSize) const {
+        std::vector<RenderTile> tiles;
+        for (int y = 0; y < imageSize.getHeight(); y += _tileSize) {
+            for (int x = 0; x < imageSize.getWidth(); x += _tileSize) {
+                tiles.push_back({static_cast<uint32_t>(tiles.size()),
+                                 x,
+                                 y,
+                                 std::min(_tileSize, imageSize.getWidth() - x),
+                                 std::min(_tileSize, imageSize.getHeight() - y)});
+            }
+        }
+        return tiles;
+    }
+
+    void Renderer::forEachPixel(const RenderTile& tile, const std::function<void(int x, int y)>& pixelFunction) const {
+        for (const auto& [offsetX, offsetY]: _mortonOffsets) {
+            // Partial tiles at the right and bottom image border skip the offsets outside the image.
+            if (offsetX < tile.width && offsetY < tile.height) {
+                pixelFunction(tile.x + offsetX, tile.y + offsetY);
+            }
+        }
+    }
+
+    void Renderer::renderTiles(const std::vector<RenderTile>& tiles, const TileFunction& tileFunction) {
+        _threadPool.parallelFor(static_cast<uint32_t>(tiles.size()), [&](uint32_t taskIndex, unsigned workerIndex) {
+            tileFunction(tiles[taskIndex], workerIndex);
+        });
+    }
+
+    namespace {
+        void writePixel(uint8_t* outputRGB, int width, int x, int y, const Vector3f& color) {
+            auto* pixel = outputRGB + (static_cast<size_t>(y) * width + x) * 3;
+            pixel[0] = toUnorm8(color.getX());
+            pixel[1] = toUnorm8(color.getY());
+            pixel[2] = toUnorm8(color.getZ());
+        }
+    }
+
+    template<typename Store>
+    void Renderer::shadeTile(const RenderTile& tile, unsigned workerIndex, const PixelFunction& pixelFunction,
+                             RenderProgress* progress, const Store& store) const {
+        forEachPixel(tile, [&](int x, int y) {
+            PixelContext context{workerIndex, tile.index, 0};
+            const auto color = pixelFunction(x, y, context);
+            if (progress) {
+                progress->addPixels(tile.index, 1, context.rayCount);
+            }
+            store(x, y, color);
+        });
+    }
+
+    template<typename Store>
+    void Renderer::shadeTile(const RenderTile& tile, unsigned workerIndex, int packetSize,
+                             const PacketFunction& packetFunction, RenderProgress* progress,
+                             const Store& store) const {
+        std::vector<PixelCoordinate> pixels(packetSize);
+        std::vector<Vector3f> colors(packetSize);
+        for (size_t first = 0; first < _mortonOffsets.size(); first += packetSize) {
+            int pixelCount = 0;
+            for (size_t i = first; i < first + packetSize; ++i) {
+                const auto& [offsetX, offsetY] = _mortonOffsets[i];
+                if (offsetX < tile.width && offsetY < tile.height) {
+                    pixels[pixelCount++] = {tile.x + offsetX, tile.y + offsetY};
+                }
+            }
+            if (pixelCount == 0) {
+                continue;
+            }
+            PixelContext context{workerIndex, tile.index, 0};
+            packetFunction(pixels.data(), pixelCount, context, colors.data());
+            if (progress) {
+                progress->addPixels(tile.index, pixelCount, context.rayCount);
+            }
+            for (int i = 0; i < pixelCount; ++i) {
+                store(pixels[i].x, pixels[i].y, colors[i]);
+            }
+        }
+    }
+
+    template<typename ShadeTile>
+    bool Renderer::renderBands(const SizeI& imageSize, ImageOutput& output, RenderProgress* progress,
+                               const ShadeTile& tileShader) {
+        const auto width = imageSize.getWidth();
+        const auto tiles = makeTiles(imageSize);
+        if (!output.begin(imageSize)) {
+            return false;
+        }
+        if (progress) {
+            progress->begin(tiles.size(), static_cast<uint64_t>(width) * imageSize.getHeight());
+        }
+        // Tiles are row major, so every run of tilesPerRow tiles is one band of rows.
+        const auto tilesPerRow = static_cast<size_t>((width + _tileSize - 1) / _tileSize);
+        std::vector<Vector3f> band(static_cast<size_t>(width) * _tileSize);
+        bool succeeded = true;
+        for (size_t first = 0; first < tiles.size() && succeeded; first += tilesPerRow) {
+            const std::vector<RenderTile> bandTiles(tiles.begin() + static_cast<std::ptrdiff_t>(first),
+                                                    tiles.begin() + static_cast<std::ptrdiff_t>(first + tilesPerRow));
+            const auto bandY = bandTiles.front().y;
+            renderTiles(bandTiles, [&](const RenderTile& tile, unsigned workerIndex) {
+                tileShader(tile, workerIndex, [&](int x, int y, const Vector3f& color) {
+                    band[static_cast<size_t>(y - bandY) * width + x] = color;
+                });
+            });
+            succeeded = output.writeRows(bandY, bandTiles.front().height, band.data());
+        }
+        if (progress) {
+            progress->end();
+        }
+        return succeeded && output.end();
+    }
+
+    void Renderer::render(const SizeI& imageSize, const PixelFunction& pixelFunction, uint8_t* outputRGB,
+                          RenderProgress* progress) {
+        const auto width = imageSize.getWidth();
+        const auto tiles = makeTiles(imageSize);
+        if (progress) {
+            progress->begin(tiles.size(), static_cast<uint64_t>(width) * imageSize.getHeight());
+        }
+        renderTiles(tiles, [&](const RenderTile& tile, unsigned workerIndex) {
+            shadeTile(tile, workerIndex, pixelFunction, progress, [&](int x, int y, const Vector3f& color) {
+                writePixel(outputRGB, width, x, y, color);
+            });
+        });
+        if (progress) {
+            progress->end();
+        }
+    }
+
+    void Renderer::render(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                          uint8_t* outputRGB, RenderProgress* progress) {
+        assert(packetSize > 0 && (packetSize & (packetSize - 1)) == 0);
+        assert(static_cast<size_t>(packetSize) <= _mortonOffsets.size());
+        const auto width = imageSize.getWidth();
+        const auto tiles = makeTiles(imageSize);
+        if (progress) {
+            progress->begin(tiles.size(), static_cast<uint64_t>(width) * imageSize.getHeight());
+        }
+        renderTiles(tiles, [&](const RenderTile& tile, unsigned workerIndex) {
+            shadeTile(tile, workerIndex, packetSize, packetFunction, progress,
+                      [&](int x, int y, const Vector3f& color) {
+                          writePixel(outputRGB, width, x, y, color);
+                      });
+        });
+        if (progress) {
+            progress->end();
+        }
+    }
+
+    bool Renderer::render(const SizeI& imageSize, const PixelFunction& pixelFunction, ImageOutput& output,
+                          RenderProgress* progress) {
+        return renderBands(imageSize, output, progress, [&](const RenderTile& tile, unsigned workerIndex,
+                                                             const auto& store) {
+            shadeTile(tile, workerIndex, pixelFunction, progress, store);
+        });
+    }
+
+    bool Renderer::render(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                          ImageOutput& output, RenderProgress* progress) {
+        assert(packetSize > 0 && (packetSize & (packetSize - 1)) == 0);
+        assert(static_cast<size_t>(packetSize) <= _mortonOffsets.size());
+        return renderBands(imageSize, output, progress, [&](const RenderTile& tile, unsigned workerIndex,
+                                                             const auto& store) {
+            shadeTile(tile, workerIndex, packetSize, packetFunction, progress, store);
+        });
+    }
+
+    bool Renderer::renderProgressive(const SizeI& imageSize, const ProgressiveOptions& options, ImageOutput& output,
+                                     RenderProgress* progress, ProgressiveStatistics* outStatistics,
+                                     const SampleFunction& sampleFunction) {
+        assert(options.minSamples >= 2 && options.minSamples <= options.maxSamples && options.samplesPerPass > 0);
+        const auto width = imageSize.getWidth();
+        const auto tiles = makeTiles(imageSize);
+        if (!output.begin(imageSize)) {
+            return false;
+        }
+        if (progress) {
+            // Progress starts out against the full sample budget, pixels that converge early give back what they
+            // did not use.
+            progress->begin(tiles.size(), static_cast<uint64_t>(width) * imageSize.getHeight() * options.maxSamples);
+        }
+        SampleAccumulator accumulator(imageSize);
+        ProgressiveStatistics statistics;
+        std::vector<uint8_t> tileConverged(tiles.size(), 0);
+        const auto isActive = [&](const PixelCoordinate& pixel) {
+            const auto sampleCount = accumulator.getSampleCount(pixel.x, pixel.y);
+            return sampleCount < options.minSamples ||
+                   (sampleCount < options.maxSamples &&
+                    accumulator.getStandardError(pixel.x, pixel.y) > options.errorThreshold);
+        };
+        auto activeTiles = tiles;
+        while (!activeTiles.empty()) {
+            renderTiles(activeTiles, [&](const RenderTile& tile, unsigned workerIndex) {
+                std::vector<PixelCoordinate> pixels;
+                forEachPixel(tile, [&](int x, int y) {
+                    if (isActive({x, y})) {
+                        pixels.push_back({x, y});
+                    }
+                });
+                // Pixels only ever leave the active set, so all active pixels have the same sample count.
+                const auto sampleCount = accumulator.getSampleCount(pixels.front().x, pixels.front().y);
+                const auto passSamples = sampleCount == 0
+                                         ? options.minSamples
+                                         : std::min(options.samplesPerPass, options.maxSamples - sampleCount);
+                for (uint32_t sample = 0; sample < passSamples; ++sample) {
+                    sampleFunction(pixels, tile, workerIndex, accumulator);
+                }
+                bool converged = true;
+                uint64_t unusedSamples = 0;
+                for (const auto& pixel: pixels) {
+                    if (isActive(pixel)) {
+                        converged = false;
+                    } else {
+                        unusedSamples += options.maxSamples - accumulator.getSampleCount(pixel.x, pixel.y);
+                    }
+                }
+                tileConverged[tile.index] = converged;
+                if (progress && unusedSamples > 0) {
+                    progress->removeFromTotal(unusedSamples);
+                }
+            });
+            ++statistics.passCount;
+            activeTiles.erase(std::remove_if(activeTiles.begin(), activeTiles.end(), [&](const RenderTile& tile) {
+                return tileConverged[tile.index] != 0;
+            }), activeTiles.end());
+        }
+        if (progress) {
+            progress->end();
+        }
+        for (int y = 0; y < imageSize.getHeight(); ++y) {
+            for (int x = 0; x < width; ++x) {
+                statistics.sampleCount += accumulator.getSampleCount(x, y);
+            }
+        }
+        if (outStatistics) {
+            *outStatistics = statistics;
+        }
+
+        for (int y = 0; y < imageSize.getHeight(); y += _tileSize) {
+            const auto rowCount = std::min(_tileSize, imageSize.getHeight() - y);
+            if (!output.writeRows(y, rowCount, accumulator.getMeans() + static_cast<size_t>(y) * width)) {
+                return false;
+            }
+        }
+        return output.end();
+    }
+
+    bool Renderer::renderProgressive(const SizeI& imageSize, const PixelFunction& pixelFunction,
+                                     const ProgressiveOptions& options, ImageOutput& output,
+                                     RenderProgress* progress, ProgressiveStatistics* outStatistics) {
+        return renderProgressive(imageSize, options, output, progress, outStatistics,
+                                 [&](const std::vector<PixelCoordinate>& pixels, const RenderTile& tile,
+                                     unsigned workerIndex, SampleAccumulator& accumulator) {
+            for (const auto& pixel: pixels) {
+                PixelContext context{workerIndex, tile.index, 0, accumulator.getSampleCount(pixel.x, pixel.y)};
+                accumulator.addSample(pixel.x, pixel.y, pixelFunction(pixel.x, pixel.y, context));
+                if (progress) {
+                    progress->addPixels(tile.index, 1, context.rayCount);
+                }
+            }
+        });
+    }
+
+    bool Renderer::renderProgressive(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                                     const ProgressiveOptions& options, ImageOutput& output,
+                                     RenderProgress* progress, ProgressiveStatistics* outStatistics) {
+        assert(packetSize > 0 && (packetSize & (packetSize - 1)) == 0);
+        return renderProgressive(imageSize, options, output, progress, outStatistics,
+                                 [&](const std::vector<PixelCoordinate>& pixels, const RenderTile& tile,
+                                     unsigned workerIndex, SampleAccumulator& accumulator) {
+            std::vector<Vector3f> colors(packetSize);
+            const auto sampleIndex = accumulator.getSampleCount(pixels.front().x, pixels.front().y);
+            for (size_t first = 0; first < pixels.size(); first += packetSize) {
+                const auto pixelCount = static_cast<int>(std::min(pixels.size() - first,
+                                                                  static_cast<size_t>(packetSize)));
+                PixelContext context{workerIndex, tile.index, 0, sampleIndex};
+                packetFunction(pixels.data() + first, pixelCount, context, colors.data());
+                for (int i = 0; i < pixelCount; ++i) {
+                    accumulator.addSample(pixels[first + i].x, pixels[first + i].y, colors[i]);
+                }
+                if (progress) {
+                    progress->addPixels(tile.index, pixelCount, context.rayCount);
+                }
+            }
+        });
+    }
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "ImageOutput.h"
+#include "RenderProgress.h"
+#include "SampleAccumulator.h"
+#include "Size.h"
+#include "ThreadPool.h"
+#include "Vector.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace crt {
+
+    struct RenderTile {
+        uint32_t index;
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    /**
+     * Per pixel state handed to the pixel function by the worker shading it.
+     */
+    struct PixelContext {
+        unsigned workerIndex;
+        uint32_t tileIndex;
+        // Number of rays traced for the pixel, filled in by the pixel function for telemetry.
+        uint32_t rayCount;
+        // Index of the sample being taken of the pixel, always 0 outside progressive rendering.
+        uint32_t sampleIndex = 0;
+    };
+
+    struct ProgressiveOptions {
+        // Samples every pixel gets in the first pass, before its error estimate is trusted.
+        uint32_t minSamples = 4;
+        uint32_t maxSamples = 64;
+        // Samples added per pass to the pixels that have not converged yet.
+        uint32_t samplesPerPass = 4;
+        // A pixel converges once the standard error of its mean luminance drops to this.
+        float errorThreshold = 0.01f;
+    };
+
+    struct ProgressiveStatistics {
+        uint32_t passCount = 0;
+        uint64_t sampleCount = 0;
+    };
+
+    struct PixelCoordinate {
+        int x;
+        int y;
+    };
+
+    /**
+     * Tile based renderer. The image is cut into square tiles which are scheduled on a persistent
+     * work-stealing thread pool, pixels inside a tile are visited in Morton (Z) order.
+     */
+    class Renderer {
+    public:
+        static constexpr int kDefaultTileSize = 32;
+
+        using PixelFunction = std::function<Vector3f(int x, int y, PixelContext& context)>;
+        using TileFunction = std::function<void(const RenderTile& tile, unsigned workerIndex)>;
+        // Shades pixelCount pixels at once and writes one color per pixel into outColors.
+        using PacketFunction = std::function<void(const PixelCoordinate* pixels, int pixelCount,
+                                                  PixelContext& context, Vector3f* outColors)>;
+
+        /**
+         * @param threadCount number of render threads, 0 uses every hardware thread
+         * @param tileSize tile edge length in pixels, must be a power of two
+         */
+        explicit Renderer(unsigned threadCount = 0, int tileSize = kDefaultTileSize);
+
+        [[nodiscard]] unsigned getThreadCount() const {
+            return _threadPool.getThreadCount();
+        }
+
+        [[nodiscard]] int getTileSize() const {
+            return _tileSize;
+        }
+
+        [[nodiscard]] std::vector<RenderTile> makeTiles(const SizeI& imageSize) const;
+
+        /**
+         * Calls pixelFunction(x, y) for every pixel of tile, in Morton order.
+         */
+        void forEachPixel(const RenderTile& tile, const std::function<void(int x, int y)>& pixelFunction) const;
+
+        void renderTiles(const std::vector<RenderTile>& tiles, const TileFunction& tileFunction);
+
+        /**
+         * Shades every pixel and writes clamped 8-bit RGB, row major, into outputRGB.
+         * Pixel and ray counts are reported to progress when one is given.
+         */
+        void render(const SizeI& imageSize, const PixelFunction& pixelFunction, uint8_t* outputRGB,
+                    RenderProgress* progress = nullptr);
+
+        /**
+         * Same as render, but hands groups of up to packetSize pixels to packetFunction. Consecutive Morton
+         * offsets form square or 2:1 blocks, so packetSize 16 shades 4x4 pixel blocks and 8 shades 4x2 blocks.
+         * @param packetSize power of two, at most the pixel count of a tile
+         */
+        void render(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                    uint8_t* outputRGB, RenderProgress* progress = nullptr);
+
+        /**
+         * Streaming variants: renders one band of tile rows at a time and hands each finished band to output,
+         * so only a band of pixels is ever held. Returns false with output's error when writing fails.
+         */
+        bool render(const SizeI& imageSize, const PixelFunction& pixelFunction, ImageOutput& output,
+                    RenderProgress* progress = nullptr);
+
+        bool render(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                    ImageOutput& output, RenderProgress* progress = nullptr);
+
+        /**
+         * Progressive adaptive rendering. The first pass takes minSamples samples of every pixel, each later
+         * pass only revisits the pixels whose error estimate is still above the threshold, and a tile drops out
+         * once all its pixels converged or hit maxSamples. The pixel function reads the sample index from its
+         * context to place the sample. The means go to output at the end.
+         */
+        bool renderProgressive(const SizeI& imageSize, const PixelFunction& pixelFunction,
+                               const ProgressiveOptions& options, ImageOutput& output,
+                               RenderProgress* progress = nullptr, ProgressiveStatistics* outStatistics = nullptr);
+
+        /**
+         * Packet variant of renderProgressive. The pixels still active in a tile share their sample count, so
+         * every packet has one sample index.
+         */
+        bool renderProgressive(const SizeI& imageSize, int packetSize, const PacketFunction& packetFunction,
+                               const ProgressiveOptions& options, ImageOutput& output,
+                               RenderProgress* progress = nullptr, ProgressiveStatistics* outStatistics = nullptr);
+
+    private:
+        // Shade one tile and pass every pixel to store(x, y, color).
+        template<typename Store>
+        void shadeTile(const RenderTile& tile, unsigned workerIndex, const PixelFunction& pixelFunction,
+                       RenderProgress* progress, const Store& store) const;
+
+        template<typename Store>
+        void shadeTile(const RenderTile& tile, unsigned workerIndex, int packetSize,
+                       const PacketFunction& packetFunction, RenderProgress* progress, const Store& store) const;
+
+        // Shades one sample of each of pixels and adds it to accumulator.
+        using SampleFunction = std::function<void(const std::vector<PixelCoordinate>& pixels, const RenderTile& tile,
+                                                  unsigned workerIndex, SampleAccumulator& accumulator)>;
+
+        bool renderProgressive(const SizeI& imageSize, const ProgressiveOptions& options, ImageOutput& output,
+                               RenderProgress* progress, ProgressiveStatistics* outStatistics,
+                               const SampleFunction& sampleFunction);
+
+        template<typename ShadeTile>
+        bool renderBands(const SizeI& imageSize, ImageOutput& output, RenderProgress* progress,
+                         const ShadeTile& tileShader);
+
+        int _tileSize;
+        // Pixel offsets within a full tile, sorted by Morton code.
+        std::vector<std::pair<uint16_t, uint16_t>> _mortonOffsets;
+        ThreadPool _threadPool;
+    };
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Size.h"
+#include "Vector.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Per pixel running mean of the color samples plus Welford's running variance of their luminance, the
+     * error estimate that steers adaptive sampling.
+     */
+    class SampleAccumulator {
+    public:
+        explicit SampleAccumulator(const SizeI& imageSize)
+                : _width(imageSize.getWidth()),
+                  _means(static_cast<size_t>(imageSize.getWidth()) * imageSize.getHeight()),
+                  _luminanceM2(_means.size(), 0.0f),
+                  _sampleCounts(_means.size(), 0) {}
+
+        void addSample(int x, int y, const Vector3f& color) {
+            const auto index = getIndex(x, y);
+            auto& mean = _means[index];
+            const auto count = ++_sampleCounts[index];
+            const auto luminance = getLuminance(color);
+            const auto previousMeanLuminance = getLuminance(mean);
+            mean += (color - mean) / static_cast<float>(count);
+            _luminanceM2[index] += (luminance - previousMeanLuminance) * (luminance - getLuminance(mean));
+        }
+
+        [[nodiscard]] uint32_t getSampleCount(int x, int y) const {
+            return _sampleCounts[getIndex(x, y)];
+        }
+
+        [[nodiscard]] const Vector3f& getMean(int x, int y) const {
+            return _means[getIndex(x, y)];
+        }
+
+        /**
+         * Standard error of the mean luminance, infinite until there are two samples.
+         */
+        [[nodiscard]] float getStandardError(int x, int y) const {
+            const auto index = getIndex(x, y);
+            const auto count = _sampleCounts[index];
+            if (count < 2) {
+                return std::numeric_limits<float>::infinity();
+            }
+            return std::sqrt(_luminanceM2[index] / static_cast<float>(count - 1) / static_cast<float>(count));
+        }
+
+        /**
+         * Row major means, rows [y, y + rowCount) of them are what an ImageOutput takes.
+         */
+        [[nodiscard]] const Vector3f* getMeans() const {
+            return _means.data();
+        }
+
+        static float getLuminance(const Vector3f& color) {
+            return 0.2126f * color.getX() + 0.7152f * color.getY() + 0.0722f * color.getZ();
+        }
+
+    private:
+        [[nodiscard]] size_t getIndex(int x, int y) const {
+            return static_cast<size_t>(y) * _width + x;
+        }
+
+    private:
+        int _width;
+        std::vector<Vector3f> _means;
+        std::vector<float> _luminanceM2;
+        std::vector<uint32_t> _sampleCounts;
+    };
+}
@@ -0,0 +1,259 @@
+#include "Sampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Low bias 32-bit integer hash (Wellons).
+    uint32_t hash(uint32_t value) {
+        value ^= value >> 16u;
+        value *= 0x7feb352du;
+        value ^= value >> 15u;
+        value *= 0x846ca68bu;
+        value ^= value >> 16u;
+        return value;
+    }
+
+    uint32_t hashSample(int x, int y, uint32_t sampleIndex, uint32_t dimension) {
+        return hash(static_cast<uint32_t>(x) ^ hash(static_cast<uint32_t>(y) ^ hash(sampleIndex ^ hash(dimension))));
+    }
+
+    float toUnitFloat(uint32_t value) {
+        return static_cast<float>(value >> 8u) * 0x1p-24f;
+    }
+
+    uint32_t reverseBits(uint32_t value) {
+        value = (value << 16u) | (value >> 16u);
+        value = ((value & 0x00ff00ffu) << 8u) | ((value & 0xff00ff00u) >> 8u);
+        value = ((value & 0x0f0f0f0fu) << 4u) | ((value & 0xf0f0f0f0u) >> 4u);
+        value = ((value & 0x33333333u) << 2u) | ((value & 0xccccccccu) >> 2u);
+        value = ((value & 0x55555555u) << 1u) | ((value & 0xaaaaaaaau) >> 1u);
+        return value;
+    }
+
+    /**
+     * Owen scrambling of a bit reversed value: every bit is flipped depending only on the bits below it.
+     */
+    uint32_t laineKarrasPermutation(uint32_t value, uint32_t seed) {
+        value += seed;
+        value ^= value * 0x6c50b47cu;
+        value ^= value * 0xb82f1e52u;
+        value ^= value * 0xc7afe638u;
+        value ^= value * 0x8d22f6e6u;
+        return value;
+    }
+
+    uint32_t nestedUniformScramble(uint32_t value, uint32_t seed) {
+        return reverseBits(laineKarrasPermutation(reverseBits(value), seed));
+    }
+
+    uint32_t sobol0(uint32_t index) {
+        return reverseBits(index);
+    }
+
+    uint32_t sobol1(uint32_t index) {
+        // Direction numbers of the second Sobol dimension are the rows of Pascal's triangle mod 2.
+        uint32_t result = 0;
+        for (uint32_t direction = 1u << 31u; index != 0; index >>= 1u, direction ^= direction >> 1u) {
+            if (index & 1u) {
+                result ^= direction;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Random permutation of [0, length) indexed by value (Kensler, Correlated Multi-Jittered Sampling).
+     */
+    uint32_t permute(uint32_t value, uint32_t length, uint32_t seed) {
+        uint32_t mask = length - 1;
+        mask |= mask >> 1u;
+        mask |= mask >> 2u;
+        mask |= mask >> 4u;
+        mask |= mask >> 8u;
+        mask |= mask >> 16u;
+        // Cycle walking: permute within the next power of two until the value lands inside the range.
+        do {
+            value ^= seed;
+            value *= 0xe170893du;
+            value ^= seed >> 16u;
+            value ^= (value & mask) >> 4u;
+            value ^= seed >> 8u;
+            value *= 0x0929eb3fu;
+            value ^= seed >> 23u;
+            value ^= (value & mask) >> 1u;
+            value *= 1u | seed >> 27u;
+            value *= 0x6935fa69u;
+            value ^= (value & mask) >> 11u;
+            value *= 0x74dcb303u;
+            value ^= (value & mask) >> 2u;
+            value *= 0x9e501cc3u;
+            value ^= (value & mask) >> 2u;
+            value *= 0xc860a3dfu;
+            value &= mask;
+            value ^= value >> 5u;
+        } while (value >= length);
+        return (value + seed) % length;
+    }
+
+    /**
+     * Void-and-cluster (Ulichney 1993) on a toroidal size x size grid: returns the rank of every texel, the order
+     * in which texels switch on so that every prefix is as evenly spread as possible.
+     */
+    std::vector<uint32_t> makeVoidAndClusterRanks(int size) {
+        const auto count = static_cast<size_t>(size) * size;
+        constexpr float sigma = 1.5f;
+        std::vector<float> kernel(count);
+        for (int y = 0; y < size; ++y) {
+            for (int x = 0; x < size; ++x) {
+                const auto dx = static_cast<float>(std::min(x, size - x));
+                const auto dy = static_cast<float>(std::min(y, size - y));
+                kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+            }
+        }
+        std::vector<uint8_t> pattern(count, 0);
+        std::vector<float> energy(count, 0.0f);
+        const auto toggle = [&](size_t index, bool on) {
+            pattern[index] = on;
+            const auto sign = on ? 1.0f : -1.0f;
+            const auto px = static_cast<int>(index % size);
+            const auto py = static_cast<int>(index / size);
+            for (int y = 0; y < size; ++y) {
+                const auto* kernelRow = &kernel[((y - py + size) % size) * size];
+                auto* energyRow = &energy[y * size];
+                for (int x = 0; x < size; ++x) {
+                    energyRow[x] += sign * kernelRow[(x - px + size) % size];
+                }
+            }
+        };
+        // Texel with the highest energy among those set (tightest cluster), or lowest among unset (largest void).
+        const auto findExtreme = [&](bool set) {
+            size_t best = count;
+            for (size_t i = 0; i < count; ++i) {
+                if (pattern[i] == set &&
+                    (best == count || (set ? energy[i] > energy[best] : energy[i] < energy[best]))) {
+                    best = i;
+                }
+            }
+            return best;
+        };
+
+        // Initial binary pattern: a tenth of the texels at random, relaxed until moving a point does not help.
+        crt::Pcg32 random(size);
+        const auto initialCount = count / 10;
+        for (size_t placed = 0; placed < initialCount;) {
+            const auto index = random.nextUint() % count;
+            if (!pattern[index]) {
+                toggle(index, true);
+                ++placed;
+            }
+        }
+        for (size_t iteration = 0; iteration < count; ++iteration) {
+            const auto cluster = findExtreme(true);
+            toggle(cluster, false);
+            const auto voidIndex = findExtreme(false);
+            toggle(voidIndex, true);
+            if (voidIndex == cluster) {
+                break;
+            }
+        }
+
+        std::vector<uint32_t> ranks(count);
+        const auto prototype = pattern;
+        const auto prototypeEnergy = energy;
+        // Ranks below the prototype: take away the tightest clusters one by one.
+        for (auto rank = static_cast<uint32_t>(initialCount); rank-- > 0;) {
+            const auto cluster = findExtreme(true);
+            toggle(cluster, false);
+            ranks[cluster] = rank;
+        }
+        // Ranks above: fill the largest voids until the mask is full.
+        pattern = prototype;
+        energy = prototypeEnergy;
+        for (auto rank = static_cast<uint32_t>(initialCount); rank < count; ++rank) {
+            const auto voidIndex = findExtreme(false);
+            toggle(voidIndex, true);
+            ranks[voidIndex] = rank;
+        }
+        return ranks;
+    }
+}
+
+std::shared_ptr<crt::Sampler> crt::Sampler::create(SamplerType type, uint32_t samplesPerPixel) {
+    switch (type) {
+        case SamplerType::Random:
+            return std::make_shared<RandomSampler>();
+        case SamplerType::Stratified:
+            return std::make_shared<StratifiedSampler>(samplesPerPixel);
+        case SamplerType::Sobol:
+            return std::make_shared<SobolSampler>();
+        case SamplerType::BlueNoise:
+            return std::make_shared<BlueNoiseSampler>();
+    }
+    return nullptr;
+}
+
+bool crt::Sampler::parseType(const std::string& name, SamplerType& outType) {
+    if (name == "random") {
+        outType = SamplerType::Random;
+    } else if (name == "stratified") {
+        outType = SamplerType::Stratified;
+    } else if (name == "sobol") {
+        outType = SamplerType::Sobol;
+    } else if (name == "bluenoise") {
+        outType = SamplerType::BlueNoise;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+crt::Vector2f crt::RandomSampler::get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const {
+    Pcg32 random(hashSample(x, y, 0, dimension), sampleIndex);
+    const auto u = random.nextFloat();
+    return {u, random.nextFloat()};
+}
+
+crt::StratifiedSampler::StratifiedSampler(uint32_t samplesPerPixel)
+        : _gridSize(std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(samplesPerPixel)))))) {}
+
+crt::Vector2f crt::StratifiedSampler::get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const {
+    const auto stratumCount = _gridSize * _gridSize;
+    const auto round = sampleIndex / stratumCount;
+    const auto stratum = permute(sampleIndex % stratumCount, stratumCount, hashSample(x, y, round, dimension));
+    Pcg32 random(hashSample(x, y, 0, dimension), sampleIndex);
+    const auto jitterX = random.nextFloat();
+    const auto jitterY = random.nextFloat();
+    const auto scale = 1.0f / static_cast<float>(_gridSize);
+    // Clamped so rounding of the last stratum's upper edge cannot reach 1.
+    return {std::min((static_cast<float>(stratum % _gridSize) + jitterX) * scale, 0x1.fffffep-1f),
+            std::min((static_cast<float>(stratum / _gridSize) + jitterY) * scale, 0x1.fffffep-1f)};
+}
+
+crt::Vector2f crt::SobolSampler::get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const {
+    const auto seed = hashSample(x, y, 0, dimension);
+    const auto index = nestedUniformScramble(sampleIndex, seed);
+    return {toUnitFloat(nestedUniformScramble(sobol0(index), hash(seed ^ 0x5bd1e995u))),
+            toUnitFloat(nestedUniformScramble(sobol1(index), hash(seed ^ 0x27d4eb2du)))};
+}
+
+crt::BlueNoiseSampler::BlueNoiseSampler() {
+    const auto ranks = makeVoidAndClusterRanks(kMaskSize);
+    _mask.resize(ranks.size());
+    for (size_t i = 0; i < ranks.size(); ++i) {
+        _mask[i] = (static_cast<float>(ranks[i]) + 0.5f) / static_cast<float>(ranks.size());
+    }
+}
+
+crt::Vector2f crt::BlueNoiseSampler::get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const {
+    // Both coordinates read the same mask at offsets far enough apart to be uncorrelated.
+    const auto offset = hash(dimension);
+    const auto u = getMaskValue(x + static_cast<int>(offset & 63u), y + static_cast<int>((offset >> 6u) & 63u));
+    const auto v = getMaskValue(x + static_cast<int>((offset >> 12u) & 63u) + kMaskSize / 2,
+                                y + static_cast<int>((offset >> 18u) & 63u) + kMaskSize / 2);
+    // R2 sequence (Roberts): the 2D analogue of the golden ratio sequence.
+    const auto rotatedU = u + 0.7548776662466927 * sampleIndex;
+    const auto rotatedV = v + 0.5698402909980532 * sampleIndex;
+    return {std::min(static_cast<float>(rotatedU - std::floor(rotatedU)), 0x1.fffffep-1f),
+            std::min(static_cast<float>(rotatedV - std::floor(rotatedV)), 0x1.fffffep-1f)};
+}
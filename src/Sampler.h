@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Vector.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * PCG32 random number generator (O'Neill, XSH RR variant). Eight bytes of state, cheap enough to keep one per
+     * thread or to seed one per pixel sample.
+     */
+    class Pcg32 {
+    public:
+        explicit Pcg32(uint64_t seed, uint64_t sequence = 0) : _increment((sequence << 1u) | 1u) {
+            nextUint();
+            _state += seed;
+            nextUint();
+        }
+
+        uint32_t nextUint() {
+            const auto state = _state;
+            _state = state * 6364136223846793005ull + _increment;
+            const auto shifted = static_cast<uint32_t>(((state >> 18u) ^ state) >> 27u);
+            const auto rotation = static_cast<uint32_t>(state >> 59u);
+            return (shifted >> rotation) | (shifted << ((~rotation + 1u) & 31u));
+        }
+
+        /**
+         * Uniform float in [0, 1).
+         */
+        float nextFloat() {
+            return static_cast<float>(nextUint() >> 8u) * 0x1p-24f;
+        }
+
+    private:
+        uint64_t _state = 0;
+        uint64_t _increment;
+    };
+
+    enum class SamplerType {
+        Random,
+        Stratified,
+        Sobol,
+        BlueNoise,
+    };
+
+    /**
+     * Source of sample positions in [0, 1)^2. A sample is a pure function of pixel, sample index and dimension,
+     * so samplers hold no mutable state, are shared by all render threads and give the same image under any
+     * schedule. Dimension tells apart the independent 2D samples one path needs (pixel position, lens, light...).
+     */
+    class Sampler {
+    public:
+        virtual ~Sampler() = default;
+
+        [[nodiscard]] virtual Vector2f get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension = 0) const = 0;
+
+        [[nodiscard]] float get1D(int x, int y, uint32_t sampleIndex, uint32_t dimension = 0) const {
+            return get2D(x, y, sampleIndex, dimension).getX();
+        }
+
+        /**
+         * @param samplesPerPixel sample count the stratified sampler divides the pixel for, ignored by the others
+         */
+        static std::shared_ptr<Sampler> create(SamplerType type, uint32_t samplesPerPixel);
+
+        static bool parseType(const std::string& name, SamplerType& outType);
+    };
+
+    using SamplerPtr = std::shared_ptr<Sampler>;
+
+    /**
+     * Independent uniform samples from a PCG32 seeded by pixel, sample index and dimension. The baseline the
+     * other samplers are measured against.
+     */
+    class RandomSampler : public Sampler {
+    public:
+        [[nodiscard]] Vector2f get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const override;
+    };
+
+    /**
+     * Jittered grid: the pixel is cut into ceil(sqrt(n))^2 strata, visited in a per pixel random order with one
+     * jittered sample each. Every further round of samples starts a new permutation.
+     */
+    class StratifiedSampler : public Sampler {
+    public:
+        explicit StratifiedSampler(uint32_t samplesPerPixel);
+
+        [[nodiscard]] Vector2f get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const override;
+
+    private:
+        uint32_t _gridSize;
+    };
+
+    /**
+     * First two Sobol dimensions with hash based Owen scrambling (Burley 2020). The index is shuffled per pixel
+     * and dimension, so every pixel and dimension gets a decorrelated (0, 2)-sequence and any prefix of samples
+     * stays well stratified.
+     */
+    class SobolSampler : public Sampler {
+    public:
+        [[nodiscard]] Vector2f get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const override;
+    };
+
+    /**
+     * Blue noise mask built with void-and-cluster, tiled over the image and offset per dimension. Sample i of a
+     * pixel rotates the mask value by the i-th point of the R2 sequence, so neighbouring pixels keep
+     * complementary errors at every sample count.
+     */
+    class BlueNoiseSampler : public Sampler {
+    public:
+        static constexpr int kMaskSize = 64;
+
+        BlueNoiseSampler();
+
+        [[nodiscard]] Vector2f get2D(int x, int y, uint32_t sampleIndex, uint32_t dimension) const override;
+
+        /**
+         * Threshold in [0, 1) of mask texel (x, y), every value occurs exactly once.
+         */
+        [[nodiscard]] float getMaskValue(int x, int y) const {
+            return _mask[(y & (kMaskSize - 1)) * kMaskSize + (x & (kMaskSize - 1))];
+        }
+
+    private:
+        std::vector<float> _mask;
+    };
+}
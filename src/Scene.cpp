@@ -1,20 +1,54 @@
 #include "Scene.h"
 
+#include "Statistics.h"
+
 namespace crt {
-    bool Scene::hit(const Ray& ray, float tMin, float tMax, HitRecord& hitRecord) const {
-        auto minT = tMax;
-        HitRecord tempHitRecord;
-        bool hasHit = false;
-        for (const auto& surface: _surfaces) {
-            if (surface->hit(ray, tMin, tMax, tempHitRecord)) {
-                hasHit = true;
-                if (tempHitRecord.t < minT) {
-                    hitRecord = tempHitRecord;
-                    minT = tempHitRecord.t;
-                }
+    void Scene::ensureBvh() const {
+        if (!_bvhDirty.load(std::memory_order_acquire) && !_boundsDirty.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_bvhMutex);
+        if (_bvhDirty.load(std::memory_order_relaxed)) {
+            _frozenScene.build(_surfaces);
+        } else if (_boundsDirty.load(std::memory_order_relaxed)) {
+            _frozenScene.refit(_surfaces);
+        } else {
+            return;
+        }
+        _boundsDirty.store(false, std::memory_order_release);
+        _bvhDirty.store(false, std::memory_order_release);
+    }
+
+    bool Scene::intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const {
+        ensureBvh();
+        CRT_COUNT(closestHitRays, 1);
+        return _frozenScene.intersect(ray, tMin, tMax, outHit);
+    }
+
+    bool Scene::occluded(const Ray& ray, float tMin, float tMax) const {
+        ensureBvh();
+        CRT_COUNT(occlusionRays, 1);
+        return _frozenScene.occluded(ray, tMin, tMax);
+    }
+
+    void Scene::hitPacket(RayPacket& packet, PacketHit& outHit) const {
+        ensureBvh();
+        if constexpr (Statistics::kEnabled) {
+            for (int lane = 0; lane < packet.size; ++lane) {
+                CRT_COUNT(closestHitRays, packet.isActive(lane));
             }
         }
-        return hasHit;
+        _frozenScene.hitPacket(packet, outHit);
+    }
+
+    bool Scene::hit(const Ray& ray, float tMin, float tMax, HitRecord& hitRecord) const {
+        SurfaceHit surfaceHit{};
+        if (!intersect(ray, tMin, tMax, surfaceHit)) {
+            return false;
+        }
+        surfaceHit.surface->resolveHit(ray, surfaceHit.t, surfaceHit.primitive, surfaceHit.u, surfaceHit.v,
+                                       hitRecord);
+        return true;
     }
 
     bool Scene::hit(const Ray& ray, HitRecord& hitRecord) const {
@@ -1,7 +1,13 @@
 #pragma once
 
 #include "Surface.h"
+#include "Bvh.h"
+#include "FrozenScene.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <mutex>
 #include <vector>
 
 namespace crt {
@@ -13,25 +19,96 @@ namespace crt {
 
         void addSurface(const SurfacePtr& surface) {
             _surfaces.push_back(surface);
+            _bvhDirty = true;
         }
         
         void removeSurface(const SurfacePtr& surface) {
             _surfaces.erase(std::remove(_surfaces.begin(), _surfaces.end(), surface), _surfaces.end());
+            _bvhDirty = true;
         }
 
         void clear() {
             _surfaces.clear();
+            _bvhDirty = true;
+        }
+
+        /**
+         * Reports that surface was moved or reshaped in place, e.g. through Mesh::updatePoints. The next query
+         * refits the top level hierarchy instead of rebuilding it.
+         */
+        void updateSurface(const SurfacePtr& surface) {
+            assert(std::find(_surfaces.begin(), _surfaces.end(), surface) != _surfaces.end());
+            _boundsDirty = true;
+        }
+
+        /**
+         * Moves surface by transform (see Surface::transform) and reports it like updateSurface. Returns false for
+         * surfaces that cannot follow the transform.
+         */
+        bool transformSurface(const SurfacePtr& surface, const Matrix4f& transform) {
+            if (!surface->transform(transform)) {
+                return false;
+            }
+            updateSurface(surface);
+            return true;
         }
 
         [[nodiscard]] const std::vector<SurfacePtr>& getSurface() const {
             return _surfaces;
         }
 
+        /**
+         * Closest hit without shading, see Surface::intersect.
+         */
+        bool intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const;
+
+        /**
+         * Closest hit, resolved into a full record once traversal is done.
+         */
         bool hit(const Ray& ray, float tMin, float tMax, HitRecord& hitRecord) const;
 
         bool hit(const Ray& ray, HitRecord& hitRecord) const;
 
+        /**
+         * True if any surface blocks the ray within [tMin, tMax]. Meant for shadow rays, where tMax is the
+         * distance to the light and the first blocker found ends the query.
+         */
+        [[nodiscard]] bool occluded(const Ray& ray, float tMin, float tMax) const;
+
+        /**
+         * Closest hit for every active lane of a coherent packet, see Surface::resolveHit to shade a lane.
+         */
+        void hitPacket(RayPacket& packet, PacketHit& outHit) const;
+
+        /**
+         * Top level hierarchy over the bounded surfaces, rebuilt on first use after the surface list changed and
+         * refit after surfaces were updated.
+         */
+        [[nodiscard]] const Bvh& getBvh() const {
+            return getFrozenScene().getBvh();
+        }
+
+        /**
+         * Traversal copy of the surfaces, see FrozenScene. Add and remove surfaces through the scene, and report
+         * surfaces moved or reshaped in place with updateSurface, so the copy follows them. Nothing may change
+         * while queries are running.
+         */
+        [[nodiscard]] const FrozenScene& getFrozenScene() const {
+            ensureBvh();
+            return _frozenScene;
+        }
+
+    private:
+        void ensureBvh() const;
+
     private:
         std::vector<SurfacePtr> _surfaces;
+
+        // Acceleration state, derived from _surfaces. Rebuilt lazily, guarded for concurrent hit() callers.
+        mutable FrozenScene _frozenScene;
+        mutable std::atomic<bool> _bvhDirty{true};
+        // Only surface bounds changed, a refit is enough.
+        mutable std::atomic<bool> _boundsDirty{false};
+        mutable std::mutex _bvhMutex;
     };
-}
\ No newline at end of file
+}
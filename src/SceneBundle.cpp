@@ -0,0 +1,483 @@
+#include "SceneBundle.h"
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace crt {
+    namespace {
+        constexpr char kMagic[8] = {'C', 'R', 'T', 'S', 'C', 'E', 'N', 'E'};
+        constexpr uint32_t kByteOrderMark = 0x01020304;
+        // Arrays start on cache line boundaries, which satisfies the alignment of every stored type.
+        constexpr size_t kArrayAlignment = 64;
+
+        struct BundleArray {
+            uint64_t offset = 0;
+            uint64_t count = 0;
+        };
+
+        struct BundleHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t byteOrderMark;
+            // Sizes of the types stored verbatim, so bundles from a build with another layout are rejected.
+            uint32_t vector3fSize;
+            uint32_t bvhNodeSize;
+            uint32_t triangleBlockSize;
+            uint32_t reserved;
+            BundleArray textures;
+            BundleArray surfaces;
+        };
+
+        struct BundleTexture {
+            int32_t width;
+            int32_t height;
+            TextureFormat format;
+            TextureLayout layout;
+            uint32_t mipmaps;
+            uint32_t reserved;
+            BundleArray texels;
+        };
+
+        struct BundleMaterial {
+            float ambient[3];
+            float diffuse[3];
+            float specular[3];
+            float shininess;
+        };
+
+        enum class BundleSurfaceType : uint32_t { Sphere, Plane, Triangle, Mesh };
+
+        struct BundleSurface {
+            BundleSurfaceType type;
+            // Index into the texture records, -1 for none.
+            int32_t texture;
+            BundleMaterial material;
+            // Sphere: center and radius. Plane: normal and point. Triangle: the three vertices.
+            float parameters[9];
+            // The remaining fields are only used by meshes. bvhNodes holds WideBvhNodes when bvhWidth is 4 or 8,
+            // bvhPrimitiveIndices and leafBlocks are then empty.
+            BundleArray points;
+            BundleArray triangleVertexIndices;
+            BundleArray bvhNodes;
+            BundleArray bvhPrimitiveIndices;
+            BundleArray triangleBlocks;
+            BundleArray leafBlocks;
+            uint32_t leafBlockSize;
+            float sahCost;
+            uint32_t bvhWidth;
+            uint32_t reserved;
+            uint64_t leafCount;
+            uint64_t maxDepth;
+            uint64_t maxLeafPrimitiveCount;
+        };
+
+        void storeVector(const Vector3f& vector, float* outValues) {
+            outValues[0] = vector.getX();
+            outValues[1] = vector.getY();
+            outValues[2] = vector.getZ();
+        }
+
+        Vector3f loadVector(const float* values) {
+            return {values[0], values[1], values[2]};
+        }
+
+        BundleMaterial toBundleMaterial(const Material& material) {
+            BundleMaterial result{};
+            storeVector(material.getAmbient(), result.ambient);
+            storeVector(material.getDiffuse(), result.diffuse);
+            storeVector(material.getSpecular(), result.specular);
+            result.shininess = material.getShininess();
+            return result;
+        }
+
+        Material fromBundleMaterial(const BundleMaterial& material) {
+            return {loadVector(material.ambient), loadVector(material.diffuse), loadVector(material.specular),
+                    material.shininess};
+        }
+
+        // Traversal keeps a fixed size stack per tree level, so children must come after their parent (which also
+        // rules out cycles) and no leaf may lie deeper than the builders go.
+        bool isValidChild(uint32_t child, size_t parent, size_t nodeCount, const std::vector<uint32_t>& depths) {
+            return child > parent && child < nodeCount && depths[parent] + 1 < Bvh::kMaxDepth;
+        }
+
+        bool areValidTriangles(const SharedArray<Vector3i>& triangleVertexIndices, size_t pointCount) {
+            for (const auto& triangle: triangleVertexIndices) {
+                for (int i = 0; i < 3; ++i) {
+                    if (triangle[i] < 0 || static_cast<size_t>(triangle[i]) >= pointCount) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool areValidBlocks(const SharedArray<TriangleBlock>& triangleBlocks, size_t triangleCount) {
+            for (const auto& block: triangleBlocks) {
+                for (const auto triangle: block.triangle) {
+                    if (triangle >= triangleCount) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool isValidBvh(const SharedArray<BvhNode>& nodes, const SharedArray<uint32_t>& primitiveIndices,
+                        const SharedArray<uint32_t>& leafBlocks, size_t triangleCount, size_t blockCount) {
+            for (const auto triangle: primitiveIndices) {
+                if (triangle >= triangleCount) {
+                    return false;
+                }
+            }
+            std::vector<uint32_t> depths(nodes.size(), 0);
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                const auto& node = nodes[i];
+                if (node.isLeaf()) {
+                    if (node.primitiveCount > TriangleBlock::kSize || node.offset > primitiveIndices.size() ||
+                        node.primitiveCount > primitiveIndices.size() - node.offset || leafBlocks[i] >= blockCount) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (node.axis > 2 || !isValidChild(node.offset, i, nodes.size(), depths) ||
+                    !isValidChild(node.offset + 1, i, nodes.size(), depths)) {
+                    return false;
+                }
+                depths[node.offset] = std::max(depths[node.offset], depths[i] + 1);
+                depths[node.offset + 1] = std::max(depths[node.offset + 1], depths[i] + 1);
+            }
+            return true;
+        }
+
+        template<int Width>
+        bool isValidWideBvh(const SharedArray<WideBvhNode<Width>>& nodes, size_t blockCount) {
+            using Node = WideBvhNode<Width>;
+            std::vector<uint32_t> depths(nodes.size(), 0);
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                const auto& node = nodes[i];
+                if (node.childCount > Width) {
+                    return false;
+                }
+                for (int slot = 0; slot < node.childCount; ++slot) {
+                    const auto child = node.children[slot];
+                    if (Node::isLeaf(child)) {
+                        if (Node::getLeafIndex(child) >= blockCount) {
+                            return false;
+                        }
+                    } else if (isValidChild(child, i, nodes.size(), depths)) {
+                        depths[child] = std::max(depths[child], depths[i] + 1);
+                    } else {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        class BundleWriter {
+        public:
+            BundleWriter() : _bytes(sizeof(BundleHeader), 0) {}
+
+            template<typename T>
+            BundleArray append(const T* data, size_t count) {
+                _bytes.resize((_bytes.size() + kArrayAlignment - 1) / kArrayAlignment * kArrayAlignment, 0);
+                const BundleArray array{_bytes.size(), count};
+                const auto* bytes = reinterpret_cast<const char*>(data);
+                _bytes.insert(_bytes.end(), bytes, bytes + count * sizeof(T));
+                return array;
+            }
+
+            template<typename T>
+            BundleArray append(const SharedArray<T>& array) {
+                return append(array.data(), array.size());
+            }
+
+            void setHeader(const BundleHeader& header) {
+                std::memcpy(_bytes.data(), &header, sizeof(header));
+            }
+
+            [[nodiscard]] const std::vector<char>& getBytes() const { return _bytes; }
+
+        private:
+            std::vector<char> _bytes;
+        };
+
+        class BundleReader {
+        public:
+            explicit BundleReader(std::shared_ptr<const MappedFile> file) : _file(std::move(file)) {}
+
+            /**
+             * Views array in place after checking that it lies inside the file and is aligned for T.
+             */
+            template<typename T>
+            bool get(const BundleArray& array, SharedArray<T>& outArray) const {
+                const auto size = static_cast<uint64_t>(_file->getSize());
+                if (array.offset % alignof(T) != 0 || array.offset > size ||
+                    array.count > (size - array.offset) / sizeof(T)) {
+                    return false;
+                }
+                outArray = SharedArray<T>(reinterpret_cast<const T*>(_file->getData() + array.offset),
+                                          static_cast<size_t>(array.count), _file);
+                return true;
+            }
+
+        private:
+            std::shared_ptr<const MappedFile> _file;
+        };
+    }
+
+    bool SceneBundle::write(const Scene& scene, const std::string& path, std::string& outError) {
+        BundleWriter writer;
+        std::vector<BundleTexture> textures;
+        std::unordered_map<const Texture2D*, int32_t> textureIndices;
+        std::vector<BundleSurface> surfaces;
+        for (const auto& surface: scene.getSurface()) {
+            BundleSurface record{};
+            record.material = toBundleMaterial(surface->getMaterial());
+            record.texture = -1;
+            if (const auto& texture = surface->getTexture()) {
+                const auto [entry, isNew] = textureIndices.emplace(texture.get(),
+                                                                   static_cast<int32_t>(textures.size()));
+                if (isNew) {
+                    const auto& options = texture->getOptions();
+                    BundleTexture textureRecord{};
+                    textureRecord.width = texture->getWidth();
+                    textureRecord.height = texture->getHeight();
+                    textureRecord.format = options.format;
+                    textureRecord.layout = options.layout;
+                    textureRecord.mipmaps = options.mipmaps;
+                    textureRecord.texels = writer.append(texture->getTexels());
+                    textures.push_back(textureRecord);
+                }
+                record.texture = entry->second;
+            }
+
+            if (const auto* mesh = dynamic_cast<const Mesh*>(surface.get())) {
+                if (mesh->isCompact()) {
+                    outError = "scene bundles cannot store compact meshes";
+                    return false;
+                }
+                const auto& bvh = mesh->getBvh();
+                const auto& statistics = bvh.getStatistics();
+                record.type = BundleSurfaceType::Mesh;
+                record.points = writer.append(mesh->getPoints());
+                record.triangleVertexIndices = writer.append(mesh->getTriangleVertexIndices());
+                record.bvhWidth = mesh->getBvhWidth();
+                if (record.bvhWidth == 8) {
+                    record.bvhNodes = writer.append(mesh->getWideBvh8().getNodes());
+                } else if (record.bvhWidth == 4) {
+                    record.bvhNodes = writer.append(mesh->getWideBvh4().getNodes());
+                } else {
+                    record.bvhNodes = writer.append(bvh.getNodes());
+                }
+                record.bvhPrimitiveIndices = writer.append(bvh.getPrimitiveIndices());
+                record.triangleBlocks = writer.append(mesh->getTriangleBlocks());
+                record.leafBlocks = writer.append(mesh->getLeafBlocks());
+                record.leafBlockSize = bvh.getOptions().leafBlockSize;
+                record.sahCost = statistics.sahCost;
+                record.leafCount = statistics.leafCount;
+                record.maxDepth = statistics.maxDepth;
+                record.maxLeafPrimitiveCount = statistics.maxLeafPrimitiveCount;
+            } else if (const auto* sphere = dynamic_cast<const Sphere*>(surface.get())) {
+                record.type = BundleSurfaceType::Sphere;
+                storeVector(sphere->getCenter(), record.parameters);
+                record.parameters[3] = sphere->getRadius();
+            } else if (const auto* plane = dynamic_cast<const Plane*>(surface.get())) {
+                record.type = BundleSurfaceType::Plane;
+                storeVector(plane->getNormal(plane->getPoint()), record.parameters);
+                storeVector(plane->getPoint(), record.parameters + 3);
+            } else if (const auto* triangle = dynamic_cast<const Triangle*>(surface.get())) {
+                record.type = BundleSurfaceType::Triangle;
+                for (int i = 0; i < 3; ++i) {
+                    storeVector((*triangle)[i], record.parameters + 3 * i);
+                }
+            } else {
+                outError = "scene bundles cannot store this surface type";
+                return false;
+            }
+            surfaces.push_back(record);
+        }
+
+        BundleHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byteOrderMark = kByteOrderMark;
+        header.vector3fSize = sizeof(Vector3f);
+        header.bvhNodeSize = sizeof(BvhNode);
+        header.triangleBlockSize = sizeof(TriangleBlock);
+        header.textures = writer.append(textures.data(), textures.size());
+        header.surfaces = writer.append(surfaces.data(), surfaces.size());
+        writer.setHeader(header);
+
+        auto* fp = std::fopen(path.c_str(), "wb");
+        if (!fp) {
+            outError = path + ": " + std::strerror(errno);
+            return false;
+        }
+        const auto& bytes = writer.getBytes();
+        const bool written = std::fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size();
+        if (std::fclose(fp) != 0 || !written) {
+            outError = path + ": write failed";
+            return false;
+        }
+        return true;
+    }
+
+    bool SceneBundle::read(const std::string& path, Scene& outScene, std::string& outError) {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(path)) {
+            outError = file->getError();
+            return false;
+        }
+        const auto fail = [&](const std::string& message) {
+            outError = path + ": " + message;
+            return false;
+        };
+
+        BundleHeader header{};
+        if (file->getSize() < sizeof(header)) {
+            return fail("not a scene bundle");
+        }
+        std::memcpy(&header, file->getData(), sizeof(header));
+        if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+            return fail("not a scene bundle");
+        }
+        if (header.version != kVersion || header.byteOrderMark != kByteOrderMark ||
+            header.vector3fSize != sizeof(Vector3f) || header.bvhNodeSize != sizeof(BvhNode) ||
+            header.triangleBlockSize != sizeof(TriangleBlock)) {
+            return fail("bundle was compiled by another version or build, compile the scene again");
+        }
+
+        const BundleReader reader(file);
+        SharedArray<BundleTexture> textureRecords;
+        SharedArray<BundleSurface> surfaceRecords;
+        if (!reader.get(header.textures, textureRecords) || !reader.get(header.surfaces, surfaceRecords)) {
+            return fail("truncated bundle");
+        }
+
+        std::vector<Texture2DPtr> textures;
+        for (const auto& record: textureRecords) {
+            const TextureOptions options{record.format, record.layout, record.mipmaps != 0};
+            SharedArray<uint8_t> texels;
+            if (record.width <= 0 || record.height <= 0 || record.format > TextureFormat::RGBFloat ||
+                record.layout > TextureLayout::Tiled || !reader.get(record.texels, texels) ||
+                texels.size() != Texture2D::getByteSize(record.width, record.height, options)) {
+                return fail("invalid texture");
+            }
+            textures.push_back(std::make_shared<Texture2D>(record.width, record.height, options, std::move(texels)));
+        }
+
+        // Surfaces are only added to the scene once the whole bundle checked out.
+        std::vector<SurfacePtr> surfaces;
+        for (const auto& record: surfaceRecords) {
+            const auto material = fromBundleMaterial(record.material);
+            SurfacePtr surface;
+            switch (record.type) {
+                case BundleSurfaceType::Sphere:
+                    surface = std::make_shared<Sphere>(loadVector(record.parameters), record.parameters[3], material);
+                    break;
+                case BundleSurfaceType::Plane:
+                    surface = std::make_shared<Plane>(loadVector(record.parameters), loadVector(record.parameters + 3),
+                                                      material);
+                    break;
+                case BundleSurfaceType::Triangle:
+                    surface = std::make_shared<Triangle>(loadVector(record.parameters),
+                                                         loadVector(record.parameters + 3),
+                                                         loadVector(record.parameters + 6), material);
+                    break;
+                case BundleSurfaceType::Mesh: {
+                    SharedArray<Vector3f> points;
+                    SharedArray<Vector3i> triangleVertexIndices;
+                    SharedArray<uint32_t> primitiveIndices;
+                    SharedArray<TriangleBlock> triangleBlocks;
+                    SharedArray<uint32_t> leafBlocks;
+                    if (!reader.get(record.points, points) ||
+                        !reader.get(record.triangleVertexIndices, triangleVertexIndices) ||
+                        !reader.get(record.bvhPrimitiveIndices, primitiveIndices) ||
+                        !reader.get(record.triangleBlocks, triangleBlocks) ||
+                        !reader.get(record.leafBlocks, leafBlocks) ||
+                        record.leafCount != triangleBlocks.size() ||
+                        !areValidTriangles(triangleVertexIndices, points.size()) ||
+                        !areValidBlocks(triangleBlocks, triangleVertexIndices.size())) {
+                        return fail("invalid mesh");
+                    }
+                    BvhBuildStatistics statistics;
+                    statistics.leafCount = static_cast<size_t>(record.leafCount);
+                    statistics.maxDepth = static_cast<size_t>(record.maxDepth);
+                    statistics.maxLeafPrimitiveCount = static_cast<size_t>(record.maxLeafPrimitiveCount);
+                    statistics.sahCost = record.sahCost;
+                    BvhBuildOptions options;
+                    options.leafBlockSize = record.leafBlockSize;
+                    options.width = record.bvhWidth;
+                    if (record.bvhWidth == 4 || record.bvhWidth == 8) {
+                        // A wide mesh keeps no binary nodes, so nodeCount stays that of the binary build.
+                        statistics.nodeCount = 2 * statistics.leafCount - 1;
+                        if (!primitiveIndices.empty() || !leafBlocks.empty()) {
+                            return fail("invalid mesh");
+                        }
+                        const Bvh bvh({}, {}, statistics, options);
+                        if (record.bvhWidth == 4) {
+                            SharedArray<WideBvhNode<4>> nodes;
+                            if (!reader.get(record.bvhNodes, nodes) || nodes.empty() ||
+                                !isValidWideBvh(nodes, triangleBlocks.size())) {
+                                return fail("invalid mesh");
+                            }
+                            surface = std::make_shared<Mesh>(std::move(points), std::move(triangleVertexIndices),
+                                                             bvh, WideBvh<4>(std::move(nodes)),
+                                                             std::move(triangleBlocks));
+                        } else {
+                            SharedArray<WideBvhNode<8>> nodes;
+                            if (!reader.get(record.bvhNodes, nodes) || nodes.empty() ||
+                                !isValidWideBvh(nodes, triangleBlocks.size())) {
+                                return fail("invalid mesh");
+                            }
+                            surface = std::make_shared<Mesh>(std::move(points), std::move(triangleVertexIndices),
+                                                             bvh, WideBvh<8>(std::move(nodes)),
+                                                             std::move(triangleBlocks));
+                        }
+                    } else {
+                        SharedArray<BvhNode> nodes;
+                        if (record.bvhWidth != 2 || !reader.get(record.bvhNodes, nodes) ||
+                            primitiveIndices.size() != triangleVertexIndices.size() ||
+                            leafBlocks.size() != nodes.size() ||
+                            !isValidBvh(nodes, primitiveIndices, leafBlocks, triangleVertexIndices.size(),
+                                        triangleBlocks.size())) {
+                            return fail("invalid mesh");
+                        }
+                        statistics.nodeCount = nodes.size();
+                        Bvh bvh(std::move(nodes), std::move(primitiveIndices), statistics, options);
+                        surface = std::make_shared<Mesh>(std::move(points), std::move(triangleVertexIndices),
+                                                         std::move(bvh), std::move(triangleBlocks),
+                                                         std::move(leafBlocks));
+                    }
+                    surface->setMaterial(material);
+                    break;
+                }
+                default:
+                    return fail("unknown surface type");
+            }
+            if (record.texture >= 0) {
+                if (static_cast<size_t>(record.texture) >= textures.size()) {
+                    return fail("invalid texture index");
+                }
+                surface->setTexture(textures[record.texture]);
+            }
+            surfaces.push_back(std::move(surface));
+        }
+
+        for (const auto& surface: surfaces) {
+            outScene.addSurface(surface);
+        }
+        return true;
+    }
+}
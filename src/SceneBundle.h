@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Scene.h"
+
+#include <cstdint>
+#include <string>
+
+namespace crt {
+
+    /**
+     * Precompiled scene file. A bundle stores every surface with its material and texture, and for meshes the
+     * transformed vertices, indices, BVH nodes and triangle blocks in exactly their in-memory layout; textures keep
+     * their encoded texels and mip chain. Reading maps the file and points the surfaces straight at it, so nothing
+     * is parsed, converted or rebuilt.
+     *
+     * Bundles are tied to the build that wrote them: a different version, byte order or vector layout (see
+     * CRT_VECTOR3_PADDED) is rejected and the bundle has to be compiled again.
+     */
+    class SceneBundle {
+    public:
+        static constexpr uint32_t kVersion = 4;
+
+        /**
+         * Writes the surfaces of scene to path. Fails for surface types the bundle does not know.
+         */
+        static bool write(const Scene& scene, const std::string& path, std::string& outError);
+
+        /**
+         * Maps path and adds its surfaces to outScene. The mapping stays alive as long as any surface or
+         * texture uses it. Every index the surfaces follow at render time (BVH children and leaves, primitive and
+         * vertex indices) is checked first, so a corrupt bundle fails to read instead of crashing a render.
+         */
+        static bool read(const std::string& path, Scene& outScene, std::string& outError);
+    };
+}
@@ -0,0 +1,97 @@
+#include "SequenceTrack.h"
+
+#include "MatrixUtils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace crt {
+    Matrix4f SequenceFrame::getTransform(const Vector3f& pivot) const {
+        const auto angle = static_cast<float>(yaw * M_PI / 180.0);
+        return MatrixUtils::translate(pivot + move) * MatrixUtils::rotateByY<float>(angle) *
+               MatrixUtils::translate(Vector3f{} - pivot);
+    }
+
+    SequenceTrack SequenceTrack::makeTurntable(uint32_t frameCount, const Vector3f& eye, const Vector3f& target) {
+        if (frameCount == 0) {
+            return {};
+        }
+        // The last frame stops one step short of a full turn, so the sequence loops without a repeated frame.
+        const auto lastYaw = 360.0f * static_cast<float>(frameCount - 1) / static_cast<float>(frameCount);
+        return SequenceTrack({{0, {eye, target, 0.0f, {}}},
+                              {frameCount - 1, {eye, target, lastYaw, {}}}});
+    }
+
+    bool SequenceTrack::parse(std::istream& input, SequenceTrack& outTrack, std::string& outError) {
+        std::vector<Key> keys;
+        std::string line;
+        for (int lineNumber = 1; std::getline(input, line); ++lineNumber) {
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            std::istringstream fields(line);
+            int64_t frame = -1;
+            float values[10];
+            fields >> frame;
+            for (auto& value: values) {
+                fields >> value;
+            }
+            std::string rest;
+            if (fields.fail() || frame < 0 || frame > UINT32_MAX || (fields >> rest)) {
+                outError = "track line " + std::to_string(lineNumber) +
+                           ": expected frame eyeX eyeY eyeZ targetX targetY targetZ yaw moveX moveY moveZ";
+                return false;
+            }
+            if (!keys.empty() && static_cast<uint32_t>(frame) <= keys.back().frame) {
+                outError = "track line " + std::to_string(lineNumber) + ": frames must increase";
+                return false;
+            }
+            keys.push_back({static_cast<uint32_t>(frame),
+                            {{values[0], values[1], values[2]}, {values[3], values[4], values[5]}, values[6],
+                             {values[7], values[8], values[9]}}});
+        }
+        if (keys.empty()) {
+            outError = "track has no keyframes";
+            return false;
+        }
+        outTrack = SequenceTrack(std::move(keys));
+        return true;
+    }
+
+    bool SequenceTrack::load(const std::string& path, SequenceTrack& outTrack, std::string& outError) {
+        std::ifstream input(path);
+        if (!input) {
+            outError = "cannot open " + path;
+            return false;
+        }
+        if (!parse(input, outTrack, outError)) {
+            outError = path + ": " + outError;
+            return false;
+        }
+        return true;
+    }
+
+    SequenceFrame SequenceTrack::getFrame(uint32_t frame) const {
+        if (_keys.empty()) {
+            return {};
+        }
+        const auto next = std::upper_bound(_keys.begin(), _keys.end(), frame, [](uint32_t frame, const Key& key) {
+            return frame < key.frame;
+        });
+        if (next == _keys.begin()) {
+            return _keys.front().value;
+        }
+        if (next == _keys.end()) {
+            return _keys.back().value;
+        }
+        const auto& a = std::prev(next)->value;
+        const auto& b = next->value;
+        const auto t = static_cast<float>(frame - std::prev(next)->frame) /
+                       static_cast<float>(next->frame - std::prev(next)->frame);
+        const auto mix = [t](const auto& x, const auto& y) { return x + (y - x) * t; };
+        return {mix(a.eye, b.eye), mix(a.target, b.target), mix(a.yaw, b.yaw), mix(a.move, b.move)};
+    }
+}
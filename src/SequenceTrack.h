@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Matrix.h"
+#include "Vector.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Camera and object placement of one frame of a sequence.
+     */
+    struct SequenceFrame {
+        Vector3f eye;
+        Vector3f target;
+        // Rotation of the animated objects about the vertical axis through their pivot, in degrees.
+        float yaw = 0.0f;
+        // Translation of the animated objects, applied after the rotation.
+        Vector3f move;
+
+        /**
+         * Transform of the animated objects from their rest pose, rotating about pivot.
+         */
+        [[nodiscard]] Matrix4f getTransform(const Vector3f& pivot) const;
+    };
+
+    /**
+     * Per frame camera and transform track, given as keyframes that are interpolated linearly. Frames before the
+     * first keyframe and after the last one hold the nearest keyframe.
+     *
+     * Text form, one keyframe per line in increasing frame order, '#' starts a comment:
+     *     frame  eyeX eyeY eyeZ  targetX targetY targetZ  yaw  moveX moveY moveZ
+     */
+    class SequenceTrack {
+    public:
+        struct Key {
+            uint32_t frame;
+            SequenceFrame value;
+        };
+
+        SequenceTrack() = default;
+
+        explicit SequenceTrack(std::vector<Key> keys) : _keys(std::move(keys)) {}
+
+        /**
+         * frameCount frames with a fixed camera while the objects turn once around their pivot.
+         */
+        static SequenceTrack makeTurntable(uint32_t frameCount, const Vector3f& eye, const Vector3f& target);
+
+        static bool parse(std::istream& input, SequenceTrack& outTrack, std::string& outError);
+
+        static bool load(const std::string& path, SequenceTrack& outTrack, std::string& outError);
+
+        [[nodiscard]] bool isEmpty() const {
+            return _keys.empty();
+        }
+
+        /**
+         * One past the last keyframe.
+         */
+        [[nodiscard]] uint32_t getFrameCount() const {
+            return _keys.empty() ? 0 : _keys.back().frame + 1;
+        }
+
+        [[nodiscard]] const std::vector<Key>& getKeys() const {
+            return _keys;
+        }
+
+        [[nodiscard]] SequenceFrame getFrame(uint32_t frame) const;
+
+    private:
+        std::vector<Key> _keys;
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Material.h"
+#include "Ray.h"
+#include "Vector.h"
+
+#include <cmath>
+
+namespace crt {
+
+    struct LightSource {
+        Vector3f position;
+        Vector3f color;
+    };
+
+    /**
+     * Whitted style shading shared by the recursive and the wavefront tracer: Blinn-Phong for every light the hit
+     * point sees, plus a mirror reflection weighted by the light color on specular materials.
+     */
+    namespace Shading {
+        /**
+         * Unit direction from point to the light, outDistance receives the distance to it.
+         */
+        inline Vector3f getLightDirection(const LightSource& lightSource, const Vector3f& point, float& outDistance) {
+            const auto toLight = lightSource.position - point;
+            outDistance = toLight.getLength();
+            return toLight / outDistance;
+        }
+
+        [[nodiscard]] inline bool isReflective(const Material& material) {
+            return material.getSpecular() > 0.0f;
+        }
+
+        inline Ray reflect(const Ray& ray, const Vector3f& point, const Vector3f& normal) {
+            const auto r = ray.getDirection() - normal * 2 * normal.dot(ray.getDirection());
+            return {point, r};
+        }
+
+        /**
+         * Diffuse and specular light a visible light source adds at point. reflectedColor is the color seen in the
+         * mirror direction, or null when no reflection was traced.
+         */
+        inline Vector3f shadeLight(const LightSource& lightSource, const Material& material, const Ray& ray,
+                                   const Vector3f& point, const Vector3f& normal, const Vector3f& l,
+                                   const Vector3f* reflectedColor) {
+            const auto diffuseColor = lightSource.color * normal.dot(l);
+
+            const auto v = (ray.getOrigin() - point).normalize();
+            const auto h = (l + v).normalize();
+            auto specularColor = lightSource.color * std::pow(normal.dot(h), material.getShininess());
+            if (reflectedColor) {
+                specularColor += lightSource.color * *reflectedColor;
+            }
+            return material.getDiffuse() * diffuseColor + material.getSpecular() * specularColor;
+        }
+
+        /**
+         * Final color from the summed light, tinted by the surface color and clamped to 1.
+         */
+        inline Vector3f finish(Vector3f color, const Vector3f& surfaceColor) {
+            color *= color.dot(surfaceColor);
+            return color.min(Vector3f{1.0f, 1.0f, 1.0f});
+        }
+    }
+}
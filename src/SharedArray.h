@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Immutable array that either owns its elements or views memory kept alive by another object, e.g. a
+     * mapped scene bundle. Copies are cheap and share the elements.
+     */
+    template<typename T>
+    class SharedArray {
+    public:
+        SharedArray() = default;
+
+        explicit SharedArray(std::vector<T>&& elements) {
+            auto owned = std::make_shared<const std::vector<T>>(std::move(elements));
+            _data = owned->data();
+            _size = owned->size();
+            _owner = std::move(owned);
+            _ownsElements = true;
+        }
+
+        explicit SharedArray(const std::vector<T>& elements) : SharedArray(std::vector<T>(elements)) {}
+
+        /**
+         * Views size elements at data, which must stay valid as long as owner lives.
+         */
+        SharedArray(const T* data, size_t size, std::shared_ptr<const void> owner) : _owner(std::move(owner)),
+                                                                                    _data(data),
+                                                                                    _size(size) {}
+
+        [[nodiscard]] const T* data() const { return _data; }
+
+        [[nodiscard]] size_t size() const { return _size; }
+
+        [[nodiscard]] bool empty() const { return _size == 0; }
+
+        const T& operator[](size_t index) const { return _data[index]; }
+
+        [[nodiscard]] const T& front() const { return _data[0]; }
+
+        [[nodiscard]] const T* begin() const { return _data; }
+
+        [[nodiscard]] const T* end() const { return _data + _size; }
+
+        /**
+         * Elements for updating in place. They are copied first unless this array is their only owner, so other
+         * copies and views never see the change.
+         */
+        T* getMutableData() {
+            if (!_ownsElements || _owner.use_count() != 1) {
+                *this = SharedArray(std::vector<T>(begin(), end()));
+            }
+            return const_cast<T*>(_data);
+        }
+
+    private:
+        std::shared_ptr<const void> _owner;
+        const T* _data = nullptr;
+        size_t _size = 0;
+        // Whether _owner is the vector holding the elements rather than something a view keeps alive.
+        bool _ownsElements = false;
+    };
+}
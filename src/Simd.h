@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define CRT_SIMD_SSE 1
+#include <immintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define CRT_SIMD_AVX 1
+#endif
+
+namespace crt {
+
+    /**
+     * Fixed width float lanes used by the packet kernels. The primary templates are plain loops, SSE and AVX
+     * specializations below are picked up whenever the target supports them.
+     */
+    template<int Width>
+    class SimdMask {
+    public:
+        SimdMask() = default;
+
+        explicit SimdMask(uint32_t bits) : _bits(bits) {}
+
+        [[nodiscard]] uint32_t getBits() const { return _bits; }
+
+        [[nodiscard]] bool any() const { return _bits != 0; }
+
+        [[nodiscard]] bool get(int lane) const { return (_bits >> lane) & 1u; }
+
+        SimdMask operator&(const SimdMask& rhs) const { return SimdMask(_bits & rhs._bits); }
+
+        SimdMask operator|(const SimdMask& rhs) const { return SimdMask(_bits | rhs._bits); }
+
+    private:
+        uint32_t _bits = 0;
+    };
+
+    template<int Width>
+    class SimdFloat {
+    public:
+        static constexpr int kWidth = Width;
+        using Mask = SimdMask<Width>;
+
+        SimdFloat() = default;
+
+        explicit SimdFloat(float value) {
+            std::fill(_data, _data + Width, value);
+        }
+
+        static SimdFloat load(const float* data) {
+            SimdFloat result;
+            std::copy(data, data + Width, result._data);
+            return result;
+        }
+
+        /**
+         * Converts Width unsigned bytes, e.g. quantized coordinates, to floats. data needs no alignment.
+         */
+        static SimdFloat loadBytes(const uint8_t* data) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = static_cast<float>(data[i]);
+            return result;
+        }
+
+        void store(float* data) const {
+            std::copy(_data, _data + Width, data);
+        }
+
+        [[nodiscard]] float operator[](int lane) const { return _data[lane]; }
+
+#define CRT_SIMD_BINARY_OPERATOR(op)                                        \
+        SimdFloat operator op(const SimdFloat& rhs) const {                 \
+            SimdFloat result;                                               \
+            for (int i = 0; i < Width; ++i) result._data[i] = _data[i] op rhs._data[i]; \
+            return result;                                                  \
+        }
+        CRT_SIMD_BINARY_OPERATOR(+)
+        CRT_SIMD_BINARY_OPERATOR(-)
+        CRT_SIMD_BINARY_OPERATOR(*)
+        CRT_SIMD_BINARY_OPERATOR(/)
+#undef CRT_SIMD_BINARY_OPERATOR
+
+#define CRT_SIMD_COMPARE_OPERATOR(op)                                       \
+        Mask operator op(const SimdFloat& rhs) const {                      \
+            uint32_t bits = 0;                                              \
+            for (int i = 0; i < Width; ++i) bits |= (_data[i] op rhs._data[i] ? 1u : 0u) << i; \
+            return Mask(bits);                                              \
+        }
+        CRT_SIMD_COMPARE_OPERATOR(<)
+        CRT_SIMD_COMPARE_OPERATOR(<=)
+        CRT_SIMD_COMPARE_OPERATOR(>)
+        CRT_SIMD_COMPARE_OPERATOR(>=)
+#undef CRT_SIMD_COMPARE_OPERATOR
+
+        // Like minps/maxps: the second operand is returned when either one is NaN.
+        friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = a._data[i] < b._data[i] ? a._data[i] : b._data[i];
+            return result;
+        }
+
+        friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = a._data[i] > b._data[i] ? a._data[i] : b._data[i];
+            return result;
+        }
+
+        friend SimdFloat sqrt(const SimdFloat& a) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = std::sqrt(a._data[i]);
+            return result;
+        }
+
+        friend SimdFloat abs(const SimdFloat& a) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = std::abs(a._data[i]);
+            return result;
+        }
+
+        friend SimdFloat select(const Mask& mask, const SimdFloat& a, const SimdFloat& b) {
+            SimdFloat result;
+            for (int i = 0; i < Width; ++i) result._data[i] = mask.get(i) ? a._data[i] : b._data[i];
+            return result;
+        }
+
+    private:
+        float _data[Width];
+    };
+
+#if CRT_SIMD_SSE
+    template<>
+    class SimdMask<4> {
+    public:
+        SimdMask() : _value(_mm_setzero_ps()) {}
+
+        explicit SimdMask(__m128 value) : _value(value) {}
+
+        [[nodiscard]] uint32_t getBits() const { return static_cast<uint32_t>(_mm_movemask_ps(_value)); }
+
+        [[nodiscard]] bool any() const { return _mm_movemask_ps(_value) != 0; }
+
+        [[nodiscard]] bool get(int lane) const { return (getBits() >> lane) & 1u; }
+
+        [[nodiscard]] __m128 getValue() const { return _value; }
+
+        SimdMask operator&(const SimdMask& rhs) const { return SimdMask(_mm_and_ps(_value, rhs._value)); }
+
+        SimdMask operator|(const SimdMask& rhs) const { return SimdMask(_mm_or_ps(_value, rhs._value)); }
+
+    private:
+        __m128 _value;
+    };
+
+    template<>
+    class SimdFloat<4> {
+    public:
+        static constexpr int kWidth = 4;
+        using Mask = SimdMask<4>;
+
+        SimdFloat() : _value(_mm_setzero_ps()) {}
+
+        explicit SimdFloat(float value) : _value(_mm_set1_ps(value)) {}
+
+        explicit SimdFloat(__m128 value) : _value(value) {}
+
+        static SimdFloat load(const float* data) { return SimdFloat(_mm_load_ps(data)); }
+
+        static SimdFloat loadBytes(const uint8_t* data) {
+            int32_t bytes;
+            std::memcpy(&bytes, data, sizeof(bytes));
+            const auto zero = _mm_setzero_si128();
+            const auto words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+            return SimdFloat(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)));
+        }
+
+        void store(float* data) const { _mm_store_ps(data, _value); }
+
+        [[nodiscard]] float operator[](int lane) const {
+            alignas(16) float data[4];
+            store(data);
+            return data[lane];
+        }
+
+        SimdFloat operator+(const SimdFloat& rhs) const { return SimdFloat(_mm_add_ps(_value, rhs._value)); }
+
+        SimdFloat operator-(const SimdFloat& rhs) const { return SimdFloat(_mm_sub_ps(_value, rhs._value)); }
+
+        SimdFloat operator*(const SimdFloat& rhs) const { return SimdFloat(_mm_mul_ps(_value, rhs._value)); }
+
+        SimdFloat operator/(const SimdFloat& rhs) const { return SimdFloat(_mm_div_ps(_value, rhs._value)); }
+
+        Mask operator<(const SimdFloat& rhs) const { return Mask(_mm_cmplt_ps(_value, rhs._value)); }
+
+        Mask operator<=(const SimdFloat& rhs) const { return Mask(_mm_cmple_ps(_value, rhs._value)); }
+
+        Mask operator>(const SimdFloat& rhs) const { return Mask(_mm_cmpgt_ps(_value, rhs._value)); }
+
+        Mask operator>=(const SimdFloat& rhs) const { return Mask(_mm_cmpge_ps(_value, rhs._value)); }
+
+        friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) { return SimdFloat(_mm_min_ps(a._value, b._value)); }
+
+        friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) { return SimdFloat(_mm_max_ps(a._value, b._value)); }
+
+        friend SimdFloat sqrt(const SimdFloat& a) { return SimdFloat(_mm_sqrt_ps(a._value)); }
+
+        friend SimdFloat abs(const SimdFloat& a) {
+            return SimdFloat(_mm_andnot_ps(_mm_set1_ps(-0.0f), a._value));
+        }
+
+        friend SimdFloat select(const Mask& mask, const SimdFloat& a, const SimdFloat& b) {
+            return SimdFloat(_mm_or_ps(_mm_and_ps(mask.getValue(), a._value),
+                                       _mm_andnot_ps(mask.getValue(), b._value)));
+        }
+
+    private:
+        __m128 _value;
+    };
+#endif
+
+#if CRT_SIMD_AVX
+    template<>
+    class SimdMask<8> {
+    public:
+        SimdMask() : _value(_mm256_setzero_ps()) {}
+
+        explicit SimdMask(__m256 value) : _value(value) {}
+
+        [[nodiscard]] uint32_t getBits() const { return static_cast<uint32_t>(_mm256_movemask_ps(_value)); }
+
+        [[nodiscard]] bool any() const { return _mm256_movemask_ps(_value) != 0; }
+
+        [[nodiscard]] bool get(int lane) const { return (getBits() >> lane) & 1u; }
+
+        [[nodiscard]] __m256 getValue() const { return _value; }
+
+        SimdMask operator&(const SimdMask& rhs) const { return SimdMask(_mm256_and_ps(_value, rhs._value)); }
+
+        SimdMask operator|(const SimdMask& rhs) const { return SimdMask(_mm256_or_ps(_value, rhs._value)); }
+
+    private:
+        __m256 _value;
+    };
+
+    template<>
+    class SimdFloat<8> {
+    public:
+        static constexpr int kWidth = 8;
+        using Mask = SimdMask<8>;
+
+        SimdFloat() : _value(_mm256_setzero_ps()) {}
+
+        explicit SimdFloat(float value) : _value(_mm256_set1_ps(value)) {}
+
+        explicit SimdFloat(__m256 value) : _value(value) {}
+
+        static SimdFloat load(const float* data) { return SimdFloat(_mm256_load_ps(data)); }
+
+        static SimdFloat loadBytes(const uint8_t* data) {
+#if defined(__AVX2__)
+            const auto bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+            return SimdFloat(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)));
+#else
+            alignas(32) float values[8];
+            SimdFloat<4>::loadBytes(data).store(values);
+            SimdFloat<4>::loadBytes(data + 4).store(values + 4);
+            return load(values);
+#endif
+        }
+
+        void store(float* data) const { _mm256_store_ps(data, _value); }
+
+        [[nodiscard]] float operator[](int lane) const {
+            alignas(32) float data[8];
+            store(data);
+            return data[lane];
+        }
+
+        SimdFloat operator+(const SimdFloat& rhs) const { return SimdFloat(_mm256_add_ps(_value, rhs._value)); }
+
+        SimdFloat operator-(const SimdFloat& rhs) const { return SimdFloat(_mm256_sub_ps(_value, rhs._value)); }
+
+        SimdFloat operator*(const SimdFloat& rhs) const { return SimdFloat(_mm256_mul_ps(_value, rhs._value)); }
+
+        SimdFloat operator/(const SimdFloat& rhs) const { return SimdFloat(_mm256_div_ps(_value, rhs._value)); }
+
+        Mask operator<(const SimdFloat& rhs) const { return Mask(_mm256_cmp_ps(_value, rhs._value, _CMP_LT_OQ)); }
+
+        Mask operator<=(const SimdFloat& rhs) const { return Mask(_mm256_cmp_ps(_value, rhs._value, _CMP_LE_OQ)); }
+
+        Mask operator>(const SimdFloat& rhs) const { return Mask(_mm256_cmp_ps(_value, rhs._value, _CMP_GT_OQ)); }
+
+        Mask operator>=(const SimdFloat& rhs) const { return Mask(_mm256_cmp_ps(_value, rhs._value, _CMP_GE_OQ)); }
+
+        friend SimdFloat min(const SimdFloat& a, const SimdFloat& b) {
+            return SimdFloat(_mm256_min_ps(a._value, b._value));
+        }
+
+        friend SimdFloat max(const SimdFloat& a, const SimdFloat& b) {
+            return SimdFloat(_mm256_max_ps(a._value, b._value));
+        }
+
+        friend SimdFloat sqrt(const SimdFloat& a) { return SimdFloat(_mm256_sqrt_ps(a._value)); }
+
+        friend SimdFloat abs(const SimdFloat& a) {
+            return SimdFloat(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a._value));
+        }
+
+        friend SimdFloat select(const Mask& mask, const SimdFloat& a, const SimdFloat& b) {
+            return SimdFloat(_mm256_blendv_ps(b._value, a._value, mask.getValue()));
+        }
+
+    private:
+        __m256 _value;
+    };
+#endif
+
+#if CRT_SIMD_AVX
+    constexpr int kSimdWidth = 8;
+#else
+    constexpr int kSimdWidth = 4;
+#endif
+
+    using SimdFloatN = SimdFloat<kSimdWidth>;
+    using SimdMaskN = SimdMask<kSimdWidth>;
+}
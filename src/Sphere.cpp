@@ -1,5 +1,7 @@
 #include "Sphere.h"
 
+#include "MathUtils.h"
+
 namespace crt {
     bool Sphere::intersect(const crt::Ray& ray) const {
         Vector3f oc = ray.getOrigin() - _center;
@@ -11,47 +13,64 @@ namespace crt {
     }
 
     bool Sphere::intersect(const Ray& ray, float& outT) const {
-        const auto& oc = ray.getOrigin() - _center;
-        const float a = ray.getDirection().dot(ray.getDirection());
-        const float b = 2.0f * oc.dot(ray.getDirection());
-        const float c = oc.dot(oc) - _radius * _radius;
-        const float discriminant = b * b - 4.0f * a * c;
-        if (discriminant < 0.0f) {
-            return false;
-        }
-        if (discriminant == 0.0f) {
-            outT = -b / (2.0f * a);
-            return true;
-        } else {
-            const float t1 = (-b - std::sqrt(discriminant)) / (2.0f * a);
-            const float t2 = (-b + std::sqrt(discriminant)) / (2.0f * a);
-            if (t1 < 0.0f && t2 < 0.0f) {
-                return false;
-            }
-            if (t1 < 0.0f) {
-                outT = t2;
-            } else if (t2 < 0.0f) {
-                outT = t1;
-            } else {
-                outT = std::min(t1, t2);
-            }
-            return true;
-        }
+        return MathUtils::rayIntersectsSphere(ray, _center, _radius, outT);
     }
 
-    bool Sphere::hit(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const {
+    bool Sphere::intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const {
         float t;
         if (intersect(ray, t) && t >= tMin && t <= tMax) {
-            outRecord.t = t;
-            outRecord.p = ray.getPoint(t);
-            outRecord.normal = (outRecord.p - _center) / _radius;
-            outRecord.material = getMaterial();
-            outRecord.color = getColor(outRecord.p);
+            outHit = {t, 0, 0.0f, 0.0f, this};
             return true;
         }
         return false;
     }
 
+    void Sphere::resolveHit(const Ray& ray, float t, uint32_t, float, float, HitRecord& outRecord) const {
+        outRecord.t = t;
+        outRecord.p = ray.getPoint(t);
+        outRecord.normal = (outRecord.p - _center) / _radius;
+        outRecord.material = &getMaterial();
+        outRecord.color = getColor(outRecord.p, ray.getFootprint(t));
+    }
+
+    bool Sphere::occluded(const Ray& ray, float tMin, float tMax) const {
+        return MathUtils::rayIntersectsSphere(ray, _center, _radius, tMin, tMax);
+    }
+
+    bool Sphere::boundingBox(BoundingBox<float> &outBox) const {
+        const Vector3f extent{_radius, _radius, _radius};
+        outBox = BoundingBox<float>(_center - extent, _center + extent);
+        return true;
+    }
+
+    bool Sphere::transform(const Matrix4f &transform) {
+        // Only rotations, translations and uniform scales keep a sphere a sphere: the images of the axes have to
+        // be pairwise orthogonal and of one nonzero length.
+        Vector3f axes[3];
+        float scales[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            Vector4f direction{0.0f, 0.0f, 0.0f, 0.0f};
+            direction[axis] = 1.0f;
+            axes[axis] = (transform * direction).getXYZ();
+            scales[axis] = axes[axis].getLength();
+        }
+        if (!(scales[0] > 0.0f)) {
+            return false;
+        }
+        const auto tolerance = 1e-4f * scales[0];
+        if (std::abs(scales[1] - scales[0]) > tolerance || std::abs(scales[2] - scales[0]) > tolerance) {
+            return false;
+        }
+        const auto dotTolerance = tolerance * scales[0];
+        if (std::abs(axes[0].dot(axes[1])) > dotTolerance || std::abs(axes[0].dot(axes[2])) > dotTolerance ||
+            std::abs(axes[1].dot(axes[2])) > dotTolerance) {
+            return false;
+        }
+        _center = (transform * Vector4f{_center.getX(), _center.getY(), _center.getZ(), 1.0f}).getXYZ();
+        _radius *= scales[0];
+        return true;
+    }
+
     Vector2f Sphere::getUV(const Vector3f &p) const{
         const auto& d = p - _center;
         const auto phi = std::atan2(d.getZ(), d.getX());
@@ -26,11 +26,32 @@ namespace crt {
 
         [[nodiscard]] Vector2f getUV(const Vector3f &p) const override;
 
+        [[nodiscard]] Vector2f getUVScale() const override {
+            // u runs around the equator, a full great circle, and v from pole to pole, half of one.
+            return {static_cast<float>(M_1_PI) * 0.5f / _radius, static_cast<float>(M_1_PI) / _radius};
+        }
+
         [[nodiscard]] bool intersect(const Ray &ray) const;
 
         [[nodiscard]] bool intersect(const Ray &ray, float &outT) const;
 
-        bool hit(const Ray &ray, float tMin, float tMax, HitRecord &record) const override;
+        bool intersect(const Ray &ray, float tMin, float tMax, SurfaceHit &outHit) const override;
+
+        [[nodiscard]] bool occluded(const Ray &ray, float tMin, float tMax) const override;
+
+        void hitPacket(RayPacket &packet, PacketHit &outHit) const override {
+            PacketKernels::intersectSphere(packet, outHit, _center, _radius, this);
+        }
+
+        void resolveHit(const Ray &ray, float t, uint32_t primitive, float u, float v,
+                        HitRecord &outRecord) const override;
+
+        bool boundingBox(BoundingBox<float> &outBox) const override;
+
+        /**
+         * Fails for transforms that scale the axes differently.
+         */
+        bool transform(const Matrix4f &transform) override;
 
     private:
 
@@ -0,0 +1,104 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <vector>
+
+namespace crt {
+    namespace {
+        struct Registry {
+            std::mutex mutex;
+            std::vector<TraversalCounters*> threads;
+            // Counts of threads that already ended.
+            TraversalCounters finished;
+        };
+
+        Registry& getRegistry() {
+            // Never destroyed, so threads ending during static destruction can still unregister.
+            static auto* registry = new Registry;
+            return *registry;
+        }
+    }
+
+    void TraversalCounters::add(const TraversalCounters& other) {
+        closestHitRays += other.closestHitRays;
+        occlusionRays += other.occlusionRays;
+        reflectionRays += other.reflectionRays;
+        boxTests += other.boxTests;
+        triangleTests += other.triangleTests;
+        primitiveTests += other.primitiveTests;
+        meshQueries += other.meshQueries;
+        maxReflectionDepth = std::max(maxReflectionDepth, other.maxReflectionDepth);
+    }
+
+    Statistics::ThreadCounters::ThreadCounters() {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.threads.push_back(&counters);
+    }
+
+    Statistics::ThreadCounters::~ThreadCounters() {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.finished.add(counters);
+        registry.threads.erase(std::remove(registry.threads.begin(), registry.threads.end(), &counters),
+                               registry.threads.end());
+    }
+
+    TraversalCounters Statistics::collect() {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        auto total = registry.finished;
+        for (const auto* counters: registry.threads) {
+            total.add(*counters);
+        }
+        return total;
+    }
+
+    void Statistics::reset() {
+        auto& registry = getRegistry();
+        std::lock_guard lock(registry.mutex);
+        registry.finished = {};
+        for (auto* counters: registry.threads) {
+            *counters = {};
+        }
+    }
+
+    void Statistics::print(const TraversalCounters& counters, std::ostream& output) {
+        const auto perRay = [&](uint64_t count) {
+            return counters.getRayCount() > 0 ? static_cast<double>(count) / counters.getRayCount() : 0.0;
+        };
+        output << "Traversal statistics:\n"
+               << "  closest hit rays  " << counters.closestHitRays << " (" << counters.reflectionRays
+               << " reflections, deepest bounce " << counters.maxReflectionDepth << ")\n"
+               << "  occlusion rays    " << counters.occlusionRays << "\n"
+               << "  box tests         " << counters.boxTests << " (" << perRay(counters.boxTests) << " per ray)\n"
+               << "  triangle tests    " << counters.triangleTests << " (" << perRay(counters.triangleTests)
+               << " per ray)\n"
+               << "  primitive tests   " << counters.primitiveTests << " (" << perRay(counters.primitiveTests)
+               << " per ray)\n"
+               << "  mesh queries      " << counters.meshQueries << std::endl;
+    }
+
+    Vector3f Statistics::getHeatColor(float value) {
+        static const Vector3f kStops[] = {
+                {0.0f, 0.0f, 0.3f},
+                {0.0f, 0.4f, 1.0f},
+                {0.0f, 0.9f, 0.4f},
+                {1.0f, 0.9f, 0.0f},
+                {1.0f, 0.1f, 0.0f},
+        };
+        constexpr int kSegmentCount = static_cast<int>(std::size(kStops)) - 1;
+        if (!(value >= 0.0f)) {
+            return kStops[0];
+        }
+        if (value > 1.0f) {
+            return {1.0f, 1.0f, 1.0f};
+        }
+        const auto position = value * kSegmentCount;
+        const auto segment = std::min(static_cast<int>(position), kSegmentCount - 1);
+        const auto weight = position - static_cast<float>(segment);
+        return kStops[segment] * (1.0f - weight) + kStops[segment + 1] * weight;
+    }
+}
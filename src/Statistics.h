@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Vector.h"
+
+#include <cstdint>
+#include <ostream>
+
+// Traversal counters cost a thread local access per box and triangle test, so they are only compiled in on request.
+#ifndef CRT_ENABLE_STATISTICS
+#define CRT_ENABLE_STATISTICS 0
+#endif
+
+namespace crt {
+
+    /**
+     * What tracing did, as counted by one thread. Packet kernels count one test per packet, not per lane.
+     */
+    struct TraversalCounters {
+        // Closest hit queries, camera and reflection rays; packets count their active lanes.
+        uint64_t closestHitRays = 0;
+        // Any hit queries, i.e. shadow rays.
+        uint64_t occlusionRays = 0;
+        uint64_t reflectionRays = 0;
+        // Bounding box slab tests, BVH nodes included.
+        uint64_t boxTests = 0;
+        // Ray/triangle tests, a SIMD triangle block counts as many tests as it has lanes.
+        uint64_t triangleTests = 0;
+        // Ray tests against spheres and planes.
+        uint64_t primitiveTests = 0;
+        // Queries that descended into a mesh hierarchy.
+        uint64_t meshQueries = 0;
+        // Deepest reflection bounce reached.
+        uint32_t maxReflectionDepth = 0;
+
+        void add(const TraversalCounters& other);
+
+        [[nodiscard]] uint64_t getRayCount() const {
+            return closestHitRays + occlusionRays;
+        }
+
+        [[nodiscard]] uint64_t getIntersectionTests() const {
+            return triangleTests + primitiveTests;
+        }
+    };
+
+    namespace Statistics {
+        constexpr bool kEnabled = CRT_ENABLE_STATISTICS != 0;
+
+        /**
+         * Counters of one thread, registered for collect on first use and folded into a global total when the
+         * thread ends.
+         */
+        class ThreadCounters {
+        public:
+            ThreadCounters();
+
+            ~ThreadCounters();
+
+            ThreadCounters(const ThreadCounters&) = delete;
+
+            ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+            TraversalCounters counters;
+        };
+
+        inline thread_local ThreadCounters threadCounters;
+
+        /**
+         * Counters of the calling thread, which counts into them without synchronization.
+         */
+        inline TraversalCounters& getThreadCounters() {
+            return threadCounters.counters;
+        }
+
+        /**
+         * Sum over every thread that counted, finished threads included. Only meaningful while no thread is
+         * tracing, e.g. after Renderer::render returned.
+         */
+        TraversalCounters collect();
+
+        /**
+         * Zeroes the counters of all threads, with the same restriction as collect.
+         */
+        void reset();
+
+        void print(const TraversalCounters& counters, std::ostream& output);
+
+        /**
+         * False color for a cost in [0, 1]: dark blue through cyan, green and yellow to red, white above 1.
+         */
+        Vector3f getHeatColor(float value);
+    }
+}
+
+#if CRT_ENABLE_STATISTICS
+#define CRT_COUNT(counter, amount) (::crt::Statistics::getThreadCounters().counter += (amount))
+#define CRT_COUNT_MAX(counter, value) do { \
+        auto& crtCounter = ::crt::Statistics::getThreadCounters().counter; \
+        crtCounter = crtCounter < (value) ? (value) : crtCounter; \
+    } while (false)
+#else
+#define CRT_COUNT(counter, amount) ((void) 0)
+#define CRT_COUNT_MAX(counter, value) ((void) 0)
+#endif
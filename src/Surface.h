@@ -3,6 +3,9 @@
 #include "Ray.h"
 #include "HitRecord.h"
 #include "Texture2D.h"
+#include "BoundingBox.h"
+#include "Matrix.h"
+#include "RayPacket.h"
 
 #include <memory>
 #include <utility>
@@ -22,23 +25,90 @@ namespace crt {
 
         virtual ~Surface() = default;
 
-        virtual bool hit(const Ray &ray, float tMin, float tMax, HitRecord &outRecord) const = 0;
+        /**
+         * Traversal phase: finds the closest intersection within [tMin, tMax] and records only its distance,
+         * primitive and barycentrics. Nothing is shaded, so it is cheap to call for every candidate surface.
+         */
+        virtual bool intersect(const Ray &ray, float tMin, float tMax, SurfaceHit &outHit) const = 0;
+
+        /**
+         * Closest hit with the full record, i.e. intersect followed by resolveHit.
+         */
+        bool hit(const Ray &ray, float tMin, float tMax, HitRecord &outRecord) const {
+            SurfaceHit surfaceHit{};
+            if (!intersect(ray, tMin, tMax, surfaceHit)) {
+                return false;
+            }
+            resolveHit(ray, surfaceHit.t, surfaceHit.primitive, surfaceHit.u, surfaceHit.v, outRecord);
+            return true;
+        }
 
-        [[nodiscard]] virtual bool hit(const Ray &ray, float tMin, float tMax) const {
-            HitRecord record{};
-            return hit(ray, tMin, tMax, record);
+        [[nodiscard]] bool hit(const Ray &ray, float tMin, float tMax) const {
+            SurfaceHit surfaceHit{};
+            return intersect(ray, tMin, tMax, surfaceHit);
         }
 
-        [[nodiscard]] virtual bool hit(const Ray &ray, HitRecord &outRecord) const {
+        bool hit(const Ray &ray, HitRecord &outRecord) const {
             return hit(ray, 0.0f, std::numeric_limits<float>::max(), outRecord);
         }
 
+        /**
+         * Occlusion query: true if the ray hits the surface anywhere within [tMin, tMax].
+         * Unlike hit() it may stop at any intersection and never shades.
+         */
+        [[nodiscard]] virtual bool occluded(const Ray &ray, float tMin, float tMax) const {
+            return hit(ray, tMin, tMax);
+        }
+
+        /**
+         * Intersects every active lane of the packet and records hits closer than the lane's tMax.
+         * The default traces lane by lane, surfaces with a SIMD kernel override it.
+         */
+        virtual void hitPacket(RayPacket &packet, PacketHit &outHit) const {
+            for (int lane = 0; lane < packet.size; ++lane) {
+                SurfaceHit surfaceHit{};
+                if (packet.isActive(lane) &&
+                    intersect(packet.getRay(lane), packet.tMin[lane], packet.tMax[lane], surfaceHit) &&
+                    surfaceHit.t < packet.tMax[lane]) {
+                    packet.tMax[lane] = surfaceHit.t;
+                    outHit.surface[lane] = this;
+                    outHit.primitive[lane] = surfaceHit.primitive;
+                    outHit.u[lane] = surfaceHit.u;
+                    outHit.v[lane] = surfaceHit.v;
+                }
+            }
+        }
+
+        /**
+         * Shades a hit found by intersect or hitPacket: fills outRecord from the hit distance, primitive and
+         * barycentrics. Only ever called for the closest hit.
+         */
+        virtual void resolveHit(const Ray &ray, float t, uint32_t primitive, float u, float v,
+                                HitRecord &outRecord) const = 0;
+
         [[nodiscard]] virtual Vector2f getUV(const Vector3f &p) const = 0;
 
+        /**
+         * How fast u and v change per world unit along the surface, which turns a ray footprint into a mip level.
+         * 0, the default, always samples the full resolution level.
+         */
+        [[nodiscard]] virtual Vector2f getUVScale() const {
+            return {0.0f, 0.0f};
+        }
+
         [[nodiscard]] Vector3f getColor(const Vector3f &p) const {
-            const auto uv = getUV(p);
             if (_texture) {
-                return _texture->getColor(uv);
+                return _texture->getColor(getUV(p));
+            }
+            return {1.0f, 1.0f, 1.0f};
+        }
+
+        /**
+         * Texture color filtered over a footprint of the given world space width, see Ray::getFootprint.
+         */
+        [[nodiscard]] Vector3f getColor(const Vector3f &p, float footprint) const {
+            if (_texture) {
+                return _texture->getColor(getUV(p), getUVScale() * footprint);
             }
             return {1.0f, 1.0f, 1.0f};
         }
@@ -63,9 +133,19 @@ namespace crt {
             _texture = texture;
         }
 
-
-
-//        virtual bool boundingBox(float t0, float t1, AABB& outBox) const = 0;
+        /**
+         * World space bounds of the surface. Returns false for unbounded surfaces such as planes.
+         */
+        virtual bool boundingBox(BoundingBox<float> &outBox) const = 0;
+
+        /**
+         * Moves the surface in place by transform. Returns false, leaving the surface as it was, for surfaces that
+         * cannot follow the transform. A surface that is part of a Scene has to be reported with
+         * Scene::updateSurface afterwards (or be moved through Scene::transformSurface).
+         */
+        virtual bool transform(const Matrix4f &) {
+            return false;
+        }
 
     private:
         Material _material;
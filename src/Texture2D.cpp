@@ -1,43 +1,302 @@
 #include "Texture2D.h"
 
-crt::Texture2D::Texture2D(int width, int height, const std::vector<Vector3f> &pixels) : _width(width), _height(height),
-                                                                                        _pixels(pixels) {
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    size_t getTexelSize(crt::TextureFormat format) {
+        switch (format) {
+            case crt::TextureFormat::RGB8:
+                return 3;
+            case crt::TextureFormat::RGBA8:
+                return 4;
+            case crt::TextureFormat::RGBHalf:
+                return 6;
+            case crt::TextureFormat::RGBFloat:
+                return 12;
+        }
+        return 0;
+    }
+
+    // Round to nearest even, overflow becomes infinity and tiny values become half subnormals or zero.
+    uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+        const auto biasedExponent = (bits >> 23) & 0xffu;
+        auto mantissa = bits & 0x7fffffu;
+        if (biasedExponent == 0xffu) {
+            return sign | 0x7c00u | (mantissa ? 0x200u : 0u);
+        }
+        const auto exponent = static_cast<int>(biasedExponent) - 127 + 15;
+        if (exponent >= 31) {
+            return sign | 0x7c00u;
+        }
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return sign;
+            }
+            mantissa |= 0x800000u;
+            const auto shift = static_cast<uint32_t>(14 - exponent);
+            auto half = mantissa >> shift;
+            const auto rest = mantissa & ((1u << shift) - 1u);
+            const auto halfway = 1u << (shift - 1u);
+            if (rest > halfway || (rest == halfway && (half & 1u))) {
+                ++half;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        auto half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+        const auto rest = mantissa & 0x1fffu;
+        // A carry out of the mantissa correctly bumps the exponent, up to infinity.
+        if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    float halfToFloat(uint16_t half) {
+        const auto sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+        auto exponent = static_cast<uint32_t>(half >> 10) & 0x1fu;
+        auto mantissa = static_cast<uint32_t>(half) & 0x3ffu;
+        uint32_t bits;
+        if (exponent == 0x1fu) {
+            bits = sign | 0x7f800000u | (mantissa << 13);
+        } else if (exponent != 0) {
+            bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+        } else if (mantissa == 0) {
+            bits = sign;
+        } else {
+            exponent = 113;
+            while (!(mantissa & 0x400u)) {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void encodeTexel(const crt::Vector3f &color, crt::TextureFormat format, uint8_t *outTexel) {
+        switch (format) {
+            case crt::TextureFormat::RGB8:
+            case crt::TextureFormat::RGBA8:
+                for (int i = 0; i < 3; ++i) {
+                    outTexel[i] = static_cast<uint8_t>(std::lround(std::clamp(color[i], 0.0f, 1.0f) * 255.0f));
+                }
+                if (format == crt::TextureFormat::RGBA8) {
+                    outTexel[3] = 255;
+                }
+                break;
+            case crt::TextureFormat::RGBHalf:
+                for (int i = 0; i < 3; ++i) {
+                    const auto half = floatToHalf(color[i]);
+                    std::memcpy(outTexel + i * sizeof(half), &half, sizeof(half));
+                }
+                break;
+            case crt::TextureFormat::RGBFloat:
+                for (int i = 0; i < 3; ++i) {
+                    const auto value = color[i];
+                    std::memcpy(outTexel + i * sizeof(value), &value, sizeof(value));
+                }
+                break;
+        }
+    }
+
+    crt::Vector3f decodeTexel(const uint8_t *texel, crt::TextureFormat format) {
+        switch (format) {
+            case crt::TextureFormat::RGB8:
+            case crt::TextureFormat::RGBA8:
+                return {static_cast<float>(texel[0]) / 255.0f,
+                        static_cast<float>(texel[1]) / 255.0f,
+                        static_cast<float>(texel[2]) / 255.0f};
+            case crt::TextureFormat::RGBHalf: {
+                uint16_t halves[3];
+                std::memcpy(halves, texel, sizeof(halves));
+                return {halfToFloat(halves[0]), halfToFloat(halves[1]), halfToFloat(halves[2])};
+            }
+            case crt::TextureFormat::RGBFloat: {
+                float values[3];
+                std::memcpy(values, texel, sizeof(values));
+                return {values[0], values[1], values[2]};
+            }
+        }
+        return {};
+    }
+
+    std::vector<crt::Vector3f> convertRGB8(int width, int height, const std::vector<uint8_t> &rgb8) {
+        assert(rgb8.size() == static_cast<size_t>(width) * height * 3);
+        std::vector<crt::Vector3f> pixels(static_cast<size_t>(width) * height);
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            pixels[i] = crt::Vector3f{
+                    static_cast<float>(rgb8[i * 3 + 0]) / 255.0f,
+                    static_cast<float>(rgb8[i * 3 + 1]) / 255.0f,
+                    static_cast<float>(rgb8[i * 3 + 2]) / 255.0f
+            };
+        }
+        return pixels;
+    }
+}
+
+crt::Texture2D::Texture2D(int width, int height, const std::vector<Vector3f> &pixels, const TextureOptions &options)
+        : _width(width), _height(height), _options(options), _levels(makeLevels(width, height, options)) {
     assert(width > 0);
     assert(height > 0);
-    assert(pixels.size() == width * height);
+    assert(pixels.size() == static_cast<size_t>(width) * height);
+    encode(pixels);
 }
 
-crt::Texture2D::Texture2D(int width, int height, std::vector<Vector3f> &&pixels) : _width(width), _height(height),
-                                                                                   _pixels(std::move(pixels)) {
+crt::Texture2D::Texture2D(int width, int height, const std::vector<uint8_t> &rgb8, const TextureOptions &options)
+        : _width(width), _height(height), _options(options), _levels(makeLevels(width, height, options)) {
     assert(width > 0);
     assert(height > 0);
-    assert(pixels.size() == width * height);
+    encode(convertRGB8(width, height, rgb8));
+}
+
+crt::Texture2D::Texture2D(int width, int height, const TextureOptions &options, SharedArray<uint8_t> texels)
+        : _width(width), _height(height), _options(options), _levels(makeLevels(width, height, options)),
+          _texels(std::move(texels)) {
+    assert(width > 0);
+    assert(height > 0);
+    assert(_texels.size() == getByteSize(width, height, options));
+}
+
+std::vector<crt::Texture2D::Level> crt::Texture2D::makeLevels(int width, int height, const TextureOptions &options) {
+    std::vector<Level> levels;
+    size_t offset = 0;
+    while (true) {
+        const Level level{width, height, (width + kTileSize - 1) / kTileSize, offset};
+        levels.push_back(level);
+        offset += getLevelByteSize(level, options);
+        if (!options.mipmaps || (width == 1 && height == 1)) {
+            break;
+        }
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return levels;
+}
+
+size_t crt::Texture2D::getByteSize(int width, int height, const TextureOptions &options) {
+    const auto levels = makeLevels(width, height, options);
+    return levels.back().offset + getLevelByteSize(levels.back(), options);
+}
+
+size_t crt::Texture2D::getLevelByteSize(const Level &level, const TextureOptions &options) {
+    const auto texelSize = getTexelSize(options.format);
+    if (options.layout == TextureLayout::Linear) {
+        return static_cast<size_t>(level.width) * level.height * texelSize;
+    }
+    // Partial tiles at the right and bottom edge are padded to full tiles.
+    const auto tileRows = (level.height + kTileSize - 1) / kTileSize;
+    return static_cast<size_t>(level.tileColumns) * tileRows * kTileSize * kTileSize * texelSize;
+}
+
+size_t crt::Texture2D::getTexelOffset(const Level &level, int x, int y, const TextureOptions &options) {
+    const auto texelSize = getTexelSize(options.format);
+    if (options.layout == TextureLayout::Linear) {
+        return level.offset + (static_cast<size_t>(y) * level.width + x) * texelSize;
+    }
+    const auto tile = static_cast<size_t>(y / kTileSize) * level.tileColumns + x / kTileSize;
+    const auto texelInTile = (y % kTileSize) * kTileSize + x % kTileSize;
+    return level.offset + (tile * kTileSize * kTileSize + texelInTile) * texelSize;
 }
 
+void crt::Texture2D::encode(std::vector<Vector3f> pixels) {
+    std::vector<uint8_t> texels(getByteSize(_width, _height, _options), 0);
+    for (size_t levelIndex = 0; levelIndex < _levels.size(); ++levelIndex) {
+        const auto &level = _levels[levelIndex];
+        for (int y = 0; y < level.height; ++y) {
+            for (int x = 0; x < level.width; ++x) {
+                encodeTexel(pixels[static_cast<size_t>(y) * level.width + x], _options.format,
+                            texels.data() + getTexelOffset(level, x, y, _options));
+            }
+        }
+        if (levelIndex + 1 == _levels.size()) {
+            break;
+        }
+
+        // Box filter the float texels of this level, so rounding errors do not accumulate down the chain. The last
+        // texel of an odd sized axis also takes the column or row that halving drops.
+        const auto &next = _levels[levelIndex + 1];
+        std::vector<Vector3f> nextPixels(static_cast<size_t>(next.width) * next.height);
+        for (int y = 0; y < next.height; ++y) {
+            const auto y0 = std::min(y * 2, level.height - 1);
+            const auto y1 = y + 1 == next.height ? level.height : y * 2 + 2;
+            for (int x = 0; x < next.width; ++x) {
+                const auto x0 = std::min(x * 2, level.width - 1);
+                const auto x1 = x + 1 == next.width ? level.width : x * 2 + 2;
+                Vector3f sum{0.0f, 0.0f, 0.0f};
+                for (auto sourceY = y0; sourceY < y1; ++sourceY) {
+                    for (auto sourceX = x0; sourceX < x1; ++sourceX) {
+                        sum = sum + pixels[static_cast<size_t>(sourceY) * level.width + sourceX];
+                    }
+                }
+                nextPixels[static_cast<size_t>(y) * next.width + x] =
+                        sum * (1.0f / static_cast<float>((x1 - x0) * (y1 - y0)));
+            }
+        }
+        pixels = std::move(nextPixels);
+    }
+    _texels = SharedArray<uint8_t>(std::move(texels));
+}
+
+crt::Vector3f crt::Texture2D::getPixel(int x, int y, int level) const {
+    return decodeTexel(_texels.data() + getTexelOffset(_levels[level], x, y, _options), _options.format);
+}
 
 template<class T>
 static T lerp(T x0, T x1, float frac) {
     return x0 + (x1 - x0) * frac;
 }
 
-crt::Vector3f crt::Texture2D::getColor(const crt::Vector2f &uv) const {
-    const auto x = uv.getX() * static_cast<float>(_width);
-    const auto y = uv.getY() * static_cast<float>(_height);
+crt::Vector3f crt::Texture2D::sampleBilinear(const Level &level, const Vector2f &uv) const {
+    const auto x = uv.getX() * static_cast<float>(level.width);
+    const auto y = uv.getY() * static_cast<float>(level.height);
     const auto xFloor = std::floor(x);
     const auto yFloor = std::floor(y);
     const auto xCeil = std::ceil(x);
     const auto yCeil = std::ceil(y);
     const auto xFrac = x - xFloor;
     const auto yFrac = y - yFloor;
-    const auto x0 = static_cast<int>(xFloor);
-    const auto y0 = static_cast<int>(yFloor);
-    const auto x1 = static_cast<int>(xCeil);
-    const auto y1 = static_cast<int>(yCeil);
-    const auto c00 = _pixels[y0 * _width + x0];
-    const auto c01 = _pixels[y0 * _width + x1];
-    const auto c10 = _pixels[y1 * _width + x0];
-    const auto c11 = _pixels[y1 * _width + x1];
+    // u == 1 or v == 1 would step past the last column or row.
+    const auto x0 = std::clamp(static_cast<int>(xFloor), 0, level.width - 1);
+    const auto y0 = std::clamp(static_cast<int>(yFloor), 0, level.height - 1);
+    const auto x1 = std::clamp(static_cast<int>(xCeil), 0, level.width - 1);
+    const auto y1 = std::clamp(static_cast<int>(yCeil), 0, level.height - 1);
+    const auto fetch = [&](int texelX, int texelY) {
+        return decodeTexel(_texels.data() + getTexelOffset(level, texelX, texelY, _options), _options.format);
+    };
+    const auto c00 = fetch(x0, y0);
+    const auto c01 = fetch(x1, y0);
+    const auto c10 = fetch(x0, y1);
+    const auto c11 = fetch(x1, y1);
     const auto c0 = lerp(c00, c01, xFrac);
     const auto c1 = lerp(c10, c11, xFrac);
     return lerp(c0, c1, yFrac);
 }
+
+crt::Vector3f crt::Texture2D::getColor(const crt::Vector2f &uv) const {
+    return sampleBilinear(_levels.front(), uv);
+}
+
+crt::Vector3f crt::Texture2D::getColor(const crt::Vector2f &uv, const crt::Vector2f &footprint) const {
+    // Level l has 2^l times larger texels, pick the one where the footprint covers about one texel along the axis
+    // it spans the most texels of.
+    const auto lod = std::log2(std::max(footprint.getX() * static_cast<float>(_width),
+                                        footprint.getY() * static_cast<float>(_height)));
+    if (!(lod > 0.0f) || _levels.size() == 1) {
+        return sampleBilinear(_levels.front(), uv);
+    }
+    const auto maxLevel = static_cast<float>(_levels.size() - 1);
+    if (lod >= maxLevel) {
+        return sampleBilinear(_levels.back(), uv);
+    }
+    const auto level = static_cast<int>(lod);
+    return lerp(sampleBilinear(_levels[level], uv), sampleBilinear(_levels[level + 1], uv),
+                lod - static_cast<float>(level));
+}
@@ -1,15 +1,49 @@
 #pragma once
 
+#include "SharedArray.h"
 #include "Vector.h"
 
+#include <cstdint>
+#include <memory>
 #include <utility>
 #include <vector>
 
 namespace crt {
+    enum class TextureFormat : uint32_t {
+        RGB8,
+        RGBA8,
+        // Three IEEE 754 half floats per texel, for HDR content.
+        RGBHalf,
+        RGBFloat,
+    };
+
+    enum class TextureLayout : uint32_t {
+        Linear,
+        // Texels grouped in kTileSize x kTileSize tiles, so a 2D neighbourhood spans few cache lines.
+        Tiled,
+    };
+
+    struct TextureOptions {
+        TextureFormat format = TextureFormat::RGB8;
+        TextureLayout layout = TextureLayout::Tiled;
+        bool mipmaps = true;
+    };
+
     class Texture2D {
     public:
-        Texture2D(int width, int height, const std::vector<Vector3f> &pixels);
-        Texture2D(int width, int height, std::vector<Vector3f> &&pixels);
+        static constexpr int kTileSize = 8;
+
+        Texture2D(int width, int height, const std::vector<Vector3f> &pixels, const TextureOptions &options = {});
+
+        /**
+         * @param rgb8 three bytes per texel, rows from top to bottom
+         */
+        Texture2D(int width, int height, const std::vector<uint8_t> &rgb8, const TextureOptions &options = {});
+
+        /**
+         * Uses texels encoded earlier with the same size and options, e.g. mapped from a scene bundle.
+         */
+        Texture2D(int width, int height, const TextureOptions &options, SharedArray<uint8_t> texels);
 
         ~Texture2D() = default;
 
@@ -21,17 +55,64 @@ namespace crt {
             return _height;
         }
 
-        [[nodiscard]] const Vector3f &getPixel(int x, int y) const {
-            return _pixels[y * _width + x];
+        [[nodiscard]] const TextureOptions &getOptions() const {
+            return _options;
         }
 
+        [[nodiscard]] int getLevelCount() const {
+            return static_cast<int>(_levels.size());
+        }
+
+        /**
+         * Encoded texels of every mip level, largest first.
+         */
+        [[nodiscard]] const SharedArray<uint8_t> &getTexels() const {
+            return _texels;
+        }
+
+        [[nodiscard]] Vector3f getPixel(int x, int y, int level = 0) const;
+
+        /**
+         * Bilinear sample of the full resolution level.
+         */
         [[nodiscard]] Vector3f getColor(const Vector2f &uv) const;
 
+        /**
+         * Trilinear sample for a footprint spanning footprint.u and footprint.v in uv units, e.g. the ray cone
+         * width at the hit scaled to texture coordinates. Footprints below one texel sample the full resolution
+         * level.
+         */
+        [[nodiscard]] Vector3f getColor(const Vector2f &uv, const Vector2f &footprint) const;
+
+        /**
+         * Bytes of texel storage the given options need for a texture of this size, with padding and mips.
+         */
+        [[nodiscard]] static size_t getByteSize(int width, int height, const TextureOptions &options);
+
+    private:
+        struct Level {
+            int width;
+            int height;
+            int tileColumns;
+            size_t offset;
+        };
+
+        static std::vector<Level> makeLevels(int width, int height, const TextureOptions &options);
+
+        void encode(std::vector<Vector3f> pixels);
+
+        [[nodiscard]] Vector3f sampleBilinear(const Level &level, const Vector2f &uv) const;
+
+        [[nodiscard]] static size_t getLevelByteSize(const Level &level, const TextureOptions &options);
+
+        [[nodiscard]] static size_t getTexelOffset(const Level &level, int x, int y, const TextureOptions &options);
+
     private:
-        // RGB888
-        std::vector<Vector3f> _pixels;
         int _width;
         int _height;
+        TextureOptions _options;
+        std::vector<Level> _levels;
+        SharedArray<uint8_t> _texels;
     };
     using Texture2DPtr = std::shared_ptr<Texture2D>;
-}
\ No newline at end of file
+}
@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace crt {
+    ThreadPool::ThreadPool(unsigned threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            _queues.push_back(std::make_unique<WorkQueue>());
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            _threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeCondition.notify_all();
+        for (auto& thread: _threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::parallelFor(uint32_t taskCount, const Task& task) {
+        if (taskCount == 0) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        // Workers that woke up late for the previous batch must be gone before the queues are refilled,
+        // otherwise they could pick up new indices with the previous task.
+        _doneCondition.wait(lock, [this]() { return _activeWorkers == 0; });
+
+        const auto workerCount = static_cast<uint32_t>(_queues.size());
+        for (uint32_t worker = 0; worker < workerCount; ++worker) {
+            const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * worker / workerCount);
+            const auto end = static_cast<uint32_t>(static_cast<uint64_t>(taskCount) * (worker + 1) / workerCount);
+            std::lock_guard<std::mutex> queueLock(_queues[worker]->mutex);
+            for (auto i = begin; i < end; ++i) {
+                _queues[worker]->tasks.push_back(i);
+            }
+        }
+        _pendingTasks.store(taskCount, std::memory_order_relaxed);
+        _task = &task;
+        ++_generation;
+        _wakeCondition.notify_all();
+
+        _doneCondition.wait(lock, [this]() {
+            return _pendingTasks.load(std::memory_order_acquire) == 0 && _activeWorkers == 0;
+        });
+        _task = nullptr;
+    }
+
+    bool ThreadPool::popTask(unsigned workerIndex, uint32_t& outTaskIndex) {
+        {
+            auto& queue = *_queues[workerIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                outTaskIndex = queue.tasks.front();
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+
+        const auto workerCount = static_cast<unsigned>(_queues.size());
+        for (unsigned i = 1; i < workerCount; ++i) {
+            auto& victim = *_queues[(workerIndex + i) % workerCount];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                outTaskIndex = victim.tasks.back();
+                victim.tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::workerLoop(unsigned workerIndex) {
+        uint64_t seenGeneration = 0;
+        while (true) {
+            const Task* task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeCondition.wait(lock, [&]() { return _stopping || _generation != seenGeneration; });
+                if (_stopping) {
+                    return;
+                }
+                seenGeneration = _generation;
+                task = _task;
+                ++_activeWorkers;
+            }
+
+            uint32_t taskIndex;
+            while (task && popTask(workerIndex, taskIndex)) {
+                (*task)(taskIndex, workerIndex);
+                _pendingTasks.fetch_sub(1, std::memory_order_release);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                --_activeWorkers;
+            }
+            _doneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Persistent worker threads with one task deque per worker. Each worker drains its own deque from the front
+     * and, once empty, steals from the back of the other workers' deques.
+     */
+    class ThreadPool {
+    public:
+        using Task = std::function<void(uint32_t taskIndex, unsigned workerIndex)>;
+
+        /**
+         * @param threadCount number of workers, 0 picks std::thread::hardware_concurrency()
+         */
+        explicit ThreadPool(unsigned threadCount = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        [[nodiscard]] unsigned getThreadCount() const {
+            return static_cast<unsigned>(_threads.size());
+        }
+
+        /**
+         * Runs task(i, worker) for every i in [0, taskCount) and blocks until all of them finished.
+         * Consecutive task indices are handed to the same worker, so neighbouring tasks share caches.
+         */
+        void parallelFor(uint32_t taskCount, const Task& task);
+
+    private:
+        struct alignas(64) WorkQueue {
+            std::mutex mutex;
+            std::deque<uint32_t> tasks;
+        };
+
+        void workerLoop(unsigned workerIndex);
+
+        bool popTask(unsigned workerIndex, uint32_t& outTaskIndex);
+
+    private:
+        std::vector<std::thread> _threads;
+        std::vector<std::unique_ptr<WorkQueue>> _queues;
+
+        std::mutex _mutex;
+        std::condition_variable _wakeCondition;
+        std::condition_variable _doneCondition;
+        const Task* _task = nullptr;
+        uint64_t _generation = 0;
+        unsigned _activeWorkers = 0;
+        std::atomic<uint32_t> _pendingTasks{0};
+        bool _stopping = false;
+    };
+}
@@ -0,0 +1,272 @@
+#include "TileCoordinator.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <poll.h>
+
+namespace crt {
+    namespace {
+        // Poll interval, also how often slow tiles and the worker timeout are checked.
+        constexpr int kPollMilliseconds = 50;
+
+        double getSeconds() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    TileCoordinator::~TileCoordinator() {
+        finish();
+    }
+
+    bool TileCoordinator::listen(const std::string& address) {
+        if (!_listener.listen(address)) {
+            return fail(_listener.getError());
+        }
+        return true;
+    }
+
+    void TileCoordinator::finish() {
+        for (auto& worker: _workers) {
+            worker->connection.send(TileMessage::makeDone());
+        }
+        _workers.clear();
+        _listener.close();
+    }
+
+    bool TileCoordinator::render(const SizeI& imageSize, ImageOutput& output,
+                                 TileCoordinatorStatistics* outStatistics, const WatchFunction& watch) {
+        const auto start = getSeconds();
+        TileCoordinatorStatistics statistics;
+        const auto width = imageSize.getWidth();
+        const auto height = imageSize.getHeight();
+        const auto tileSize = std::clamp(_options.tileSize, 1, TileConnection::kMaxTileSize);
+        if (_listener.getDescriptor() < 0) {
+            return fail("not listening");
+        }
+        if (!output.begin(imageSize)) {
+            return fail(output.getError());
+        }
+
+        // Tiles row by row, so the rows at the top finish first and stream out early.
+        std::vector<RenderTile> tiles;
+        for (int y = 0; y < height; y += tileSize) {
+            for (int x = 0; x < width; x += tileSize) {
+                tiles.push_back({_nextTileId + static_cast<uint32_t>(tiles.size()), x, y,
+                                 std::min(tileSize, width - x), std::min(tileSize, height - y)});
+            }
+        }
+        const auto firstTileId = _nextTileId;
+        _nextTileId += static_cast<uint32_t>(tiles.size());
+        statistics.tileCount = static_cast<uint32_t>(tiles.size());
+
+        struct TileState {
+            bool done = false;
+            // Workers currently holding the tile.
+            uint32_t holderCount = 0;
+        };
+        std::vector<TileState> tileStates(tiles.size());
+        std::deque<uint32_t> pendingTiles;
+        for (uint32_t i = 0; i < tiles.size(); ++i) {
+            pendingTiles.push_back(i);
+        }
+        const auto tilesPerRow = static_cast<uint32_t>((width + tileSize - 1) / tileSize);
+        const auto bandCount = static_cast<uint32_t>((height + tileSize - 1) / tileSize);
+        std::vector<std::vector<Vector3f>> bands(bandCount);
+        std::vector<uint32_t> bandRemaining(bandCount, tilesPerRow);
+        uint32_t nextBand = 0;
+        uint32_t doneCount = 0;
+
+        const auto dropWorker = [&](size_t workerIndex) {
+            for (const auto id: _workers[workerIndex]->tiles) {
+                if (id < firstTileId) {
+                    continue;
+                }
+                auto& state = tileStates[id - firstTileId];
+                if (--state.holderCount == 0 && !state.done) {
+                    pendingTiles.push_front(id - firstTileId);
+                    ++statistics.reassignedTileCount;
+                }
+            }
+            ++statistics.failedWorkerCount;
+            _workers.erase(_workers.begin() + static_cast<std::ptrdiff_t>(workerIndex));
+        };
+        const auto sendTile = [&](Worker& worker, uint32_t tile) {
+            if (worker.tiles.empty()) {
+                worker.busySince = getSeconds();
+            }
+            worker.tiles.push_back(tiles[tile].index);
+            ++tileStates[tile].holderCount;
+            return worker.connection.send(TileMessage::makeTile(width, height, tiles[tile]));
+        };
+        // Copies a result into its band and streams every band that is complete.
+        const auto storeResult = [&](const TileMessage& message) {
+            const auto& tile = tiles[message.tile.index - firstTileId];
+            const auto band = static_cast<uint32_t>(tile.y / tileSize);
+            auto& pixels = bands[band];
+            const auto bandHeight = std::min(tileSize, height - static_cast<int>(band) * tileSize);
+            pixels.resize(static_cast<size_t>(width) * bandHeight);
+            for (int row = 0; row < tile.height; ++row) {
+                std::copy_n(message.pixels.begin() + static_cast<std::ptrdiff_t>(row) * tile.width, tile.width,
+                            pixels.begin() + static_cast<std::ptrdiff_t>(row) * width + tile.x);
+            }
+            --bandRemaining[band];
+            while (nextBand < bandCount && bandRemaining[nextBand] == 0) {
+                const auto y = static_cast<int>(nextBand) * tileSize;
+                if (!output.writeRows(y, std::min(tileSize, height - y), bands[nextBand].data())) {
+                    return false;
+                }
+                std::vector<Vector3f>().swap(bands[nextBand]);
+                ++nextBand;
+            }
+            return true;
+        };
+
+        auto lastWorkerSeen = getSeconds();
+        std::vector<pollfd> descriptors;
+        while (doneCount < tiles.size()) {
+            // Keep every worker topped up, then put idle workers on tiles that take suspiciously long.
+            for (size_t i = 0; i < _workers.size(); ++i) {
+                auto& worker = *_workers[i];
+                while (worker.ready && worker.tiles.size() < _options.tilesPerWorker && !pendingTiles.empty()) {
+                    const auto tile = pendingTiles.front();
+                    pendingTiles.pop_front();
+                    if (tileStates[tile].done) {
+                        continue;
+                    }
+                    if (!sendTile(worker, tile)) {
+                        dropWorker(i--);
+                        break;
+                    }
+                }
+            }
+            const auto now = getSeconds();
+            for (size_t i = 0; i < _workers.size() && pendingTiles.empty(); ++i) {
+                auto& idle = *_workers[i];
+                if (!idle.ready || !idle.tiles.empty()) {
+                    continue;
+                }
+                // Every unanswered tile of the slowest workers, not just their oldest one, so a worker that stalls
+                // with several tiles cannot hold up the frame.
+                bool sendFailed = false;
+                while (!sendFailed && idle.tiles.size() < _options.tilesPerWorker) {
+                    const Worker* slowest = nullptr;
+                    uint32_t slowTile = 0;
+                    for (const auto& worker: _workers) {
+                        if (worker.get() == &idle || worker->tiles.empty() ||
+                            now - worker->busySince < _options.slowTileSeconds ||
+                            (slowest && worker->busySince >= slowest->busySince)) {
+                            continue;
+                        }
+                        for (const auto id: worker->tiles) {
+                            if (id >= firstTileId && !tileStates[id - firstTileId].done &&
+                                tileStates[id - firstTileId].holderCount == 1) {
+                                slowest = worker.get();
+                                slowTile = id - firstTileId;
+                                break;
+                            }
+                        }
+                    }
+                    if (!slowest) {
+                        break;
+                    }
+                    ++statistics.duplicatedTileCount;
+                    sendFailed = !sendTile(idle, slowTile);
+                }
+                if (sendFailed) {
+                    dropWorker(i--);
+                } else if (idle.tiles.empty()) {
+                    break;
+                }
+            }
+
+            bool hasReadyWorker = false;
+            descriptors.clear();
+            descriptors.push_back({_listener.getDescriptor(), POLLIN, 0});
+            for (const auto& worker: _workers) {
+                descriptors.push_back({worker->connection.getDescriptor(), POLLIN, 0});
+                hasReadyWorker |= worker->ready;
+            }
+            std::string watchError;
+            if (watch && !watch(watchError)) {
+                return fail(watchError);
+            }
+            if (hasReadyWorker) {
+                lastWorkerSeen = now;
+            } else if (now - lastWorkerSeen > _options.workerTimeoutSeconds) {
+                return fail("no workers to render on");
+            }
+            if (::poll(descriptors.data(), descriptors.size(), kPollMilliseconds) < 0) {
+                continue;
+            }
+
+            // Walk backwards so dropping a worker leaves the indices of the ones not visited yet alone.
+            for (auto i = descriptors.size() - 1; i > 0; --i) {
+                if (!descriptors[i].revents) {
+                    continue;
+                }
+                const auto workerIndex = i - 1;
+                auto& worker = *_workers[workerIndex];
+                TileMessage message;
+                if (!worker.connection.receive(message)) {
+                    dropWorker(workerIndex);
+                    continue;
+                }
+                if (message.type == TileMessageType::Hello && !worker.ready &&
+                    message.version == TileConnection::kVersion) {
+                    worker.ready = true;
+                    continue;
+                }
+                const auto held = std::find(worker.tiles.begin(), worker.tiles.end(), message.tile.index);
+                if (message.type != TileMessageType::Result || held == worker.tiles.end()) {
+                    dropWorker(workerIndex);
+                    continue;
+                }
+                worker.tiles.erase(held);
+                worker.busySince = getSeconds();
+                if (message.tile.index < firstTileId) {
+                    // Late answer to a tile of an earlier frame.
+                    continue;
+                }
+                const auto tile = message.tile.index - firstTileId;
+                auto& state = tileStates[tile];
+                --state.holderCount;
+                if (state.done) {
+                    continue;
+                }
+                if (message.tile.x != tiles[tile].x || message.tile.y != tiles[tile].y ||
+                    message.tile.width != tiles[tile].width || message.tile.height != tiles[tile].height) {
+                    dropWorker(workerIndex);
+                    continue;
+                }
+                state.done = true;
+                ++doneCount;
+                if (!storeResult(message)) {
+                    return fail(output.getError());
+                }
+            }
+            if (descriptors[0].revents & POLLIN) {
+                auto worker = std::make_unique<Worker>();
+                if (_listener.accept(worker->connection)) {
+                    worker->connection.setReceiveTimeout(_options.receiveTimeoutSeconds);
+                    _workers.push_back(std::move(worker));
+                    ++statistics.workerCount;
+                }
+            }
+        }
+
+        if (!output.end()) {
+            return fail(output.getError());
+        }
+        statistics.seconds = getSeconds() - start;
+        if (outStatistics) {
+            *outStatistics = statistics;
+        }
+        return true;
+    }
+
+    bool TileCoordinator::fail(std::string error) {
+        _error = std::move(error);
+        return false;
+    }
+}
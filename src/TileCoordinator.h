@@ -0,0 +1,105 @@
+#pragma once
+
+#include "ImageOutput.h"
+#include "Size.h"
+#include "TileProtocol.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    struct TileCoordinatorOptions {
+        // Edge length of the tiles handed to workers. Workers cut them into render tiles of their own.
+        int tileSize = 128;
+        // Tiles a worker holds at once, so the next one is already waiting when it sends a result.
+        uint32_t tilesPerWorker = 2;
+        // Once every tile is handed out, the tiles of a worker that has spent this long on its oldest one are given
+        // to idle workers as well and the first result wins.
+        double slowTileSeconds = 5.0;
+        // Rendering fails after this long without any connected worker.
+        double workerTimeoutSeconds = 30.0;
+        // A worker that stalls for this long in the middle of a message is dropped.
+        double receiveTimeoutSeconds = 10.0;
+    };
+
+    struct TileCoordinatorStatistics {
+        uint32_t tileCount = 0;
+        // Workers that joined during the render, and those dropped because they disconnected or misbehaved.
+        uint32_t workerCount = 0;
+        uint32_t failedWorkerCount = 0;
+        // Tiles handed out again because their worker was dropped, and tiles also given to a second worker because
+        // the first was slow.
+        uint32_t reassignedTileCount = 0;
+        uint32_t duplicatedTileCount = 0;
+        double seconds = 0.0;
+    };
+
+    /**
+     * Renders a frame on worker processes (see TileWorker). The frame is cut into tiles that are handed out
+     * dynamically, so fast workers take more of them; tiles of a worker that fails are handed out again, and slow
+     * tiles are duplicated at the end of the frame. Finished tile rows are streamed to the output top to bottom.
+     * Workers may connect at any time and stay connected across renders until finish().
+     */
+    class TileCoordinator {
+    public:
+        /**
+         * Checked between polls while rendering, so a caller can notice its workers are gone long before the
+         * worker timeout. Returning false stops the render with outError.
+         */
+        using WatchFunction = std::function<bool(std::string& outError)>;
+
+        explicit TileCoordinator(TileCoordinatorOptions options = {}) : _options(options) {}
+
+        ~TileCoordinator();
+
+        TileCoordinator(const TileCoordinator&) = delete;
+
+        TileCoordinator& operator=(const TileCoordinator&) = delete;
+
+        /**
+         * Starts accepting workers on address, "unix:PATH" or "HOST:PORT".
+         */
+        bool listen(const std::string& address);
+
+        /**
+         * Renders imageSize on the workers into output. On failure returns false and getError() says why.
+         */
+        bool render(const SizeI& imageSize, ImageOutput& output, TileCoordinatorStatistics* outStatistics = nullptr,
+                    const WatchFunction& watch = nullptr);
+
+        /**
+         * Tells every worker there is no more work and disconnects them.
+         */
+        void finish();
+
+        [[nodiscard]] size_t getWorkerCount() const { return _workers.size(); }
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+    private:
+        struct Worker {
+            TileConnection connection;
+            // Set once the worker introduced itself with a matching protocol version.
+            bool ready = false;
+            // Ids of the tiles sent to the worker and not answered yet, oldest first.
+            std::deque<uint32_t> tiles;
+            // When the worker started on the oldest of its tiles.
+            double busySince = 0.0;
+        };
+
+        bool fail(std::string error);
+
+    private:
+        TileCoordinatorOptions _options;
+        TileListener _listener;
+        std::vector<std::unique_ptr<Worker>> _workers;
+        // Tile ids keep counting across renders, so late answers to an earlier frame are told apart.
+        uint32_t _nextTileId = 0;
+        std::string _error;
+    };
+}
@@ -0,0 +1,362 @@
+#include "TileProtocol.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace crt {
+    namespace {
+        constexpr uint32_t kMagic = 0x54545243; // "CRTT"
+        // Image size and tile rectangle, ahead of the pixels of a result.
+        constexpr size_t kTileFieldsSize = 7 * sizeof(int32_t);
+        const std::string kUnixPrefix = "unix:";
+
+        struct MessageHeader {
+            uint32_t magic;
+            uint32_t type;
+            uint32_t size;
+        };
+
+        struct SocketAddress {
+            sockaddr_storage storage{};
+            socklen_t length = 0;
+            int family = AF_UNSPEC;
+            std::string unixPath;
+        };
+
+        bool parseAddress(const std::string& address, bool passive, SocketAddress& outAddress,
+                          std::string& outError) {
+            if (address.rfind(kUnixPrefix, 0) == 0) {
+                auto& unixAddress = reinterpret_cast<sockaddr_un&>(outAddress.storage);
+                outAddress.unixPath = address.substr(kUnixPrefix.size());
+                if (outAddress.unixPath.empty() || outAddress.unixPath.size() >= sizeof(unixAddress.sun_path)) {
+                    outError = address + ": bad socket path";
+                    return false;
+                }
+                unixAddress.sun_family = AF_UNIX;
+                std::memcpy(unixAddress.sun_path, outAddress.unixPath.c_str(), outAddress.unixPath.size() + 1);
+                outAddress.length = sizeof(sockaddr_un);
+                outAddress.family = AF_UNIX;
+                return true;
+            }
+
+            const auto colon = address.rfind(':');
+            if (colon == std::string::npos || colon + 1 == address.size()) {
+                outError = address + ": expected unix:PATH or HOST:PORT";
+                return false;
+            }
+            const auto host = address.substr(0, colon);
+            const auto port = address.substr(colon + 1);
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+            addrinfo* results = nullptr;
+            const auto status = ::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results);
+            if (status != 0 || !results) {
+                outError = address + ": " + ::gai_strerror(status);
+                return false;
+            }
+            std::memcpy(&outAddress.storage, results->ai_addr, results->ai_addrlen);
+            outAddress.length = results->ai_addrlen;
+            outAddress.family = results->ai_family;
+            ::freeaddrinfo(results);
+            return true;
+        }
+
+        template<typename T>
+        void append(std::vector<uint8_t>& buffer, T value) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        template<typename T>
+        T read(const uint8_t*& data) {
+            T value;
+            std::memcpy(&value, data, sizeof(T));
+            data += sizeof(T);
+            return value;
+        }
+    }
+
+    TileConnection::~TileConnection() {
+        close();
+    }
+
+    TileConnection::TileConnection(TileConnection&& other) noexcept
+            : _descriptor(std::exchange(other._descriptor, -1)),
+              _error(std::move(other._error)),
+              _buffer(std::move(other._buffer)) {}
+
+    TileConnection& TileConnection::operator=(TileConnection&& other) noexcept {
+        if (this != &other) {
+            close();
+            _descriptor = std::exchange(other._descriptor, -1);
+            _error = std::move(other._error);
+            _buffer = std::move(other._buffer);
+        }
+        return *this;
+    }
+
+    bool TileConnection::connect(const std::string& address, double timeoutSeconds) {
+        close();
+        SocketAddress socketAddress;
+        if (!parseAddress(address, false, socketAddress, _error)) {
+            return false;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+        while (true) {
+            _descriptor = ::socket(socketAddress.family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (_descriptor < 0) {
+                return fail(address + ": " + std::strerror(errno));
+            }
+            if (::connect(_descriptor, reinterpret_cast<const sockaddr*>(&socketAddress.storage),
+                          socketAddress.length) == 0) {
+                break;
+            }
+            const auto error = errno;
+            close();
+            // The coordinator may not be listening yet.
+            if ((error != ECONNREFUSED && error != ENOENT) || std::chrono::steady_clock::now() >= deadline) {
+                return fail(address + ": " + std::strerror(error));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (socketAddress.family != AF_UNIX) {
+            const int noDelay = 1;
+            ::setsockopt(_descriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+        return send(TileMessage::makeHello(kVersion));
+    }
+
+    void TileConnection::close() {
+        if (_descriptor >= 0) {
+            ::close(_descriptor);
+            _descriptor = -1;
+        }
+    }
+
+    void TileConnection::setReceiveTimeout(double seconds) {
+        timeval timeout{};
+        timeout.tv_sec = static_cast<time_t>(seconds);
+        timeout.tv_usec = static_cast<suseconds_t>((seconds - static_cast<double>(timeout.tv_sec)) * 1e6);
+        ::setsockopt(_descriptor, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    bool TileConnection::send(const TileMessage& message) {
+        _buffer.clear();
+        append(_buffer, MessageHeader{kMagic, static_cast<uint32_t>(message.type), 0});
+        if (message.type == TileMessageType::Hello) {
+            append(_buffer, message.version);
+        } else if (message.type == TileMessageType::Tile || message.type == TileMessageType::Result) {
+            append<int32_t>(_buffer, message.imageWidth);
+            append<int32_t>(_buffer, message.imageHeight);
+            append<uint32_t>(_buffer, message.tile.index);
+            append<int32_t>(_buffer, message.tile.x);
+            append<int32_t>(_buffer, message.tile.y);
+            append<int32_t>(_buffer, message.tile.width);
+            append<int32_t>(_buffer, message.tile.height);
+            if (message.type == TileMessageType::Result) {
+                // Component by component, Vector3f may be padded.
+                for (const auto& pixel: message.pixels) {
+                    append(_buffer, pixel.getX());
+                    append(_buffer, pixel.getY());
+                    append(_buffer, pixel.getZ());
+                }
+            }
+        }
+        const auto payloadSize = static_cast<uint32_t>(_buffer.size() - sizeof(MessageHeader));
+        std::memcpy(_buffer.data() + offsetof(MessageHeader, size), &payloadSize, sizeof(payloadSize));
+
+        size_t sent = 0;
+        while (sent < _buffer.size()) {
+            // MSG_NOSIGNAL: a worker that went away is an error to handle, not a SIGPIPE.
+            const auto count = ::send(_descriptor, _buffer.data() + sent, _buffer.size() - sent, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return fail(std::string("send failed: ") + std::strerror(errno));
+            }
+            sent += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    bool TileConnection::receive(TileMessage& outMessage) {
+        MessageHeader header{};
+        if (!readFully(&header, sizeof(header))) {
+            return false;
+        }
+        if (header.magic != kMagic) {
+            return fail("not a tile protocol message");
+        }
+        // The size comes from the peer, bound it before allocating.
+        size_t maxSize = 0;
+        switch (static_cast<TileMessageType>(header.type)) {
+            case TileMessageType::Hello:
+                maxSize = sizeof(uint32_t);
+                break;
+            case TileMessageType::Tile:
+                maxSize = kTileFieldsSize;
+                break;
+            case TileMessageType::Result:
+                maxSize = kTileFieldsSize + 3 * sizeof(float) * static_cast<size_t>(kMaxTileSize) * kMaxTileSize;
+                break;
+            case TileMessageType::Done:
+                break;
+            default:
+                return fail("unknown message type " + std::to_string(header.type));
+        }
+        if (header.size > maxSize) {
+            return fail("message too large");
+        }
+        _buffer.resize(header.size);
+        if (!readFully(_buffer.data(), _buffer.size())) {
+            return false;
+        }
+
+        outMessage.type = static_cast<TileMessageType>(header.type);
+        const auto* data = _buffer.data();
+        switch (outMessage.type) {
+            case TileMessageType::Hello:
+                if (header.size != sizeof(uint32_t)) {
+                    return fail("malformed hello");
+                }
+                outMessage.version = read<uint32_t>(data);
+                return true;
+            case TileMessageType::Tile:
+            case TileMessageType::Result: {
+                if (header.size < kTileFieldsSize) {
+                    return fail("malformed tile");
+                }
+                outMessage.imageWidth = read<int32_t>(data);
+                outMessage.imageHeight = read<int32_t>(data);
+                auto& tile = outMessage.tile;
+                tile.index = read<uint32_t>(data);
+                tile.x = read<int32_t>(data);
+                tile.y = read<int32_t>(data);
+                tile.width = read<int32_t>(data);
+                tile.height = read<int32_t>(data);
+                if (tile.width <= 0 || tile.height <= 0 || tile.width > kMaxTileSize || tile.height > kMaxTileSize ||
+                    tile.x < 0 || tile.y < 0 || tile.x + tile.width > outMessage.imageWidth ||
+                    tile.y + tile.height > outMessage.imageHeight) {
+                    return fail("tile outside the image");
+                }
+                const auto pixelCount = static_cast<size_t>(tile.width) * tile.height;
+                const auto pixelBytes = outMessage.type == TileMessageType::Result ? 3 * sizeof(float) * pixelCount
+                                                                                   : 0;
+                if (header.size != kTileFieldsSize + pixelBytes) {
+                    return fail("malformed tile");
+                }
+                outMessage.pixels.resize(pixelBytes > 0 ? pixelCount : 0);
+                for (auto& pixel: outMessage.pixels) {
+                    const auto r = read<float>(data);
+                    const auto g = read<float>(data);
+                    const auto b = read<float>(data);
+                    pixel = {r, g, b};
+                }
+                return true;
+            }
+            case TileMessageType::Done:
+                return true;
+        }
+        return fail("unknown message type " + std::to_string(header.type));
+    }
+
+    bool TileConnection::fail(const std::string& error) {
+        _error = error;
+        return false;
+    }
+
+    bool TileConnection::readFully(void* data, size_t size) {
+        auto* bytes = static_cast<uint8_t*>(data);
+        size_t received = 0;
+        while (received < size) {
+            const auto count = ::recv(_descriptor, bytes + received, size - received, 0);
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count == 0) {
+                return fail("connection closed");
+            }
+            if (count < 0) {
+                return fail(errno == EAGAIN || errno == EWOULDBLOCK ? "receive timed out"
+                                                                    : std::string("receive failed: ") +
+                                                                      std::strerror(errno));
+            }
+            received += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    TileListener::~TileListener() {
+        close();
+    }
+
+    bool TileListener::listen(const std::string& address) {
+        close();
+        SocketAddress socketAddress;
+        if (!parseAddress(address, true, socketAddress, _error)) {
+            return false;
+        }
+        _descriptor = ::socket(socketAddress.family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (_descriptor < 0) {
+            _error = address + ": " + std::strerror(errno);
+            return false;
+        }
+        if (socketAddress.family == AF_UNIX) {
+            // A socket file left behind by an earlier run would make bind fail.
+            ::unlink(socketAddress.unixPath.c_str());
+        } else {
+            const int reuse = 1;
+            ::setsockopt(_descriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (::bind(_descriptor, reinterpret_cast<const sockaddr*>(&socketAddress.storage),
+                   socketAddress.length) != 0 || ::listen(_descriptor, SOMAXCONN) != 0) {
+            _error = address + ": " + std::strerror(errno);
+            close();
+            return false;
+        }
+        _unixPath = socketAddress.unixPath;
+        return true;
+    }
+
+    void TileListener::close() {
+        if (_descriptor >= 0) {
+            ::close(_descriptor);
+            _descriptor = -1;
+        }
+        if (!_unixPath.empty()) {
+            ::unlink(_unixPath.c_str());
+            _unixPath.clear();
+        }
+    }
+
+    bool TileListener::accept(TileConnection& outConnection) {
+        const int descriptor = ::accept4(_descriptor, nullptr, nullptr, SOCK_CLOEXEC);
+        if (descriptor < 0) {
+            _error = std::string("accept failed: ") + std::strerror(errno);
+            return false;
+        }
+        outConnection = TileConnection(descriptor);
+        sockaddr_storage address{};
+        socklen_t length = sizeof(address);
+        if (::getsockname(descriptor, reinterpret_cast<sockaddr*>(&address), &length) == 0 &&
+            address.ss_family != AF_UNIX) {
+            const int noDelay = 1;
+            ::setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+        return true;
+    }
+}
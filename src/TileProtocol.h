@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Renderer.h"
+#include "Vector.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace crt {
+
+    enum class TileMessageType : uint32_t {
+        // Worker to coordinator after connecting, carries the protocol version.
+        Hello = 1,
+        // Coordinator to worker: render tile of an imageWidth x imageHeight frame.
+        Tile = 2,
+        // Worker to coordinator: the linear RGB pixels of tile, row major.
+        Result = 3,
+        // Coordinator to worker: no more tiles, disconnect.
+        Done = 4,
+    };
+
+    struct TileMessage {
+        TileMessageType type = TileMessageType::Done;
+        uint32_t version = 0;
+        int imageWidth = 0;
+        int imageHeight = 0;
+        RenderTile tile{};
+        std::vector<Vector3f> pixels;
+
+        static TileMessage makeHello(uint32_t version) {
+            TileMessage message;
+            message.type = TileMessageType::Hello;
+            message.version = version;
+            return message;
+        }
+
+        static TileMessage makeTile(int imageWidth, int imageHeight, const RenderTile& tile) {
+            TileMessage message;
+            message.type = TileMessageType::Tile;
+            message.imageWidth = imageWidth;
+            message.imageHeight = imageHeight;
+            message.tile = tile;
+            return message;
+        }
+
+        static TileMessage makeDone() {
+            TileMessage message;
+            message.type = TileMessageType::Done;
+            return message;
+        }
+    };
+
+    /**
+     * One end of a coordinator to worker connection, over a Unix domain socket ("unix:PATH") or TCP
+     * ("HOST:PORT"). Messages are a small header and a payload in host byte order, so both ends must share the
+     * byte order; the version in Hello tells builds with a different protocol apart.
+     */
+    class TileConnection {
+    public:
+        static constexpr uint32_t kVersion = 1;
+        // Tiles larger than this on either side are rejected as corrupt.
+        static constexpr int kMaxTileSize = 4096;
+
+        TileConnection() = default;
+
+        explicit TileConnection(int descriptor) : _descriptor(descriptor) {}
+
+        ~TileConnection();
+
+        TileConnection(const TileConnection&) = delete;
+
+        TileConnection& operator=(const TileConnection&) = delete;
+
+        TileConnection(TileConnection&& other) noexcept;
+
+        TileConnection& operator=(TileConnection&& other) noexcept;
+
+        /**
+         * Connects to address, retrying for up to timeoutSeconds while nobody listens there yet.
+         */
+        bool connect(const std::string& address, double timeoutSeconds = 0.0);
+
+        void close();
+
+        [[nodiscard]] bool isOpen() const { return _descriptor >= 0; }
+
+        [[nodiscard]] int getDescriptor() const { return _descriptor; }
+
+        /**
+         * Makes receive fail instead of waiting longer than seconds for the rest of a message.
+         */
+        void setReceiveTimeout(double seconds);
+
+        bool send(const TileMessage& message);
+
+        /**
+         * Blocks for the next message. Fails on a closed connection, a timeout or a malformed message.
+         */
+        bool receive(TileMessage& outMessage);
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+    private:
+        bool fail(const std::string& error);
+
+        bool readFully(void* data, size_t size);
+
+    private:
+        int _descriptor = -1;
+        std::string _error;
+        std::vector<uint8_t> _buffer;
+    };
+
+    /**
+     * Listening socket of the coordinator. A Unix domain socket path is removed again when the listener closes.
+     */
+    class TileListener {
+    public:
+        TileListener() = default;
+
+        ~TileListener();
+
+        TileListener(const TileListener&) = delete;
+
+        TileListener& operator=(const TileListener&) = delete;
+
+        bool listen(const std::string& address);
+
+        void close();
+
+        /**
+         * Accepts one pending connection, call when the descriptor polls readable.
+         */
+        bool accept(TileConnection& outConnection);
+
+        [[nodiscard]] int getDescriptor() const { return _descriptor; }
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+    private:
+        int _descriptor = -1;
+        std::string _unixPath;
+        std::string _error;
+    };
+}
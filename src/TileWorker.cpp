@@ -0,0 +1,68 @@
+#include "TileWorker.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace crt {
+    bool TileWorker::connect(const std::string& address, double timeoutSeconds) {
+        if (!_connection.connect(address, timeoutSeconds)) {
+            return fail(_connection.getError());
+        }
+        return true;
+    }
+
+    bool TileWorker::run(const RenderFunction& render, TileWorkerStatistics* outStatistics) {
+        const auto start = std::chrono::steady_clock::now();
+        TileWorkerStatistics statistics;
+        FrameBuffer image;
+        TileMessage message;
+        bool succeeded = true;
+        while (true) {
+            if (!_connection.receive(message)) {
+                succeeded = fail(_connection.getError());
+                break;
+            }
+            if (message.type == TileMessageType::Done) {
+                break;
+            }
+            if (message.type != TileMessageType::Tile) {
+                succeeded = fail("unexpected message from the coordinator");
+                break;
+            }
+
+            const auto renderStart = std::chrono::steady_clock::now();
+            std::string error;
+            if (!render({message.imageWidth, message.imageHeight}, message.tile, image, error)) {
+                succeeded = fail(error);
+                break;
+            }
+            if (!image.isComplete() || image.getSize().getWidth() != message.tile.width ||
+                image.getSize().getHeight() != message.tile.height) {
+                succeeded = fail("tile rendered at the wrong size");
+                break;
+            }
+            statistics.renderSeconds += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - renderStart).count();
+
+            message.type = TileMessageType::Result;
+            message.pixels.resize(image.getPixels().size());
+            std::copy(image.getPixels().begin(), image.getPixels().end(), message.pixels.begin());
+            if (!_connection.send(message)) {
+                succeeded = fail(_connection.getError());
+                break;
+            }
+            ++statistics.tileCount;
+        }
+        _connection.close();
+        statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (outStatistics) {
+            *outStatistics = statistics;
+        }
+        return succeeded;
+    }
+
+    bool TileWorker::fail(std::string error) {
+        _error = std::move(error);
+        return false;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "FrameBuffer.h"
+#include "Renderer.h"
+#include "TileProtocol.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace crt {
+
+    struct TileWorkerStatistics {
+        uint32_t tileCount = 0;
+        double seconds = 0.0;
+        double renderSeconds = 0.0;
+    };
+
+    /**
+     * Worker side of TileCoordinator. Loads nothing itself: the owner sets up the scene once, connects and then
+     * renders the tiles it is sent until the coordinator is done.
+     */
+    class TileWorker {
+    public:
+        static constexpr double kDefaultConnectSeconds = 10.0;
+
+        // Renders tile of an imageSize frame into outImage, which must end up tile sized and complete.
+        using RenderFunction = std::function<bool(const SizeI& imageSize, const RenderTile& tile,
+                                                  FrameBuffer& outImage, std::string& outError)>;
+
+        /**
+         * Connects to the coordinator at address, waiting up to timeoutSeconds for it to start listening.
+         */
+        bool connect(const std::string& address, double timeoutSeconds = kDefaultConnectSeconds);
+
+        /**
+         * Serves tiles until the coordinator sends Done. Fails when the connection breaks or a tile fails to
+         * render; the coordinator then hands that worker's tiles to the others.
+         */
+        bool run(const RenderFunction& render, TileWorkerStatistics* outStatistics = nullptr);
+
+        [[nodiscard]] const std::string& getError() const { return _error; }
+
+    private:
+        bool fail(std::string error);
+
+    private:
+        TileConnection _connection;
+        std::string _error;
+    };
+}
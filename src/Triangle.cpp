@@ -4,22 +4,47 @@
 
 namespace crt {
 
-    bool Triangle::hit(const Ray& ray, float tMin, float tMax, HitRecord& outRecord) const {
+    bool Triangle::intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const {
         float t, u, v;
         if (MathUtils::rayIntersectsTriangle(ray, _vertices[0], _vertices[1], _vertices[2], t, u, v) && t >= tMin &&
             t <= tMax) {
-            outRecord.t = t;
-            outRecord.u = u;
-            outRecord.v = v;
-            outRecord.p = ray.getPoint(t);
-            outRecord.normal = (_vertices[1] - _vertices[0]).cross(_vertices[2] - _vertices[0]).normalize();
-            outRecord.material = getMaterial();
-            outRecord.color = getColor(outRecord.p);
+            outHit = {t, 0, u, v, this};
             return true;
         }
         return false;
     }
 
+    void Triangle::resolveHit(const Ray& ray, float t, uint32_t, float u, float v, HitRecord& outRecord) const {
+        outRecord.t = t;
+        outRecord.u = u;
+        outRecord.v = v;
+        outRecord.p = ray.getPoint(t);
+        outRecord.normal = (_vertices[1] - _vertices[0]).cross(_vertices[2] - _vertices[0]).normalize();
+        outRecord.material = &getMaterial();
+        outRecord.color = getColor(outRecord.p, ray.getFootprint(t));
+    }
+
+    bool Triangle::occluded(const Ray& ray, float tMin, float tMax) const {
+        float t, u, v;
+        return MathUtils::rayIntersectsTriangle(ray, _vertices[0], _vertices[1], _vertices[2], t, u, v) &&
+               t >= tMin && t <= tMax;
+    }
+
+    bool Triangle::boundingBox(BoundingBox<float>& outBox) const {
+        outBox = BoundingBox<float>();
+        for (const auto& vertex: _vertices) {
+            outBox.expand(vertex);
+        }
+        return true;
+    }
+
+    bool Triangle::transform(const Matrix4f& transform) {
+        for (auto& vertex: _vertices) {
+            vertex = (transform * Vector4f{vertex.getX(), vertex.getY(), vertex.getZ(), 1.0f}).getXYZ();
+        }
+        return true;
+    }
+
     Vector2f Triangle::getUV(const Vector3f& p) const {
         // calculate uv base on barycentric coordinates
         const auto& v0v1 = _vertices[1] - _vertices[0];
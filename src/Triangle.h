@@ -31,19 +31,32 @@ namespace crt {
 
         Vector2f getUV(const Vector3f &p) const override;
 
-        constexpr bool operator==(const Triangle &other) const {
+        bool operator==(const Triangle &other) const {
             return _vertices[0] == other._vertices[0]
                    && _vertices[1] == other._vertices[1]
                    && _vertices[2] == other._vertices[2];
         }
 
-        constexpr bool operator!=(const Triangle &other) const {
+        bool operator!=(const Triangle &other) const {
             return !(*this == other);
         }
 
         bool intersect(const Ray &ray, float &t, float &u, float &v) const;
 
-        bool hit(const Ray &ray, float tMin, float tMax, HitRecord &record) const override;
+        bool intersect(const Ray &ray, float tMin, float tMax, SurfaceHit &outHit) const override;
+
+        [[nodiscard]] bool occluded(const Ray &ray, float tMin, float tMax) const override;
+
+        void hitPacket(RayPacket &packet, PacketHit &outHit) const override {
+            PacketKernels::intersectTriangle(packet, outHit, _vertices[0], _vertices[1], _vertices[2], this, 0);
+        }
+
+        void resolveHit(const Ray &ray, float t, uint32_t primitive, float u, float v,
+                        HitRecord &outRecord) const override;
+
+        bool boundingBox(BoundingBox<float> &outBox) const override;
+
+        bool transform(const Matrix4f &transform) override;
 
     private:
         std::array<Vector3f, 3> _vertices;
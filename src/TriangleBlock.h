@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Ray.h"
+#include "Simd.h"
+#include "Statistics.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace crt {
+
+    /**
+     * Eight triangles in intersection ready structure-of-arrays form: the first vertex and both edges,
+     * as Möller-Trumbore consumes them. Unused lanes have zero edges, so their determinant rejects every ray.
+     */
+    struct alignas(32) TriangleBlock {
+        static constexpr int kSize = 8;
+
+        float v0X[kSize] = {};
+        float v0Y[kSize] = {};
+        float v0Z[kSize] = {};
+        float edge1X[kSize] = {};
+        float edge1Y[kSize] = {};
+        float edge1Z[kSize] = {};
+        float edge2X[kSize] = {};
+        float edge2Y[kSize] = {};
+        float edge2Z[kSize] = {};
+        uint32_t triangle[kSize] = {};
+
+        void set(int lane, const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, uint32_t triangleIndex) {
+            const auto edge1 = v1 - v0;
+            const auto edge2 = v2 - v0;
+            v0X[lane] = v0.getX();
+            v0Y[lane] = v0.getY();
+            v0Z[lane] = v0.getZ();
+            edge1X[lane] = edge1.getX();
+            edge1Y[lane] = edge1.getY();
+            edge1Z[lane] = edge1.getZ();
+            edge2X[lane] = edge2.getX();
+            edge2Y[lane] = edge2.getY();
+            edge2Z[lane] = edge2.getZ();
+            triangle[lane] = triangleIndex;
+        }
+
+        /**
+         * Hit mask of all eight lanes for tMin < t < tMax, with the same acceptance rules as
+         * MathUtils::rayIntersectsTriangle. t, u and v are written for every lane.
+         */
+        uint32_t intersect(const Ray& ray, float tMin, float tMax,
+                           SimdFloat<kSize>& outT, SimdFloat<kSize>& outU, SimdFloat<kSize>& outV) const {
+            using Float = SimdFloat<kSize>;
+            CRT_COUNT(triangleTests, kSize);
+            const auto& origin = ray.getOrigin();
+            const auto& direction = ray.getDirection();
+            const Float directionX(direction.getX()), directionY(direction.getY()), directionZ(direction.getZ());
+            const auto e1X = Float::load(edge1X), e1Y = Float::load(edge1Y), e1Z = Float::load(edge1Z);
+            const auto e2X = Float::load(edge2X), e2Y = Float::load(edge2Y), e2Z = Float::load(edge2Z);
+
+            const auto pX = directionY * e2Z - directionZ * e2Y;
+            const auto pY = directionZ * e2X - directionX * e2Z;
+            const auto pZ = directionX * e2Y - directionY * e2X;
+            const auto det = e1X * pX + e1Y * pY + e1Z * pZ;
+            const auto invDet = Float(1.0f) / det;
+
+            const auto tX = Float(origin.getX()) - Float::load(v0X);
+            const auto tY = Float(origin.getY()) - Float::load(v0Y);
+            const auto tZ = Float(origin.getZ()) - Float::load(v0Z);
+            outU = (tX * pX + tY * pY + tZ * pZ) * invDet;
+
+            const auto qX = tY * e1Z - tZ * e1Y;
+            const auto qY = tZ * e1X - tX * e1Z;
+            const auto qZ = tX * e1Y - tY * e1X;
+            outV = (directionX * qX + directionY * qY + directionZ * qZ) * invDet;
+            outT = (e2X * qX + e2Y * qY + e2Z * qZ) * invDet;
+
+            const Float zero(0.0f);
+            const Float one(1.0f);
+            const auto mask = (abs(det) >= Float(std::numeric_limits<float>::epsilon())) &
+                              (outU >= zero) & (outU <= one) & (outV >= zero) & (outU + outV <= one) &
+                              (outT > Float(tMin)) & (outT < Float(tMax));
+            return mask.getBits();
+        }
+
+        /**
+         * Closest hit among the eight lanes. Shrinks tMax and reports the mesh triangle index on a hit.
+         */
+        bool intersectClosest(const Ray& ray, float tMin, float& tMax,
+                              uint32_t& outTriangle, float& outU, float& outV) const {
+            SimdFloat<kSize> t, u, v;
+            auto bits = intersect(ray, tMin, tMax, t, u, v);
+            if (bits == 0) {
+                return false;
+            }
+            alignas(32) float laneT[kSize];
+            t.store(laneT);
+            int closestLane = __builtin_ctz(bits);
+            for (bits &= bits - 1; bits != 0; bits &= bits - 1) {
+                const auto lane = __builtin_ctz(bits);
+                if (laneT[lane] < laneT[closestLane]) {
+                    closestLane = lane;
+                }
+            }
+            tMax = laneT[closestLane];
+            outTriangle = triangle[closestLane];
+            outU = u[closestLane];
+            outV = v[closestLane];
+            return true;
+        }
+    };
+}
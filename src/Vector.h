@@ -1,8 +1,11 @@
 #pragma once
 
 #include <array>
+#include <cassert>
 #include <cmath>
+#include <type_traits>
 #include "Common.h"
+#include "Simd.h"
 
 namespace crt {
 
@@ -102,16 +105,18 @@ namespace crt {
         }
 
         [[nodiscard]] constexpr float getLength() const {
-            double length = 0;
+            // Integer vectors accumulate in double to avoid overflow, floating point ones in their own type.
+            using Accumulator = std::conditional_t<std::is_floating_point_v<T>, T, double>;
+            Accumulator length = 0;
             for (size_t i = 0; i < N; ++i) {
-                length += _data[i] * _data[i];
+                length += static_cast<Accumulator>(_data[i]) * static_cast<Accumulator>(_data[i]);
             }
             return static_cast<float>(std::sqrt(length));
         }
 
         [[nodiscard]] constexpr bool isZero() const {
             for (size_t i = 0; i < N; ++i) {
-                if (!almostEqual(_data[i], 0.0f)) {
+                if (!almostEqual(_data[i], static_cast<T>(0))) {
                     return false;
                 }
             }
@@ -320,9 +325,228 @@ namespace crt {
         }
 
     private:
-        std::array<T, N> _data;
+        std::array<T, N> _data{};
     };
 
+#if CRT_SIMD_SSE
+    /**
+     * Shared implementation of the SSE backed float vectors. Values live in one 16 byte aligned register wide
+     * array; for N = 3 the padding lane is kept at zero so dot products and lengths can reduce all four lanes.
+     */
+    template<size_t N>
+    class SimdVectorBase {
+    public:
+        static_assert(N == 3 || N == 4, "Only 3 and 4 component float vectors are SIMD backed");
+
+        using VectorType = Vector<float, N>;
+
+        [[nodiscard]] constexpr const float& getX() const { return _data[0]; }
+
+        void setX(float x) { _data[0] = x; }
+
+        [[nodiscard]] constexpr const float& getY() const { return _data[1]; }
+
+        void setY(float y) { _data[1] = y; }
+
+        [[nodiscard]] constexpr const float& getZ() const { return _data[2]; }
+
+        void setZ(float z) { _data[2] = z; }
+
+        [[nodiscard]] constexpr const float& getW() const {
+            static_assert(N >= 4);
+            return _data[3];
+        }
+
+        void setW(float w) {
+            static_assert(N >= 4);
+            _data[3] = w;
+        }
+
+        [[nodiscard]] constexpr size_t getSize() const { return N; }
+
+        [[nodiscard]] float getLength() const {
+            return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(dot(asVector()))));
+        }
+
+        [[nodiscard]] bool isZero() const {
+            return allLanes(_mm_cmplt_ps(abs(load()), epsilon()));
+        }
+
+        [[nodiscard]] VectorType getNormalized() const {
+            return divide(load(), _mm_set1_ps(getLength()));
+        }
+
+        [[nodiscard]] VectorType normalize() const {
+            const auto length = getLength();
+            assert(!almostEqual(length, 0.0f));
+            return divide(load(), _mm_set1_ps(length));
+        }
+
+        [[nodiscard]] constexpr const float& operator[](size_t index) const { return _data[index]; }
+
+        [[nodiscard]] float& operator[](size_t index) { return _data[index]; }
+
+        [[nodiscard]] VectorType max(const VectorType& other) const { return make(_mm_max_ps(load(), other.load())); }
+
+        [[nodiscard]] VectorType min(const VectorType& other) const { return make(_mm_min_ps(load(), other.load())); }
+
+        VectorType& operator+=(const VectorType& other) { return assign(_mm_add_ps(load(), other.load())); }
+
+        VectorType& operator-=(const VectorType& other) { return assign(_mm_sub_ps(load(), other.load())); }
+
+        VectorType& operator*=(const VectorType& other) { return assign(_mm_mul_ps(load(), other.load())); }
+
+        VectorType& operator/=(const VectorType& other) { return assign(divide(load(), other.load()).load()); }
+
+        VectorType& operator+=(float scalar) { return assign(maskPadding(_mm_add_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType& operator-=(float scalar) { return assign(maskPadding(_mm_sub_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType& operator*=(float scalar) { return assign(maskPadding(_mm_mul_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType& operator/=(float scalar) { return assign(divide(load(), _mm_set1_ps(scalar)).load()); }
+
+        VectorType operator+(const VectorType& other) const { return make(_mm_add_ps(load(), other.load())); }
+
+        VectorType operator-(const VectorType& other) const { return make(_mm_sub_ps(load(), other.load())); }
+
+        VectorType operator*(const VectorType& other) const { return make(_mm_mul_ps(load(), other.load())); }
+
+        VectorType operator/(const VectorType& other) const { return divide(load(), other.load()); }
+
+        VectorType operator+(float scalar) const { return make(maskPadding(_mm_add_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType operator-(float scalar) const { return make(maskPadding(_mm_sub_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType operator*(float scalar) const { return make(maskPadding(_mm_mul_ps(load(), _mm_set1_ps(scalar)))); }
+
+        VectorType operator/(float scalar) const { return divide(load(), _mm_set1_ps(scalar)); }
+
+        bool operator==(const VectorType& other) const {
+            return allLanes(_mm_cmplt_ps(abs(_mm_sub_ps(load(), other.load())), epsilon()));
+        }
+
+        bool operator!=(const VectorType& other) const { return !operator==(other); }
+
+        bool operator>(const VectorType& other) const { return allLanes(_mm_cmpgt_ps(load(), other.load())); }
+
+        bool operator>(float scalar) const { return allLanes(_mm_cmpgt_ps(load(), _mm_set1_ps(scalar))); }
+
+        [[nodiscard]] float dot(const VectorType& other) const {
+            const auto product = _mm_mul_ps(load(), other.load());
+            const auto pairs = _mm_add_ps(product, _mm_movehl_ps(product, product));
+            return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+        }
+
+        [[nodiscard]] VectorType cross(const VectorType& other) const {
+            static_assert(N == 3, "Cross product only defined for 3D vectors");
+            const auto a = load();
+            const auto b = other.load();
+            const auto aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+            const auto bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+            const auto c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+            return make(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+        }
+
+        void swap(VectorType& other) {
+            std::swap(_data, other._data);
+        }
+
+    protected:
+        constexpr SimdVectorBase() : _data{} {}
+
+        constexpr SimdVectorBase(float x, float y, float z, float w) : _data{x, y, z, w} {}
+
+        [[nodiscard]] __m128 load() const { return _mm_load_ps(_data); }
+
+        [[nodiscard]] static VectorType make(__m128 value) {
+            VectorType result;
+            _mm_store_ps(result._data, value);
+            return result;
+        }
+
+    private:
+        [[nodiscard]] const VectorType& asVector() const { return static_cast<const VectorType&>(*this); }
+
+        VectorType& assign(__m128 value) {
+            _mm_store_ps(_data, value);
+            return static_cast<VectorType&>(*this);
+        }
+
+        // Scalar operations would otherwise write the scalar (or NaN) into the zero padding lane.
+        [[nodiscard]] static __m128 maskPadding(__m128 value) {
+            if constexpr (N == 3) {
+                return _mm_and_ps(value, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1)));
+            } else {
+                return value;
+            }
+        }
+
+        [[nodiscard]] static VectorType divide(__m128 lhs, __m128 rhs) {
+            return make(maskPadding(_mm_div_ps(lhs, rhs)));
+        }
+
+        [[nodiscard]] static __m128 abs(__m128 value) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), value); }
+
+        [[nodiscard]] static __m128 epsilon() { return _mm_set1_ps(std::numeric_limits<float>::epsilon()); }
+
+        [[nodiscard]] static bool allLanes(__m128 mask) {
+            constexpr int kLaneBits = (1 << N) - 1;
+            return (_mm_movemask_ps(mask) & kLaneBits) == kLaneBits;
+        }
+
+    private:
+        alignas(16) float _data[4];
+    };
+
+#if CRT_VECTOR3_PADDED
+    /**
+     * Opt-in (CRT_VECTOR3_PADDED): 3 component float vectors padded to 16 bytes so they share the SSE code path.
+     * Costs a third more memory for vertex and pixel arrays.
+     */
+    template<>
+    class Vector<float, 3> : public SimdVectorBase<3> {
+    public:
+        constexpr Vector() = default;
+
+        constexpr explicit Vector(const std::array<float, 3>& data)
+                : SimdVectorBase(data[0], data[1], data[2], 0.0f) {}
+
+        constexpr Vector(float x, float y) : SimdVectorBase(x, y, 0.0f, 0.0f) {}
+
+        constexpr Vector(float x, float y, float z) : SimdVectorBase(x, y, z, 0.0f) {}
+
+        template<typename ...Args, typename = std::enable_if_t<sizeof...(Args) == 3>>
+        constexpr explicit Vector(Args&& ... args) : Vector(static_cast<float>(args)...) {}
+
+        [[nodiscard]] Vector getXYZ() const { return *this; }
+    };
+#endif
+
+    template<>
+    class Vector<float, 4> : public SimdVectorBase<4> {
+    public:
+        constexpr Vector() = default;
+
+        constexpr explicit Vector(const std::array<float, 4>& data)
+                : SimdVectorBase(data[0], data[1], data[2], data[3]) {}
+
+        constexpr Vector(float x, float y) : SimdVectorBase(x, y, 0.0f, 0.0f) {}
+
+        constexpr Vector(float x, float y, float z) : SimdVectorBase(x, y, z, 0.0f) {}
+
+        constexpr Vector(float x, float y, float z, float w) : SimdVectorBase(x, y, z, w) {}
+
+        template<typename ...Args, typename = std::enable_if_t<sizeof...(Args) == 4>>
+        constexpr explicit Vector(Args&& ... args) : Vector(static_cast<float>(args)...) {}
+
+        // Not part of SimdVectorBase, where naming Vector<float, 3> would instantiate it before its specialization.
+        [[nodiscard]] Vector<float, 3> getXYZ() const {
+            return Vector<float, 3>(getX(), getY(), getZ());
+        }
+    };
+#endif
+
     template<class Type = float>
     using Vector2 = Vector<Type, 2>;
     using Vector2f = Vector2<float>;
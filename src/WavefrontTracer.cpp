@@ -0,0 +1,156 @@
+#include "WavefrontTracer.h"
+
+#include "RayPacket.h"
+#include "Statistics.h"
+#include "Surface.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace crt {
+    WavefrontTracer::WavefrontTracer(const Scene& scene, std::vector<LightSource> lightSources,
+                                     WavefrontOptions options)
+            : _scene(scene), _lightSources(std::move(lightSources)), _options(options) {}
+
+    uint32_t WavefrontTracer::trace(const Ray* cameraRays, int rayCount, Vector3f* outColors) {
+        _rays.assign(cameraRays, cameraRays + rayCount);
+        _sources.resize(rayCount);
+        for (int i = 0; i < rayCount; ++i) {
+            _sources[i] = ~i;
+        }
+        _pathVertices.assign(rayCount, kMissed);
+        _vertexRays.clear();
+        _points.clear();
+        _normals.clear();
+        _materials.clear();
+        _surfaceColors.clear();
+        _reflections.clear();
+        _visibility.clear();
+        _rayCount = 0;
+
+        for (int depth = 0; !_rays.empty(); ++depth) {
+            const auto firstVertex = static_cast<uint32_t>(_points.size());
+            extend(depth == 0 ? 0.0f : _options.rayEpsilon);
+            shade();
+            shadow();
+            spawn(firstVertex, depth);
+        }
+        accumulate(rayCount, outColors);
+        return _rayCount;
+    }
+
+    void WavefrontTracer::extend(float tMin) {
+        const auto count = _rays.size();
+        _hitT.resize(count);
+        _hitPrimitives.resize(count);
+        _hitU.resize(count);
+        _hitV.resize(count);
+        _hitSurfaces.resize(count);
+        RayPacket packet;
+        PacketHit packetHit;
+        for (size_t first = 0; first < count; first += RayPacket::kMaxSize) {
+            const auto laneCount = static_cast<int>(std::min(count - first, static_cast<size_t>(RayPacket::kMaxSize)));
+            packet.reset(RayPacket::kMaxSize);
+            packetHit.reset();
+            for (int lane = 0; lane < laneCount; ++lane) {
+                packet.setRay(lane, _rays[first + lane], tMin, std::numeric_limits<float>::max());
+            }
+            _scene.hitPacket(packet, packetHit);
+            for (int lane = 0; lane < laneCount; ++lane) {
+                _hitT[first + lane] = packet.tMax[lane];
+                _hitPrimitives[first + lane] = packetHit.primitive[lane];
+                _hitU[first + lane] = packetHit.u[lane];
+                _hitV[first + lane] = packetHit.v[lane];
+                _hitSurfaces[first + lane] = packetHit.surface[lane];
+            }
+        }
+        _rayCount += static_cast<uint32_t>(count);
+    }
+
+    void WavefrontTracer::shade() {
+        const auto lightCount = _lightSources.size();
+        _shadowRays.clear();
+        _shadowTMax.clear();
+        _shadowTargets.clear();
+        for (size_t i = 0; i < _rays.size(); ++i) {
+            const auto* surface = _hitSurfaces[i];
+            if (!surface) {
+                continue;
+            }
+            HitRecord hitRecord{};
+            surface->resolveHit(_rays[i], _hitT[i], _hitPrimitives[i], _hitU[i], _hitV[i], hitRecord);
+            const auto vertex = static_cast<int32_t>(_points.size());
+            getSlot(_sources[i]) = vertex;
+            _vertexRays.push_back(_rays[i]);
+            _points.push_back(hitRecord.p);
+            _normals.push_back(hitRecord.normal);
+            _materials.push_back(hitRecord.material);
+            _surfaceColors.push_back(hitRecord.color);
+            _reflections.push_back(kNotTraced);
+            _visibility.resize(_visibility.size() + lightCount, 0);
+            for (size_t light = 0; light < lightCount; ++light) {
+                float lightDistance;
+                const auto l = Shading::getLightDirection(_lightSources[light], hitRecord.p, lightDistance);
+                _shadowRays.push_back({hitRecord.p, l});
+                _shadowTMax.push_back(lightDistance);
+                _shadowTargets.push_back(static_cast<uint32_t>(vertex * lightCount + light));
+            }
+        }
+    }
+
+    void WavefrontTracer::shadow() {
+        for (size_t i = 0; i < _shadowRays.size(); ++i) {
+            _visibility[_shadowTargets[i]] = !_scene.occluded(_shadowRays[i], _options.rayEpsilon, _shadowTMax[i]);
+        }
+        _rayCount += static_cast<uint32_t>(_shadowRays.size());
+    }
+
+    void WavefrontTracer::spawn(uint32_t firstVertex, int depth) {
+        const auto lightCount = _lightSources.size();
+        _rays.clear();
+        _sources.clear();
+        if (depth >= _options.maxReflections) {
+            return;
+        }
+        for (auto vertex = firstVertex; vertex < _points.size(); ++vertex) {
+            const auto* visibility = _visibility.data() + vertex * lightCount;
+            // The recursive tracer reflects once per visible light, always along the same ray; one is enough.
+            if (Shading::isReflective(*_materials[vertex]) &&
+                std::any_of(visibility, visibility + lightCount, [](uint8_t visible) { return visible != 0; })) {
+                _rays.push_back(Shading::reflect(_vertexRays[vertex], _points[vertex], _normals[vertex]));
+                _sources.push_back(static_cast<int32_t>(vertex));
+                _reflections[vertex] = kMissed;
+            }
+        }
+        if (!_rays.empty()) {
+            CRT_COUNT(reflectionRays, _rays.size());
+            CRT_COUNT_MAX(maxReflectionDepth, static_cast<uint32_t>(depth + 1));
+        }
+    }
+
+    void WavefrontTracer::accumulate(int rayCount, Vector3f* outColors) {
+        const auto lightCount = _lightSources.size();
+        const Vector3f black{};
+        _colors.resize(_points.size());
+        for (auto vertex = _points.size(); vertex-- > 0;) {
+            const auto& material = *_materials[vertex];
+            const auto& point = _points[vertex];
+            const auto reflection = _reflections[vertex];
+            const Vector3f* reflectedColor = reflection == kNotTraced ? nullptr
+                                             : reflection == kMissed ? &black : &_colors[reflection];
+            auto color = material.getAmbient();
+            for (size_t light = 0; light < lightCount; ++light) {
+                if (_visibility[vertex * lightCount + light]) {
+                    float lightDistance;
+                    const auto l = Shading::getLightDirection(_lightSources[light], point, lightDistance);
+                    color += Shading::shadeLight(_lightSources[light], material, _vertexRays[vertex], point,
+                                                 _normals[vertex], l, reflectedColor);
+                }
+            }
+            _colors[vertex] = Shading::finish(color, _surfaceColors[vertex]);
+        }
+        for (int i = 0; i < rayCount; ++i) {
+            outColors[i] = _pathVertices[i] == kMissed ? black : _colors[_pathVertices[i]];
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "HitRecord.h"
+#include "Scene.h"
+#include "Shading.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace crt {
+
+    struct WavefrontOptions {
+        // Reflection bounces after the camera ray.
+        int maxReflections = 5;
+        // Start offset of shadow and reflection rays, keeps them off the surface they leave.
+        float rayEpsilon = 0.006f;
+    };
+
+    /**
+     * Breadth-first tracer for the Whitted style shading of Shading. Instead of following each camera ray
+     * depth first, all rays of a batch move through stages held in structure-of-arrays queues:
+     *
+     *   extend  closest hits of the ray queue, 16 rays per packet
+     *   shade   resolve the hits into path vertices and queue one shadow ray per light
+     *   shadow  occlusion test of the shadow queue
+     *   spawn   queue the mirror rays of reflective vertices that see a light
+     *
+     * which repeat per bounce until no rays are left, after which accumulate folds the vertices back into
+     * colors, deepest first. Each stage is one tight loop over one kind of work, so geometry, lights and
+     * materials stay in cache across the whole batch.
+     *
+     * A tracer keeps its queues between batches and is not thread safe, use one per render thread.
+     */
+    class WavefrontTracer {
+    public:
+        WavefrontTracer(const Scene& scene, std::vector<LightSource> lightSources, WavefrontOptions options = {});
+
+        /**
+         * Traces rayCount camera rays and writes one color per ray into outColors.
+         * @return number of rays traced, camera, shadow and reflection rays together
+         */
+        uint32_t trace(const Ray* cameraRays, int rayCount, Vector3f* outColors);
+
+    private:
+        // Vertex slot of a queued ray: set for hits, left at kMissed otherwise.
+        static constexpr int32_t kMissed = -1;
+        // Reflection slot of vertices that traced no reflection.
+        static constexpr int32_t kNotTraced = -2;
+
+        void extend(float tMin);
+
+        void shade();
+
+        void shadow();
+
+        void spawn(uint32_t firstVertex, int depth);
+
+        void accumulate(int rayCount, Vector3f* outColors);
+
+        [[nodiscard]] int32_t& getSlot(int32_t source) {
+            return source < 0 ? _pathVertices[~source] : _reflections[source];
+        }
+
+    private:
+        const Scene& _scene;
+        std::vector<LightSource> _lightSources;
+        WavefrontOptions _options;
+
+        // Ray queue of the current bounce. A source >= 0 is the vertex that reflected the ray, a negative source
+        // is ~path for camera rays.
+        std::vector<Ray> _rays;
+        std::vector<int32_t> _sources;
+        std::vector<float> _hitT;
+        std::vector<uint32_t> _hitPrimitives;
+        std::vector<float> _hitU;
+        std::vector<float> _hitV;
+        std::vector<const Surface*> _hitSurfaces;
+
+        // Path vertices of the whole batch in creation order, so a reflection always comes after its parent.
+        std::vector<Ray> _vertexRays;
+        std::vector<Vector3f> _points;
+        std::vector<Vector3f> _normals;
+        std::vector<const Material*> _materials;
+        std::vector<Vector3f> _surfaceColors;
+        std::vector<int32_t> _reflections;
+        std::vector<Vector3f> _colors;
+        // One flag per vertex and light.
+        std::vector<uint8_t> _visibility;
+        std::vector<int32_t> _pathVertices;
+
+        // Shadow queue, target indexes _visibility.
+        std::vector<Ray> _shadowRays;
+        std::vector<float> _shadowTMax;
+        std::vector<uint32_t> _shadowTargets;
+
+        uint32_t _rayCount = 0;
+    };
+}
@@ -0,0 +1,276 @@
+#include "WideBvh.h"
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <optional>
+#include <vector>
+
+namespace crt {
+    namespace {
+        constexpr int kMinExponent = -126;
+        constexpr int kMaxExponent = 127;
+        // Smaller trees are refit on the calling thread, larger ones split into about kRefitSubtreeCount subtrees.
+        constexpr size_t kParallelRefitThreshold = 16 * 1024;
+        constexpr size_t kRefitSubtreeCount = 64;
+
+        /**
+         * Quantizes one axis of the child bounds with grid spacing 2^exponent, rounding outwards. Fails when a
+         * child reaches past grid coordinate 255.
+         */
+        template<int Width>
+        bool quantizeAxis(WideBvhNode<Width>& node, int axis, int exponent,
+                          const BoundingBox<float>* childBounds, int childCount) {
+            const auto origin = node.origin[axis];
+            const auto scale = WideBvhNode<Width>::getScale(static_cast<int8_t>(exponent));
+            for (int slot = 0; slot < childCount; ++slot) {
+                const auto min = childBounds[slot].getMin()[axis];
+                const auto max = childBounds[slot].getMax()[axis];
+                auto lower = std::clamp(std::floor((min - origin) / scale), 0.0f, 255.0f);
+                while (lower > 0.0f && origin + lower * scale > min) {
+                    lower -= 1.0f;
+                }
+                auto upper = std::max(std::ceil((max - origin) / scale), lower);
+                while (upper <= 255.0f && origin + upper * scale < max) {
+                    upper += 1.0f;
+                }
+                if (upper > 255.0f) {
+                    return false;
+                }
+                node.lower[axis][slot] = static_cast<uint8_t>(lower);
+                node.upper[axis][slot] = static_cast<uint8_t>(upper);
+            }
+            return true;
+        }
+
+        template<int Width>
+        void initializeNode(WideBvhNode<Width>& node, const BoundingBox<float>& bounds,
+                            const BoundingBox<float>* childBounds, const uint32_t* children, int childCount) {
+            node.childCount = static_cast<uint8_t>(childCount);
+            std::fill(&node.lower[0][0], &node.lower[0][0] + 3 * Width, uint8_t{255});
+            std::fill(&node.upper[0][0], &node.upper[0][0] + 3 * Width, uint8_t{0});
+            std::fill(node.children, node.children + Width, ~0u);
+            std::copy(children, children + childCount, node.children);
+            for (int axis = 0; axis < 3; ++axis) {
+                node.origin[axis] = bounds.getMin()[axis];
+                const auto extent = bounds.getMax()[axis] - bounds.getMin()[axis];
+                auto exponent = extent > 0.0f ? static_cast<int>(std::ceil(std::log2(extent / 255.0f))) : kMinExponent;
+                exponent = std::clamp(exponent, kMinExponent, kMaxExponent);
+                // log2 may round the wrong way, then the next coarser grid fits.
+                while (!quantizeAxis(node, axis, exponent, childBounds, childCount)) {
+                    assert(exponent < kMaxExponent);
+                    ++exponent;
+                }
+                node.exponent[axis] = static_cast<int8_t>(exponent);
+            }
+        }
+
+        /**
+         * Recomputes the exact bounds of the subtree under nodeIndex into nodeBounds and requantizes its nodes.
+         */
+        template<int Width>
+        void refitNode(uint32_t nodeIndex, const std::vector<BoundingBox<float>>& leafBounds,
+                       WideBvhNode<Width>* nodes, std::vector<BoundingBox<float>>& nodeBounds) {
+            auto& node = nodes[nodeIndex];
+            BoundingBox<float> childBounds[Width];
+            BoundingBox<float> bounds;
+            for (int slot = 0; slot < node.childCount; ++slot) {
+                const auto child = node.children[slot];
+                if (WideBvhNode<Width>::isLeaf(child)) {
+                    childBounds[slot] = leafBounds[WideBvhNode<Width>::getLeafIndex(child)];
+                } else {
+                    refitNode(child, leafBounds, nodes, nodeBounds);
+                    childBounds[slot] = nodeBounds[child];
+                }
+                bounds.expand(childBounds[slot]);
+            }
+            nodeBounds[nodeIndex] = bounds;
+            // initializeNode rewrites the children it reads.
+            uint32_t children[Width];
+            std::copy(node.children, node.children + Width, children);
+            initializeNode(node, bounds, childBounds, children, node.childCount);
+        }
+    }
+
+    template<int Width>
+    WideBvh<Width>::WideBvh(const Bvh& bvh) {
+        const auto& binaryNodes = bvh.getNodes();
+        if (binaryNodes.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> leafIndices(binaryNodes.size(), 0);
+        uint32_t leafCount = 0;
+        for (size_t i = 0; i < binaryNodes.size(); ++i) {
+            if (binaryNodes[i].isLeaf()) {
+                leafIndices[i] = leafCount++;
+            }
+        }
+        assert(leafCount - 1 <= Node::kMaxLeafIndex);
+
+        struct PendingNode {
+            uint32_t wideIndex;
+            uint32_t binaryIndex;
+        };
+        std::vector<Node> nodes(1);
+        std::vector<PendingNode> pendingNodes{{0, 0}};
+        float areaSum = 0.0f;
+        while (!pendingNodes.empty()) {
+            const auto pending = pendingNodes.back();
+            pendingNodes.pop_back();
+
+            const auto& binaryNode = binaryNodes[pending.binaryIndex];
+            uint32_t slots[Width];
+            int childCount = 0;
+            if (binaryNode.isLeaf()) {
+                // Only a leaf root gets here.
+                slots[childCount++] = pending.binaryIndex;
+            } else {
+                slots[childCount++] = binaryNode.offset;
+                slots[childCount++] = binaryNode.offset + 1;
+                while (childCount < Width) {
+                    // Open the interior child most likely to be entered, the one with the largest surface area.
+                    int best = -1;
+                    float bestArea = -1.0f;
+                    for (int i = 0; i < childCount; ++i) {
+                        const auto& child = binaryNodes[slots[i]];
+                        if (!child.isLeaf() && child.bounds.getSurfaceArea() > bestArea) {
+                            best = i;
+                            bestArea = child.bounds.getSurfaceArea();
+                        }
+                    }
+                    if (best < 0) {
+                        break;
+                    }
+                    const auto opened = binaryNodes[slots[best]].offset;
+                    slots[best] = opened;
+                    slots[childCount++] = opened + 1;
+                }
+            }
+
+            BoundingBox<float> childBounds[Width];
+            uint32_t children[Width];
+            areaSum += binaryNode.bounds.getSurfaceArea();
+            for (int i = 0; i < childCount; ++i) {
+                const auto& child = binaryNodes[slots[i]];
+                childBounds[i] = child.bounds;
+                if (child.isLeaf()) {
+                    areaSum += child.bounds.getSurfaceArea();
+                    children[i] = Node::kLeafFlag | (child.primitiveCount - 1u) << Node::kLeafCountShift |
+                                  leafIndices[slots[i]];
+                } else {
+                    children[i] = static_cast<uint32_t>(nodes.size());
+                    nodes.emplace_back();
+                    pendingNodes.push_back({children[i], slots[i]});
+                }
+            }
+            initializeNode(nodes[pending.wideIndex], binaryNode.bounds, childBounds, children, childCount);
+        }
+        _nodes = SharedArray<Node>(std::move(nodes));
+        const auto rootArea = binaryNodes.front().bounds.getSurfaceArea();
+        _sahCost = _builtSahCost = rootArea > 0.0f ? areaSum / rootArea : 1.0f;
+    }
+
+    template<int Width>
+    void WideBvh<Width>::refit(const std::vector<BoundingBox<float>>& leafBounds, ThreadPool* threadPool) {
+        if (_nodes.empty()) {
+            return;
+        }
+        auto* nodes = _nodes.getMutableData();
+        std::vector<BoundingBox<float>> nodeBounds(_nodes.size());
+
+        // Same split as Bvh::refit: independent subtrees on the workers, the nodes above them afterwards.
+        std::vector<uint32_t> topNodes;
+        std::vector<uint32_t> subtrees{0};
+        if (_nodes.size() >= kParallelRefitThreshold) {
+            while (subtrees.size() < kRefitSubtreeCount) {
+                std::vector<uint32_t> nextSubtrees;
+                for (const auto index: subtrees) {
+                    const auto& node = nodes[index];
+                    bool hasInteriorChild = false;
+                    for (int slot = 0; slot < node.childCount; ++slot) {
+                        hasInteriorChild |= !Node::isLeaf(node.children[slot]);
+                    }
+                    if (!hasInteriorChild) {
+                        nextSubtrees.push_back(index);
+                        continue;
+                    }
+                    // The leaf children are picked up when the node itself is requantized below.
+                    topNodes.push_back(index);
+                    for (int slot = 0; slot < node.childCount; ++slot) {
+                        if (!Node::isLeaf(node.children[slot])) {
+                            nextSubtrees.push_back(node.children[slot]);
+                        }
+                    }
+                }
+                if (topNodes.empty() || nextSubtrees == subtrees) {
+                    break;
+                }
+                subtrees.swap(nextSubtrees);
+            }
+        }
+
+        if (topNodes.empty()) {
+            refitNode(0, leafBounds, nodes, nodeBounds);
+        } else {
+            std::optional<ThreadPool> localThreadPool;
+            if (!threadPool) {
+                localThreadPool.emplace();
+                threadPool = &*localThreadPool;
+            }
+            threadPool->parallelFor(static_cast<uint32_t>(subtrees.size()), [&](uint32_t subtree, unsigned) {
+                refitNode(subtrees[subtree], leafBounds, nodes, nodeBounds);
+            });
+            for (auto it = topNodes.rbegin(); it != topNodes.rend(); ++it) {
+                auto& node = nodes[*it];
+                BoundingBox<float> childBounds[Width];
+                BoundingBox<float> bounds;
+                for (int slot = 0; slot < node.childCount; ++slot) {
+                    const auto child = node.children[slot];
+                    childBounds[slot] = Node::isLeaf(child) ? leafBounds[Node::getLeafIndex(child)]
+                                                             : nodeBounds[child];
+                    bounds.expand(childBounds[slot]);
+                }
+                nodeBounds[*it] = bounds;
+                uint32_t children[Width];
+                std::copy(node.children, node.children + Width, children);
+                initializeNode(node, bounds, childBounds, children, node.childCount);
+            }
+        }
+
+        float areaSum = 0.0f;
+        for (size_t i = 0; i < _nodes.size(); ++i) {
+            areaSum += nodeBounds[i].getSurfaceArea();
+            for (int slot = 0; slot < nodes[i].childCount; ++slot) {
+                if (Node::isLeaf(nodes[i].children[slot])) {
+                    areaSum += leafBounds[Node::getLeafIndex(nodes[i].children[slot])].getSurfaceArea();
+                }
+            }
+        }
+        const auto rootArea = nodeBounds.front().getSurfaceArea();
+        _sahCost = rootArea > 0.0f ? areaSum / rootArea : 1.0f;
+        if (_builtSahCost == 0.0f) {
+            _builtSahCost = _sahCost;
+        }
+    }
+
+    template<int Width>
+    BoundingBox<float> WideBvh<Width>::getBounds() const {
+        BoundingBox<float> bounds;
+        if (_nodes.empty()) {
+            return bounds;
+        }
+        const auto& root = _nodes.front();
+        for (int slot = 0; slot < root.childCount; ++slot) {
+            const auto childBounds = root.getChildBounds(slot);
+            bounds.expand(childBounds.getMin());
+            bounds.expand(childBounds.getMax());
+        }
+        return bounds;
+    }
+
+    template class WideBvh<4>;
+    template class WideBvh<8>;
+}
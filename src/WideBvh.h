@@ -0,0 +1,290 @@
+#pragma once
+
+#include "Bvh.h"
+#include "RayPacket.h"
+#include "SharedArray.h"
+#include "Simd.h"
+#include "Statistics.h"
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace crt {
+
+    /**
+     * Node of a WideBvh with up to Width children. Child bounds are stored as 8 bit coordinates on a grid laid
+     * over the node bounds. The grid spacing of every axis is a power of two, so dequantizing is exact and the
+     * quantized boxes always enclose the real child bounds. A node takes one cache line at Width 4, two at 8.
+     */
+    template<int Width>
+    struct alignas(64) WideBvhNode {
+        static constexpr uint32_t kLeafFlag = 0x80000000u;
+        static constexpr int kLeafCountShift = 28;
+        static constexpr uint32_t kMaxLeafIndex = (1u << kLeafCountShift) - 1;
+
+        // Lower corner of the grid and the log2 of its spacing per axis.
+        float origin[3];
+        int8_t exponent[3];
+        uint8_t childCount;
+        // Slots from childCount on have lower 255 and upper 0, a box no ray passes.
+        uint8_t lower[3][Width];
+        uint8_t upper[3][Width];
+        // Index of an interior child, or kLeafFlag | (primitiveCount - 1) << kLeafCountShift | leafIndex.
+        uint32_t children[Width];
+
+        [[nodiscard]] static bool isLeaf(uint32_t child) { return (child & kLeafFlag) != 0; }
+
+        [[nodiscard]] static uint32_t getLeafIndex(uint32_t child) { return child & kMaxLeafIndex; }
+
+        [[nodiscard]] static uint32_t getLeafPrimitiveCount(uint32_t child) {
+            return ((child & ~kLeafFlag) >> kLeafCountShift) + 1;
+        }
+
+        [[nodiscard]] static float getScale(int8_t exponent) {
+            const auto bits = static_cast<uint32_t>(exponent + 127) << 23;
+            float scale;
+            std::memcpy(&scale, &bits, sizeof(scale));
+            return scale;
+        }
+
+        [[nodiscard]] BoundingBox<float> getChildBounds(int slot) const {
+            float min[3];
+            float max[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                const auto scale = getScale(exponent[axis]);
+                min[axis] = origin[axis] + static_cast<float>(lower[axis][slot]) * scale;
+                max[axis] = origin[axis] + static_cast<float>(upper[axis][slot]) * scale;
+            }
+            return {Vector3f{min[0], min[1], min[2]}, Vector3f{max[0], max[1], max[2]}};
+        }
+    };
+
+    static_assert(sizeof(WideBvhNode<4>) == 64 && sizeof(WideBvhNode<8>) == 128);
+
+    /**
+     * Bounding volume hierarchy with Width (4 or 8) children per node and quantized child bounds, collapsed from
+     * a binary Bvh. Traversal tests all children of a node at once with SIMD, against reciprocal ray directions
+     * computed once per ray, and visits the hit children nearest first. Leaves are numbered in the node order of
+     * the binary Bvh, so an owner that stores one block of primitives per leaf indexes it directly.
+     */
+    template<int Width>
+    class WideBvh {
+    public:
+        static_assert(Width == 4 || Width == 8, "wide BVH nodes hold 4 or 8 children");
+
+        using Node = WideBvhNode<Width>;
+
+        WideBvh() = default;
+
+        /**
+         * Collapses bvh: every wide node opens the binary descendant with the largest surface area until it has
+         * Width children.
+         */
+        explicit WideBvh(const Bvh& bvh);
+
+        /**
+         * Adopts nodes collapsed earlier, e.g. ones stored in a scene bundle.
+         */
+        explicit WideBvh(SharedArray<Node> nodes) : _nodes(std::move(nodes)) {}
+
+        /**
+         * Requantizes every node after the primitives moved, keeping the topology. leafBounds holds the exact
+         * bounds of every leaf by leaf index. Subtrees are refit in parallel on threadPool; null uses a temporary
+         * pool for large trees. Nodes no other WideBvh shares are updated in place.
+         */
+        void refit(const std::vector<BoundingBox<float>>& leafBounds, ThreadPool* threadPool = nullptr);
+
+        [[nodiscard]] bool isEmpty() const { return _nodes.empty(); }
+
+        [[nodiscard]] const SharedArray<Node>& getNodes() const { return _nodes; }
+
+        [[nodiscard]] BoundingBox<float> getBounds() const;
+
+        /**
+         * Expected node and leaf tests of a random ray through the root, from the exact bounds at collapse or
+         * refit time. Zero for adopted nodes that were never refit.
+         */
+        [[nodiscard]] float getSahCost() const { return _sahCost; }
+
+        /**
+         * Whether refits grew the cost past maxSahRatio times the cost after the collapse (or, for adopted nodes,
+         * the first refit).
+         */
+        [[nodiscard]] bool needsRebuild(float maxSahRatio) const { return _sahCost > maxSahRatio * _builtSahCost; }
+
+        /**
+         * Closest hit traversal. `leafIntersector(leafIndex, primitiveCount, tMin, tMax)` must return true on a
+         * hit closer than tMax and shrink tMax to the hit distance.
+         */
+        template<typename LeafIntersector>
+        bool intersectLeaves(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const {
+            return traverse<false>(ray, tMin, tMax, leafIntersector);
+        }
+
+        /**
+         * Any hit traversal, stops at the first leaf for which
+         * `leafIntersector(leafIndex, primitiveCount, tMin, tMax)` returns true.
+         */
+        template<typename LeafIntersector>
+        bool occludedLeaves(const Ray& ray, float tMin, float tMax, LeafIntersector&& leafIntersector) const {
+            return traverse<true>(ray, tMin, tMax, leafIntersector);
+        }
+
+        /**
+         * Closest hit traversal for a whole packet, `leafIntersector(leafIndex, primitiveCount)` intersects the
+         * packet with a leaf and shrinks the lanes' tMax.
+         */
+        template<typename LeafIntersector>
+        void intersectPacket(const RayPacket& packet, LeafIntersector&& leafIntersector) const;
+
+    private:
+        // A wide level replaces at least one binary level and leaves at most Width - 1 siblings on the stack.
+        static constexpr size_t kStackSize = Bvh::kMaxDepth * (Width - 1) + 1;
+
+        struct StackEntry {
+            uint32_t child;
+            float tNear;
+        };
+
+        template<bool AnyHit, typename LeafIntersector>
+        bool traverse(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const;
+
+    private:
+        SharedArray<Node> _nodes;
+        float _sahCost = 0.0f;
+        float _builtSahCost = 0.0f;
+    };
+
+    template<int Width>
+    template<bool AnyHit, typename LeafIntersector>
+    bool WideBvh<Width>::traverse(const Ray& ray, float tMin, float& tMax, LeafIntersector&& leafIntersector) const {
+        using Float = SimdFloat<Width>;
+        if (_nodes.empty()) {
+            return false;
+        }
+
+        // Same widening of the exit distance as the binary slab test, for flat boxes.
+        constexpr float kRobustness = 1.0f + 3.0f * std::numeric_limits<float>::epsilon();
+        // Axis parallel directions get a huge but finite reciprocal, so plane distances never turn into NaNs.
+        constexpr float kMinDirection = 1e-18f;
+        float rayOrigin[3];
+        float invDirection[3];
+        bool isNegative[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            const auto direction = ray.getDirection()[axis];
+            rayOrigin[axis] = ray.getOrigin()[axis];
+            invDirection[axis] = 1.0f / (std::abs(direction) >= kMinDirection ? direction
+                                                                               : std::copysign(kMinDirection, direction));
+            isNegative[axis] = invDirection[axis] < 0.0f;
+        }
+
+        StackEntry stack[kStackSize];
+        size_t stackSize = 0;
+        uint32_t nodeIndex = 0;
+        bool hit = false;
+        while (true) {
+            const auto& node = _nodes[nodeIndex];
+            CRT_COUNT(boxTests, node.childCount);
+            auto tNear = Float(tMin);
+            auto tFar = Float(tMax);
+            for (int axis = 0; axis < 3; ++axis) {
+                // The distance to grid plane q is q * scale / direction + (origin - rayOrigin) / direction.
+                const Float slope(Node::getScale(node.exponent[axis]) * invDirection[axis]);
+                const Float offset((node.origin[axis] - rayOrigin[axis]) * invDirection[axis]);
+                const auto nearPlane = Float::loadBytes(isNegative[axis] ? node.upper[axis] : node.lower[axis]);
+                const auto farPlane = Float::loadBytes(isNegative[axis] ? node.lower[axis] : node.upper[axis]);
+                tNear = max(nearPlane * slope + offset, tNear);
+                tFar = min((farPlane * slope + offset) * Float(kRobustness), tFar);
+            }
+
+            auto bits = (tNear <= tFar).getBits() & ((1u << node.childCount) - 1);
+            if (bits != 0) {
+                alignas(32) float distances[Width];
+                tNear.store(distances);
+                // Keep the new entries sorted far to near, so the nearest child is popped first.
+                const auto first = stackSize;
+                for (; bits != 0; bits &= bits - 1) {
+                    const auto slot = __builtin_ctz(bits);
+                    const StackEntry entry{node.children[slot], distances[slot]};
+                    auto i = stackSize++;
+                    for (; i > first && stack[i - 1].tNear < entry.tNear; --i) {
+                        stack[i] = stack[i - 1];
+                    }
+                    stack[i] = entry;
+                }
+            }
+
+            bool hasNode = false;
+            while (stackSize > 0) {
+                const auto entry = stack[--stackSize];
+                if (!AnyHit && entry.tNear > tMax) {
+                    // A hit found since it was pushed is closer than the whole child.
+                    continue;
+                }
+                if (!Node::isLeaf(entry.child)) {
+                    nodeIndex = entry.child;
+                    hasNode = true;
+                    break;
+                }
+                if (leafIntersector(Node::getLeafIndex(entry.child), Node::getLeafPrimitiveCount(entry.child),
+                                    tMin, tMax)) {
+                    if constexpr (AnyHit) {
+                        return true;
+                    }
+                    hit = true;
+                }
+            }
+            if (!hasNode) {
+                break;
+            }
+        }
+        return hit;
+    }
+
+    template<int Width>
+    template<typename LeafIntersector>
+    void WideBvh<Width>::intersectPacket(const RayPacket& packet, LeafIntersector&& leafIntersector) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        // Packets are coherent, so children are ordered along the summed direction of the active lanes.
+        Vector3f directionSum{0.0f, 0.0f, 0.0f};
+        for (int lane = 0; lane < packet.size; ++lane) {
+            if (packet.isActive(lane)) {
+                directionSum += Vector3f{packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]};
+            }
+        }
+
+        uint32_t stack[kStackSize];
+        size_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0) {
+            const auto child = stack[--stackSize];
+            if (Node::isLeaf(child)) {
+                leafIntersector(Node::getLeafIndex(child), Node::getLeafPrimitiveCount(child));
+                continue;
+            }
+
+            const auto& node = _nodes[child];
+            float keys[Width];
+            const auto first = stackSize;
+            for (int slot = 0; slot < node.childCount; ++slot) {
+                const auto bounds = node.getChildBounds(slot);
+                if (!PacketKernels::intersectBounds(packet, bounds)) {
+                    continue;
+                }
+                const auto key = bounds.getCenter().dot(directionSum);
+                auto i = stackSize++;
+                for (; i > first && keys[i - 1 - first] < key; --i) {
+                    stack[i] = stack[i - 1];
+                    keys[i - first] = keys[i - 1 - first];
+                }
+                stack[i] = node.children[slot];
+                keys[i - first] = key;
+            }
+        }
+    }
+}
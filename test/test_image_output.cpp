@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include "../src/HdrOutput.h"
+#include "../src/PngOutput.h"
+#include "../src/Renderer.h"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace crt;
+
+namespace {
+    std::vector<uint8_t> readFile(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    uint32_t readBigEndian(const uint8_t* bytes) {
+        return static_cast<uint32_t>(bytes[0]) << 24 | static_cast<uint32_t>(bytes[1]) << 16 |
+               static_cast<uint32_t>(bytes[2]) << 8 | bytes[3];
+    }
+
+    /**
+     * Minimal decoder for 8-bit RGB PNGs: checks every chunk CRC, inflates the IDAT stream and undoes the filters.
+     */
+    bool decodePng(const std::vector<uint8_t>& file, int& outWidth, int& outHeight, std::vector<uint8_t>& outRGB) {
+        if (file.size() < 8 || std::memcmp(file.data(), "\x89PNG\r\n\x1a\n", 8) != 0) {
+            return false;
+        }
+        std::vector<uint8_t> compressed;
+        for (size_t offset = 8; offset + 12 <= file.size();) {
+            const auto length = readBigEndian(&file[offset]);
+            const auto* type = &file[offset + 4];
+            const auto* data = &file[offset + 8];
+            if (crc32(0, type, length + 4) != readBigEndian(data + length)) {
+                return false;
+            }
+            if (std::memcmp(type, "IHDR", 4) == 0) {
+                outWidth = static_cast<int>(readBigEndian(data));
+                outHeight = static_cast<int>(readBigEndian(data + 4));
+            } else if (std::memcmp(type, "IDAT", 4) == 0) {
+                compressed.insert(compressed.end(), data, data + length);
+            } else if (std::memcmp(type, "IEND", 4) == 0) {
+                break;
+            }
+            offset += length + 12;
+        }
+        const auto rowBytes = static_cast<size_t>(outWidth) * 3;
+        std::vector<uint8_t> filtered((rowBytes + 1) * outHeight);
+        auto filteredSize = static_cast<uLongf>(filtered.size());
+        if (uncompress(filtered.data(), &filteredSize, compressed.data(), compressed.size()) != Z_OK ||
+            filteredSize != filtered.size()) {
+            return false;
+        }
+        outRGB.assign(rowBytes * outHeight, 0);
+        const std::vector<uint8_t> zeroRow(rowBytes, 0);
+        for (int y = 0; y < outHeight; ++y) {
+            const auto* line = &filtered[y * (rowBytes + 1)];
+            auto* row = &outRGB[y * rowBytes];
+            const auto* up = y == 0 ? zeroRow.data() : row - rowBytes;
+            for (size_t i = 0; i < rowBytes; ++i) {
+                const int a = i >= 3 ? row[i - 3] : 0;
+                const int b = up[i];
+                const int c = i >= 3 ? up[i - 3] : 0;
+                const int p = a + b - c;
+                int prediction = 0;
+                switch (line[0]) {
+                    case 0:
+                        break;
+                    case 1:
+                        prediction = a;
+                        break;
+                    case 2:
+                        prediction = b;
+                        break;
+                    case 3:
+                        prediction = (a + b) / 2;
+                        break;
+                    case 4:
+                        prediction = std::abs(p - a) <= std::abs(p - b) && std::abs(p - a) <= std::abs(p - c) ? a
+                                     : std::abs(p - b) <= std::abs(p - c) ? b : c;
+                        break;
+                    default:
+                        return false;
+                }
+                row[i] = static_cast<uint8_t>(line[1 + i] + prediction);
+            }
+        }
+        return true;
+    }
+
+    Vector3f testPattern(int x, int y) {
+        // Smooth gradients with some noise, so every filter type gets picked somewhere.
+        const auto noise = static_cast<float>((x * 7919 + y * 104729) % 13) / 255.0f;
+        return {static_cast<float>(x % 256) / 255.0f + noise, static_cast<float>(y) / 70.0f, noise * 10.0f - 0.2f};
+    }
+}
+
+TEST(crtTest, PngOutputMatchesFramebuffer) {
+    // Bands of 32 rows are over 64 KiB wide here, so they split into several deflate chunks.
+    const SizeI imageSize{1100, 70};
+    Renderer renderer(2, 32);
+    std::vector<uint8_t> expected(static_cast<size_t>(imageSize.getWidth()) * imageSize.getHeight() * 3);
+    renderer.render(imageSize, [](int x, int y, PixelContext&) { return testPattern(x, y); }, expected.data());
+
+    const std::string path = ::testing::TempDir() + "crt_png_output_test.png";
+    for (const int level: {0, 1, 6, 9}) {
+        PngOutput output(path, level, 2);
+        ASSERT_TRUE(renderer.render(imageSize, [](int x, int y, PixelContext&) {
+            return testPattern(x, y);
+        }, output)) << output.getError();
+
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> decoded;
+        ASSERT_TRUE(decodePng(readFile(path), width, height, decoded));
+        ASSERT_EQ(width, imageSize.getWidth());
+        ASSERT_EQ(height, imageSize.getHeight());
+        ASSERT_EQ(decoded, expected);
+    }
+    std::remove(path.c_str());
+
+    PngOutput output(path);
+    ASSERT_TRUE(output.begin(imageSize));
+    ASSERT_FALSE(output.writeRows(32, 1, nullptr));
+    ASSERT_FALSE(output.end());
+    std::remove(path.c_str());
+}
+
+TEST(crtTest, HdrOutputStoresFloats) {
+    const SizeI imageSize{40, 50};
+    Renderer renderer(2, 16);
+    const std::string path = ::testing::TempDir() + "crt_hdr_output_test";
+    for (const auto format: {HdrFormat::Pfm, HdrFormat::Raw}) {
+        HdrOutput output(path, format);
+        ASSERT_TRUE(renderer.render(imageSize, 4, [](const PixelCoordinate* pixels, int pixelCount, PixelContext&,
+                                                     Vector3f* outColors) {
+            for (int i = 0; i < pixelCount; ++i) {
+                outColors[i] = testPattern(pixels[i].x, pixels[i].y);
+            }
+        }, output)) << output.getError();
+
+        const auto file = readFile(path);
+        const std::string pfmHeader = "PF\n40 50\n-1.0\n";
+        const auto headerSize = format == HdrFormat::Pfm ? pfmHeader.size() : 0;
+        ASSERT_EQ(file.size(), headerSize + imageSize.getWidth() * imageSize.getHeight() * 3 * sizeof(float));
+        if (format == HdrFormat::Pfm) {
+            ASSERT_EQ(std::string(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(headerSize)), pfmHeader);
+        }
+        for (int y = 0; y < imageSize.getHeight(); ++y) {
+            // PFM stores the bottom row first.
+            const auto fileRow = format == HdrFormat::Pfm ? imageSize.getHeight() - 1 - y : y;
+            for (int x = 0; x < imageSize.getWidth(); ++x) {
+                float rgb[3];
+                std::memcpy(rgb, &file[headerSize + (fileRow * imageSize.getWidth() + x) * sizeof(rgb)], sizeof(rgb));
+                ASSERT_EQ((Vector3f{rgb[0], rgb[1], rgb[2]}), testPattern(x, y));
+            }
+        }
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,511 @@
+#include <gtest/gtest.h>
+#include "../src/LinearBvhBuilder.h"
+#include "../src/MatrixUtils.h"
+#include "../src/Mesh.h"
+#include "../src/ThreadPool.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace crt;
+
+namespace {
+    // Unit sphere tessellated into latitude/longitude quads, scaled and moved away from the origin.
+    Mesh makeSphereMesh(int rings, int segments, float radius, const Vector3f& center,
+                        const BvhBuildOptions& bvhOptions = {}, MeshStorage storage = MeshStorage::Full) {
+        std::vector<Vector3f> points;
+        for (int r = 0; r <= rings; ++r) {
+            const auto theta = static_cast<float>(M_PI) * static_cast<float>(r) / static_cast<float>(rings);
+            for (int s = 0; s < segments; ++s) {
+                const auto phi = 2.0f * static_cast<float>(M_PI) * static_cast<float>(s) / static_cast<float>(segments);
+                points.push_back(center + Vector3f{std::sin(theta) * std::cos(phi),
+                                                   std::cos(theta),
+                                                   std::sin(theta) * std::sin(phi)} * radius);
+            }
+        }
+        std::vector<Vector3i> indices;
+        for (int r = 0; r < rings; ++r) {
+            for (int s = 0; s < segments; ++s) {
+                const int i0 = r * segments + s;
+                const int i1 = r * segments + (s + 1) % segments;
+                const int i2 = (r + 1) * segments + s;
+                const int i3 = (r + 1) * segments + (s + 1) % segments;
+                indices.emplace_back(i0, i2, i1);
+                indices.emplace_back(i1, i2, i3);
+            }
+        }
+        return {std::move(points), std::move(indices), bvhOptions, storage};
+    }
+
+    Mesh makeTriangleSoup(int count, std::mt19937& random, const BvhBuildOptions& bvhOptions = {},
+                          MeshStorage storage = MeshStorage::Full) {
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+        std::vector<Vector3f> points;
+        std::vector<Vector3i> indices;
+        for (int i = 0; i < count; ++i) {
+            const Vector3f base{position(random), position(random), position(random)};
+            points.push_back(base);
+            points.push_back(base + Vector3f{offset(random), offset(random), offset(random)});
+            points.push_back(base + Vector3f{offset(random), offset(random), offset(random)});
+            indices.emplace_back(i * 3, i * 3 + 1, i * 3 + 2);
+        }
+        return {std::move(points), std::move(indices), bvhOptions, storage};
+    }
+
+    Ray makeRandomRay(std::mt19937& random) {
+        std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        Vector3f d{direction(random), direction(random), direction(random)};
+        if (d.getLength() < 1e-3f) {
+            d = Vector3f{0.0f, 0.0f, 1.0f};
+        }
+        return {Vector3f{position(random), position(random), position(random)}, d.normalize()};
+    }
+
+    void expectSameHits(const Mesh& mesh, std::mt19937& random, int rayCount) {
+        int hitCount = 0;
+        for (int i = 0; i < rayCount; ++i) {
+            const auto ray = makeRandomRay(random);
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = mesh.hitBruteForce(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            const bool actualHit = mesh.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual);
+            ASSERT_EQ(expectedHit, actualHit) << "ray " << i;
+            if (expectedHit) {
+                ++hitCount;
+                ASSERT_FLOAT_EQ(expected.t, actual.t) << "ray " << i;
+                ASSERT_EQ(expected.p, actual.p) << "ray " << i;
+                ASSERT_EQ(expected.normal, actual.normal) << "ray " << i;
+            }
+        }
+        ASSERT_GT(hitCount, 0);
+    }
+}
+
+TEST(crtTest, MeshBvhMatchesBruteForce) {
+    std::mt19937 random(20220620);
+    {
+        const auto mesh = makeSphereMesh(64, 128, 60.0f, Vector3f{10.0f, -5.0f, 20.0f});
+        expectSameHits(mesh, random, 4000);
+    }
+    {
+        const auto mesh = makeTriangleSoup(5000, random);
+        expectSameHits(mesh, random, 4000);
+    }
+}
+
+namespace {
+    void expectValidBvh(const Mesh& mesh) {
+        const auto& bvh = mesh.getBvh();
+        const auto& statistics = bvh.getStatistics();
+        ASSERT_EQ(statistics.nodeCount, statistics.leafCount * 2 - 1);
+        ASSERT_LT(statistics.maxDepth, Bvh::kMaxDepth);
+        ASSERT_LE(statistics.maxLeafPrimitiveCount, Bvh::kMaxLeafSize);
+
+        // Every triangle sits in exactly one leaf, and every node encloses its children.
+        std::vector<int> leafCounts(mesh.getTriangleCount(), 0);
+        const auto& nodes = bvh.getNodes();
+        for (const auto& node: nodes) {
+            if (node.isLeaf()) {
+                for (uint32_t i = 0; i < node.primitiveCount; ++i) {
+                    ++leafCounts[bvh.getPrimitiveIndices()[node.offset + i]];
+                }
+            } else {
+                for (uint32_t child = node.offset; child < node.offset + 2; ++child) {
+                    auto bounds = node.bounds;
+                    bounds.expand(nodes[child].bounds);
+                    ASSERT_EQ(bounds.getMin(), node.bounds.getMin());
+                    ASSERT_EQ(bounds.getMax(), node.bounds.getMax());
+                }
+            }
+        }
+        ASSERT_TRUE(std::all_of(leafCounts.begin(), leafCounts.end(), [](int count) { return count == 1; }));
+    }
+}
+
+TEST(crtTest, MortonCodes) {
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode30(1, 0, 0), 4u);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode30(0, 1, 0), 2u);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode30(0, 0, 1), 1u);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode30(2, 0, 3), 0b101'001u);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode30(1023, 1023, 1023), (1u << 30) - 1);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode63(1, 0, 0), 4u);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode63(0, 0, 1u << 20), uint64_t{1} << 60);
+    ASSERT_EQ(LinearBvhBuilder::getMortonCode63((1u << 21) - 1, (1u << 21) - 1, (1u << 21) - 1),
+              (uint64_t{1} << 63) - 1);
+}
+
+TEST(crtTest, LinearBvhMatchesBruteForce) {
+    for (const auto method: {BvhBuildMethod::Lbvh, BvhBuildMethod::Ploc}) {
+        for (const uint32_t mortonBits: {30u, 63u}) {
+            SCOPED_TRACE(testing::Message() << "method " << static_cast<int>(method) << ", " << mortonBits
+                                            << " bit codes");
+            BvhBuildOptions options;
+            options.method = method;
+            options.mortonBits = mortonBits;
+            std::mt19937 random(20220620);
+            const auto sphere = makeSphereMesh(64, 128, 60.0f, Vector3f{10.0f, -5.0f, 20.0f}, options);
+            expectValidBvh(sphere);
+            expectSameHits(sphere, random, 1000);
+            const auto soup = makeTriangleSoup(5000, random, options);
+            expectValidBvh(soup);
+            expectSameHits(soup, random, 1000);
+
+            // Sorting by Morton code gives up some tree quality against the SAH build, but not a lot.
+            const auto sahSoup = makeTriangleSoup(5000, random);
+            const auto linearSoup = makeTriangleSoup(5000, random, options);
+            ASSERT_LT(linearSoup.getBvh().getStatistics().sahCost, sahSoup.getBvh().getStatistics().sahCost * 2.0f);
+        }
+    }
+}
+
+TEST(crtTest, LinearBvhCoincidentTriangles) {
+    // Equal Morton codes everywhere: the builders have to fall back to median splits and still bound the depth.
+    std::vector<Vector3f> points = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}};
+    std::vector<Vector3i> indices(20000, Vector3i{0, 1, 2});
+    for (const auto method: {BvhBuildMethod::Lbvh, BvhBuildMethod::Ploc}) {
+        BvhBuildOptions options;
+        options.method = method;
+        const Mesh mesh(points, indices, options);
+        expectValidBvh(mesh);
+        HitRecord record{};
+        ASSERT_TRUE(mesh.hit(Ray({0.25f, 0.25f, 1.0f}, {0.0f, 0.0f, -1.0f}), 0.0f, 10.0f, record));
+        ASSERT_FLOAT_EQ(record.t, 1.0f);
+    }
+}
+
+TEST(crtTest, LinearBvhIsIndependentOfThreadCount) {
+    ThreadPool singleThread(1);
+    ThreadPool fourThreads(4);
+    for (const auto method: {BvhBuildMethod::Lbvh, BvhBuildMethod::Ploc}) {
+        BvhBuildOptions options;
+        options.method = method;
+        options.threadPool = &singleThread;
+        std::mt19937 random(11);
+        const auto serial = makeTriangleSoup(100000, random, options);
+        options.threadPool = &fourThreads;
+        random.seed(11);
+        const auto parallel = makeTriangleSoup(100000, random, options);
+
+        const auto& serialNodes = serial.getBvh().getNodes();
+        const auto& parallelNodes = parallel.getBvh().getNodes();
+        ASSERT_EQ(serialNodes.size(), parallelNodes.size());
+        for (size_t i = 0; i < serialNodes.size(); ++i) {
+            ASSERT_EQ(serialNodes[i].offset, parallelNodes[i].offset);
+            ASSERT_EQ(serialNodes[i].primitiveCount, parallelNodes[i].primitiveCount);
+        }
+        const auto& serialIndices = serial.getBvh().getPrimitiveIndices();
+        const auto& parallelIndices = parallel.getBvh().getPrimitiveIndices();
+        ASSERT_TRUE(std::equal(serialIndices.begin(), serialIndices.end(), parallelIndices.begin()));
+        ASSERT_EQ(serial.getBvh().getOptions().threadPool, nullptr);
+    }
+}
+
+TEST(crtTest, MeshBvhStatistics) {
+    std::mt19937 random(7);
+    const auto mesh = makeTriangleSoup(10000, random);
+    const auto& bvh = mesh.getBvh();
+    const auto& statistics = bvh.getStatistics();
+
+    ASSERT_EQ(statistics.nodeCount, bvh.getNodes().size());
+    ASSERT_EQ(statistics.nodeCount, statistics.leafCount * 2 - 1);
+    ASSERT_LT(statistics.maxDepth, Bvh::kMaxDepth);
+    ASSERT_GT(statistics.sahCost, 0.0f);
+    // A flat list of all triangles costs one intersection per triangle, the hierarchy must do far better.
+    ASSERT_LT(statistics.sahCost, static_cast<float>(mesh.getTriangleCount()) / 10.0f);
+
+    size_t primitiveCount = 0;
+    for (const auto& node: bvh.getNodes()) {
+        if (node.isLeaf()) {
+            primitiveCount += node.primitiveCount;
+        }
+    }
+    ASSERT_EQ(primitiveCount, mesh.getTriangleCount());
+}
+
+namespace {
+    BvhBuildOptions makeWideOptions(uint32_t width) {
+        BvhBuildOptions options;
+        options.width = width;
+        return options;
+    }
+
+    /**
+     * Every triangle sits in exactly one wide leaf, inside the quantized box its parent stores for it.
+     */
+    template<int Width>
+    void expectValidWideBvh(const Mesh& mesh, const WideBvh<Width>& wideBvh) {
+        using Node = WideBvhNode<Width>;
+        ASSERT_FALSE(wideBvh.isEmpty());
+        std::vector<int> leafCounts(mesh.getTriangleCount(), 0);
+        for (const auto& node: wideBvh.getNodes()) {
+            ASSERT_GE(node.childCount, 1);
+            ASSERT_LE(node.childCount, Width);
+            for (int slot = 0; slot < node.childCount; ++slot) {
+                const auto child = node.children[slot];
+                if (!Node::isLeaf(child)) {
+                    ASSERT_LT(child, wideBvh.getNodes().size());
+                    continue;
+                }
+                const auto bounds = node.getChildBounds(slot);
+                const auto& block = mesh.getTriangleBlocks()[Node::getLeafIndex(child)];
+                for (uint32_t i = 0; i < Node::getLeafPrimitiveCount(child); ++i) {
+                    const auto triangle = block.triangle[i];
+                    ++leafCounts[triangle];
+                    for (int vertex = 0; vertex < 3; ++vertex) {
+                        const auto& point = mesh.getPoints()[mesh.getTriangleVertexIndices()[triangle][vertex]];
+                        for (int axis = 0; axis < 3; ++axis) {
+                            ASSERT_GE(point[axis], bounds.getMin()[axis]);
+                            ASSERT_LE(point[axis], bounds.getMax()[axis]);
+                        }
+                    }
+                }
+            }
+        }
+        ASSERT_TRUE(std::all_of(leafCounts.begin(), leafCounts.end(), [](int count) { return count == 1; }));
+    }
+}
+
+TEST(crtTest, WideBvhMatchesBruteForce) {
+    std::mt19937 random(20240301);
+    for (const uint32_t width: {4u, 8u}) {
+        const auto sphere = makeSphereMesh(64, 128, 60.0f, Vector3f{10.0f, -5.0f, 20.0f}, makeWideOptions(width));
+        const auto soup = makeTriangleSoup(5000, random, makeWideOptions(width));
+        ASSERT_EQ(sphere.getBvhWidth(), width);
+        ASSERT_TRUE(sphere.getBvh().isEmpty());
+        ASSERT_TRUE(sphere.getLeafBlocks().empty());
+        if (width == 4) {
+            expectValidWideBvh(soup, soup.getWideBvh4());
+        } else {
+            expectValidWideBvh(soup, soup.getWideBvh8());
+        }
+        expectSameHits(sphere, random, 4000);
+        expectSameHits(soup, random, 4000);
+
+        // Axis parallel rays take the clamped reciprocal path.
+        for (int i = 0; i < 200; ++i) {
+            const auto offset = static_cast<float>(i) * 0.5f - 50.0f;
+            const Ray ray{{10.0f + offset, -5.0f + offset * 0.3f, -200.0f}, {0.0f, 0.0f, 1.0f}};
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = sphere.hitBruteForce(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(sphere.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual), expectedHit) << "ray " << i;
+            ASSERT_EQ(sphere.occluded(ray, 0.0f, std::numeric_limits<float>::max()), expectedHit) << "ray " << i;
+            if (expectedHit) {
+                ASSERT_FLOAT_EQ(expected.t, actual.t) << "ray " << i;
+            }
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            const auto ray = makeRandomRay(random);
+            HitRecord expected{};
+            const bool expectedHit = soup.hitBruteForce(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(soup.occluded(ray, 0.0f, std::numeric_limits<float>::max()), expectedHit) << "ray " << i;
+        }
+    }
+}
+
+TEST(crtTest, WideBvhPacketMatchesScalarHit) {
+    std::mt19937 random(31);
+    std::uniform_real_distribution<float> direction(-0.3f, 0.3f);
+    for (const uint32_t width: {4u, 8u}) {
+        const auto mesh = makeSphereMesh(32, 64, 60.0f, Vector3f{0.0f, 0.0f, 0.0f}, makeWideOptions(width));
+        int hitCount = 0;
+        for (int i = 0; i < 200; ++i) {
+            const Vector3f origin{direction(random) * 100.0f, direction(random) * 100.0f, 300.0f};
+            RayPacket packet(8);
+            for (int lane = 0; lane < 8; ++lane) {
+                const Ray ray{origin, Vector3f{direction(random), direction(random), -1.0f}.normalize()};
+                packet.setRay(lane, ray, 0.0f, std::numeric_limits<float>::max());
+            }
+            PacketHit packetHit;
+            mesh.hitPacket(packet, packetHit);
+            for (int lane = 0; lane < 8; ++lane) {
+                const auto ray = packet.getRay(lane);
+                HitRecord expected{};
+                const bool expectedHit = mesh.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+                ASSERT_EQ(expectedHit, packetHit.surface[lane] != nullptr) << "ray " << i;
+                if (expectedHit) {
+                    ++hitCount;
+                    ASSERT_NEAR(expected.t, packet.tMax[lane], 1e-3f * expected.t) << "ray " << i;
+                }
+            }
+        }
+        ASSERT_GT(hitCount, 0);
+    }
+}
+
+TEST(crtTest, CompactMeshMatchesBruteForce) {
+    for (const uint32_t width: {2u, 4u, 8u}) {
+        std::mt19937 random(404);
+        const auto options = makeWideOptions(width);
+        const auto sphere = makeSphereMesh(64, 128, 60.0f, Vector3f{10.0f, -5.0f, 20.0f}, options,
+                                           MeshStorage::Compact);
+        // 66000 points need 32 bit indices.
+        const auto soup = makeTriangleSoup(22000, random, options, MeshStorage::Compact);
+        ASSERT_TRUE(sphere.isCompact());
+        ASSERT_TRUE(sphere.getCompactGeometry().hasNarrowIndices());
+        ASSERT_FALSE(soup.getCompactGeometry().hasNarrowIndices());
+        ASSERT_EQ(sphere.getBvhWidth(), width);
+        ASSERT_TRUE(sphere.getPoints().empty());
+        ASSERT_TRUE(sphere.getTriangleBlocks().empty());
+        ASSERT_TRUE(sphere.getBvh().getPrimitiveIndices().empty());
+        expectSameHits(sphere, random, 4000);
+        expectSameHits(soup, random, 250);
+
+        for (int i = 0; i < 250; ++i) {
+            const auto ray = makeRandomRay(random);
+            HitRecord expected{};
+            const bool expectedHit = soup.hitBruteForce(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(soup.occluded(ray, 0.0f, std::numeric_limits<float>::max()), expectedHit) << "ray " << i;
+        }
+    }
+}
+
+TEST(crtTest, CompactMeshIsCloseToFullMesh) {
+    std::mt19937 random(405);
+    const auto full = makeSphereMesh(32, 64, 60.0f, Vector3f{10.0f, -5.0f, 20.0f});
+    const auto compact = makeSphereMesh(32, 64, 60.0f, Vector3f{10.0f, -5.0f, 20.0f}, {}, MeshStorage::Compact);
+    ASSERT_EQ(compact.getTriangleCount(), full.getTriangleCount());
+    ASSERT_LT(compact.getByteSize() * 3, full.getByteSize());
+
+    // Points move by at most half a grid step, 120 / 65535 / 2 on the widest axis.
+    constexpr float kTolerance = 120.0f / 65535.0f;
+    for (uint32_t point = 0; point < full.getPoints().size(); ++point) {
+        const auto delta = compact.getCompactGeometry().getPoint(point) - full.getPoints()[point];
+        ASSERT_LE(std::abs(delta.getX()), kTolerance);
+        ASSERT_LE(std::abs(delta.getY()), kTolerance);
+        ASSERT_LE(std::abs(delta.getZ()), kTolerance);
+    }
+
+    int hitCount = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const Ray ray{{10.0f, -5.0f, 200.0f}, Vector3f{std::uniform_real_distribution<float>(-0.3f, 0.3f)(random),
+                                                       std::uniform_real_distribution<float>(-0.3f, 0.3f)(random),
+                                                       -1.0f}.normalize()};
+        HitRecord expected{};
+        HitRecord actual{};
+        if (full.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected) &&
+            compact.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual)) {
+            ++hitCount;
+            ASSERT_NEAR(actual.t, expected.t, 0.05f);
+        }
+    }
+    ASSERT_GT(hitCount, 1000);
+}
+
+namespace {
+    /**
+     * Points of a makeSphereMesh(rings, segments, ...) sphere with every third point pushed outwards by a bump.
+     */
+    std::vector<Vector3f> getBumpedPoints(const Mesh& mesh, const Vector3f& center, float height,
+                                          std::vector<uint32_t>& outMovedPoints) {
+        std::vector<Vector3f> points(mesh.getPoints().begin(), mesh.getPoints().end());
+        for (uint32_t i = 0; i < points.size(); i += 3) {
+            points[i] = points[i] + (points[i] - center).normalize() * height;
+            outMovedPoints.push_back(i);
+        }
+        return points;
+    }
+}
+
+TEST(crtTest, MeshRefitMatchesBruteForce) {
+    std::mt19937 random(2023);
+    const Vector3f center{10.0f, -5.0f, 20.0f};
+    for (const uint32_t width: {2u, 4u, 8u}) {
+        auto mesh = makeSphereMesh(64, 128, 60.0f, center, makeWideOptions(width));
+        const auto reference = makeSphereMesh(64, 128, 60.0f, center);
+        std::vector<uint32_t> movedPoints;
+        const auto points = getBumpedPoints(reference, center, 4.0f, movedPoints);
+        const auto builtSahCost = mesh.getBvh().getStatistics().builtSahCost;
+
+        ASSERT_FALSE(mesh.updatePoints(std::vector<Vector3f>(points.size() - 1)));
+        ASSERT_FALSE(mesh.updatePoints(points, {static_cast<uint32_t>(points.size())}));
+        ASSERT_TRUE(mesh.updatePoints(points, movedPoints));
+        ASSERT_EQ(mesh.getBvhWidth(), width);
+        ASSERT_EQ(mesh.getBvh().getStatistics().builtSahCost, builtSahCost);
+        ASSERT_EQ(mesh.getPoints()[0], points[0]);
+        ASSERT_GT(mesh.getBoundingBox().getMax().getY(), center.getY() + 62.0f);
+        if (width == 2) {
+            expectValidBvh(mesh);
+            // The bumps only grow the bounds a little, the refit tree is kept.
+            ASSERT_FALSE(mesh.getBvh().needsRebuild());
+            ASSERT_GT(mesh.getBvh().getStatistics().sahCost, builtSahCost);
+        } else if (width == 4) {
+            expectValidWideBvh(mesh, mesh.getWideBvh4());
+        } else {
+            expectValidWideBvh(mesh, mesh.getWideBvh8());
+        }
+        expectSameHits(mesh, random, 4000);
+
+        // Moving the points back restores the hits of the original mesh.
+        ASSERT_TRUE(mesh.updatePoints({reference.getPoints().begin(), reference.getPoints().end()}));
+        for (int i = 0; i < 500; ++i) {
+            const auto ray = makeRandomRay(random);
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = reference.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(mesh.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual), expectedHit) << "ray " << i;
+            if (expectedHit) {
+                ASSERT_FLOAT_EQ(expected.t, actual.t) << "ray " << i;
+            }
+        }
+    }
+}
+
+TEST(crtTest, CompactMeshRefitMatchesBruteForce) {
+    std::mt19937 random(2024);
+    const Vector3f center{10.0f, -5.0f, 20.0f};
+    const auto reference = makeSphereMesh(32, 64, 60.0f, center);
+    std::vector<uint32_t> movedPoints;
+    const auto points = getBumpedPoints(reference, center, 4.0f, movedPoints);
+    for (const uint32_t width: {2u, 4u, 8u}) {
+        auto mesh = makeSphereMesh(32, 64, 60.0f, center, makeWideOptions(width), MeshStorage::Compact);
+        ASSERT_TRUE(mesh.updatePoints(points, movedPoints));
+        ASSERT_TRUE(mesh.isCompact());
+        ASSERT_EQ(mesh.getBvhWidth(), width);
+        expectSameHits(mesh, random, 2000);
+    }
+}
+
+TEST(crtTest, MeshRefitRebuildsDegradedTree) {
+    std::mt19937 random(2025);
+    for (const uint32_t width: {2u, 8u}) {
+        auto mesh = makeTriangleSoup(5000, random, makeWideOptions(width));
+        // Swapping the triangles around leaves every leaf spanning the whole soup.
+        std::vector<Vector3f> points(mesh.getPoints().begin(), mesh.getPoints().end());
+        for (size_t i = 0; i + 3 < points.size(); i += 6) {
+            std::swap(points[i], points[points.size() - 1 - i]);
+        }
+        ASSERT_TRUE(mesh.updatePoints(points));
+        const auto& statistics = mesh.getBvh().getStatistics();
+        ASSERT_EQ(statistics.sahCost, statistics.builtSahCost);
+        if (width == 2) {
+            expectValidBvh(mesh);
+        } else {
+            ASSERT_FALSE(mesh.getWideBvh8().needsRebuild(mesh.getBvh().getOptions().maxRefitSahRatio));
+            expectValidWideBvh(mesh, mesh.getWideBvh8());
+        }
+        expectSameHits(mesh, random, 2000);
+    }
+}
+
+TEST(crtTest, MeshTransformMatchesTransformedBuild) {
+    std::mt19937 random(2026);
+    const auto transform = MatrixUtils::translate(5.0f, 0.0f, -10.0f) * MatrixUtils::rotateByY<float>(40.0);
+    ThreadPool threadPool(2);
+    for (const uint32_t width: {2u, 4u}) {
+        auto mesh = makeSphereMesh(32, 64, 60.0f, Vector3f{10.0f, -5.0f, 20.0f}, makeWideOptions(width));
+        ASSERT_TRUE(mesh.transform(transform));
+        expectSameHits(mesh, random, 2000);
+
+        auto soup = makeTriangleSoup(2000, random, makeWideOptions(width));
+        std::vector<Vector3f> points(soup.getPoints().begin(), soup.getPoints().end());
+        for (auto& point: points) {
+            point = (transform * Vector4f{point.getX(), point.getY(), point.getZ(), 1.0f}).getXYZ();
+        }
+        ASSERT_TRUE(soup.updatePoints(points, {}, &threadPool));
+        expectSameHits(soup, random, 2000);
+    }
+}
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include "../src/MeshLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace crt;
+
+namespace {
+    const std::vector<Vector3f> kPoints = {{0.0f, 0.0f, 0.0f},
+                                           {1.5f, 0.0f, -0.25f},
+                                           {1.0f, 1e-3f, 2.0f},
+                                           {-3.0f, 1.0f, 0.125f},
+                                           {7.0f, -2.0f, 1e5f}};
+    // A quad and a triangle, the quad is fanned into (0, 1, 2) and (0, 2, 3).
+    const std::vector<std::vector<int>> kFaces = {{0, 1, 2, 3}, {1, 4, 2}};
+    const std::vector<Vector3i> kTriangles = {{0, 1, 2}, {0, 2, 3}, {1, 4, 2}};
+
+    const char* kPlyHeaderBody =
+            "comment extra properties and elements have to be skipped\n"
+            "element vertex 5\n"
+            "property float x\n"
+            "property float y\n"
+            "property uchar red\n"
+            "property float z\n"
+            "property double confidence\n"
+            "element edge 2\n"
+            "property int vertex1\n"
+            "property int vertex2\n"
+            "element face 2\n"
+            "property uchar flags\n"
+            "property list uchar int vertex_indices\n"
+            "property list uchar float texcoord\n"
+            "end_header\n";
+
+    template<typename T>
+    void appendValue(std::string& out, T value, bool bigEndian) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        if (bigEndian) {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        out.append(bytes, sizeof(T));
+    }
+
+    std::string makeAsciiPly() {
+        std::string ply = std::string("ply\nformat ascii 1.0\n") + kPlyHeaderBody;
+        char line[256];
+        for (const auto& point: kPoints) {
+            std::snprintf(line, sizeof(line), "%.9g %.9g 255 %.9g 0.5\n", point.getX(), point.getY(), point.getZ());
+            ply += line;
+        }
+        ply += "0 1\n\n  1 2\r\n";
+        for (const auto& face: kFaces) {
+            ply += "7 " + std::to_string(face.size());
+            for (const auto index: face) {
+                ply += " " + std::to_string(index);
+            }
+            ply += " 2 0.5 0.25\n";
+        }
+        return ply;
+    }
+
+    std::string makeBinaryPly(bool bigEndian) {
+        std::string ply = std::string("ply\r\nformat ") + (bigEndian ? "binary_big_endian" : "binary_little_endian") +
+                          " 1.0\r\n" + kPlyHeaderBody;
+        for (const auto& point: kPoints) {
+            appendValue(ply, point.getX(), bigEndian);
+            appendValue(ply, point.getY(), bigEndian);
+            appendValue<uint8_t>(ply, 255, bigEndian);
+            appendValue(ply, point.getZ(), bigEndian);
+            appendValue(ply, 0.5, bigEndian);
+        }
+        for (int edge = 0; edge < 2; ++edge) {
+            appendValue<int32_t>(ply, edge, bigEndian);
+            appendValue<int32_t>(ply, edge + 1, bigEndian);
+        }
+        for (const auto& face: kFaces) {
+            appendValue<uint8_t>(ply, 7, bigEndian);
+            appendValue(ply, static_cast<uint8_t>(face.size()), bigEndian);
+            for (const auto index: face) {
+                appendValue<int32_t>(ply, index, bigEndian);
+            }
+            appendValue<uint8_t>(ply, 2, bigEndian);
+            appendValue(ply, 0.5f, bigEndian);
+            appendValue(ply, 0.25f, bigEndian);
+        }
+        return ply;
+    }
+
+    void expectMeshData(const MeshData& data, const std::vector<Vector3i>& triangles) {
+        ASSERT_EQ(data.points.size(), kPoints.size());
+        for (size_t i = 0; i < kPoints.size(); ++i) {
+            ASSERT_EQ(data.points[i], kPoints[i]) << "vertex " << i;
+        }
+        ASSERT_EQ(data.triangleVertexIndices.size(), triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            ASSERT_EQ(data.triangleVertexIndices[i], triangles[i]) << "triangle " << i;
+        }
+    }
+}
+
+TEST(crtTest, MeshLoaderPlyFormats) {
+    // Tiny chunks put nearly every line into its own parallel task.
+    MeshLoader loader(4, 8);
+    for (const auto& ply: {makeAsciiPly(), makeBinaryPly(false), makeBinaryPly(true)}) {
+        MeshData data;
+        ASSERT_TRUE(loader.loadPly(ply.data(), ply.size(), data)) << loader.getError();
+        expectMeshData(data, kTriangles);
+        ASSERT_EQ(loader.getStatistics().byteCount, ply.size());
+        ASSERT_EQ(loader.getStatistics().triangleCount, kTriangles.size());
+    }
+
+    // Pure triangle meshes take the parallel fixed stride path for faces.
+    std::string ply = "ply\nformat binary_big_endian 1.0\nelement vertex 5\nproperty float x\nproperty float y\n"
+                      "property float z\nelement face 3\nproperty list uint8 uint32 vertex_indices\nend_header\n";
+    for (const auto& point: kPoints) {
+        for (int axis = 0; axis < 3; ++axis) {
+            appendValue(ply, point[axis], true);
+        }
+    }
+    for (const auto& triangle: kTriangles) {
+        appendValue<uint8_t>(ply, 3, true);
+        for (int k = 0; k < 3; ++k) {
+            appendValue(ply, static_cast<uint32_t>(triangle[k]), true);
+        }
+    }
+    MeshData data;
+    ASSERT_TRUE(loader.loadPly(ply.data(), ply.size(), data)) << loader.getError();
+    expectMeshData(data, kTriangles);
+}
+
+TEST(crtTest, MeshLoaderObj) {
+    const std::string obj = "# comment\n"
+                            "o test\n"
+                            "v 0 0 0\n"
+                            "v 1.5 0 -0.25\n"
+                            "vt 0.5 0.5\n"
+                            "v 1 0.001 2\n"
+                            "v -3 1 0.125\r\n"
+                            "f 1/1 2/1 3/1 4/1\n"
+                            "v 7 -2 1e5\n"
+                            "vn 0 1 0\n"
+                            "s off\n"
+                            "f -4//1 -1//1 -3//1\n";
+    MeshLoader loader(4, 8);
+    MeshData data;
+    ASSERT_TRUE(loader.loadObj(obj.data(), obj.size(), data)) << loader.getError();
+    expectMeshData(data, kTriangles);
+}
+
+TEST(crtTest, MeshLoaderErrors) {
+    MeshLoader loader(2, 16);
+    MeshData data;
+
+    const auto ascii = makeAsciiPly();
+    const auto truncatedAscii = ascii.substr(0, ascii.size() - 20);
+    ASSERT_FALSE(loader.loadPly(truncatedAscii.data(), truncatedAscii.size(), data));
+    ASSERT_FALSE(loader.getError().empty());
+
+    const auto binary = makeBinaryPly(false);
+    ASSERT_FALSE(loader.loadPly(binary.data(), binary.size() - 3, data));
+    ASSERT_FALSE(loader.loadPly(binary.data(), 30, data));
+
+    const std::string badIndex = "ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nproperty float y\n"
+                                 "property float z\nelement face 1\nproperty list uchar int vertex_indices\n"
+                                 "end_header\n0 0 0\n3 0 0 1\n";
+    ASSERT_FALSE(loader.loadPly(badIndex.data(), badIndex.size(), data));
+    ASSERT_NE(loader.getError().find("vertex"), std::string::npos);
+
+    // A list count far beyond what the line holds.
+    const std::string hugeCount = "ply\nformat ascii 1.0\nelement vertex 1\nproperty float x\nproperty float y\n"
+                                  "property float z\nelement face 1\nproperty list uchar int vertex_indices\n"
+                                  "end_header\n0 0 0\n99999999999999 0 0 0\n";
+    ASSERT_FALSE(loader.loadPly(hugeCount.data(), hugeCount.size(), data));
+    ASSERT_NE(loader.getError().find("line 2"), std::string::npos) << loader.getError();
+
+    const std::string badObj = "v 0 0 0\nf 1 2 3\n";
+    ASSERT_FALSE(loader.loadObj(badObj.data(), badObj.size(), data));
+
+    ASSERT_FALSE(loader.load("/nonexistent/mesh.ply", data));
+}
+
+TEST(crtTest, MeshLoaderFile) {
+    const std::string path = ::testing::TempDir() + "crt_mesh_loader_test.bin";
+    {
+        const auto ply = makeBinaryPly(true);
+        std::ofstream file(path, std::ios::binary);
+        file.write(ply.data(), static_cast<std::streamsize>(ply.size()));
+    }
+    MeshLoader loader;
+    // PLY files are recognized by their magic, not the extension.
+    const auto mesh = loader.loadMesh(path, Matrix4f::makeIdentity());
+    std::remove(path.c_str());
+    ASSERT_NE(mesh, nullptr) << loader.getError();
+    ASSERT_EQ(mesh->getTriangleCount(), kTriangles.size());
+    ASSERT_GT(loader.getStatistics().seconds, 0.0);
+}
+
+TEST(crtTest, MeshLoaderRemoveDuplicatePoints) {
+    // Two quads that share an edge, written with separate corners as triangle soups often are.
+    MeshData data;
+    data.points = {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f},
+                   {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 0.0f},
+                   {1.0f, 0.0f, 0.0f}, {2.0f, 0.0f, 0.0f}, {2.0f, 1.0f, 0.0f}};
+    data.triangleVertexIndices = {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {6, 8, 2}};
+    const auto expected = data;
+
+    ASSERT_EQ(MeshLoader::removeDuplicatePoints(data), 3u);
+    ASSERT_EQ(data.points.size(), 6u);
+    ASSERT_EQ(data.triangleVertexIndices.size(), expected.triangleVertexIndices.size());
+    for (size_t triangle = 0; triangle < data.triangleVertexIndices.size(); ++triangle) {
+        for (int corner = 0; corner < 3; ++corner) {
+            ASSERT_EQ(data.points[data.triangleVertexIndices[triangle][corner]],
+                      expected.points[expected.triangleVertexIndices[triangle][corner]]);
+        }
+    }
+    // The first of equal points is kept, in the original order.
+    ASSERT_EQ(data.triangleVertexIndices[1], Vector3i(2, 3, 0));
+    ASSERT_EQ(MeshLoader::removeDuplicatePoints(data), 0u);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include "../src/Scene.h"
+#include "../src/Sphere.h"
+#include "../src/Plane.h"
+#include "../src/Triangle.h"
+#include "../src/Mesh.h"
+
+#include <random>
+
+using namespace crt;
+
+TEST(crtTest, SimdFloatMatchesGeneric) {
+    alignas(32) const float a[8] = {1.0f, -2.0f, 3.5f, 0.0f, 7.0f, -0.5f, 2.0f, 9.0f};
+    alignas(32) const float b[8] = {2.0f, -3.0f, 1.5f, 4.0f, 7.0f, 0.5f, -2.0f, 3.0f};
+    // No width has a specialization for 2 lanes, so these exercise the plain loop template.
+    const auto genericA = SimdFloat<2>::load(a);
+    const auto genericB = SimdFloat<2>::load(b);
+    const auto nativeA = SimdFloatN::load(a);
+    const auto nativeB = SimdFloatN::load(b);
+
+    const auto sum = nativeA + nativeB;
+    const auto product = nativeA * nativeB;
+    const auto smaller = min(nativeA, nativeB);
+    const auto picked = select(nativeA < nativeB, nativeA, nativeB);
+    for (int lane = 0; lane < kSimdWidth; ++lane) {
+        ASSERT_FLOAT_EQ(sum[lane], a[lane] + b[lane]);
+        ASSERT_FLOAT_EQ(product[lane], a[lane] * b[lane]);
+        ASSERT_FLOAT_EQ(smaller[lane], std::min(a[lane], b[lane]));
+        ASSERT_FLOAT_EQ(picked[lane], a[lane] < b[lane] ? a[lane] : b[lane]);
+        ASSERT_FLOAT_EQ(abs(nativeA)[lane], std::abs(a[lane]));
+    }
+    ASSERT_EQ((nativeA < nativeB).getBits() & 0xfu, 0b1001u);
+    ASSERT_EQ((genericA < genericB).getBits(), 0b01u);
+    ASSERT_FLOAT_EQ(max(genericA, genericB)[1], -2.0f);
+    ASSERT_FLOAT_EQ(sqrt(genericA + genericB)[0], std::sqrt(3.0f));
+}
+
+TEST(crtTest, PacketHitMatchesScalarHit) {
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(5.0f, 30.0f);
+
+    Scene scene;
+    for (int i = 0; i < 100; ++i) {
+        scene.addSurface(std::make_shared<Sphere>(Vector3f{position(random), position(random), position(random)},
+                                                  size(random)));
+    }
+    std::vector<Vector3f> points;
+    std::vector<Vector3i> indices;
+    for (int i = 0; i < 300; ++i) {
+        const Vector3f v0{position(random), position(random), position(random)};
+        points.push_back(v0);
+        points.push_back(v0 + Vector3f{size(random), 0.0f, size(random)});
+        points.push_back(v0 + Vector3f{0.0f, size(random), size(random)});
+        indices.push_back({i * 3, i * 3 + 1, i * 3 + 2});
+    }
+    scene.addSurface(std::make_shared<Mesh>(points, indices));
+    scene.addSurface(std::make_shared<Triangle>(Vector3f{-50.0f, -50.0f, -300.0f},
+                                                Vector3f{50.0f, -50.0f, -300.0f},
+                                                Vector3f{0.0f, 50.0f, -300.0f}));
+    scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -250.0f, 0.0f}));
+
+    // Camera like bundles: one origin, directions spread over a small cone.
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+    int hitCount = 0;
+    for (const int packetSize: {4, 8, 16}) {
+        for (int i = 0; i < 300; ++i) {
+            const Vector3f origin{position(random), position(random), 400.0f};
+            const Vector3f center{direction(random), direction(random), -1.0f};
+            RayPacket packet(packetSize);
+            // Leave the last lane empty to cover partial packets.
+            for (int lane = 0; lane + 1 < packetSize; ++lane) {
+                const Ray ray{origin, (center + Vector3f{jitter(random), jitter(random), 0.0f}).normalize()};
+                packet.setRay(lane, ray, 0.0f, std::numeric_limits<float>::max());
+            }
+            PacketHit packetHit;
+            scene.hitPacket(packet, packetHit);
+            ASSERT_EQ(packetHit.surface[packetSize - 1], nullptr);
+
+            for (int lane = 0; lane + 1 < packetSize; ++lane) {
+                const auto ray = packet.getRay(lane);
+                HitRecord expected{};
+                const bool expectedHit = scene.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+                ASSERT_EQ(expectedHit, packetHit.surface[lane] != nullptr) << "size " << packetSize << " ray " << i;
+                if (expectedHit) {
+                    ++hitCount;
+                    HitRecord actual{};
+                    packetHit.surface[lane]->resolveHit(ray, packet.tMax[lane], packetHit.primitive[lane],
+                                                        packetHit.u[lane], packetHit.v[lane], actual);
+                    ASSERT_NEAR(expected.t, actual.t, 1e-3f * expected.t);
+                    ASSERT_NEAR(expected.normal.dot(actual.normal), 1.0f, 1e-3f);
+                }
+            }
+        }
+    }
+    ASSERT_GT(hitCount, 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "../src/Renderer.h"
+
+#include <atomic>
+
+using namespace crt;
+
+TEST(crtTest, RendererVisitsEveryPixelOnce) {
+    const SizeI imageSize{100, 70};
+    Renderer renderer(4, 16);
+
+    std::vector<std::atomic<int>> visits(imageSize.getWidth() * imageSize.getHeight());
+    std::vector<uint8_t> output(visits.size() * 3);
+    renderer.render(imageSize, [&](int x, int y, PixelContext&) {
+        ++visits[y * imageSize.getWidth() + x];
+        return Vector3f{static_cast<float>(x) / 255.0f, static_cast<float>(y) / 255.0f, 2.0f};
+    }, output.data());
+
+    for (int y = 0; y < imageSize.getHeight(); ++y) {
+        for (int x = 0; x < imageSize.getWidth(); ++x) {
+            const auto index = y * imageSize.getWidth() + x;
+            ASSERT_EQ(visits[index], 1);
+            ASSERT_EQ(output[index * 3 + 0], x);
+            ASSERT_EQ(output[index * 3 + 1], y);
+            ASSERT_EQ(output[index * 3 + 2], 255);
+        }
+    }
+}
+
+TEST(crtTest, RendererMortonOrder) {
+    Renderer renderer(1, 4);
+    std::vector<std::pair<int, int>> order;
+    renderer.forEachPixel({0, 8, 4, 4, 4}, [&](int x, int y) {
+        order.emplace_back(x, y);
+    });
+    ASSERT_EQ(order.size(), 16u);
+    ASSERT_EQ(order[0], std::make_pair(8, 4));
+    ASSERT_EQ(order[1], std::make_pair(9, 4));
+    ASSERT_EQ(order[2], std::make_pair(8, 5));
+    ASSERT_EQ(order[3], std::make_pair(9, 5));
+    ASSERT_EQ(order[4], std::make_pair(10, 4));
+    ASSERT_EQ(order[15], std::make_pair(11, 7));
+}
+
+TEST(crtTest, ThreadPoolRunsEveryTask) {
+    ThreadPool threadPool(3);
+    for (uint32_t taskCount: {1u, 2u, 5u, 1000u}) {
+        std::vector<std::atomic<int>> runs(taskCount);
+        threadPool.parallelFor(taskCount, [&](uint32_t taskIndex, unsigned workerIndex) {
+            ASSERT_LT(workerIndex, threadPool.getThreadCount());
+            ++runs[taskIndex];
+        });
+        for (const auto& run: runs) {
+            ASSERT_EQ(run, 1);
+        }
+    }
+}
+
+namespace {
+    class MemoryOutput : public ImageOutput {
+    public:
+        bool begin(const SizeI& imageSize) override {
+            _width = imageSize.getWidth();
+            pixels.assign(static_cast<size_t>(imageSize.getWidth()) * imageSize.getHeight(), {});
+            return true;
+        }
+
+        bool writeRows(int y, int rowCount, const Vector3f* rows) override {
+            std::copy(rows, rows + static_cast<size_t>(rowCount) * _width, pixels.begin() + y * _width);
+            return true;
+        }
+
+        bool end() override {
+            return true;
+        }
+
+        std::vector<Vector3f> pixels;
+
+    private:
+        int _width = 0;
+    };
+}
+
+TEST(crtTest, RendererProgressiveAdaptiveSampling) {
+    // The left half is flat, the right half noisy: only the right half needs more than the first pass.
+    const SizeI imageSize{64, 40};
+    const auto shade = [](int x, int y, PixelContext& context) {
+        if (x < 32) {
+            return Vector3f{0.5f, 0.5f, 0.5f};
+        }
+        const auto value = static_cast<float>((x * 31 + y * 17 + context.sampleIndex * 7) % 5) / 4.0f;
+        return Vector3f{value, value, value};
+    };
+    ProgressiveOptions options;
+    options.maxSamples = 32;
+    options.errorThreshold = 0.001f;
+
+    MemoryOutput output;
+    ProgressiveStatistics statistics;
+    RenderProgress progress;
+    progress.setQuiet(true);
+    Renderer renderer(3, 16);
+    ASSERT_TRUE(renderer.renderProgressive(imageSize, shade, options, output, &progress, &statistics));
+    ASSERT_EQ(statistics.passCount, 1 + (options.maxSamples - options.minSamples) / options.samplesPerPass);
+    ASSERT_EQ(statistics.sampleCount, 32u * 40u * options.minSamples + 32u * 40u * options.maxSamples);
+    // Converged pixels gave back their unused samples, so progress ends at exactly 100%.
+    ASSERT_EQ(progress.getPixelCount(), statistics.sampleCount);
+    ASSERT_EQ(progress.getTotalPixelCount(), statistics.sampleCount);
+    ASSERT_EQ(output.pixels[0], (Vector3f{0.5f, 0.5f, 0.5f}));
+
+    // Sample placement only depends on the sample index, so packets and any thread count give the same image.
+    MemoryOutput packetOutput;
+    Renderer(1, 16).renderProgressive(imageSize, 4, [&](const PixelCoordinate* pixels, int pixelCount,
+                                                        PixelContext& context, Vector3f* outColors) {
+        for (int i = 0; i < pixelCount; ++i) {
+            outColors[i] = shade(pixels[i].x, pixels[i].y, context);
+        }
+    }, options, packetOutput);
+    ASSERT_EQ(packetOutput.pixels, output.pixels);
+}
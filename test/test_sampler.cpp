@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "../src/Sampler.h"
+
+#include <cmath>
+#include <set>
+
+using namespace crt;
+
+namespace {
+    /**
+     * Root mean square error of the quarter disk area estimated with sampleCount samples, over many pixels.
+     */
+    double getQuarterDiskError(const Sampler& sampler, uint32_t sampleCount) {
+        const double expected = M_PI / 4.0;
+        double squaredError = 0.0;
+        const int pixelCount = 32;
+        for (int y = 0; y < pixelCount; ++y) {
+            for (int x = 0; x < pixelCount; ++x) {
+                int inside = 0;
+                for (uint32_t i = 0; i < sampleCount; ++i) {
+                    const auto sample = sampler.get2D(x, y, i, 0);
+                    inside += sample.getX() * sample.getX() + sample.getY() * sample.getY() < 1.0f;
+                }
+                const auto error = static_cast<double>(inside) / sampleCount - expected;
+                squaredError += error * error;
+            }
+        }
+        return std::sqrt(squaredError / (pixelCount * pixelCount));
+    }
+}
+
+TEST(crtTest, SamplersAreDeterministicAndConverge) {
+    const uint32_t sampleCount = 16;
+    const auto random = Sampler::create(SamplerType::Random, sampleCount);
+    const auto randomError = getQuarterDiskError(*random, sampleCount);
+    for (const auto type: {SamplerType::Random, SamplerType::Stratified, SamplerType::Sobol, SamplerType::BlueNoise}) {
+        const auto sampler = Sampler::create(type, sampleCount);
+        for (uint32_t i = 0; i < 100; ++i) {
+            const auto sample = sampler->get2D(7, 3, i, 2);
+            ASSERT_GE(sample.getX(), 0.0f);
+            ASSERT_LT(sample.getX(), 1.0f);
+            ASSERT_GE(sample.getY(), 0.0f);
+            ASSERT_LT(sample.getY(), 1.0f);
+            ASSERT_EQ(sample, sampler->get2D(7, 3, i, 2));
+        }
+        ASSERT_NE(sampler->get2D(7, 3, 0, 0), sampler->get2D(7, 3, 0, 1));
+        if (type != SamplerType::Random) {
+            ASSERT_LT(getQuarterDiskError(*sampler, sampleCount), randomError * 0.8);
+        }
+    }
+
+    // A full round of the stratified sampler puts exactly one sample into every stratum.
+    const StratifiedSampler stratified(16);
+    std::set<std::pair<int, int>> strata;
+    for (uint32_t i = 0; i < 16; ++i) {
+        const auto sample = stratified.get2D(5, 9, i, 0);
+        strata.emplace(static_cast<int>(sample.getX() * 4), static_cast<int>(sample.getY() * 4));
+    }
+    ASSERT_EQ(strata.size(), 16u);
+}
+
+TEST(crtTest, BlueNoiseMask) {
+    const BlueNoiseSampler sampler;
+    const auto size = BlueNoiseSampler::kMaskSize;
+    std::set<float> values;
+    double variance = 0.0;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            values.insert(sampler.getMaskValue(x, y));
+            // Blue noise has little low frequency energy, so even 2x2 averages stay close to one half.
+            const auto average = (sampler.getMaskValue(x, y) + sampler.getMaskValue(x + 1, y) +
+                                  sampler.getMaskValue(x, y + 1) + sampler.getMaskValue(x + 1, y + 1)) / 4.0f - 0.5f;
+            variance += average * average;
+        }
+    }
+    ASSERT_EQ(values.size(), static_cast<size_t>(size * size));
+    // White noise would give 1 / 48.
+    ASSERT_LT(variance / (size * size), 1.0 / 48.0 / 2.5);
+}
@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+#include "../src/MatrixUtils.h"
+#include "../src/Mesh.h"
+#include "../src/Scene.h"
+#include "../src/Sphere.h"
+#include "../src/Plane.h"
+#include "../src/Triangle.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace crt;
+
+namespace {
+    bool hitAllSurfaces(const Scene& scene, const Ray& ray, float tMin, float tMax, HitRecord& outRecord) {
+        bool hasHit = false;
+        HitRecord record{};
+        for (const auto& surface: scene.getSurface()) {
+            if (surface->hit(ray, tMin, tMax, record) && record.t < tMax) {
+                tMax = record.t;
+                outRecord = record;
+                hasHit = true;
+            }
+        }
+        return hasHit;
+    }
+
+    /**
+     * A type the frozen scene does not know, so it stays on the virtual path. Counts the calls it gets there.
+     */
+    template<typename Base>
+    class CountingSurface : public Base {
+    public:
+        using Base::Base;
+
+        bool intersect(const Ray& ray, float tMin, float tMax, SurfaceHit& outHit) const override {
+            ++callCount;
+            return Base::intersect(ray, tMin, tMax, outHit);
+        }
+
+        [[nodiscard]] bool occluded(const Ray& ray, float tMin, float tMax) const override {
+            ++callCount;
+            return Base::occluded(ray, tMin, tMax);
+        }
+
+        void hitPacket(RayPacket& packet, PacketHit& outHit) const override {
+            ++callCount;
+            Base::hitPacket(packet, outHit);
+        }
+
+        mutable uint32_t callCount = 0;
+    };
+}
+
+TEST(crtTest, SceneBvhMatchesLinearScan) {
+    std::mt19937 random(2022);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(1.0f, 20.0f);
+
+    Scene scene;
+    std::vector<SurfacePtr> spheres;
+    for (int i = 0; i < 1000; ++i) {
+        auto sphere = std::make_shared<Sphere>(Vector3f{position(random), position(random), position(random)},
+                                               size(random));
+        spheres.push_back(sphere);
+        scene.addSurface(sphere);
+    }
+    for (int i = 0; i < 500; ++i) {
+        const Vector3f v0{position(random), position(random), position(random)};
+        scene.addSurface(std::make_shared<Triangle>(v0,
+                                                    v0 + Vector3f{size(random), 0.0f, 0.0f},
+                                                    v0 + Vector3f{0.0f, size(random), size(random)}));
+    }
+    scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -400.0f, 0.0f}));
+
+    const auto checkRays = [&]() {
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        int hitCount = 0;
+        for (int i = 0; i < 2000; ++i) {
+            const Ray ray{Vector3f{position(random), position(random), position(random)},
+                          Vector3f{direction(random), direction(random), direction(random)}.normalize()};
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = hitAllSurfaces(scene, ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            const bool actualHit = scene.hit(ray, actual);
+            ASSERT_EQ(expectedHit, actualHit) << "ray " << i;
+            if (expectedHit) {
+                ++hitCount;
+                ASSERT_FLOAT_EQ(expected.t, actual.t) << "ray " << i;
+                ASSERT_EQ(expected.normal, actual.normal) << "ray " << i;
+            }
+            // The traversal phase alone finds the same closest hit.
+            SurfaceHit surfaceHit{};
+            ASSERT_EQ(scene.intersect(ray, 0.0f, std::numeric_limits<float>::max(), surfaceHit), actualHit);
+            if (actualHit) {
+                ASSERT_EQ(surfaceHit.t, actual.t) << "ray " << i;
+                ASSERT_EQ(surfaceHit.surface->getMaterial().getShininess(), actual.material->getShininess());
+            }
+        }
+        ASSERT_GT(hitCount, 0);
+    };
+
+    checkRays();
+    ASSERT_EQ(scene.getBvh().getPrimitiveIndices().size(), 1500u);
+
+    // Removing surfaces must invalidate the hierarchy.
+    for (size_t i = 0; i < spheres.size(); i += 2) {
+        scene.removeSurface(spheres[i]);
+    }
+    checkRays();
+    ASSERT_EQ(scene.getBvh().getPrimitiveIndices().size(), 1000u);
+}
+
+TEST(crtTest, FrozenSceneMatchesLinearScanOverMixedSurfaces) {
+    std::mt19937 random(2031);
+    std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> size(5.0f, 30.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+    Scene scene;
+    std::vector<std::shared_ptr<CountingSurface<Sphere>>> customSpheres;
+    for (int i = 0; i < 100; ++i) {
+        const Vector3f center{position(random), position(random), position(random)};
+        scene.addSurface(std::make_shared<Sphere>(center, size(random)));
+        const Vector3f v0{position(random), position(random), position(random)};
+        scene.addSurface(std::make_shared<Triangle>(v0, v0 + Vector3f{size(random), 0.0f, size(random)},
+                                                    v0 + Vector3f{0.0f, size(random), size(random)}));
+        if (i % 10 == 0) {
+            customSpheres.push_back(std::make_shared<CountingSurface<Sphere>>(
+                    Vector3f{position(random), position(random), position(random)}, size(random) * 2.0f));
+            scene.addSurface(customSpheres.back());
+        }
+    }
+    for (int meshIndex = 0; meshIndex < 3; ++meshIndex) {
+        std::vector<Vector3f> points;
+        std::vector<Vector3i> indices;
+        for (int i = 0; i < 100; ++i) {
+            const Vector3f v0{position(random), position(random), position(random)};
+            points.push_back(v0);
+            points.push_back(v0 + Vector3f{size(random), 0.0f, size(random)});
+            points.push_back(v0 + Vector3f{0.0f, size(random), size(random)});
+            indices.push_back({i * 3, i * 3 + 1, i * 3 + 2});
+        }
+        scene.addSurface(std::make_shared<Mesh>(points, indices));
+    }
+    scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -190.0f, 0.0f}));
+    const auto customPlane = std::make_shared<CountingSurface<Plane>>(Vector3f{1.0f, 0.0f, 0.0f},
+                                                                      Vector3f{-190.0f, 0.0f, 0.0f});
+    scene.addSurface(customPlane);
+
+    // Spheres, triangles, meshes and the custom spheres are in the hierarchy, the planes are not.
+    ASSERT_EQ(scene.getBvh().getPrimitiveIndices().size(), 100u + 100u + 3u + customSpheres.size());
+
+    const auto isCustom = [&](const Surface* surface) {
+        return surface == customPlane.get() ||
+               std::any_of(customSpheres.begin(), customSpheres.end(),
+                           [&](const auto& sphere) { return surface == sphere.get(); });
+    };
+    int customHitCount = 0;
+    int triangleHitCount = 0;
+    int meshHitCount = 0;
+    for (int i = 0; i < 3000; ++i) {
+        const Ray ray{Vector3f{position(random), position(random), position(random)},
+                      Vector3f{direction(random), direction(random), direction(random)}.normalize()};
+        SurfaceHit expected{};
+        bool expectedHit = false;
+        float tMax = std::numeric_limits<float>::max();
+        for (const auto& surface: scene.getSurface()) {
+            SurfaceHit candidate{};
+            if (surface->intersect(ray, 0.0f, tMax, candidate) && candidate.t < tMax) {
+                expected = candidate;
+                tMax = candidate.t;
+                expectedHit = true;
+            }
+        }
+        SurfaceHit actual{};
+        ASSERT_EQ(scene.intersect(ray, 0.0f, std::numeric_limits<float>::max(), actual), expectedHit) << "ray " << i;
+        if (expectedHit) {
+            ASSERT_FLOAT_EQ(actual.t, expected.t) << "ray " << i;
+            ASSERT_EQ(actual.surface, expected.surface) << "ray " << i;
+            ASSERT_EQ(actual.primitive, expected.primitive) << "ray " << i;
+            ASSERT_FLOAT_EQ(actual.u, expected.u) << "ray " << i;
+            ASSERT_FLOAT_EQ(actual.v, expected.v) << "ray " << i;
+            customHitCount += isCustom(expected.surface);
+            triangleHitCount += dynamic_cast<const Triangle*>(expected.surface) != nullptr;
+            meshHitCount += dynamic_cast<const Mesh*>(expected.surface) != nullptr && expected.primitive > 0;
+        }
+
+        const float occlusionTMax = size(random) * 5.0f;
+        const bool expectedOccluded = std::any_of(scene.getSurface().begin(), scene.getSurface().end(),
+                                                  [&](const SurfacePtr& surface) {
+                                                      return surface->occluded(ray, 0.0f, occlusionTMax);
+                                                  });
+        ASSERT_EQ(scene.occluded(ray, 0.0f, occlusionTMax), expectedOccluded) << "ray " << i;
+    }
+    ASSERT_GT(customHitCount, 0);
+    ASSERT_GT(triangleHitCount, 0);
+    ASSERT_GT(meshHitCount, 0);
+
+    // Packets against every surface's own packet path in turn, which runs the same kernels.
+    std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+    for (int i = 0; i < 300; ++i) {
+        const Vector3f origin{position(random), position(random), position(random)};
+        const Vector3f center{direction(random), direction(random), direction(random)};
+        RayPacket packet;
+        for (int lane = 0; lane < RayPacket::kMaxSize; ++lane) {
+            const Ray ray{origin, (center + Vector3f{jitter(random), jitter(random), jitter(random)}).normalize()};
+            packet.setRay(lane, ray, 0.0f, std::numeric_limits<float>::max());
+        }
+        auto expectedPacket = packet;
+        PacketHit expected;
+        for (const auto& surface: scene.getSurface()) {
+            surface->hitPacket(expectedPacket, expected);
+        }
+        PacketHit actual;
+        scene.hitPacket(packet, actual);
+        for (int lane = 0; lane < RayPacket::kMaxSize; ++lane) {
+            ASSERT_EQ(actual.surface[lane], expected.surface[lane]) << "packet " << i << " lane " << lane;
+            ASSERT_FLOAT_EQ(packet.tMax[lane], expectedPacket.tMax[lane]) << "packet " << i << " lane " << lane;
+            ASSERT_EQ(actual.primitive[lane], expected.primitive[lane]) << "packet " << i << " lane " << lane;
+            ASSERT_FLOAT_EQ(actual.u[lane], expected.u[lane]) << "packet " << i << " lane " << lane;
+            ASSERT_FLOAT_EQ(actual.v[lane], expected.v[lane]) << "packet " << i << " lane " << lane;
+        }
+    }
+
+    // Every query reached the custom surfaces through their virtual interface.
+    ASSERT_GT(customPlane->callCount, 0u);
+    ASSERT_TRUE(std::any_of(customSpheres.begin(), customSpheres.end(),
+                            [](const auto& sphere) { return sphere->callCount > 0; }));
+}
+
+TEST(crtTest, SceneRefitAfterSurfacesMoved) {
+    std::mt19937 random(2027);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(1.0f, 20.0f);
+
+    Scene scene;
+    std::vector<SurfacePtr> surfaces;
+    for (int i = 0; i < 500; ++i) {
+        const Vector3f v0{position(random), position(random), position(random)};
+        surfaces.push_back(std::make_shared<Sphere>(v0, size(random)));
+        surfaces.push_back(std::make_shared<Triangle>(v0, v0 + Vector3f{size(random), 0.0f, 0.0f},
+                                                      v0 + Vector3f{0.0f, size(random), size(random)}));
+    }
+    for (const auto& surface: surfaces) {
+        scene.addSurface(surface);
+    }
+    const auto plane = std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -400.0f, 0.0f});
+    scene.addSurface(plane);
+
+    const auto checkRays = [&]() {
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        for (int i = 0; i < 1000; ++i) {
+            const Ray ray{Vector3f{position(random), position(random), position(random)},
+                          Vector3f{direction(random), direction(random), direction(random)}.normalize()};
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = hitAllSurfaces(scene, ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(scene.hit(ray, actual), expectedHit) << "ray " << i;
+            if (expectedHit) {
+                ASSERT_FLOAT_EQ(expected.t, actual.t) << "ray " << i;
+            }
+        }
+    };
+    checkRays();
+    const auto builtSahCost = scene.getBvh().getStatistics().builtSahCost;
+
+    // Small moves are refit, the build cost is kept.
+    std::uniform_real_distribution<float> step(-5.0f, 5.0f);
+    for (const auto& surface: surfaces) {
+        ASSERT_TRUE(scene.transformSurface(surface, MatrixUtils::translate(step(random), step(random), step(random))));
+    }
+    ASSERT_FALSE(scene.transformSurface(surfaces[0], MatrixUtils::scale(1.0f, 2.0f, 1.0f)));
+    ASSERT_FALSE(scene.transformSurface(plane, MatrixUtils::translate(0.0f, 1.0f, 0.0f)));
+    checkRays();
+    ASSERT_EQ(scene.getBvh().getStatistics().builtSahCost, builtSahCost);
+    ASSERT_NE(scene.getBvh().getStatistics().sahCost, builtSahCost);
+
+    // Scattering everything degrades the refit tree too far, it is rebuilt.
+    for (const auto& surface: surfaces) {
+        ASSERT_TRUE(scene.transformSurface(surface, MatrixUtils::translate(position(random), position(random),
+                                                                           position(random))));
+    }
+    checkRays();
+    ASSERT_FALSE(scene.getBvh().needsRebuild());
+    ASSERT_EQ(scene.getBvh().getStatistics().sahCost, scene.getBvh().getStatistics().builtSahCost);
+}
+
+TEST(crtTest, SceneOccludedMatchesHit) {
+    std::mt19937 random(5);
+    std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+    std::uniform_real_distribution<float> size(5.0f, 40.0f);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+    Scene scene;
+    for (int i = 0; i < 800; ++i) {
+        const Vector3f v0{position(random), position(random), position(random)};
+        scene.addSurface(std::make_shared<Triangle>(v0,
+                                                    v0 + Vector3f{size(random), 0.0f, size(random)},
+                                                    v0 + Vector3f{0.0f, size(random), size(random)}));
+    }
+    scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -250.0f, 0.0f}));
+
+    // Triangles and planes have a single intersection, so occlusion within [tMin, tMax] is exactly a closest hit
+    // within the same interval.
+    int occludedCount = 0;
+    for (int i = 0; i < 4000; ++i) {
+        const Ray ray{Vector3f{position(random), position(random), position(random)},
+                      Vector3f{direction(random), direction(random), direction(random)}.normalize()};
+        const float tMax = size(random) * 10.0f;
+        HitRecord record{};
+        const bool expected = scene.hit(ray, 0.0f, tMax, record);
+        ASSERT_EQ(expected, scene.occluded(ray, 0.0f, tMax)) << "ray " << i;
+        occludedCount += expected;
+    }
+    ASSERT_GT(occludedCount, 0);
+}
+
+TEST(crtTest, SphereOccludedFromInside) {
+    const Sphere sphere(Vector3f{0.0f, 0.0f, 0.0f}, 10.0f);
+    const Ray outward{Vector3f{0.0f, 0.0f, 0.0f}, Vector3f{1.0f, 0.0f, 0.0f}};
+    ASSERT_TRUE(sphere.occluded(outward, 0.001f, 100.0f));
+    ASSERT_FALSE(sphere.occluded(outward, 0.001f, 9.0f));
+
+    const Ray away{Vector3f{20.0f, 0.0f, 0.0f}, Vector3f{1.0f, 0.0f, 0.0f}};
+    ASSERT_FALSE(sphere.occluded(away, 0.001f, 100.0f));
+
+    // A blocker beyond the light must not cast a shadow.
+    const Ray towards{Vector3f{-20.0f, 0.0f, 0.0f}, Vector3f{1.0f, 0.0f, 0.0f}};
+    ASSERT_TRUE(sphere.occluded(towards, 0.001f, 15.0f));
+    ASSERT_FALSE(sphere.occluded(towards, 0.001f, 5.0f));
+}
+
+TEST(crtTest, SphereTransformKeepsOnlySimilarities) {
+    Sphere sphere(Vector3f{1.0f, 2.0f, 3.0f}, 2.0f);
+    ASSERT_TRUE(sphere.transform(MatrixUtils::translate(1.0f, 0.0f, 0.0f) * MatrixUtils::rotateByY<float>(0.5f) *
+                                 MatrixUtils::scale(3.0f, 3.0f, 3.0f)));
+    EXPECT_NEAR(sphere.getRadius(), 6.0f, 1e-4f);
+
+    const auto center = sphere.getCenter();
+    // Unit length but not orthogonal columns: x stays, y goes to (0.6, 0.8, 0).
+    const Matrix4f shear{1.0f, 0.6f, 0.0f, 0.0f,
+                         0.0f, 0.8f, 0.0f, 0.0f,
+                         0.0f, 0.0f, 1.0f, 0.0f,
+                         0.0f, 0.0f, 0.0f, 1.0f};
+    EXPECT_FALSE(sphere.transform(shear));
+    EXPECT_FALSE(sphere.transform(MatrixUtils::scale(1.0f, 2.0f, 1.0f)));
+    EXPECT_FALSE(sphere.transform(MatrixUtils::scale(0.0f, 0.0f, 0.0f)));
+    EXPECT_EQ(sphere.getCenter(), center);
+    EXPECT_NEAR(sphere.getRadius(), 6.0f, 1e-4f);
+}
@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include "../src/SceneBundle.h"
+#include "../src/Mesh.h"
+#include "../src/Plane.h"
+#include "../src/Sphere.h"
+#include "../src/Triangle.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+using namespace crt;
+
+namespace {
+    void buildTestScene(Scene& scene, const BvhBuildOptions& bvhOptions = {}) {
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+
+        std::vector<Vector3f> pixels;
+        for (int i = 0; i < 4 * 2; ++i) {
+            pixels.push_back({static_cast<float>(i) / 8.0f, 0.5f, 1.0f});
+        }
+        const auto texture = std::make_shared<Texture2D>(4, 2, std::move(pixels));
+
+        auto sphere = std::make_shared<Sphere>(Vector3f{0.0f, 50.0f, -100.0f}, 40.0f,
+                                               Material({0.1f, 0.1f, 0.1f}, {0.2f, 0.3f, 0.4f}, {}, 8.0f));
+        sphere->setTexture(texture);
+        scene.addSurface(sphere);
+        scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -150.0f, 0.0f}));
+        scene.addSurface(std::make_shared<Triangle>(Vector3f{-50.0f, -50.0f, -300.0f},
+                                                    Vector3f{50.0f, -50.0f, -300.0f},
+                                                    Vector3f{0.0f, 50.0f, -300.0f},
+                                                    Material({}, {0.9f, 0.1f, 0.1f}, {}, 2.0f)));
+
+        std::vector<Vector3f> points;
+        std::vector<Vector3i> indices;
+        for (int i = 0; i < 200; ++i) {
+            const Vector3f v0{position(random), position(random), position(random)};
+            points.push_back(v0);
+            points.push_back(v0 + Vector3f{10.0f, 0.0f, 5.0f});
+            points.push_back(v0 + Vector3f{0.0f, 10.0f, 5.0f});
+            indices.push_back({i * 3, i * 3 + 1, i * 3 + 2});
+        }
+        auto mesh = std::make_shared<Mesh>(std::move(points), std::move(indices), bvhOptions);
+        mesh->setMaterial(Material({}, {0.5f, 0.5f, 0.0f}, {0.3f, 0.3f, 0.3f}, 100.0f));
+        mesh->setTexture(texture);
+        scene.addSurface(mesh);
+    }
+}
+
+TEST(crtTest, SceneBundleRoundTrip) {
+    const std::string path = ::testing::TempDir() + "crt_scene_bundle_test.crtscene";
+    Scene original;
+    buildTestScene(original);
+    std::string error;
+    ASSERT_TRUE(SceneBundle::write(original, path, error)) << error;
+
+    Scene loaded;
+    ASSERT_TRUE(SceneBundle::read(path, loaded, error)) << error;
+    // The surfaces keep the mapping alive on their own.
+    std::remove(path.c_str());
+    ASSERT_EQ(loaded.getSurface().size(), original.getSurface().size());
+
+    const auto* originalMesh = dynamic_cast<const Mesh*>(original.getSurface().back().get());
+    const auto* loadedMesh = dynamic_cast<const Mesh*>(loaded.getSurface().back().get());
+    ASSERT_NE(loadedMesh, nullptr);
+    ASSERT_EQ(loadedMesh->getTriangleCount(), originalMesh->getTriangleCount());
+    ASSERT_EQ(loadedMesh->getBvh().getStatistics().nodeCount, originalMesh->getBvh().getStatistics().nodeCount);
+    ASSERT_EQ(loadedMesh->getTexture(), loaded.getSurface().front()->getTexture());
+
+    std::mt19937 random(9);
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    int hitCount = 0;
+    for (int i = 0; i < 2000; ++i) {
+        const Ray ray{{0.0f, 0.0f, 200.0f},
+                      Vector3f{direction(random), direction(random), -1.0f}.normalize()};
+        HitRecord expected{};
+        HitRecord actual{};
+        const bool expectedHit = original.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+        ASSERT_EQ(loaded.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual), expectedHit);
+        if (expectedHit) {
+            ++hitCount;
+            ASSERT_EQ(actual.t, expected.t);
+            ASSERT_EQ(actual.normal, expected.normal);
+            ASSERT_EQ(actual.color, expected.color);
+            ASSERT_EQ(actual.material->getDiffuse(), expected.material->getDiffuse());
+            ASSERT_EQ(actual.material->getShininess(), expected.material->getShininess());
+        }
+    }
+    ASSERT_GT(hitCount, 0);
+}
+
+TEST(crtTest, SceneBundleRoundTripWideBvh) {
+    const std::string path = ::testing::TempDir() + "crt_scene_bundle_wide_test.crtscene";
+    for (const uint32_t width: {4u, 8u}) {
+        BvhBuildOptions bvhOptions;
+        bvhOptions.width = width;
+        Scene original;
+        buildTestScene(original, bvhOptions);
+        std::string error;
+        ASSERT_TRUE(SceneBundle::write(original, path, error)) << error;
+        Scene loaded;
+        ASSERT_TRUE(SceneBundle::read(path, loaded, error)) << error;
+        std::remove(path.c_str());
+
+        const auto* loadedMesh = dynamic_cast<const Mesh*>(loaded.getSurface().back().get());
+        ASSERT_NE(loadedMesh, nullptr);
+        ASSERT_EQ(loadedMesh->getBvhWidth(), width);
+
+        std::mt19937 random(10);
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        int hitCount = 0;
+        for (int i = 0; i < 2000; ++i) {
+            const Ray ray{{0.0f, 0.0f, 200.0f},
+                          Vector3f{direction(random), direction(random), -1.0f}.normalize()};
+            HitRecord expected{};
+            HitRecord actual{};
+            const bool expectedHit = original.hit(ray, 0.0f, std::numeric_limits<float>::max(), expected);
+            ASSERT_EQ(loaded.hit(ray, 0.0f, std::numeric_limits<float>::max(), actual), expectedHit);
+            if (expectedHit) {
+                ++hitCount;
+                ASSERT_EQ(actual.t, expected.t);
+                ASSERT_EQ(actual.normal, expected.normal);
+            }
+        }
+        ASSERT_GT(hitCount, 0);
+    }
+}
+
+TEST(crtTest, SceneBundleRejectsBadFiles) {
+    const std::string path = ::testing::TempDir() + "crt_scene_bundle_bad.crtscene";
+    Scene scene;
+    buildTestScene(scene);
+    std::string error;
+    ASSERT_TRUE(SceneBundle::write(scene, path, error)) << error;
+    std::string bytes;
+    {
+        std::ifstream file(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    const auto rewrite = [&](const std::string& content) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+
+    Scene loaded;
+    rewrite(bytes.substr(0, bytes.size() / 2));
+    ASSERT_FALSE(SceneBundle::read(path, loaded, error));
+
+    auto otherVersion = bytes;
+    otherVersion[8] = static_cast<char>(SceneBundle::kVersion + 1);
+    rewrite(otherVersion);
+    ASSERT_FALSE(SceneBundle::read(path, loaded, error));
+    ASSERT_NE(error.find("compile the scene again"), std::string::npos);
+
+    rewrite("ply\nformat ascii 1.0\n");
+    ASSERT_FALSE(SceneBundle::read(path, loaded, error));
+    ASSERT_TRUE(loaded.getSurface().empty());
+    std::remove(path.c_str());
+}
+
+TEST(crtTest, SceneBundleRejectsBadIndices) {
+    const std::string path = ::testing::TempDir() + "crt_scene_bundle_indices.crtscene";
+    const auto rewrite = [&](const std::string& content) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+    for (const uint32_t width: {2u, 8u}) {
+        BvhBuildOptions bvhOptions;
+        bvhOptions.width = width;
+        Scene scene;
+        buildTestScene(scene, bvhOptions);
+        std::string error;
+        ASSERT_TRUE(SceneBundle::write(scene, path, error)) << error;
+        std::string bytes;
+        {
+            std::ifstream file(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        // Overwrites a 32 bit value at byteOffset into the stored copy of array.
+        const auto& mesh = dynamic_cast<const Mesh&>(*scene.getSurface().back());
+        const auto corrupt = [&](const auto& array, size_t byteOffset, uint32_t value) {
+            const std::string arrayBytes(reinterpret_cast<const char*>(array.data()),
+                                         array.size() * sizeof(array[0]));
+            const auto position = bytes.find(arrayBytes);
+            EXPECT_NE(position, std::string::npos);
+            auto corrupted = bytes;
+            std::memcpy(&corrupted[position + byteOffset], &value, sizeof(value));
+            return corrupted;
+        };
+        std::vector<std::string> corruptedBundles;
+        corruptedBundles.push_back(corrupt(mesh.getTriangleVertexIndices(), sizeof(int), 600));
+        corruptedBundles.push_back(corrupt(mesh.getTriangleBlocks(), offsetof(TriangleBlock, triangle), 200));
+        if (width == 8) {
+            // The first child of the root pointing back at the root.
+            corruptedBundles.push_back(corrupt(mesh.getWideBvh8().getNodes(), offsetof(WideBvhNode<8>, children), 0));
+        } else {
+            corruptedBundles.push_back(corrupt(mesh.getBvh().getPrimitiveIndices(), 0, 200));
+            corruptedBundles.push_back(corrupt(mesh.getBvh().getNodes(), offsetof(BvhNode, offset), 0));
+            // The last node is always a leaf.
+            const auto& leafBlocks = mesh.getLeafBlocks();
+            corruptedBundles.push_back(corrupt(leafBlocks, sizeof(uint32_t) * (leafBlocks.size() - 1),
+                                               static_cast<uint32_t>(mesh.getTriangleBlocks().size())));
+        }
+        for (size_t i = 0; i < corruptedBundles.size(); ++i) {
+            rewrite(corruptedBundles[i]);
+            Scene loaded;
+            ASSERT_FALSE(SceneBundle::read(path, loaded, error)) << "width " << width << " case " << i;
+            ASSERT_NE(error.find("invalid mesh"), std::string::npos) << error;
+            ASSERT_TRUE(loaded.getSurface().empty());
+        }
+        rewrite(bytes);
+        Scene loaded;
+        ASSERT_TRUE(SceneBundle::read(path, loaded, error)) << error;
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+#include "../src/FrameBuffer.h"
+#include "../src/FramePipeline.h"
+#include "../src/SequenceTrack.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace crt;
+
+namespace {
+    /**
+     * Output that records the rows it is handed.
+     */
+    class RecordingOutput : public ImageOutput {
+    public:
+        bool begin(const SizeI& imageSize) override {
+            size.setWidth(imageSize.getWidth());
+            size.setHeight(imageSize.getHeight());
+            return true;
+        }
+
+        bool writeRows(int y, int rowCount, const Vector3f* rows) override {
+            EXPECT_EQ(y * size.getWidth(), static_cast<int>(pixels.size()));
+            pixels.insert(pixels.end(), rows, rows + rowCount * size.getWidth());
+            return true;
+        }
+
+        bool end() override {
+            ended = true;
+            return true;
+        }
+
+        SizeI size;
+        std::vector<Vector3f> pixels;
+        bool ended = false;
+    };
+
+    void fillFrame(FrameBuffer& image, const SizeI& size, float value) {
+        ASSERT_TRUE(image.begin(size));
+        std::vector<Vector3f> row(size.getWidth());
+        for (int y = 0; y < size.getHeight(); ++y) {
+            for (int x = 0; x < size.getWidth(); ++x) {
+                row[x] = {value, static_cast<float>(x), static_cast<float>(y)};
+            }
+            ASSERT_TRUE(image.writeRows(y, 1, row.data()));
+        }
+        ASSERT_TRUE(image.end());
+    }
+}
+
+TEST(crtTest, FrameBufferRoundTrip) {
+    FrameBuffer image;
+    const SizeI size{7, FrameBuffer::kBandHeight + 5};
+    fillFrame(image, size, 1.0f);
+    EXPECT_TRUE(image.isComplete());
+
+    RecordingOutput output;
+    ASSERT_TRUE(image.writeTo(output));
+    EXPECT_TRUE(output.ended);
+    ASSERT_EQ(output.pixels.size(), image.getPixels().size());
+    for (size_t i = 0; i < output.pixels.size(); ++i) {
+        EXPECT_EQ(output.pixels[i], image.getPixels()[i]);
+    }
+}
+
+TEST(crtTest, FrameBufferRejectsIncompleteFrame) {
+    FrameBuffer image;
+    ASSERT_TRUE(image.begin({4, 4}));
+    std::vector<Vector3f> rows(8);
+    EXPECT_FALSE(image.writeRows(2, 2, rows.data()));
+    ASSERT_TRUE(image.writeRows(0, 2, rows.data()));
+    EXPECT_FALSE(image.end());
+    EXPECT_FALSE(image.isComplete());
+}
+
+TEST(crtTest, FramePipelineRunsStagesInOrder) {
+    constexpr uint32_t kFrameCount = 9;
+    const SizeI size{3, 2};
+    std::mutex mutex;
+    std::vector<uint32_t> updated, rendered, written;
+    // Frame each slot was last updated to, and whether a render is reading it.
+    uint32_t slotFrames[FramePipeline::kSlotCount] = {};
+    std::atomic<bool> slotBusy[FramePipeline::kSlotCount] = {};
+    std::atomic<int> writesRunning{0};
+
+    const auto update = [&](uint32_t frame, unsigned slot, std::string&) {
+        EXPECT_FALSE(slotBusy[slot].load());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(mutex);
+        slotFrames[slot] = frame;
+        updated.push_back(frame);
+        return true;
+    };
+    const auto render = [&](uint32_t frame, unsigned slot, FrameBuffer& outImage, std::string&) {
+        slotBusy[slot] = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            EXPECT_EQ(slotFrames[slot], frame);
+            rendered.push_back(frame);
+        }
+        fillFrame(outImage, size, static_cast<float>(frame));
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        slotBusy[slot] = false;
+        return true;
+    };
+    const auto write = [&](uint32_t frame, const FrameBuffer& image, std::string&) {
+        EXPECT_EQ(++writesRunning, 1);
+        EXPECT_EQ(image.getPixels().front().getX(), static_cast<float>(frame));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            written.push_back(frame);
+        }
+        --writesRunning;
+        return true;
+    };
+
+    std::string error;
+    FramePipelineStatistics statistics;
+    ASSERT_TRUE(FramePipeline::run(kFrameCount, update, render, write, error, &statistics)) << error;
+    EXPECT_EQ(statistics.frameCount, kFrameCount);
+    std::vector<uint32_t> expected;
+    for (uint32_t frame = 0; frame < kFrameCount; ++frame) {
+        expected.push_back(frame);
+    }
+    EXPECT_EQ(updated, expected);
+    EXPECT_EQ(rendered, expected);
+    EXPECT_EQ(written, expected);
+}
+
+TEST(crtTest, FramePipelineStopsAtFirstError) {
+    std::vector<uint32_t> written;
+    const auto update = [](uint32_t, unsigned, std::string&) { return true; };
+    const auto render = [](uint32_t frame, unsigned, FrameBuffer& outImage, std::string& outError) {
+        if (frame == 3) {
+            outError = "render failed";
+            return false;
+        }
+        fillFrame(outImage, {2, 2}, 0.0f);
+        return true;
+    };
+    const auto write = [&](uint32_t frame, const FrameBuffer&, std::string&) {
+        written.push_back(frame);
+        return true;
+    };
+
+    std::string error;
+    FramePipelineStatistics statistics;
+    EXPECT_FALSE(FramePipeline::run(10, update, render, write, error, &statistics));
+    EXPECT_EQ(error, "render failed");
+    EXPECT_EQ(statistics.frameCount, 3u);
+    EXPECT_EQ(written, (std::vector<uint32_t>{0, 1, 2}));
+
+    const auto failingWrite = [](uint32_t frame, const FrameBuffer&, std::string& outError) {
+        outError = "write " + std::to_string(frame);
+        return false;
+    };
+    const auto anyRender = [](uint32_t, unsigned, FrameBuffer& outImage, std::string&) {
+        fillFrame(outImage, {2, 2}, 0.0f);
+        return true;
+    };
+    EXPECT_FALSE(FramePipeline::run(10, update, anyRender, failingWrite, error));
+    EXPECT_EQ(error, "write 0");
+}
+
+TEST(crtTest, SequenceTrackInterpolatesKeys) {
+    std::istringstream input("# frame eye target yaw move\n"
+                             "0   0 0 10   0 0 0   0    0 0 0\n"
+                             "\n"
+                             "4   4 0 10   0 2 0   90   8 0 0  # halfway\n");
+    SequenceTrack track;
+    std::string error;
+    ASSERT_TRUE(SequenceTrack::parse(input, track, error)) << error;
+    EXPECT_EQ(track.getFrameCount(), 5u);
+
+    const auto middle = track.getFrame(1);
+    EXPECT_FLOAT_EQ(middle.eye.getX(), 1.0f);
+    EXPECT_FLOAT_EQ(middle.target.getY(), 0.5f);
+    EXPECT_FLOAT_EQ(middle.yaw, 22.5f);
+    EXPECT_FLOAT_EQ(middle.move.getX(), 2.0f);
+    EXPECT_FLOAT_EQ(track.getFrame(100).yaw, 90.0f);
+
+    // A quarter turn about pivot (1, 0, 0) takes (2, 0, 0) to (1, 0, -1), then the move shifts it.
+    const auto moved = track.getFrame(4).getTransform({1.0f, 0.0f, 0.0f}) * Vector4f{2.0f, 0.0f, 0.0f, 1.0f};
+    EXPECT_NEAR(moved.getX(), 9.0f, 1e-4f);
+    EXPECT_NEAR(moved.getY(), 0.0f, 1e-4f);
+    EXPECT_NEAR(std::abs(moved.getZ()), 1.0f, 1e-4f);
+
+    const auto turntable = SequenceTrack::makeTurntable(4, {0.0f, 0.0f, 10.0f}, {});
+    EXPECT_EQ(turntable.getFrameCount(), 4u);
+    EXPECT_FLOAT_EQ(turntable.getFrame(1).yaw, 90.0f);
+    EXPECT_EQ(turntable.getFrame(3).eye, (Vector3f{0.0f, 0.0f, 10.0f}));
+}
+
+TEST(crtTest, SequenceTrackRejectsBadInput) {
+    SequenceTrack track;
+    std::string error;
+    std::istringstream shortLine("0 1 2 3\n");
+    EXPECT_FALSE(SequenceTrack::parse(shortLine, track, error));
+    EXPECT_NE(error.find("line 1"), std::string::npos);
+
+    std::istringstream unordered("5 0 0 0 0 0 0 0 0 0 0\n3 0 0 0 0 0 0 0 0 0 0\n");
+    EXPECT_FALSE(SequenceTrack::parse(unordered, track, error));
+    EXPECT_NE(error.find("line 2"), std::string::npos);
+
+    std::istringstream empty("# nothing\n");
+    EXPECT_FALSE(SequenceTrack::parse(empty, track, error));
+    EXPECT_FALSE(SequenceTrack::load("/nonexistent/track.txt", track, error));
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "../src/Scene.h"
+#include "../src/Sphere.h"
+#include "../src/Statistics.h"
+#include "../src/Triangle.h"
+
+#include <thread>
+
+using namespace crt;
+
+TEST(crtTest, TraversalCountersAreCountedAndMerged) {
+    ASSERT_TRUE(Statistics::kEnabled);
+    Scene scene;
+    for (int i = 0; i < 20; ++i) {
+        const auto x = static_cast<float>(i) * 10.0f;
+        scene.addSurface(std::make_shared<Sphere>(Vector3f{x, 0.0f, 0.0f}, 2.0f));
+        scene.addSurface(std::make_shared<Triangle>(Vector3f{x, 5.0f, 0.0f}, Vector3f{x + 2.0f, 5.0f, 0.0f},
+                                                    Vector3f{x, 7.0f, 0.0f}));
+    }
+    const Ray ray{Vector3f{50.0f, 0.0f, 100.0f}, Vector3f{0.0f, 0.0f, -1.0f}};
+    const Ray shadowRay{Vector3f{50.0f, 6.0f, 100.0f}, Vector3f{0.0f, 0.0f, -1.0f}};
+    HitRecord hitRecord{};
+    ASSERT_GT(scene.getBvh().getStatistics().nodeCount, 0u);
+    Statistics::reset();
+
+    const auto before = Statistics::getThreadCounters();
+    ASSERT_TRUE(scene.hit(ray, hitRecord));
+    const auto after = Statistics::getThreadCounters();
+    ASSERT_EQ(after.closestHitRays - before.closestHitRays, 1u);
+    ASSERT_GT(after.boxTests, before.boxTests);
+    ASSERT_GE(after.primitiveTests - before.primitiveTests, 1u);
+
+    // A thread that ends before collect still shows up in the total.
+    std::thread([&]() {
+        for (int i = 0; i < 10; ++i) {
+            ASSERT_TRUE(scene.occluded(shadowRay, 0.0f, 200.0f));
+        }
+    }).join();
+    const auto total = Statistics::collect();
+    ASSERT_EQ(total.closestHitRays, 1u);
+    ASSERT_EQ(total.occlusionRays, 10u);
+    ASSERT_GE(total.triangleTests, 10u);
+    ASSERT_EQ(total.getRayCount(), 11u);
+
+    Statistics::reset();
+    ASSERT_EQ(Statistics::collect().getRayCount(), 0u);
+}
+
+TEST(crtTest, HeatColorRamp) {
+    ASSERT_EQ(Statistics::getHeatColor(0.0f), (Vector3f{0.0f, 0.0f, 0.3f}));
+    ASSERT_EQ(Statistics::getHeatColor(1.0f), (Vector3f{1.0f, 0.1f, 0.0f}));
+    ASSERT_EQ(Statistics::getHeatColor(2.0f), (Vector3f{1.0f, 1.0f, 1.0f}));
+    // Warmer means more red and less blue.
+    ASSERT_LT(Statistics::getHeatColor(0.3f).getX(), Statistics::getHeatColor(0.8f).getX());
+    ASSERT_GT(Statistics::getHeatColor(0.3f).getZ(), Statistics::getHeatColor(0.8f).getZ());
+}
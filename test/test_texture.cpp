@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "../src/Sphere.h"
+#include "../src/Texture2D.h"
+
+#include <cmath>
+#include <random>
+
+using namespace crt;
+
+namespace {
+    std::vector<uint8_t> makeNoise(int width, int height) {
+        std::mt19937 random(3);
+        std::vector<uint8_t> rgb8(static_cast<size_t>(width) * height * 3);
+        for (auto& value: rgb8) {
+            value = static_cast<uint8_t>(random() & 0xffu);
+        }
+        return rgb8;
+    }
+}
+
+TEST(crtTest, TextureFormatsAndLayouts) {
+    // Not a multiple of the tile size, so the edge tiles are partial.
+    const int width = 37;
+    const int height = 21;
+    const auto rgb8 = makeNoise(width, height);
+    const Texture2D reference(width, height, rgb8, {TextureFormat::RGBFloat, TextureLayout::Linear, false});
+    for (const auto format: {TextureFormat::RGB8, TextureFormat::RGBA8, TextureFormat::RGBHalf}) {
+        for (const auto layout: {TextureLayout::Linear, TextureLayout::Tiled}) {
+            const Texture2D texture(width, height, rgb8, {format, layout, true});
+            ASSERT_EQ(texture.getTexels().size(), Texture2D::getByteSize(width, height, texture.getOptions()));
+            ASSERT_EQ(texture.getLevelCount(), 6);
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) {
+                    const auto expected = reference.getPixel(x, y);
+                    const auto actual = texture.getPixel(x, y);
+                    for (int i = 0; i < 3; ++i) {
+                        if (format == TextureFormat::RGBHalf) {
+                            ASSERT_NEAR(actual[i], expected[i], 1e-3f);
+                        } else {
+                            // 8 bit sources survive RGB8 exactly.
+                            ASSERT_EQ(actual[i], expected[i]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const Texture2D linear(width, height, rgb8, {TextureFormat::RGB8, TextureLayout::Linear, false});
+    const Texture2D tiled(width, height, rgb8, {TextureFormat::RGB8, TextureLayout::Tiled, false});
+    ASSERT_EQ(Texture2D::getByteSize(width, height, linear.getOptions()), width * height * 3u);
+    std::mt19937 random(4);
+    std::uniform_real_distribution<float> coordinate(0.0f, 1.0f);
+    for (int i = 0; i < 1000; ++i) {
+        const Vector2f uv{coordinate(random), coordinate(random)};
+        ASSERT_EQ(linear.getColor(uv), tiled.getColor(uv));
+    }
+    ASSERT_EQ(tiled.getColor({1.0f, 1.0f}), tiled.getPixel(width - 1, height - 1));
+}
+
+TEST(crtTest, TextureMipmaps) {
+    // Black and white checkerboard: every mip level but the first is uniformly gray.
+    const int size = 64;
+    std::vector<Vector3f> pixels;
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const auto value = static_cast<float>((x + y) % 2);
+            pixels.push_back({value, value, value});
+        }
+    }
+    const Texture2D texture(size, size, pixels, {TextureFormat::RGBFloat, TextureLayout::Tiled, true});
+    ASSERT_EQ(texture.getLevelCount(), 7);
+    ASSERT_EQ(texture.getPixel(0, 0, 6), (Vector3f{0.5f, 0.5f, 0.5f}));
+
+    const Vector2f uv{0.3f, 0.7f};
+    // Footprints below a texel, and the default, sample the full resolution level.
+    ASSERT_EQ(texture.getColor(uv, {0.0f, 0.0f}), texture.getColor(uv));
+    ASSERT_EQ(texture.getColor(uv, {0.5f / size, 0.5f / size}), texture.getColor(uv));
+    // A footprint of four texels reads level 2, far larger ones the last level.
+    ASSERT_EQ(texture.getColor(uv, {4.0f / size, 4.0f / size}), (Vector3f{0.5f, 0.5f, 0.5f}));
+    ASSERT_EQ(texture.getColor(uv, {100.0f, 100.0f}), (Vector3f{0.5f, 0.5f, 0.5f}));
+}
+
+TEST(crtTest, TextureMipLevelOfSphereFootprint) {
+    // Equirectangular like the moon map: twice as wide as high, so texels are square on the sphere.
+    const int width = 1024;
+    const int height = 512;
+    std::vector<Vector3f> pixels;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            pixels.push_back({static_cast<float>(x % 7), static_cast<float>(y % 5), static_cast<float>(x % 3)});
+        }
+    }
+    const auto texture = std::make_shared<Texture2D>(width, height, pixels,
+                                                     TextureOptions{TextureFormat::RGBFloat, TextureLayout::Tiled,
+                                                                    true});
+    const float radius = 3.0f;
+    Sphere sphere(Vector3f{0.0f, 0.0f, 0.0f}, radius);
+    sphere.setTexture(texture);
+
+    // A footprint four texels wide along both axes reads exactly level 2, at a texel corner of that level.
+    const auto footprint = 4.0f * static_cast<float>(M_PI) * radius / static_cast<float>(height);
+    const auto uvFootprint = sphere.getUVScale() * footprint;
+    ASSERT_FLOAT_EQ(uvFootprint.getX() * width, 4.0f);
+    ASSERT_FLOAT_EQ(uvFootprint.getY() * height, 4.0f);
+    const Vector2f uv{100.0f / (width / 4), 50.0f / (height / 4)};
+    ASSERT_EQ(texture->getColor(uv, {4.0f / width, 4.0f / height}), texture->getPixel(100, 50, 2));
+}
+
+TEST(crtTest, TextureMipmapsKeepOddEdges) {
+    // 3 x 1: halving drops the last column unless it is folded into the last texel.
+    const std::vector<Vector3f> pixels{{0.0f, 0.0f, 0.0f}, {3.0f, 0.0f, 0.0f}, {6.0f, 0.0f, 0.0f}};
+    const Texture2D texture(3, 1, pixels, {TextureFormat::RGBFloat, TextureLayout::Linear, true});
+    ASSERT_EQ(texture.getLevelCount(), 2);
+    ASSERT_EQ(texture.getPixel(0, 0, 1), (Vector3f{3.0f, 0.0f, 0.0f}));
+}
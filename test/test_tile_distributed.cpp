@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "../src/FrameBuffer.h"
+#include "../src/TileCoordinator.h"
+#include "../src/TileWorker.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace crt;
+
+namespace {
+    std::string makeSocketAddress(const std::string& name) {
+        return "unix:/tmp/crt_test_" + name + "_" + std::to_string(getpid()) + ".sock";
+    }
+
+    Vector3f getExpectedColor(int x, int y) {
+        return {static_cast<float>(x), static_cast<float>(y), 1.0f};
+    }
+
+    /**
+     * Render function whose pixels name their frame coordinates, after an optional delay per tile.
+     */
+    TileWorker::RenderFunction makeRenderFunction(std::chrono::milliseconds delay = {}) {
+        return [delay](const SizeI&, const RenderTile& tile, FrameBuffer& outImage, std::string&) {
+            std::this_thread::sleep_for(delay);
+            std::vector<Vector3f> pixels;
+            for (int y = 0; y < tile.height; ++y) {
+                for (int x = 0; x < tile.width; ++x) {
+                    pixels.push_back(getExpectedColor(tile.x + x, tile.y + y));
+                }
+            }
+            return outImage.begin({tile.width, tile.height}) && outImage.writeRows(0, tile.height, pixels.data()) &&
+                   outImage.end();
+        };
+    }
+
+    void expectFrame(const FrameBuffer& image, const SizeI& size) {
+        ASSERT_TRUE(image.isComplete());
+        ASSERT_EQ(image.getSize(), size);
+        for (int y = 0; y < size.getHeight(); ++y) {
+            for (int x = 0; x < size.getWidth(); ++x) {
+                ASSERT_EQ(image.getPixels()[y * size.getWidth() + x], getExpectedColor(x, y)) << x << ", " << y;
+            }
+        }
+    }
+}
+
+TEST(crtTest, DistributedTilesAssembleImage) {
+    const auto address = makeSocketAddress("assemble");
+    TileCoordinatorOptions options;
+    options.tileSize = 16;
+    TileCoordinator coordinator(options);
+    ASSERT_TRUE(coordinator.listen(address)) << coordinator.getError();
+
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> tileCount{0};
+    std::atomic<int> succeededCount{0};
+    for (int i = 0; i < 3; ++i) {
+        threads.emplace_back([&]() {
+            TileWorker worker;
+            TileWorkerStatistics statistics;
+            if (worker.connect(address) && worker.run(makeRenderFunction(), &statistics)) {
+                ++succeededCount;
+                tileCount += statistics.tileCount;
+            }
+        });
+    }
+
+    // Two frames over the same workers, the second one smaller than a tile at the edges.
+    for (const auto& size: {SizeI{70, 45}, SizeI{33, 17}}) {
+        FrameBuffer image;
+        TileCoordinatorStatistics statistics;
+        ASSERT_TRUE(coordinator.render(size, image, &statistics)) << coordinator.getError();
+        expectFrame(image, size);
+        EXPECT_EQ(statistics.failedWorkerCount, 0u);
+        EXPECT_EQ(statistics.reassignedTileCount, 0u);
+    }
+    coordinator.finish();
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    EXPECT_EQ(succeededCount, 3);
+    EXPECT_GE(tileCount, 5u * 3u + 3u * 2u);
+}
+
+TEST(crtTest, DistributedTilesReassignFailedWorker) {
+    const auto address = makeSocketAddress("failed");
+    TileCoordinatorOptions options;
+    options.tileSize = 8;
+    TileCoordinator coordinator(options);
+    ASSERT_TRUE(coordinator.listen(address)) << coordinator.getError();
+
+    // Takes tiles and disconnects without answering. The good worker only starts once it holds some.
+    std::atomic<bool> failed{false};
+    std::thread failingWorker([&]() {
+        TileConnection connection;
+        TileMessage message;
+        if (connection.connect(address, TileWorker::kDefaultConnectSeconds)) {
+            connection.receive(message);
+        }
+        connection.close();
+        failed = true;
+    });
+    std::thread goodWorker([&]() {
+        while (!failed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TileWorker worker;
+        EXPECT_TRUE(worker.connect(address) && worker.run(makeRenderFunction())) << worker.getError();
+    });
+
+    const SizeI size{32, 24};
+    FrameBuffer image;
+    TileCoordinatorStatistics statistics;
+    ASSERT_TRUE(coordinator.render(size, image, &statistics)) << coordinator.getError();
+    coordinator.finish();
+    failingWorker.join();
+    goodWorker.join();
+    expectFrame(image, size);
+    EXPECT_EQ(statistics.failedWorkerCount, 1u);
+    EXPECT_GE(statistics.reassignedTileCount, 1u);
+}
+
+TEST(crtTest, DistributedTilesDuplicateSlowTiles) {
+    const auto address = makeSocketAddress("slow");
+    TileCoordinatorOptions options;
+    options.tileSize = 16;
+    options.slowTileSeconds = 0.05;
+    TileCoordinator coordinator(options);
+    ASSERT_TRUE(coordinator.listen(address)) << coordinator.getError();
+
+    // Takes its full share of tiles and never answers, but stays connected until the coordinator is done.
+    std::atomic<uint32_t> stalledTileCount{0};
+    std::thread stalledWorker([&]() {
+        TileConnection connection;
+        TileMessage message;
+        if (!connection.connect(address, TileWorker::kDefaultConnectSeconds)) {
+            return;
+        }
+        while (connection.receive(message) && message.type == TileMessageType::Tile) {
+            ++stalledTileCount;
+        }
+    });
+    std::thread fastWorker([&]() {
+        while (stalledTileCount < options.tilesPerWorker) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TileWorker worker;
+        EXPECT_TRUE(worker.connect(address) && worker.run(makeRenderFunction())) << worker.getError();
+    });
+
+    const SizeI size{32, 32};
+    FrameBuffer image;
+    TileCoordinatorStatistics statistics;
+    ASSERT_TRUE(coordinator.render(size, image, &statistics)) << coordinator.getError();
+    coordinator.finish();
+    stalledWorker.join();
+    fastWorker.join();
+    expectFrame(image, size);
+    EXPECT_EQ(stalledTileCount, options.tilesPerWorker);
+    EXPECT_EQ(statistics.duplicatedTileCount, options.tilesPerWorker);
+    EXPECT_EQ(statistics.failedWorkerCount, 0u);
+}
+
+TEST(crtTest, DistributedTilesFailWithoutWorkers) {
+    TileCoordinatorOptions options;
+    options.workerTimeoutSeconds = 0.1;
+    TileCoordinator coordinator(options);
+    ASSERT_TRUE(coordinator.listen(makeSocketAddress("none"))) << coordinator.getError();
+    FrameBuffer image;
+    EXPECT_FALSE(coordinator.render({16, 16}, image));
+    EXPECT_FALSE(coordinator.getError().empty());
+
+    TileConnection connection;
+    EXPECT_FALSE(connection.connect("no-port-here"));
+}
+
+TEST(crtTest, DistributedTilesStopWhenWatchFails) {
+    // The default worker timeout would keep the render waiting for half a minute.
+    TileCoordinator coordinator;
+    ASSERT_TRUE(coordinator.listen(makeSocketAddress("watch"))) << coordinator.getError();
+    FrameBuffer image;
+    uint32_t watchCount = 0;
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(coordinator.render({16, 16}, image, nullptr, [&](std::string& outError) {
+        if (++watchCount < 3) {
+            return true;
+        }
+        outError = "workers exited";
+        return false;
+    }));
+    EXPECT_EQ(coordinator.getError(), "workers exited");
+    EXPECT_EQ(watchCount, 3u);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(crtTest, TileConnectionRejectsOversizedMessages) {
+    const auto address = makeSocketAddress("oversized");
+    TileListener listener;
+    ASSERT_TRUE(listener.listen(address)) << listener.getError();
+
+    // A raw client announcing a 4 GiB result.
+    const auto path = address.substr(std::string("unix:").size());
+    const int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(client, 0);
+    sockaddr_un clientAddress{};
+    clientAddress.sun_family = AF_UNIX;
+    std::copy(path.begin(), path.end(), clientAddress.sun_path);
+    ASSERT_EQ(::connect(client, reinterpret_cast<const sockaddr*>(&clientAddress), sizeof(clientAddress)), 0);
+    const uint32_t header[3] = {0x54545243, static_cast<uint32_t>(TileMessageType::Result), 0xfffffff0u};
+    ASSERT_EQ(::write(client, header, sizeof(header)), static_cast<ssize_t>(sizeof(header)));
+
+    TileConnection connection;
+    ASSERT_TRUE(listener.accept(connection)) << listener.getError();
+    TileMessage message;
+    EXPECT_FALSE(connection.receive(message));
+    EXPECT_EQ(connection.getError(), "message too large");
+    ::close(client);
+}
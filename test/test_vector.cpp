@@ -172,4 +172,73 @@ TEST(crtTest, Vector3) {
         ASSERT_FLOAT_EQ(v3.getY(), 4.0f);
         ASSERT_FLOAT_EQ(v3.getZ(), -2.0f);
     }
-}
\ No newline at end of file
+}
+namespace {
+    // Same expectations for the generic template (double) and the SSE backed float specializations.
+    template<typename VectorType>
+    void checkVectorOperations() {
+        using Scalar = std::decay_t<decltype(VectorType{}.getX())>;
+        VectorType a;
+        VectorType b;
+        for (size_t i = 0; i < a.getSize(); ++i) {
+            a[i] = static_cast<Scalar>(i + 1);
+            b[i] = static_cast<Scalar>(2 * i + 3);
+        }
+
+        const auto sum = a + b;
+        const auto quotient = b / a;
+        const auto scaled = a * static_cast<Scalar>(2);
+        const auto shifted = a + static_cast<Scalar>(1);
+        Scalar expectedDot = 0;
+        for (size_t i = 0; i < a.getSize(); ++i) {
+            ASSERT_FLOAT_EQ(sum[i], a[i] + b[i]);
+            ASSERT_FLOAT_EQ(quotient[i], b[i] / a[i]);
+            ASSERT_FLOAT_EQ(scaled[i], a[i] * 2);
+            ASSERT_FLOAT_EQ(shifted[i], a[i] + 1);
+            expectedDot += a[i] * b[i];
+        }
+        ASSERT_FLOAT_EQ(a.dot(b), expectedDot);
+        // Lengths and dot products must not see the padding lane of a padded 3 component vector.
+        ASSERT_FLOAT_EQ(shifted.getLength(), std::sqrt(static_cast<float>(shifted.dot(shifted))));
+        ASSERT_FLOAT_EQ(a.normalize().getLength(), 1.0f);
+        ASSERT_EQ(a.min(b), a);
+        ASSERT_EQ(a.max(b), b);
+        ASSERT_TRUE(b > a);
+        ASSERT_FALSE(a > b);
+        ASSERT_TRUE((a - a).isZero());
+        ASSERT_NE(a, b);
+
+        auto c = a;
+        c *= b;
+        c /= b;
+        ASSERT_EQ(c, a);
+        c.swap(b);
+        ASSERT_EQ(b, a);
+    }
+}
+
+TEST(crtTest, VectorScalarAndSimd) {
+    checkVectorOperations<Vector3d>();
+    checkVectorOperations<Vector4d>();
+    checkVectorOperations<Vector3f>();
+    checkVectorOperations<Vector4f>();
+
+    static_assert(alignof(Vector4f) == 16 && sizeof(Vector4f) == 16);
+#if CRT_VECTOR3_PADDED
+    static_assert(alignof(Vector3f) == 16 && sizeof(Vector3f) == 16);
+#else
+    static_assert(sizeof(Vector3f) == 12);
+#endif
+
+    const Vector3f v1(1.0f, 2.0f, 3.0f);
+    const Vector3f v2(3.0f, 4.0f, 5.0f);
+    const Vector3d v3 = Vector3d(1.0, 2.0, 3.0).cross(Vector3d(3.0, 4.0, 5.0));
+    const auto cross = v1.cross(v2);
+    ASSERT_FLOAT_EQ(cross.getX(), static_cast<float>(v3.getX()));
+    ASSERT_FLOAT_EQ(cross.getY(), static_cast<float>(v3.getY()));
+    ASSERT_FLOAT_EQ(cross.getZ(), static_cast<float>(v3.getZ()));
+
+    const Vector4f homogeneous{1, 2, 3, 1};
+    ASSERT_EQ(homogeneous.getXYZ(), v1);
+    ASSERT_FLOAT_EQ(homogeneous.getW(), 1.0f);
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "../src/Plane.h"
+#include "../src/Sphere.h"
+#include "../src/WavefrontTracer.h"
+
+#include <random>
+
+using namespace crt;
+
+namespace {
+    const WavefrontOptions kOptions;
+
+    /**
+     * Depth first reference: the same shading as the wavefront tracer, one ray at a time.
+     */
+    Vector3f traceRecursive(const Scene& scene, const std::vector<LightSource>& lightSources, const Ray& ray,
+                            float tMin, int depth) {
+        HitRecord hitRecord{};
+        if (!scene.hit(ray, tMin, std::numeric_limits<float>::max(), hitRecord)) {
+            return {};
+        }
+        const auto& material = *hitRecord.material;
+        auto color = material.getAmbient();
+        for (const auto& lightSource: lightSources) {
+            float lightDistance;
+            const auto l = Shading::getLightDirection(lightSource, hitRecord.p, lightDistance);
+            if (scene.occluded(Ray(hitRecord.p, l), kOptions.rayEpsilon, lightDistance)) {
+                continue;
+            }
+            if (depth < kOptions.maxReflections && Shading::isReflective(material)) {
+                const auto reflectedColor = traceRecursive(scene, lightSources,
+                                                           Shading::reflect(ray, hitRecord.p, hitRecord.normal),
+                                                           kOptions.rayEpsilon, depth + 1);
+                color += Shading::shadeLight(lightSource, material, ray, hitRecord.p, hitRecord.normal, l,
+                                             &reflectedColor);
+            } else {
+                color += Shading::shadeLight(lightSource, material, ray, hitRecord.p, hitRecord.normal, l, nullptr);
+            }
+        }
+        return Shading::finish(color, hitRecord.color);
+    }
+}
+
+TEST(crtTest, WavefrontMatchesRecursiveTracing) {
+    std::mt19937 random(17);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(5.0f, 30.0f);
+
+    // Mirror-like spheres facing each other, so paths reach the reflection limit.
+    const Material mirror({0.01f, 0.01f, 0.01f}, {0.2f, 0.2f, 0.2f}, {0.7f, 0.7f, 0.7f}, 50.0f);
+    const Material matte({0.05f, 0.05f, 0.05f}, {0.6f, 0.3f, 0.3f}, {0.0f, 0.0f, 0.0f}, 0.0f);
+    Scene scene;
+    for (int i = 0; i < 40; ++i) {
+        scene.addSurface(std::make_shared<Sphere>(Vector3f{position(random), position(random), position(random)},
+                                                  size(random), i % 2 ? mirror : matte));
+    }
+    scene.addSurface(std::make_shared<Plane>(Vector3f{0.0f, 1.0f, 0.0f}, Vector3f{0.0f, -120.0f, 0.0f}, mirror));
+    const std::vector<LightSource> lightSources = {
+            {{300.0f, 400.0f, 500.0f}, {1.0f, 1.0f, 1.0f}},
+            {{-200.0f, 300.0f, -100.0f}, {0.3f, 0.3f, 0.3f}},
+    };
+
+    std::vector<Ray> rays;
+    std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+    for (int i = 0; i < 1000; ++i) {
+        const Vector3f target{position(random), position(random), position(random)};
+        rays.push_back(Ray{Vector3f{0.0f, 50.0f, 400.0f}, (target - Vector3f{0.0f, 50.0f, 400.0f}).normalize()});
+    }
+
+    WavefrontTracer tracer(scene, lightSources, kOptions);
+    std::vector<Vector3f> colors(rays.size());
+    // Twice through the same tracer, the second batch reuses the queues of the first.
+    for (int batch = 0; batch < 2; ++batch) {
+        const auto rayCount = tracer.trace(rays.data(), static_cast<int>(rays.size()), colors.data());
+        ASSERT_GT(rayCount, rays.size() * 3);
+        int litCount = 0;
+        for (size_t i = 0; i < rays.size(); ++i) {
+            const auto expected = traceRecursive(scene, lightSources, rays[i], 0.0f, 0);
+            ASSERT_EQ(expected, colors[i]) << "ray " << i;
+            litCount += expected != Vector3f{};
+        }
+        ASSERT_GT(litCount, 100);
+    }
+}